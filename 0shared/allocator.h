@@ -0,0 +1,94 @@
+/*--------------------------------------------------------------------*/
+/* allocator.h                                                        */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef ALLOCATOR_INCLUDED
+#define ALLOCATOR_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  An Allocator_T is where a DynArray, a Path or a Node gets its
+  memory: a table of functions that share a context pointer. Every
+  block is given back with the size it was last allocated with, so an
+  allocator need not record sizes itself. A NULL Allocator_T stands
+  for malloc, realloc and free, and costs nothing over calling them
+  directly.
+*/
+struct allocator
+{
+   /* returns a block of ulSize bytes, aligned at least for a pointer
+      or a size_t, or NULL if memory could not be allocated */
+   void *(*pfAlloc)(void *pvContext, size_t ulSize);
+   /* returns pvBlock, of ulOldSize bytes, resized to ulNewSize bytes
+      as realloc does, or NULL, leaving pvBlock alone, if memory could
+      not be allocated */
+   void *(*pfRealloc)(void *pvContext, void *pvBlock, size_t ulOldSize,
+                      size_t ulNewSize);
+   /* gives back pvBlock, of ulSize bytes */
+   void (*pfRelease)(void *pvContext, void *pvBlock, size_t ulSize);
+   /* passed to each of the functions above */
+   void *pvContext;
+};
+
+typedef const struct allocator *Allocator_T;
+
+/*--------------------------------------------------------------------*/
+
+/* Returns a block of ulSize bytes from oAAlloc, or NULL if memory
+   could not be allocated. */
+static inline void *Allocator_alloc(Allocator_T oAAlloc, size_t ulSize)
+{
+   if (oAAlloc == NULL)
+      return malloc(ulSize);
+   return (*oAAlloc->pfAlloc)(oAAlloc->pvContext, ulSize);
+}
+
+/* Returns a zeroed block of ulCount objects of ulSize bytes from
+   oAAlloc, or NULL if memory could not be allocated. */
+static inline void *Allocator_calloc(Allocator_T oAAlloc, size_t ulCount,
+                                     size_t ulSize)
+{
+   void *pvBlock;
+
+   if (oAAlloc == NULL)
+      return calloc(ulCount, ulSize);
+   if (ulSize != 0 && ulCount > SIZE_MAX / ulSize)
+      return NULL;
+   pvBlock = (*oAAlloc->pfAlloc)(oAAlloc->pvContext, ulCount * ulSize);
+   if (pvBlock != NULL)
+      memset(pvBlock, 0, ulCount * ulSize);
+   return pvBlock;
+}
+
+/* Returns pvBlock, of ulOldSize bytes from oAAlloc, resized to
+   ulNewSize bytes as realloc does, or NULL, leaving pvBlock alone, if
+   memory could not be allocated. pvBlock may be NULL, and ulOldSize
+   then 0. */
+static inline void *Allocator_realloc(Allocator_T oAAlloc, void *pvBlock,
+                                      size_t ulOldSize, size_t ulNewSize)
+{
+   if (oAAlloc == NULL)
+      return realloc(pvBlock, ulNewSize);
+   if (pvBlock == NULL)
+      return (*oAAlloc->pfAlloc)(oAAlloc->pvContext, ulNewSize);
+   return (*oAAlloc->pfRealloc)(oAAlloc->pvContext, pvBlock, ulOldSize,
+                                ulNewSize);
+}
+
+/* Gives back pvBlock, of ulSize bytes from oAAlloc. pvBlock may be
+   NULL, in which case nothing is done. */
+static inline void Allocator_release(Allocator_T oAAlloc, void *pvBlock,
+                                     size_t ulSize)
+{
+   if (oAAlloc == NULL)
+      free(pvBlock);
+   else if (pvBlock != NULL)
+      (*oAAlloc->pfRelease)(oAAlloc->pvContext, pvBlock, ulSize);
+}
+
+#endif
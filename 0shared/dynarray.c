@@ -5,13 +5,69 @@
 
 #include "dynarray.h"
 #include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 /*--------------------------------------------------------------------*/
 
-/* The minimum physical length of a DynArray object. */
+/* The minimum physical length of a DynArray object, which is also
+   the number of elements it holds within itself before it moves them
+   to an array of their own.  Most DynArray objects (the components
+   of a path, for instance) stay this short, and so take a single
+   allocation. */
 
-static const size_t MIN_PHYS_LENGTH = 2;
+enum {INLINE_LENGTH = 4};
+
+/* The percentage by which a DynArray object grows its physical
+   length when it runs out of room, unless DynArray_setGrowth says
+   otherwise: doubling it. */
+
+enum {DEFAULT_GROWTH_PERCENT = 100};
+
+/*--------------------------------------------------------------------*/
+
+/* Hint that the memory at pv will soon be read, if the compiler
+   offers a way to. */
+
+#ifdef __GNUC__
+#define DynArray_prefetch(pv) __builtin_prefetch(pv)
+#else
+#define DynArray_prefetch(pv) ((void)(pv))
+#endif
+
+/*--------------------------------------------------------------------*/
+
+/* Call *pfCompare on pv1 and pv2 for a sort or merge, or for a
+   search; note the growth of oDynArray to uPhysLength elements of
+   uBytes bytes, or uShift elements moved by an operation that left
+   oDynArray uLength long; and make psStats the counts that the
+   comparisons made by this thread go to.  Only an instrumented build
+   counts them (see DynArray_getStats). */
+
+#ifdef DYNARRAY_STATS
+#define DynArray_sortCompare(pfCompare, pv1, pv2) \
+   (DynArray_countCompares(psCounting, 1, 1), \
+    (*(pfCompare))((pv1), (pv2)))
+#define DynArray_searchCompare(pfCompare, pv1, pv2) \
+   (DynArray_countCompares(psCounting, 1, 0), \
+    (*(pfCompare))((pv1), (pv2)))
+#define DynArray_noteGrow(oDynArray, uPhysLength, uBytes) \
+   DynArray_countGrow(&(oDynArray)->sStats, (uPhysLength), (uBytes))
+#define DynArray_noteShift(oDynArray, uShift, uLength) \
+   DynArray_countShift(&(oDynArray)->sStats, (uShift), (uLength))
+#define DynArray_countInto(psStats) ((void)(psCounting = (psStats)))
+#else
+#define DynArray_sortCompare(pfCompare, pv1, pv2) \
+   ((*(pfCompare))((pv1), (pv2)))
+#define DynArray_searchCompare(pfCompare, pv1, pv2) \
+   ((*(pfCompare))((pv1), (pv2)))
+#define DynArray_noteGrow(oDynArray, uPhysLength, uBytes) ((void)0)
+#define DynArray_noteShift(oDynArray, uShift, uLength) ((void)0)
+#define DynArray_countInto(psStats) ((void)0)
+#endif
 
 /*--------------------------------------------------------------------*/
 
@@ -28,12 +84,47 @@ struct DynArray
       DynArray. */
    size_t uPhysLength;
 
-   /* The array that underlies the DynArray. */
+   /* The array that underlies the DynArray: either apvInline or an
+      array of its own. */
    const void **ppvArray;
+
+   /* The elements of a DynArray whose physical length is
+      INLINE_LENGTH. */
+   const void *apvInline[INLINE_LENGTH];
+
+   /* The allocator that the DynArray and its array come from. */
+   Allocator_T oAAlloc;
+
+   /* The percentage of its physical length by which the DynArray
+      grows when it runs out of room. */
+   size_t uGrowthPercent;
+
+#ifdef DYNARRAY_STATS
+   /* The counts kept for the DynArray by an instrumented build. */
+   struct DynArrayStats sStats;
+#endif
 };
 
 /*--------------------------------------------------------------------*/
 
+#ifdef DYNARRAY_STATS
+
+/* The counts that the comparisons made by this thread go to: those
+   of the array that the thread's current sort, merge, or search
+   works on.  Each of them sets it before it compares. */
+
+#ifdef __GNUC__
+static __thread struct DynArrayStats *psCounting;
+#else
+static struct DynArrayStats *psCounting;
+#endif
+
+static void DynArray_keepWorst(DynArray_T oDynArray);
+
+#endif
+
+/*--------------------------------------------------------------------*/
+
 #ifndef NDEBUG
 
 /* Check the invariants of oDynArray.  Return 1 (TRUE) iff oDynArray
@@ -41,9 +132,12 @@ struct DynArray
 
 static int DynArray_isValid(DynArray_T oDynArray)
 {
-   if (oDynArray->uPhysLength < MIN_PHYS_LENGTH) return 0;
+   if (oDynArray->uPhysLength < INLINE_LENGTH) return 0;
    if (oDynArray->uLength > oDynArray->uPhysLength) return 0;
    if (oDynArray->ppvArray == NULL) return 0;
+   if ((oDynArray->ppvArray == oDynArray->apvInline) !=
+       (oDynArray->uPhysLength == INLINE_LENGTH)) return 0;
+   if (oDynArray->uGrowthPercent == 0) return 0;
    return 1;
 }
 
@@ -51,51 +145,141 @@ static int DynArray_isValid(DynArray_T oDynArray)
 
 /*--------------------------------------------------------------------*/
 
+/* Increase the physical length of oDynArray to uNewLength, moving
+   its elements out of apvInline if they are still there.  Return 1
+   (TRUE) if successful and 0 (FALSE) if insufficient memory is
+   available. */
+
+static int DynArray_resize(DynArray_T oDynArray, size_t uNewLength)
+{
+   const void **ppvNewArray;
+
+   assert(oDynArray != NULL);
+   assert(uNewLength > oDynArray->uPhysLength);
+
+   if (oDynArray->ppvArray == oDynArray->apvInline)
+   {
+      ppvNewArray = (const void**)Allocator_alloc(
+         oDynArray->oAAlloc, sizeof(void*) * uNewLength);
+      if (ppvNewArray == NULL)
+         return 0;
+      memcpy(ppvNewArray, oDynArray->apvInline,
+             sizeof(void*) * oDynArray->uLength);
+   }
+   else
+   {
+      ppvNewArray = (const void**)Allocator_realloc(
+         oDynArray->oAAlloc, (void*)oDynArray->ppvArray,
+         sizeof(void*) * oDynArray->uPhysLength,
+         sizeof(void*) * uNewLength);
+      if (ppvNewArray == NULL)
+         return 0;
+   }
+
+   oDynArray->uPhysLength = uNewLength;
+   oDynArray->ppvArray = ppvNewArray;
+   DynArray_noteGrow(oDynArray, uNewLength, sizeof(void*) * uNewLength);
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t DynArray_grownLength(size_t uPhysLength, size_t uPercent)
+{
+   size_t uIncrease;
+
+   assert(uPercent > 0);
+
+   /* split the product so that it cannot overflow */
+   uIncrease = uPhysLength / 100 * uPercent +
+      uPhysLength % 100 * uPercent / 100;
+   if (uIncrease == 0)
+      uIncrease = 1;
+   return uPhysLength + uIncrease;
+}
+
+/*--------------------------------------------------------------------*/
+
 /* Increase the physical length of oDynArray.  Return 1 (TRUE) if
    successful and 0 (FALSE) if insufficient memory is available. */
 
 static int DynArray_grow(DynArray_T oDynArray)
 {
-   const size_t GROWTH_FACTOR = 2;
+   assert(oDynArray != NULL);
+
+   return DynArray_resize(oDynArray,
+                          DynArray_grownLength(oDynArray->uPhysLength,
+                                               oDynArray->uGrowthPercent));
+}
 
+/*--------------------------------------------------------------------*/
+
+/* Increase the physical length of oDynArray, if need be, so that it
+   can hold uCount more elements.  Return 1 (TRUE) if successful and
+   0 (FALSE) if insufficient memory is available, in which case
+   oDynArray is unchanged. */
+
+static int DynArray_makeRoom(DynArray_T oDynArray, size_t uCount)
+{
    size_t uNewLength;
-   const void **ppvNewArray;
 
    assert(oDynArray != NULL);
 
-   uNewLength = GROWTH_FACTOR * oDynArray->uPhysLength;
+   if (uCount <= oDynArray->uPhysLength - oDynArray->uLength)
+      return 1;
+   if (uCount == 1)
+      return DynArray_grow(oDynArray);
 
-   ppvNewArray = (const void**)
-      realloc(oDynArray->ppvArray, sizeof(void*) * uNewLength);
-   if (ppvNewArray == NULL)
-      return 0;
+   /* grow at least as DynArray_grow would, so that repeated range
+      insertions still take amortized constant time per element */
+   uNewLength = DynArray_grownLength(oDynArray->uPhysLength,
+                                     oDynArray->uGrowthPercent);
+   if (uNewLength < oDynArray->uLength + uCount)
+      uNewLength = oDynArray->uLength + uCount;
 
-   oDynArray->uPhysLength = uNewLength;
-   oDynArray->ppvArray = ppvNewArray;
-   return 1;
+   return DynArray_resize(oDynArray, uNewLength);
 }
 
 /*--------------------------------------------------------------------*/
 
 DynArray_T DynArray_new(size_t uLength)
+{
+   return DynArray_newWith(uLength, NULL);
+}
+
+/*--------------------------------------------------------------------*/
+
+DynArray_T DynArray_newWith(size_t uLength, Allocator_T oAAlloc)
 {
    DynArray_T oDynArray;
 
-   oDynArray = (struct DynArray*)malloc(sizeof(struct DynArray));
+   oDynArray = (struct DynArray*)Allocator_alloc(oAAlloc,
+                                                 sizeof(struct DynArray));
    if (oDynArray == NULL)
       return NULL;
 
    oDynArray->uLength = uLength;
-   if (uLength > MIN_PHYS_LENGTH)
-      oDynArray->uPhysLength = uLength;
-   else
-      oDynArray->uPhysLength = MIN_PHYS_LENGTH;
+   oDynArray->oAAlloc = oAAlloc;
+   oDynArray->uGrowthPercent = DEFAULT_GROWTH_PERCENT;
+#ifdef DYNARRAY_STATS
+   memset(&oDynArray->sStats, 0, sizeof(oDynArray->sStats));
+#endif
 
-   oDynArray->ppvArray =
-      (const void**)calloc(oDynArray->uPhysLength, sizeof(void*));
+   /* a short array needs no allocation of its own */
+   if (uLength <= INLINE_LENGTH)
+   {
+      oDynArray->uPhysLength = INLINE_LENGTH;
+      oDynArray->ppvArray = oDynArray->apvInline;
+      memset(oDynArray->apvInline, 0, sizeof(oDynArray->apvInline));
+      return oDynArray;
+   }
+
+   oDynArray->uPhysLength = uLength;
+   oDynArray->ppvArray = (const void**)Allocator_calloc(
+      oAAlloc, oDynArray->uPhysLength, sizeof(void*));
    if (oDynArray->ppvArray == NULL)
    {
-      free(oDynArray);
+      Allocator_release(oAAlloc, oDynArray, sizeof(struct DynArray));
       return NULL;
    }
 
@@ -109,8 +293,79 @@ void DynArray_free(DynArray_T oDynArray)
    assert(oDynArray != NULL);
    assert(DynArray_isValid(oDynArray));
 
-   free(oDynArray->ppvArray);
-   free(oDynArray);
+#ifdef DYNARRAY_STATS
+   DynArray_keepWorst(oDynArray);
+#endif
+   if (oDynArray->ppvArray != oDynArray->apvInline)
+      Allocator_release(oDynArray->oAAlloc, (void*)oDynArray->ppvArray,
+                        sizeof(void*) * oDynArray->uPhysLength);
+   Allocator_release(oDynArray->oAAlloc, oDynArray,
+                     sizeof(struct DynArray));
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_reserve(DynArray_T oDynArray, size_t uPhysLength)
+{
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   if (uPhysLength <= oDynArray->uPhysLength)
+      return 1;
+   return DynArray_resize(oDynArray, uPhysLength);
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_shrinkToFit(DynArray_T oDynArray)
+{
+   const void **ppvNewArray;
+   size_t uNewLength;
+
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   uNewLength = oDynArray->uLength;
+   if (uNewLength < INLINE_LENGTH)
+      uNewLength = INLINE_LENGTH;
+   if (uNewLength == oDynArray->uPhysLength)
+      return 1;
+
+   if (uNewLength == INLINE_LENGTH)
+   {
+      /* move the elements back into the DynArray itself */
+      memcpy(oDynArray->apvInline, oDynArray->ppvArray,
+             sizeof(void*) * oDynArray->uLength);
+      Allocator_release(oDynArray->oAAlloc, (void*)oDynArray->ppvArray,
+                        sizeof(void*) * oDynArray->uPhysLength);
+      ppvNewArray = oDynArray->apvInline;
+   }
+   else
+   {
+      ppvNewArray = (const void**)Allocator_realloc(
+         oDynArray->oAAlloc, (void*)oDynArray->ppvArray,
+         sizeof(void*) * oDynArray->uPhysLength,
+         sizeof(void*) * uNewLength);
+      if (ppvNewArray == NULL)
+         return 0;
+   }
+
+   oDynArray->uPhysLength = uNewLength;
+   oDynArray->ppvArray = ppvNewArray;
+
+   assert(DynArray_isValid(oDynArray));
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_setGrowth(DynArray_T oDynArray, size_t uPercent)
+{
+   assert(oDynArray != NULL);
+   assert(uPercent > 0);
+   assert(DynArray_isValid(oDynArray));
+
+   oDynArray->uGrowthPercent = uPercent;
 }
 
 /*--------------------------------------------------------------------*/
@@ -177,21 +432,32 @@ int DynArray_add(DynArray_T oDynArray, const void *pvElement)
 int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
                    const void *pvElement)
 {
-   size_t u;
+   return DynArray_insertRange(oDynArray, uIndex, &pvElement, 1);
+}
+
+/*--------------------------------------------------------------------*/
 
+int DynArray_insertRange(DynArray_T oDynArray, size_t uIndex,
+                         const void * const *ppvElements, size_t uCount)
+{
    assert(oDynArray != NULL);
    assert(uIndex <= oDynArray->uLength);
+   assert(ppvElements != NULL || uCount == 0);
    assert(DynArray_isValid(oDynArray));
 
-   if (oDynArray->uLength == oDynArray->uPhysLength)
-      if (! DynArray_grow(oDynArray))
-         return 0;
-
-   for (u = oDynArray->uLength; u > uIndex; u--)
-      oDynArray->ppvArray[u] = oDynArray->ppvArray[u-1];
+   if (! DynArray_makeRoom(oDynArray, uCount))
+      return 0;
 
-   oDynArray->ppvArray[uIndex] = pvElement;
-   oDynArray->uLength++;
+   /* open the gap with one move of the tail */
+   memmove(&oDynArray->ppvArray[uIndex + uCount],
+           &oDynArray->ppvArray[uIndex],
+           sizeof(void*) * (oDynArray->uLength - uIndex));
+   if (uCount > 0)
+      memcpy(&oDynArray->ppvArray[uIndex], ppvElements,
+             sizeof(void*) * uCount);
+   oDynArray->uLength += uCount;
+   DynArray_noteShift(oDynArray, oDynArray->uLength - uIndex - uCount,
+                      oDynArray->uLength);
 
    assert(DynArray_isValid(oDynArray));
 
@@ -200,25 +466,117 @@ int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
 
 /*--------------------------------------------------------------------*/
 
-void *DynArray_removeAt(DynArray_T oDynArray, size_t uIndex)
+int DynArray_mergeSorted(DynArray_T oDynArray,
+                         const void * const *ppvElements, size_t uCount,
+                         int (*pfCompare)(const void *pvElement1,
+                                          const void *pvElement2),
+                         size_t *puDuplicates)
 {
-   const void *pvOldElement;
-   size_t u;
+   const void **ppvArray;
+   const void *pvLastNew = NULL;
+   size_t uOld;
+   size_t uNew;
+   size_t uTo;
+   size_t uEnd;
+   int iComparison;
 
    assert(oDynArray != NULL);
-   assert(uIndex < oDynArray->uLength);
+   assert(ppvElements != NULL || uCount == 0);
+   assert(pfCompare != NULL);
    assert(DynArray_isValid(oDynArray));
 
-   pvOldElement = oDynArray->ppvArray[uIndex];
+   if (! DynArray_makeRoom(oDynArray, uCount))
+      return 0;
+   DynArray_countInto(&oDynArray->sStats);
+
+   /* Fill the array from its new end down, taking the greater of the
+      last old and the last new element not yet placed.  Once the new
+      elements run out, the old ones left are already in place. */
+   ppvArray = oDynArray->ppvArray;
+   uOld = oDynArray->uLength;
+   uNew = uCount;
+   uEnd = uOld + uCount;
+   uTo = uEnd;
+   while (uNew > 0)
+   {
+      if (uOld > 0)
+      {
+         iComparison = DynArray_sortCompare(pfCompare, ppvArray[uOld - 1],
+                                    ppvElements[uNew - 1]);
+         if (iComparison > 0)
+         {
+            ppvArray[--uTo] = ppvArray[--uOld];
+            pvLastNew = NULL;
+            continue;
+         }
+         if (iComparison == 0)
+         {
+            uNew--;
+            continue;
+         }
+      }
 
-   oDynArray->uLength--;
+      /* a new element can only repeat the one placed just before */
+      if (pvLastNew == NULL ||
+          DynArray_sortCompare(pfCompare, ppvElements[uNew - 1],
+                               pvLastNew) != 0)
+      {
+         pvLastNew = ppvElements[uNew - 1];
+         ppvArray[--uTo] = pvLastNew;
+      }
+      uNew--;
+   }
 
-   for (u = uIndex; u < oDynArray->uLength; u++)
-      oDynArray->ppvArray[u] = oDynArray->ppvArray[u+1];
+   /* close the gap the duplicates left, if any */
+   if (uTo > uOld)
+      memmove(&ppvArray[uOld], &ppvArray[uTo],
+              sizeof(void*) * (uEnd - uTo));
+   if (puDuplicates != NULL)
+      *puDuplicates = uTo - uOld;
+   /* the old elements moved, counting those moved twice twice */
+   DynArray_noteShift(oDynArray, oDynArray->uLength - uOld +
+                      (uTo > uOld ? uEnd - uTo : 0),
+                      uEnd - (uTo - uOld));
+   oDynArray->uLength = uEnd - (uTo - uOld);
 
    assert(DynArray_isValid(oDynArray));
 
-   return (void*)pvOldElement;
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+void *DynArray_removeAt(DynArray_T oDynArray, size_t uIndex)
+{
+   void *pvOldElement;
+
+   DynArray_removeRange(oDynArray, uIndex, 1, &pvOldElement);
+   return pvOldElement;
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_removeRange(DynArray_T oDynArray, size_t uIndex,
+                          size_t uCount, void **ppvRemoved)
+{
+   assert(oDynArray != NULL);
+   assert(uIndex <= oDynArray->uLength);
+   assert(uCount <= oDynArray->uLength - uIndex);
+   assert(DynArray_isValid(oDynArray));
+
+   if (ppvRemoved != NULL && uCount > 0)
+      memcpy(ppvRemoved, &oDynArray->ppvArray[uIndex],
+             sizeof(void*) * uCount);
+
+   /* close the gap with one move of the tail */
+   memmove(&oDynArray->ppvArray[uIndex],
+           &oDynArray->ppvArray[uIndex + uCount],
+           sizeof(void*) * (oDynArray->uLength - uIndex - uCount));
+   oDynArray->uLength -= uCount;
+   DynArray_noteShift(oDynArray, oDynArray->uLength - uIndex,
+                      oDynArray->uLength);
+
+   assert(DynArray_isValid(oDynArray));
 }
 
 /*--------------------------------------------------------------------*/
@@ -253,131 +611,1122 @@ void DynArray_map(DynArray_T oDynArray,
 
 /*--------------------------------------------------------------------*/
 
-/* Sort the array of elements that resides in memory at
-   addresses ppvLo...ppvHi in ascending order, as determined
-   by *pfCompare.
-   *pfCompare must return <0, 0, or >0 depending upon whether
-   *pvElement1 is less than, equal to, or greater than *pvElement2,
-   respectively. */
-
-static void DynArray_qsort(
-   const void **ppvLo,
-   const void **ppvHi,
-   int (*pfCompare) (const void *pvElement1, const void *pvElement2))
-{
-   /* This function implements a variation of the quicksort algorithm
-      shown in the book "Algorithms + Data Structures = Programs" by
-      Niklaus Wirth. */
+/* The longest range the sorts below leave to insertion sort, the
+   shortest one for which the introsort chooses its pivot as the
+   median of three medians of three, and the most elements a partial
+   insertion sort moves before it gives up. */
 
-   /* This function uses pointers instead of indices to avoid
-      complications with using unsigned integers as array indices. */
+enum {INSERTION_LENGTH = 16, NINTHER_LENGTH = 128, PARTIAL_LIMIT = 8};
 
-   const void **ppvRight;
-   const void **ppvLeft;
-   const void *pvPivot;
-   const void *pvTemp;
+/* The most pending ranges either sort below ever keeps: one per bit
+   of a length, for each of the two ranges it may put off at once. */
 
-   assert(ppvLo != NULL);
-   assert(ppvHi != NULL);
-   assert(pfCompare != NULL);
+enum {SORT_STACK_SIZE = 2 * 8 * sizeof(size_t)};
 
-   ppvRight = ppvLo;
-   ppvLeft = ppvHi;
-   pvPivot = *(ppvLo + ((ppvHi - ppvLo) / 2));
+/*--------------------------------------------------------------------*/
 
-   while (ppvRight <= ppvLeft)
-   {
-      while ((*pfCompare)(*ppvRight, pvPivot) < 0)
-         ppvRight++;
-      while ((*pfCompare)(pvPivot, *ppvLeft) < 0)
-         ppvLeft--;
-      if (ppvRight <= ppvLeft)
-      {
-         /* Swap *ppvRight and *ppvLeft. */
-         pvTemp = *ppvRight;
-         *ppvRight = *ppvLeft;
-         *ppvLeft = pvTemp;
+/* Swap the elements at ppvOne and ppvTwo. */
 
-         ppvRight++;
-         ppvLeft--;
-      }
-   }
+static void DynArray_swap(const void **ppvOne, const void **ppvTwo)
+{
+   const void *pvTemp;
 
-   if (ppvLo < ppvLeft)
-      DynArray_qsort(ppvLo, ppvLeft, pfCompare);
-   if (ppvRight < ppvHi)
-      DynArray_qsort(ppvRight, ppvHi, pfCompare);
+   pvTemp = *ppvOne;
+   *ppvOne = *ppvTwo;
+   *ppvTwo = pvTemp;
 }
 
 /*--------------------------------------------------------------------*/
 
-void DynArray_sort(DynArray_T oDynArray,
-                   int (*pfCompare)(const void *pvElement1,
-                                    const void *pvElement2))
+/* Sort the elements at addresses ppvBegin...ppvEnd-1 with insertion
+   sort, as determined by *pfCompare.  If bPartial is 1 (TRUE), give
+   up once more than PARTIAL_LIMIT elements have been moved.  Return
+   1 (TRUE) if the elements are sorted, and 0 (FALSE) if it gave
+   up. */
+
+static int DynArray_insertionSort(
+   const void **ppvBegin,
+   const void **ppvEnd,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2),
+   int bPartial)
 {
-   assert(oDynArray != NULL);
+   const void **ppvCur;
+   const void **ppvSift;
+   const void *pvElement;
+   size_t uMoved = 0;
+
+   assert(ppvBegin != NULL);
+   assert(ppvEnd != NULL);
    assert(pfCompare != NULL);
-   assert(DynArray_isValid(oDynArray));
 
-   if (oDynArray->uLength < 2)
-      return;
+   if (ppvEnd - ppvBegin < 2)
+      return 1;
 
-   DynArray_qsort(
-      &oDynArray->ppvArray[0],
-      &oDynArray->ppvArray[oDynArray->uLength-1],
-      pfCompare);
+   for (ppvCur = ppvBegin + 1; ppvCur < ppvEnd; ppvCur++)
+   {
+      pvElement = *ppvCur;
+      for (ppvSift = ppvCur;
+           ppvSift > ppvBegin &&
+              DynArray_sortCompare(pfCompare, pvElement, ppvSift[-1]) < 0;
+           ppvSift--)
+         *ppvSift = ppvSift[-1];
+      *ppvSift = pvElement;
+
+      uMoved += (size_t)(ppvCur - ppvSift);
+      if (bPartial && uMoved > PARTIAL_LIMIT)
+         return 0;
+   }
+   return 1;
+}
 
-   assert(DynArray_isValid(oDynArray));
+/*--------------------------------------------------------------------*/
+
+/* Move the element at index uRoot of the heap of uLength elements at
+   ppvBase down to its place, as determined by *pfCompare. */
+
+static void DynArray_siftDown(
+   const void **ppvBase,
+   size_t uRoot,
+   size_t uLength,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+{
+   const void *pvElement;
+   size_t uChild;
+
+   pvElement = ppvBase[uRoot];
+   while ((uChild = 2 * uRoot + 1) < uLength)
+   {
+      if (uChild + 1 < uLength &&
+          DynArray_sortCompare(pfCompare, ppvBase[uChild],
+                               ppvBase[uChild + 1]) < 0)
+         uChild++;
+      if (DynArray_sortCompare(pfCompare, pvElement, ppvBase[uChild]) >= 0)
+         break;
+      ppvBase[uRoot] = ppvBase[uChild];
+      uRoot = uChild;
+   }
+   ppvBase[uRoot] = pvElement;
 }
 
 /*--------------------------------------------------------------------*/
 
-int DynArray_search(DynArray_T oDynArray,
-                    void *pvSoughtElement,
-                    size_t *puIndex,
-                    int (*pfCompare)(const void *pvElement1,
-                                     const void *pvElement2))
+/* Sort the elements at addresses ppvBegin...ppvEnd-1 with heapsort,
+   as determined by *pfCompare. */
+
+static void DynArray_heapSort(
+   const void **ppvBegin,
+   const void **ppvEnd,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
 {
+   size_t uLength;
    size_t u;
 
-   assert(oDynArray != NULL);
-   assert(puIndex != NULL);
-   assert(pfCompare != NULL);
-   assert(DynArray_isValid(oDynArray));
-
-   for (u = 0; u < oDynArray->uLength; u++)
-      if ((*pfCompare)(oDynArray->ppvArray[u], pvSoughtElement) == 0)
-      {
-         *puIndex = u;
-         return 1;
-      }
-   return 0;
+   uLength = (size_t)(ppvEnd - ppvBegin);
+   for (u = uLength / 2; u > 0; u--)
+      DynArray_siftDown(ppvBegin, u - 1, uLength, pfCompare);
+   for (u = uLength; u > 1; u--)
+   {
+      DynArray_swap(&ppvBegin[0], &ppvBegin[u - 1]);
+      DynArray_siftDown(ppvBegin, 0, u - 1, pfCompare);
+   }
 }
 
+/*--------------------------------------------------------------------*/
+
+/* Order the elements at ppvA, ppvB and ppvC so that *ppvB is their
+   median, as determined by *pfCompare. */
 
+static void DynArray_sort3(
+   const void **ppvA,
+   const void **ppvB,
+   const void **ppvC,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+{
+   if (DynArray_sortCompare(pfCompare, *ppvB, *ppvA) < 0)
+      DynArray_swap(ppvA, ppvB);
+   if (DynArray_sortCompare(pfCompare, *ppvC, *ppvB) < 0)
+   {
+      DynArray_swap(ppvB, ppvC);
+      if (DynArray_sortCompare(pfCompare, *ppvB, *ppvA) < 0)
+         DynArray_swap(ppvA, ppvB);
+   }
+}
 
 /*--------------------------------------------------------------------*/
 
-/* Binary search the array of elements that resides in memory at
-   addresses ppvLo...ppvHi for pvSoughtElement.
-   *pfCompare must return <0, 0, or >0 depending upon whether
-   *pvElement1 is less than, equal to, or greater than *pvElement2,
-   respectively. If pvSoughtElement is not found, *pppvInsert is set to
-   point at the memory location where it would be placed if inserted.
-*/
+/* Partition the elements at addresses ppvBegin...ppvEnd-1 around the
+   pivot *ppvBegin: those less than it come before it, and the rest
+   after it.  An element not less than the pivot must follow it.
+   Set *pbAlready to 1 (TRUE) if no element had to move but the
+   pivot.  Return the address where the pivot ends up. */
 
-static const void **DynArray_bsearchHelp(
-   void *pvSoughtElement,
-   const void **ppvLo,
-   const void **ppvHi,
+static const void **DynArray_partitionRight(
+   const void **ppvBegin,
+   const void **ppvEnd,
    int (*pfCompare)(const void *pvElement1, const void *pvElement2),
-   const void*** pppvInsert)
+   int *pbAlready)
 {
-   /* This function uses pointers instead of indices to avoid
-      complications with using unsigned integers as array indices. */
+   const void *pvPivot;
+   const void **ppvFirst;
+   const void **ppvLast;
+
+   pvPivot = *ppvBegin;
+   ppvFirst = ppvBegin;
+   ppvLast = ppvEnd;
+
+   /* The first scan stops at the element known to follow; the second
+      stops at an element the first passed, if there is one. */
+   while (DynArray_sortCompare(pfCompare, *++ppvFirst, pvPivot) < 0)
+      ;
+   if (ppvFirst - 1 == ppvBegin)
+      while (ppvFirst < ppvLast &&
+             DynArray_sortCompare(pfCompare, *--ppvLast, pvPivot) >= 0)
+         ;
+   else
+      while (DynArray_sortCompare(pfCompare, *--ppvLast, pvPivot) >= 0)
+         ;
 
-   const void **ppvMid;
-   int iCompare;
+   *pbAlready = ppvFirst >= ppvLast;
+   while (ppvFirst < ppvLast)
+   {
+      DynArray_swap(ppvFirst, ppvLast);
+      while (DynArray_sortCompare(pfCompare, *++ppvFirst, pvPivot) < 0)
+         ;
+      while (DynArray_sortCompare(pfCompare, *--ppvLast, pvPivot) >= 0)
+         ;
+   }
+
+   *ppvBegin = *(ppvFirst - 1);
+   *(ppvFirst - 1) = pvPivot;
+   return ppvFirst - 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Partition the elements at addresses ppvBegin...ppvEnd-1 around the
+   pivot *ppvBegin, which no element is less than: those equal to it
+   come before it, and the greater ones after it.  Return the address
+   where the pivot ends up. */
+
+static const void **DynArray_partitionLeft(
+   const void **ppvBegin,
+   const void **ppvEnd,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+{
+   const void *pvPivot;
+   const void **ppvFirst;
+   const void **ppvLast;
+
+   pvPivot = *ppvBegin;
+   ppvFirst = ppvBegin;
+   ppvLast = ppvEnd;
+
+   while (DynArray_sortCompare(pfCompare, pvPivot, *--ppvLast) < 0)
+      ;
+   if (ppvLast + 1 == ppvEnd)
+      while (ppvFirst < ppvLast &&
+             DynArray_sortCompare(pfCompare, pvPivot, *++ppvFirst) >= 0)
+         ;
+   else
+      while (DynArray_sortCompare(pfCompare, pvPivot, *++ppvFirst) >= 0)
+         ;
+
+   while (ppvFirst < ppvLast)
+   {
+      DynArray_swap(ppvFirst, ppvLast);
+      while (DynArray_sortCompare(pfCompare, pvPivot, *--ppvLast) < 0)
+         ;
+      while (DynArray_sortCompare(pfCompare, pvPivot, *++ppvFirst) >= 0)
+         ;
+   }
+
+   *ppvBegin = *ppvLast;
+   *ppvLast = pvPivot;
+   return ppvLast;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* A range of elements the introsort has put off sorting. */
+
+struct sortRange
+{
+   /* The range's elements are at addresses ppvBegin...ppvEnd-1. */
+   const void **ppvBegin;
+   const void **ppvEnd;
+
+   /* The number of badly unbalanced partitions still allowed before
+      the range is heapsorted instead. */
+   size_t uBadAllowed;
+
+   /* 1 (TRUE) iff no element precedes the range, so that there is no
+      element before it known to be no greater than any in it. */
+   int bLeftmost;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Sort the array of uLength elements at ppvArray in ascending order,
+   as determined by *pfCompare.
+
+   This is a pattern-defeating quicksort, after Orson Peters's
+   pdqsort.  Short ranges are insertion sorted.  Ranges whose
+   partition moved nothing are tried with an insertion sort that
+   gives up soon, so sorted and nearly sorted input takes linear
+   time.  A range whose pivot is no greater than the element before
+   it holds many equal elements, which are split off at once.  Badly
+   unbalanced partitions shuffle a few elements to break the pattern
+   that caused them, and after too many a range is heapsorted, so the
+   sort takes O(n log n) time whatever the input.  Ranges are kept on
+   an explicit stack, always working on the shorter one first, so it
+   never needs more than SORT_STACK_SIZE entries. */
+
+static void DynArray_introSort(
+   const void **ppvArray,
+   size_t uLength,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2))
+{
+   struct sortRange asStack[SORT_STACK_SIZE];
+   struct sortRange sRange;
+   struct sortRange sLeft;
+   struct sortRange sRight;
+   size_t uStack = 0;
+   size_t uSize;
+   size_t uHalf;
+   size_t uLeft;
+   size_t uRight;
+   const void **ppvBegin;
+   const void **ppvEnd;
+   const void **ppvPivot;
+   int bAlready;
+
+   assert(ppvArray != NULL);
+   assert(pfCompare != NULL);
+
+   sRange.ppvBegin = ppvArray;
+   sRange.ppvEnd = ppvArray + uLength;
+   sRange.uBadAllowed = 0;
+   for (uSize = uLength; uSize > 1; uSize /= 2)
+      sRange.uBadAllowed++;
+   sRange.bLeftmost = 1;
+
+   for (;;)
+   {
+      ppvBegin = sRange.ppvBegin;
+      ppvEnd = sRange.ppvEnd;
+      uSize = (size_t)(ppvEnd - ppvBegin);
+
+      if (uSize < INSERTION_LENGTH)
+      {
+         (void)DynArray_insertionSort(ppvBegin, ppvEnd, pfCompare, 0);
+         if (uStack == 0)
+            return;
+         sRange = asStack[--uStack];
+         continue;
+      }
+
+      /* move the pivot to *ppvBegin */
+      uHalf = uSize / 2;
+      if (uSize > NINTHER_LENGTH)
+      {
+         DynArray_sort3(ppvBegin, ppvBegin + uHalf, ppvEnd - 1,
+                        pfCompare);
+         DynArray_sort3(ppvBegin + 1, ppvBegin + uHalf - 1, ppvEnd - 2,
+                        pfCompare);
+         DynArray_sort3(ppvBegin + 2, ppvBegin + uHalf + 1, ppvEnd - 3,
+                        pfCompare);
+         DynArray_sort3(ppvBegin + uHalf - 1, ppvBegin + uHalf,
+                        ppvBegin + uHalf + 1, pfCompare);
+         DynArray_swap(ppvBegin, ppvBegin + uHalf);
+      }
+      else
+         DynArray_sort3(ppvBegin + uHalf, ppvBegin, ppvEnd - 1,
+                        pfCompare);
+
+      /* a pivot equal to the element before the range is the least
+         element in it, so the elements equal to it are done */
+      if (!sRange.bLeftmost &&
+          DynArray_sortCompare(pfCompare, ppvBegin[-1], *ppvBegin) >= 0)
+      {
+         sRange.ppvBegin =
+            DynArray_partitionLeft(ppvBegin, ppvEnd, pfCompare) + 1;
+         continue;
+      }
+
+      ppvPivot = DynArray_partitionRight(ppvBegin, ppvEnd, pfCompare,
+                                         &bAlready);
+      uLeft = (size_t)(ppvPivot - ppvBegin);
+      uRight = (size_t)(ppvEnd - (ppvPivot + 1));
+
+      if (uLeft < uSize / 8 || uRight < uSize / 8)
+      {
+         if (sRange.uBadAllowed == 0)
+         {
+            DynArray_heapSort(ppvBegin, ppvEnd, pfCompare);
+            if (uStack == 0)
+               return;
+            sRange = asStack[--uStack];
+            continue;
+         }
+         sRange.uBadAllowed--;
+
+         /* shuffle a few elements of each side */
+         if (uLeft >= INSERTION_LENGTH)
+         {
+            DynArray_swap(ppvBegin, ppvBegin + uLeft / 4);
+            DynArray_swap(ppvPivot - 1, ppvPivot - uLeft / 4);
+         }
+         if (uRight >= INSERTION_LENGTH)
+         {
+            DynArray_swap(ppvPivot + 1, ppvPivot + 1 + uRight / 4);
+            DynArray_swap(ppvEnd - 1, ppvEnd - uRight / 4);
+         }
+      }
+      else if (bAlready &&
+               DynArray_insertionSort(ppvBegin, ppvPivot, pfCompare, 1)
+               && DynArray_insertionSort(ppvPivot + 1, ppvEnd,
+                                         pfCompare, 1))
+      {
+         if (uStack == 0)
+            return;
+         sRange = asStack[--uStack];
+         continue;
+      }
+
+      sLeft.ppvBegin = ppvBegin;
+      sLeft.ppvEnd = ppvPivot;
+      sLeft.uBadAllowed = sRange.uBadAllowed;
+      sLeft.bLeftmost = sRange.bLeftmost;
+      sRight.ppvBegin = ppvPivot + 1;
+      sRight.ppvEnd = ppvEnd;
+      sRight.uBadAllowed = sRange.uBadAllowed;
+      sRight.bLeftmost = 0;
+
+      /* put off the longer side */
+      assert(uStack < SORT_STACK_SIZE);
+      if (uLeft > uRight)
+      {
+         asStack[uStack++] = sLeft;
+         sRange = sRight;
+      }
+      else
+      {
+         asStack[uStack++] = sRight;
+         sRange = sLeft;
+      }
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_sort(DynArray_T oDynArray,
+                   int (*pfCompare)(const void *pvElement1,
+                                    const void *pvElement2))
+{
+   assert(oDynArray != NULL);
+   assert(pfCompare != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   if (oDynArray->uLength < 2)
+      return;
+
+   DynArray_countInto(&oDynArray->sStats);
+   DynArray_introSort(oDynArray->ppvArray, oDynArray->uLength,
+                      pfCompare);
+
+   assert(DynArray_isValid(oDynArray));
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the sizeof(size_t) characters of the string pv starting
+   at its uDepth'th, packed most significant first into a size_t, so
+   that the words of two strings compare as strcmp would compare
+   those characters.  The characters past the end of the string are
+   taken as '\0'.  The string must not end before its uDepth'th
+   character. */
+
+static size_t DynArray_wordAt(const void *pv, size_t uDepth)
+{
+   const unsigned char *pucChar;
+   size_t uWord = 0;
+   size_t u;
+
+   pucChar = (const unsigned char*)pv + uDepth;
+   for (u = 0; u < sizeof(size_t); u++)
+   {
+      uWord = (uWord << 8) | *pucChar;
+      if (*pucChar != '\0')
+         pucChar++;
+   }
+   return uWord;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return <0, 0, or >0 depending upon whether the string pvString1 is
+   less than, equal to, or greater than pvString2.  The strings must
+   be equal in their first uDepth characters. */
+
+static int DynArray_compareFrom(const void *pvString1,
+                                const void *pvString2, size_t uDepth)
+{
+   return strcmp((const char*)pvString1 + uDepth,
+                 (const char*)pvString2 + uDepth);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return <0, 0, or >0 depending upon whether the string pvString1 is
+   less than, equal to, or greater than pvString2. */
+
+static int DynArray_compareStrings(const void *pvString1,
+                                   const void *pvString2)
+{
+   return strcmp((const char*)pvString1, (const char*)pvString2);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* A range of strings, equal in their first uDepth characters, that
+   DynArray_sortStrings has put off sorting. */
+
+struct stringRange
+{
+   /* The range's strings are the uBegin'th...(uEnd-1)'th. */
+   size_t uBegin;
+   size_t uEnd;
+
+   /* The number of leading characters they are known to share. */
+   size_t uDepth;
+
+   /* 1 (TRUE) iff the cached words of the range's strings are their
+      words at uDepth. */
+   int bCached;
+};
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_sortStrings(DynArray_T oDynArray)
+{
+   struct stringRange asStack[SORT_STACK_SIZE];
+   struct stringRange asParts[3];
+   struct stringRange sRange;
+   struct stringRange sTemp;
+   const void **ppvArray;
+   size_t *puWords;
+   size_t uStack = 0;
+   size_t u;
+   size_t uLess;
+   size_t uScan;
+   size_t uGreater;
+   size_t uSift;
+   size_t uPivot;
+   size_t uWord;
+   size_t uA, uB, uC;
+   const void *pvElement;
+
+   assert(oDynArray != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   /* This function implements the multikey quicksort of Bentley and
+      Sedgewick: each range is split three ways on one character of
+      its strings, and only the middle part moves on to the next
+      character, so no pair of strings is compared from the start
+      again once they are known to share a prefix.  It splits on a
+      word of sizeof(size_t) characters at a time rather than on one,
+      so that long shared prefixes take few passes, and it caches
+      each string's word in an array alongside the elements, so that
+      a pass reads each string once and then works on the cache. */
+
+   ppvArray = oDynArray->ppvArray;
+
+   /* input already in order, as a re-sort often is, takes one pass */
+   for (u = 1; u < oDynArray->uLength; u++)
+      if (strcmp(ppvArray[u - 1], ppvArray[u]) > 0)
+         break;
+   if (u >= oDynArray->uLength)
+      return;
+
+   puWords = (size_t*)Allocator_alloc(oDynArray->oAAlloc,
+                                      sizeof(size_t) * oDynArray->uLength);
+   if (puWords == NULL)
+   {
+      /* the comparison sort needs no memory */
+      DynArray_introSort(ppvArray, oDynArray->uLength,
+                         DynArray_compareStrings);
+      return;
+   }
+
+   sRange.uBegin = 0;
+   sRange.uEnd = oDynArray->uLength;
+   sRange.uDepth = 0;
+   sRange.bCached = 0;
+
+   for (;;)
+   {
+      if (sRange.uEnd - sRange.uBegin < INSERTION_LENGTH)
+      {
+         /* insertion sort, comparing past the shared prefix */
+         for (u = sRange.uBegin + 1; u < sRange.uEnd; u++)
+         {
+            pvElement = ppvArray[u];
+            for (uSift = u;
+                 uSift > sRange.uBegin &&
+                 DynArray_compareFrom(pvElement, ppvArray[uSift - 1],
+                                      sRange.uDepth) < 0;
+                 uSift--)
+               ppvArray[uSift] = ppvArray[uSift - 1];
+            ppvArray[uSift] = pvElement;
+         }
+         if (uStack == 0)
+            break;
+         sRange = asStack[--uStack];
+         continue;
+      }
+
+      if (!sRange.bCached)
+         for (u = sRange.uBegin; u < sRange.uEnd; u++)
+            puWords[u] = DynArray_wordAt(ppvArray[u], sRange.uDepth);
+
+      /* the pivot word is the median of three */
+      uA = puWords[sRange.uBegin];
+      uB = puWords[sRange.uBegin + (sRange.uEnd - sRange.uBegin) / 2];
+      uC = puWords[sRange.uEnd - 1];
+      if ((uA <= uB && uB <= uC) || (uC <= uB && uB <= uA))
+         uPivot = uB;
+      else if ((uB <= uA && uA <= uC) || (uC <= uA && uA <= uB))
+         uPivot = uA;
+      else
+         uPivot = uC;
+
+      /* split into the uBegin'th...(uLess-1)'th strings with a lesser
+         word, the uLess'th...(uGreater-1)'th with the pivot word, and
+         the uGreater'th...(uEnd-1)'th with a greater one */
+      uLess = sRange.uBegin;
+      uScan = sRange.uBegin;
+      uGreater = sRange.uEnd;
+      while (uScan < uGreater)
+      {
+         uWord = puWords[uScan];
+         if (uWord < uPivot)
+         {
+            DynArray_swap(&ppvArray[uLess], &ppvArray[uScan]);
+            puWords[uScan++] = puWords[uLess];
+            puWords[uLess++] = uWord;
+         }
+         else if (uWord > uPivot)
+         {
+            uGreater--;
+            DynArray_swap(&ppvArray[uScan], &ppvArray[uGreater]);
+            puWords[uScan] = puWords[uGreater];
+            puWords[uGreater] = uWord;
+         }
+         else
+            uScan++;
+      }
+
+      asParts[0].uBegin = sRange.uBegin;
+      asParts[0].uEnd = uLess;
+      asParts[0].uDepth = sRange.uDepth;
+      asParts[0].bCached = 1;
+      asParts[1].uBegin = uLess;
+      asParts[1].uEnd = uGreater;
+      asParts[1].uDepth = sRange.uDepth + sizeof(size_t);
+      asParts[1].bCached = 0;
+      asParts[2].uBegin = uGreater;
+      asParts[2].uEnd = sRange.uEnd;
+      asParts[2].uDepth = sRange.uDepth;
+      asParts[2].bCached = 1;
+
+      /* strings that end in the pivot word are equal, and so already
+         in order */
+      if ((uPivot & 0xff) == 0)
+         asParts[1].uEnd = asParts[1].uBegin;
+
+      /* work on the parts from the shortest to the longest, so that
+         each part put off is at least as long as the one worked on,
+         which bounds the stack */
+      for (u = 1; u < 3; u++)
+         if (asParts[u].uEnd - asParts[u].uBegin <
+             asParts[0].uEnd - asParts[0].uBegin)
+         {
+            sTemp = asParts[0];
+            asParts[0] = asParts[u];
+            asParts[u] = sTemp;
+         }
+      if (asParts[1].uEnd - asParts[1].uBegin <
+          asParts[2].uEnd - asParts[2].uBegin)
+      {
+         sTemp = asParts[1];
+         asParts[1] = asParts[2];
+         asParts[2] = sTemp;
+      }
+      for (u = 1; u < 3; u++)
+         if (asParts[u].uEnd - asParts[u].uBegin > 1)
+         {
+            assert(uStack < SORT_STACK_SIZE);
+            asStack[uStack++] = asParts[u];
+         }
+      sRange = asParts[0];
+   }
+
+   Allocator_release(oDynArray->oAAlloc, puWords,
+                     sizeof(size_t) * oDynArray->uLength);
+   assert(DynArray_isValid(oDynArray));
+}
+
+/*--------------------------------------------------------------------*/
+
+/* The most threads DynArray_parallelMap and DynArray_parallelSort
+   use, and the fewest elements that each of their threads must have
+   to work on for it to be worth starting. */
+
+enum {MAX_THREADS = 64};
+enum {MAP_ELEMENTS_PER_THREAD = 4096};
+enum {SORT_ELEMENTS_PER_THREAD = 16384};
+
+/* The number of pieces per thread that DynArray_parallelMap splits
+   oDynArray into, so that a thread that finishes its pieces early
+   takes over some of those a slower thread would otherwise do. */
+
+enum {MAP_CHUNKS_PER_THREAD = 8};
+
+/* A parallelJob is work that a number of threads do together: uTasks
+   tasks, handed out in order, the uTask'th of which is done by
+   calling (*pfTask)(pvState, uTask). */
+
+struct parallelJob
+{
+   /* The function that does one task. */
+   void (*pfTask)(void *pvState, size_t uTask);
+
+   /* The state that the tasks share. */
+   void *pvState;
+
+   /* The number of tasks. */
+   size_t uTasks;
+
+   /* The index of the next task to hand out. */
+   size_t uNext;
+
+   /* The lock that guards uNext. */
+   pthread_mutex_t sLock;
+};
+
+/* A mapJob is the state of a DynArray_parallelMap. */
+
+struct mapJob
+{
+   /* The elements, their number, and the number of chunks that the
+      tasks map them in. */
+   const void **ppvArray;
+   size_t uLength;
+   size_t uChunks;
+
+   /* The function to apply, and its extra argument. */
+   void (*pfApply)(void *pvElement, void *pvExtra);
+   void *pvExtra;
+};
+
+/* A sortJob is the state of a DynArray_parallelSort. */
+
+struct sortJob
+{
+   /* The array that holds the sorted runs, and the one that they are
+      merged into. */
+   const void **ppvFrom;
+   const void **ppvTo;
+
+   /* The number of runs, and where each begins in ppvFrom, with
+      auBounds[uRuns] the length of both arrays. */
+   size_t uRuns;
+   size_t auBounds[MAX_THREADS + 1];
+
+   /* The number of tasks that merge each pair of runs. */
+   size_t uParts;
+
+   /* The function that orders the elements. */
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2);
+
+#ifdef DYNARRAY_STATS
+   /* The counts of the array being sorted. */
+   struct DynArrayStats *psStats;
+#endif
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Return the number of threads to work on uLength elements with,
+   given that each thread should have at least uPerThread of them:
+   uThreads, or if uThreads is 0, the number of processors online,
+   but never more than MAX_THREADS nor less than 1. */
+
+static size_t DynArray_getThreadCount(size_t uLength,
+                                      size_t uPerThread,
+                                      size_t uThreads)
+{
+   long lProcessors;
+
+   if (uThreads == 0)
+   {
+      lProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+      uThreads = lProcessors < 1 ? 1 : (size_t)lProcessors;
+   }
+   if (uThreads > MAX_THREADS)
+      uThreads = MAX_THREADS;
+   if (uThreads > uLength / uPerThread)
+      uThreads = uLength / uPerThread;
+   return uThreads < 1 ? 1 : uThreads;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return the index at which the uPart'th of uParts nearly equal
+   pieces of uLength elements begins.  uPart may be uParts, giving
+   uLength. */
+
+static size_t DynArray_splitPoint(size_t uLength, size_t uParts,
+                                  size_t uPart)
+{
+   size_t uExtra = uLength % uParts;
+
+   return uPart * (uLength / uParts) + (uPart < uExtra ? uPart : uExtra);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Do the tasks of pvJob, a struct parallelJob, as they are handed
+   out, until there are none left.  Return NULL. */
+
+static void *DynArray_doTasks(void *pvJob)
+{
+   struct parallelJob *psJob = pvJob;
+   size_t uTask;
+
+   for (;;)
+   {
+      (void)pthread_mutex_lock(&psJob->sLock);
+      uTask = psJob->uNext++;
+      (void)pthread_mutex_unlock(&psJob->sLock);
+      if (uTask >= psJob->uTasks)
+         break;
+      (*psJob->pfTask)(psJob->pvState, uTask);
+   }
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Do the uTasks tasks (*pfTask)(pvState, uTask) with uThreads
+   threads, the calling thread among them, and return once all are
+   done.  Fewer threads are used if some cannot be started; at worst
+   the calling thread does every task itself. */
+
+static void DynArray_runTasks(void (*pfTask)(void *pvState,
+                                             size_t uTask),
+                              void *pvState, size_t uTasks,
+                              size_t uThreads)
+{
+   struct parallelJob sJob;
+   pthread_t asThreads[MAX_THREADS];
+   size_t uStarted = 0;
+   size_t u;
+
+   assert(pfTask != NULL);
+   assert(uThreads <= MAX_THREADS);
+
+   sJob.pfTask = pfTask;
+   sJob.pvState = pvState;
+   sJob.uTasks = uTasks;
+   sJob.uNext = 0;
+   (void)pthread_mutex_init(&sJob.sLock, NULL);
+
+   if (uThreads > uTasks)
+      uThreads = uTasks;
+   while (uStarted + 1 < uThreads &&
+          pthread_create(&asThreads[uStarted], NULL, DynArray_doTasks,
+                         &sJob) == 0)
+      uStarted++;
+
+   (void)DynArray_doTasks(&sJob);
+
+   for (u = 0; u < uStarted; u++)
+      (void)pthread_join(asThreads[u], NULL);
+   (void)pthread_mutex_destroy(&sJob.sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Apply the function of pvState, a struct mapJob, to the elements of
+   its uChunk'th chunk. */
+
+static void DynArray_mapChunk(void *pvState, size_t uChunk)
+{
+   struct mapJob *psJob = pvState;
+   size_t uEnd;
+   size_t u;
+
+   u = DynArray_splitPoint(psJob->uLength, psJob->uChunks, uChunk);
+   uEnd = DynArray_splitPoint(psJob->uLength, psJob->uChunks,
+                              uChunk + 1);
+   for (; u < uEnd; u++)
+      (*psJob->pfApply)((void*)psJob->ppvArray[u], psJob->pvExtra);
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_parallelMap(DynArray_T oDynArray,
+                          void (*pfApply)(void *pvElement,
+                                          void *pvExtra),
+                          const void *pvExtra, size_t uThreads)
+{
+   struct mapJob sJob;
+
+   assert(oDynArray != NULL);
+   assert(pfApply != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   uThreads = DynArray_getThreadCount(oDynArray->uLength,
+                                      MAP_ELEMENTS_PER_THREAD, uThreads);
+   if (uThreads == 1)
+   {
+      DynArray_map(oDynArray, pfApply, pvExtra);
+      return;
+   }
+
+   sJob.ppvArray = oDynArray->ppvArray;
+   sJob.uLength = oDynArray->uLength;
+   sJob.uChunks = uThreads * MAP_CHUNKS_PER_THREAD;
+   sJob.pfApply = pfApply;
+   sJob.pvExtra = (void*)pvExtra;
+   DynArray_runTasks(DynArray_mapChunk, &sJob, sJob.uChunks, uThreads);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Sort the uRun'th run of pvState, a struct sortJob, in place. */
+
+static void DynArray_sortRun(void *pvState, size_t uRun)
+{
+   struct sortJob *psJob = pvState;
+
+   DynArray_countInto(psJob->psStats);
+   DynArray_introSort(psJob->ppvFrom + psJob->auBounds[uRun],
+                      psJob->auBounds[uRun + 1] - psJob->auBounds[uRun],
+                      psJob->pfCompare);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Return how many of the first uOut elements of the merge of the
+   sorted arrays ppvLeft, of length uLeft, and ppvRight, of length
+   uRight, come from ppvLeft, given that the merge takes from ppvLeft
+   first when elements are equal. */
+
+static size_t DynArray_coRank(const void **ppvLeft, size_t uLeft,
+                              const void **ppvRight, size_t uRight,
+                              size_t uOut,
+                              int (*pfCompare)(const void *pvElement1,
+                                               const void *pvElement2))
+{
+   size_t uLow = uOut > uRight ? uOut - uRight : 0;
+   size_t uHigh = uOut < uLeft ? uOut : uLeft;
+   size_t uMid;
+
+   /* the answer is the least index whose left element follows the
+      right element that would end the prefix along with it */
+   while (uLow < uHigh)
+   {
+      uMid = uLow + (uHigh - uLow) / 2;
+      if (DynArray_sortCompare(pfCompare, ppvLeft[uMid],
+                               ppvRight[uOut - uMid - 1]) > 0)
+         uHigh = uMid;
+      else
+         uLow = uMid + 1;
+   }
+   return uLow;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Do the uTask'th merge task of pvState, a struct sortJob: merge the
+   part of a pair of runs in ppvFrom that belongs in the task's share
+   of the merged run in ppvTo.  The last run of an odd number of them
+   is paired with an empty one, and so copied. */
+
+static void DynArray_mergePart(void *pvState, size_t uTask)
+{
+   struct sortJob *psJob = pvState;
+   size_t uPair = uTask / psJob->uParts;
+   size_t uPart = uTask % psJob->uParts;
+   const void **ppvLeft;
+   const void **ppvRight;
+   const void **ppvTo;
+   size_t uLeft;
+   size_t uRight;
+   size_t uOut;
+   size_t uOutEnd;
+   size_t uL;
+   size_t uLEnd;
+   size_t uR;
+   size_t uREnd;
+
+   if (2 * uPair >= psJob->uRuns)
+      return;
+   DynArray_countInto(psJob->psStats);
+
+   ppvLeft = psJob->ppvFrom + psJob->auBounds[2 * uPair];
+   uLeft = psJob->auBounds[2 * uPair + 1] - psJob->auBounds[2 * uPair];
+   ppvRight = ppvLeft + uLeft;
+   uRight = 2 * uPair + 1 < psJob->uRuns ?
+      psJob->auBounds[2 * uPair + 2] - psJob->auBounds[2 * uPair + 1] :
+      0;
+   ppvTo = psJob->ppvTo + psJob->auBounds[2 * uPair];
+
+   uOut = DynArray_splitPoint(uLeft + uRight, psJob->uParts, uPart);
+   uOutEnd = DynArray_splitPoint(uLeft + uRight, psJob->uParts,
+                                 uPart + 1);
+   uL = DynArray_coRank(ppvLeft, uLeft, ppvRight, uRight, uOut,
+                        psJob->pfCompare);
+   uLEnd = DynArray_coRank(ppvLeft, uLeft, ppvRight, uRight, uOutEnd,
+                           psJob->pfCompare);
+   uR = uOut - uL;
+   uREnd = uOutEnd - uLEnd;
+
+   while (uL < uLEnd && uR < uREnd)
+   {
+      if (DynArray_sortCompare(psJob->pfCompare, ppvLeft[uL],
+                               ppvRight[uR]) <= 0)
+         ppvTo[uOut++] = ppvLeft[uL++];
+      else
+         ppvTo[uOut++] = ppvRight[uR++];
+   }
+   memcpy(ppvTo + uOut, ppvLeft + uL, (uLEnd - uL) * sizeof(void*));
+   uOut += uLEnd - uL;
+   memcpy(ppvTo + uOut, ppvRight + uR, (uREnd - uR) * sizeof(void*));
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_parallelSort(DynArray_T oDynArray,
+                           int (*pfCompare)(const void *pvElement1,
+                                            const void *pvElement2),
+                           size_t uThreads)
+{
+   struct sortJob sJob;
+   const void **ppvTemp;
+   const void **ppvSwap;
+   size_t uPairs;
+   size_t u;
+
+   assert(oDynArray != NULL);
+   assert(pfCompare != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   uThreads = DynArray_getThreadCount(oDynArray->uLength,
+                                      SORT_ELEMENTS_PER_THREAD, uThreads);
+   ppvTemp = NULL;
+   if (uThreads > 1)
+      ppvTemp = (const void**)Allocator_alloc(
+         oDynArray->oAAlloc, sizeof(void*) * oDynArray->uLength);
+   if (ppvTemp == NULL)
+   {
+      DynArray_sort(oDynArray, pfCompare);
+      return;
+   }
+
+   /* sort a run per thread, all at once */
+   sJob.ppvFrom = oDynArray->ppvArray;
+   sJob.ppvTo = ppvTemp;
+   sJob.uRuns = uThreads;
+   for (u = 0; u <= uThreads; u++)
+      sJob.auBounds[u] = DynArray_splitPoint(oDynArray->uLength,
+                                             uThreads, u);
+   sJob.pfCompare = pfCompare;
+#ifdef DYNARRAY_STATS
+   sJob.psStats = &oDynArray->sStats;
+#endif
+   DynArray_runTasks(DynArray_sortRun, &sJob, sJob.uRuns, uThreads);
+
+   /* then merge them in pairs, splitting each merge into parts so
+      that every thread has one, until one run is left */
+   while (sJob.uRuns > 1)
+   {
+      uPairs = (sJob.uRuns + 1) / 2;
+      sJob.uParts = (uThreads + uPairs - 1) / uPairs;
+      DynArray_runTasks(DynArray_mergePart, &sJob,
+                        uPairs * sJob.uParts, uThreads);
+
+      for (u = 0; u < uPairs; u++)
+         sJob.auBounds[u] = sJob.auBounds[2 * u];
+      sJob.auBounds[uPairs] = oDynArray->uLength;
+      sJob.uRuns = uPairs;
+      ppvSwap = sJob.ppvFrom;
+      sJob.ppvFrom = sJob.ppvTo;
+      sJob.ppvTo = ppvSwap;
+   }
+
+   if (sJob.ppvFrom != oDynArray->ppvArray)
+      memcpy(oDynArray->ppvArray, sJob.ppvFrom,
+             sizeof(void*) * oDynArray->uLength);
+   Allocator_release(oDynArray->oAAlloc, (void*)ppvTemp,
+                     sizeof(void*) * oDynArray->uLength);
+
+   assert(DynArray_isValid(oDynArray));
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_search(DynArray_T oDynArray,
+                    void *pvSoughtElement,
+                    size_t *puIndex,
+                    int (*pfCompare)(const void *pvElement1,
+                                     const void *pvElement2))
+{
+   size_t u;
+
+   assert(oDynArray != NULL);
+   assert(puIndex != NULL);
+   assert(pfCompare != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   DynArray_countInto(&oDynArray->sStats);
+
+   for (u = 0; u < oDynArray->uLength; u++)
+      if (DynArray_searchCompare(pfCompare, oDynArray->ppvArray[u],
+                                 pvSoughtElement) == 0)
+      {
+         *puIndex = u;
+         return 1;
+      }
+   return 0;
+}
+
+
+
+/*--------------------------------------------------------------------*/
+
+/* Binary search the array of elements that resides in memory at
+   addresses ppvLo...ppvHi for pvSoughtElement.
+   *pfCompare must return <0, 0, or >0 depending upon whether
+   *pvElement1 is less than, equal to, or greater than *pvElement2,
+   respectively. If pvSoughtElement is not found, *pppvInsert is set to
+   point at the memory location where it would be placed if inserted.
+*/
+
+static const void **DynArray_bsearchHelp(
+   void *pvSoughtElement,
+   const void **ppvLo,
+   const void **ppvHi,
+   int (*pfCompare)(const void *pvElement1, const void *pvElement2),
+   const void*** pppvInsert)
+{
+   /* This function uses pointers instead of indices to avoid
+      complications with using unsigned integers as array indices. */
+
+   const void **ppvMid;
+   int iCompare;
 
    assert(ppvLo != NULL);
    assert(ppvHi != NULL);
@@ -387,7 +1736,8 @@ static const void **DynArray_bsearchHelp(
    while (ppvLo <= ppvHi)
    {
       ppvMid = ppvLo + ((ppvHi - ppvLo) / 2);
-      iCompare = (*pfCompare)(*ppvMid, pvSoughtElement);
+      iCompare = DynArray_searchCompare(pfCompare, *ppvMid,
+                                        pvSoughtElement);
       if (iCompare > 0)
          ppvHi = ppvMid - 1;
       else if (iCompare < 0)
@@ -415,6 +1765,8 @@ int DynArray_bsearch(DynArray_T oDynArray,
    assert(pfCompare != NULL);
    assert(DynArray_isValid(oDynArray));
 
+   DynArray_countInto(&oDynArray->sStats);
+
    if (oDynArray->uLength == 0) {
       *puIndex = 0;
       return 0;
@@ -435,3 +1787,297 @@ int DynArray_bsearch(DynArray_T oDynArray,
    *puIndex = (size_t)(ppvElement - &oDynArray->ppvArray[0]);
    return 1;
 }
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_bsearchBranchless(DynArray_T oDynArray,
+                               void *pvSoughtElement,
+                               size_t *puIndex,
+                               int (*pfCompare)(const void *pvElement1,
+                                                const void *pvElement2))
+{
+   const void **ppvBase;
+   size_t uLeft;
+   size_t uHalf;
+   int iCompare;
+
+   assert(oDynArray != NULL);
+   assert(puIndex != NULL);
+   assert(pfCompare != NULL);
+   assert(DynArray_isValid(oDynArray));
+
+   DynArray_countInto(&oDynArray->sStats);
+
+   if (oDynArray->uLength == 0) {
+      *puIndex = 0;
+      return 0;
+   }
+
+   /* The last element not greater than *pvSoughtElement, if there is
+      one, is always within ppvBase[0..uLeft-1], and ppvBase[0] is
+      either the first element or not greater than it.  Each
+      probe halves uLeft whatever the comparison says, so the loop
+      runs a fixed number of times and the compiler can choose the
+      new ppvBase with a conditional move rather than a branch.  As
+      that leaves the processor nothing to speculate on, the two
+      elements the next probe may compare are prefetched meanwhile:
+      what they point to, since that is what *pfCompare reads. */
+   ppvBase = oDynArray->ppvArray;
+   uLeft = oDynArray->uLength;
+   while (uLeft > 1)
+   {
+      uHalf = uLeft / 2;
+      DynArray_prefetch(ppvBase[uHalf / 2]);
+      DynArray_prefetch(ppvBase[uHalf + uHalf / 2]);
+      iCompare = DynArray_searchCompare(pfCompare, ppvBase[uHalf],
+                                        pvSoughtElement);
+      ppvBase = (iCompare <= 0) ? ppvBase + uHalf : ppvBase;
+      uLeft -= uHalf;
+   }
+
+   iCompare = DynArray_searchCompare(pfCompare, *ppvBase, pvSoughtElement);
+   *puIndex = (size_t)(ppvBase - oDynArray->ppvArray) + (iCompare < 0);
+   return iCompare == 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+#ifdef DYNARRAY_STATS
+
+/* The counts kept by an instrumented build over every array, those
+   of the freed DynArray object that shifted the most elements, the
+   lock that guards the latter, and whether writing them out at exit
+   has been arranged yet. */
+
+static struct DynArrayStats sTotals;
+static struct DynArrayStats sWorst;
+static pthread_mutex_t sWorstLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t sStatsOnce = PTHREAD_ONCE_INIT;
+
+/*--------------------------------------------------------------------*/
+
+/* Add uAmount to *puCount, atomically if the compiler offers a way
+   to, since the threads of the parallel sort count too. */
+
+static void DynArray_addCount(size_t *puCount, size_t uAmount)
+{
+#ifdef __GNUC__
+   (void)__atomic_fetch_add(puCount, uAmount, __ATOMIC_RELAXED);
+#else
+   *puCount += uAmount;
+#endif
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Raise *puMost to uValue if it is less, atomically if the compiler
+   offers a way to. */
+
+static void DynArray_raiseCount(size_t *puMost, size_t uValue)
+{
+#ifdef __GNUC__
+   size_t uMost = __atomic_load_n(puMost, __ATOMIC_RELAXED);
+
+   while (uValue > uMost &&
+          !__atomic_compare_exchange_n(puMost, &uMost, uValue, 1,
+                                       __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED))
+      ;
+#else
+   if (uValue > *puMost)
+      *puMost = uValue;
+#endif
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Write the counts *psCounts to stderr under the heading pcTitle. */
+
+static void DynArray_writeStats(const char *pcTitle,
+                                const struct DynArrayStats *psCounts)
+{
+   fprintf(stderr,
+           "%s:\n"
+           "   grows:              %lu (%lu bytes)\n"
+           "   elements shifted:   %lu (at most %lu at once)\n"
+           "   search compares:    %lu\n"
+           "   sort compares:      %lu\n"
+           "   longest array:      %lu (room for at most %lu)\n",
+           pcTitle,
+           (unsigned long)psCounts->uGrows,
+           (unsigned long)psCounts->uGrowBytes,
+           (unsigned long)psCounts->uShifts,
+           (unsigned long)psCounts->uMaxShift,
+           (unsigned long)psCounts->uSearchCompares,
+           (unsigned long)psCounts->uSortCompares,
+           (unsigned long)psCounts->uMaxLength,
+           (unsigned long)psCounts->uMaxPhysLength);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Write the totals, and the counts of the worst freed DynArray
+   object if any shifted elements, to stderr. */
+
+static void DynArray_dumpStats(void)
+{
+   struct DynArrayStats sCounts;
+
+   (void)DynArray_getTotalStats(&sCounts);
+   DynArray_writeStats("DynArray statistics", &sCounts);
+
+   (void)pthread_mutex_lock(&sWorstLock);
+   sCounts = sWorst;
+   (void)pthread_mutex_unlock(&sWorstLock);
+   if (sCounts.uShifts > 0)
+      DynArray_writeStats("DynArray that shifted the most", &sCounts);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Arrange for the counts to be written out at exit. */
+
+static void DynArray_arrangeDump(void)
+{
+   (void)atexit(DynArray_dumpStats);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Assign the counts kept for oDynArray to *psStats, counting its
+   present length and physical length among the most it has had,
+   since one that never grew or shifted has not counted them. */
+
+static void DynArray_copyStats(DynArray_T oDynArray,
+                               struct DynArrayStats *psStats)
+{
+   *psStats = oDynArray->sStats;
+   if (oDynArray->uLength > psStats->uMaxLength)
+      psStats->uMaxLength = oDynArray->uLength;
+   if (oDynArray->uPhysLength > psStats->uMaxPhysLength)
+      psStats->uMaxPhysLength = oDynArray->uPhysLength;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Keep the counts of oDynArray, which is being freed, if it shifted
+   more elements than any freed before it. */
+
+static void DynArray_keepWorst(DynArray_T oDynArray)
+{
+   (void)pthread_mutex_lock(&sWorstLock);
+   if (oDynArray->sStats.uShifts > sWorst.uShifts)
+      DynArray_copyStats(oDynArray, &sWorst);
+   (void)pthread_mutex_unlock(&sWorstLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_countGrow(struct DynArrayStats *psStats,
+                        size_t uPhysLength, size_t uBytes)
+{
+   assert(psStats != NULL);
+
+   (void)pthread_once(&sStatsOnce, DynArray_arrangeDump);
+   psStats->uGrows++;
+   psStats->uGrowBytes += uBytes;
+   if (uPhysLength > psStats->uMaxPhysLength)
+      psStats->uMaxPhysLength = uPhysLength;
+
+   DynArray_addCount(&sTotals.uGrows, 1);
+   DynArray_addCount(&sTotals.uGrowBytes, uBytes);
+   DynArray_raiseCount(&sTotals.uMaxPhysLength, uPhysLength);
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_countShift(struct DynArrayStats *psStats,
+                         size_t uShift, size_t uLength)
+{
+   assert(psStats != NULL);
+
+   (void)pthread_once(&sStatsOnce, DynArray_arrangeDump);
+   psStats->uShifts += uShift;
+   if (uShift > psStats->uMaxShift)
+      psStats->uMaxShift = uShift;
+   if (uLength > psStats->uMaxLength)
+      psStats->uMaxLength = uLength;
+
+   if (uShift > 0)
+   {
+      DynArray_addCount(&sTotals.uShifts, uShift);
+      DynArray_raiseCount(&sTotals.uMaxShift, uShift);
+   }
+   DynArray_raiseCount(&sTotals.uMaxLength, uLength);
+}
+
+/*--------------------------------------------------------------------*/
+
+void DynArray_countCompares(struct DynArrayStats *psStats,
+                            size_t uCompares, int bSorting)
+{
+   /* the threads of a parallel sort share the sorted array's counts,
+      so those are added to atomically too */
+   if (bSorting)
+   {
+      if (psStats != NULL)
+         DynArray_addCount(&psStats->uSortCompares, uCompares);
+      DynArray_addCount(&sTotals.uSortCompares, uCompares);
+   }
+   else
+   {
+      if (psStats != NULL)
+         DynArray_addCount(&psStats->uSearchCompares, uCompares);
+      DynArray_addCount(&sTotals.uSearchCompares, uCompares);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_getStats(DynArray_T oDynArray,
+                      struct DynArrayStats *psStats)
+{
+   assert(oDynArray != NULL);
+   assert(psStats != NULL);
+
+   DynArray_copyStats(oDynArray, psStats);
+   return 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_getTotalStats(struct DynArrayStats *psStats)
+{
+   assert(psStats != NULL);
+
+   /* a count that another thread is updating meanwhile may be
+      read before or after its update */
+   *psStats = sTotals;
+   return 1;
+}
+
+#else
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_getStats(DynArray_T oDynArray,
+                      struct DynArrayStats *psStats)
+{
+   assert(oDynArray != NULL);
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(*psStats));
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int DynArray_getTotalStats(struct DynArrayStats *psStats)
+{
+   assert(psStats != NULL);
+
+   memset(psStats, 0, sizeof(*psStats));
+   return 0;
+}
+
+#endif
@@ -7,6 +7,7 @@
 #define DYNARRAY_INCLUDED
 
 #include <stddef.h>
+#include "allocator.h"
 
 /* A DynArray_T object is an array whose length can expand
    dynamically. */
@@ -22,12 +23,59 @@ DynArray_T DynArray_new(size_t uLength);
 
 /*--------------------------------------------------------------------*/
 
+/* Return a new DynArray_T object whose length is uLength, and which
+   takes its memory from oAAlloc, or NULL if insufficient memory is
+   available.  DynArray_new(uLength) is DynArray_newWith(uLength,
+   NULL). */
+
+DynArray_T DynArray_newWith(size_t uLength, Allocator_T oAAlloc);
+
+/*--------------------------------------------------------------------*/
+
 /* Free oDynArray. */
 
 void DynArray_free(DynArray_T oDynArray);
 
 /*--------------------------------------------------------------------*/
 
+/* Make the physical length of oDynArray at least uPhysLength, so
+   that it can grow to that length without allocating.  Return 1
+   (TRUE) if successful, or 0 (FALSE) if insufficient memory is
+   available, in which case oDynArray is unchanged. */
+
+int DynArray_reserve(DynArray_T oDynArray, size_t uPhysLength);
+
+/*--------------------------------------------------------------------*/
+
+/* Reduce the physical length of oDynArray to its length, giving back
+   the memory of the slots it does not use.  Return 1 (TRUE) if
+   successful, or 0 (FALSE) if insufficient memory is available to
+   move its elements, in which case oDynArray is unchanged. */
+
+int DynArray_shrinkToFit(DynArray_T oDynArray);
+
+/*--------------------------------------------------------------------*/
+
+/* Make oDynArray grow, whenever it runs out of room, by uPercent
+   percent of its physical length (and by at least one element)
+   rather than doubling.  uPercent must be positive.  A smaller
+   percentage wastes less memory, but copies the elements more
+   often. */
+
+void DynArray_setGrowth(DynArray_T oDynArray, size_t uPercent);
+
+/*--------------------------------------------------------------------*/
+
+/* Return the physical length that an array with room for uPhysLength
+   elements grows to when it runs out of room: uPhysLength increased
+   by uPercent percent, and by at least 1.  This is the growth that
+   DynArray_setGrowth sets, and that the arrays of typedarray.h share
+   too. */
+
+size_t DynArray_grownLength(size_t uPhysLength, size_t uPercent);
+
+/*--------------------------------------------------------------------*/
+
 /* Return the length of oDynArray. */
 
 size_t DynArray_getLength(DynArray_T oDynArray);
@@ -65,12 +113,56 @@ int DynArray_addAt(DynArray_T oDynArray, size_t uIndex,
 
 /*--------------------------------------------------------------------*/
 
+/* Add the uCount elements at ppvElements to oDynArray such that the
+   first is the uIndex'th element, moving the elements after them only
+   once.  Return 1 (TRUE) if successful, or 0 (FALSE) if insufficient
+   memory is available, in which case oDynArray is unchanged. */
+
+int DynArray_insertRange(DynArray_T oDynArray, size_t uIndex,
+                         const void * const *ppvElements, size_t uCount);
+
+/*--------------------------------------------------------------------*/
+
+/* Merge the uCount elements of ppvElements, which must be sorted as
+   determined by *pfCompare, into oDynArray, which must be sorted in
+   the same way, so that it stays sorted.  The merge takes a single
+   pass backward from the new end of oDynArray, moving each element
+   at most once (twice if there are duplicates), rather than
+   shifting the tail once per element as DynArray_addAt would.  An
+   element that compares equal to one already in oDynArray is not
+   added, and of several that compare equal to each other only one
+   is; if puDuplicates is not NULL, assign the number of elements
+   left out to *puDuplicates.  Return 1
+   (TRUE) if successful, or 0 (FALSE) if insufficient memory is
+   available, in which case oDynArray is unchanged. */
+
+int DynArray_mergeSorted(DynArray_T oDynArray,
+                         const void * const *ppvElements, size_t uCount,
+                         int (*pfCompare)(const void *pvElement1,
+                                          const void *pvElement2),
+                         size_t *puDuplicates);
+
+/*--------------------------------------------------------------------*/
+
 /* Remove and return the uIndex'th element of oDynArray. */
 
 void *DynArray_removeAt(DynArray_T oDynArray, size_t uIndex);
 
 /*--------------------------------------------------------------------*/
 
+/* Remove the uCount elements of oDynArray starting at the uIndex'th,
+   moving the elements after them only once.  If ppvRemoved is not
+   NULL, fill it with the removed elements; it must then point to an
+   area of memory that is large enough to hold them.  Removal never
+   reduces the physical length of oDynArray (only
+   DynArray_shrinkToFit does), so adding the elements back cannot
+   fail. */
+
+void DynArray_removeRange(DynArray_T oDynArray, size_t uIndex,
+                          size_t uCount, void **ppvRemoved);
+
+/*--------------------------------------------------------------------*/
+
 /* Fill ppvArray with the elements of oDynArray.  ppvArray must point
    to an area of memory that is large enough to hold all elements of
    oDynArray. */
@@ -92,7 +184,9 @@ void DynArray_map(DynArray_T oDynArray,
 /* Sort oDynArray in the order determined by *pfCompare.
    *pfCompare must return <0, 0, or >0 depending upon whether
    *pvElement1 is less than, equal to, or greater than *pvElement2,
-   respectively. */
+   respectively.  The sort is not stable, but takes O(n log n) time
+   for any order of the elements and O(n) time for ones already or
+   nearly sorted. */
 
 void DynArray_sort(DynArray_T oDynArray,
                    int (*pfCompare)(const void *pvElement1,
@@ -100,6 +194,49 @@ void DynArray_sort(DynArray_T oDynArray,
 
 /*--------------------------------------------------------------------*/
 
+/* Sort oDynArray, whose elements must be strings, in the order
+   determined by strcmp.  This is usually much faster than
+   DynArray_sort with a comparison function that calls strcmp,
+   especially when many strings share long prefixes, as the paths
+   in a tree do.  It allocates a size_t per element while it works,
+   and sorts by comparisons instead if that memory is not available. */
+
+void DynArray_sortStrings(DynArray_T oDynArray);
+
+/*--------------------------------------------------------------------*/
+
+/* Apply function *pfApply to each element of oDynArray, passing
+   pvExtra as an extra argument, as DynArray_map does, but with up to
+   uThreads threads at once, in no particular order.  *pfApply must
+   therefore be safe to call on different elements at the same time.
+   If uThreads is 0, use as many threads as there are processors
+   online.  Use fewer, down to just the calling thread, if oDynArray
+   is too short for more to pay off or they cannot be started. */
+
+void DynArray_parallelMap(DynArray_T oDynArray,
+                          void (*pfApply)(void *pvElement,
+                                          void *pvExtra),
+                          const void *pvExtra, size_t uThreads);
+
+/*--------------------------------------------------------------------*/
+
+/* Sort oDynArray in the order determined by *pfCompare, as
+   DynArray_sort does, but with up to uThreads threads at once: each
+   sorts a run of the elements, and then the runs are merged in pairs.
+   *pfCompare must be safe to call from several threads at the same
+   time.  If uThreads is 0, use as many threads as there are
+   processors online.  Use fewer, down to just DynArray_sort, if
+   oDynArray is too short for more to pay off, they cannot be
+   started, or there is not enough memory for a second array of
+   oDynArray's length. */
+
+void DynArray_parallelSort(DynArray_T oDynArray,
+                           int (*pfCompare)(const void *pvElement1,
+                                            const void *pvElement2),
+                           size_t uThreads);
+
+/*--------------------------------------------------------------------*/
+
 /* Linear search oDynArray for *pvSoughtElement using *pfCompare to
    determine equality.  If the element is found, then assign its
    index to *puIndex and return 1.  If the element is not found, then
@@ -129,4 +266,88 @@ int DynArray_bsearch(DynArray_T oDynArray,
                      int (*pfCompare)(const void *pvElement1,
                                       const void *pvElement2));
 
+/*--------------------------------------------------------------------*/
+
+/* Do the same as DynArray_bsearch, but with a probe sequence whose
+   length depends only on the length of oDynArray, so that it has no
+   unpredictable branches, and with the next probe prefetched.  It
+   makes one or two more calls of *pfCompare than DynArray_bsearch
+   may, but is faster over long arrays. */
+
+int DynArray_bsearchBranchless(DynArray_T oDynArray,
+                               void *pvSoughtElement,
+                               size_t *puIndex,
+                               int (*pfCompare)(const void *pvElement1,
+                                                const void *pvElement2));
+
+/*--------------------------------------------------------------------*/
+
+/* The counts that an instrumented build keeps for each DynArray
+   object, and each array of typedarray.h, over its life, and over
+   all of them since the program started.  A build is instrumented
+   when dynarray.c, and each file that uses typedarray.h, is compiled
+   with DYNARRAY_STATS defined; it then also writes the totals, and
+   the counts of the DynArray object that shifted the most elements,
+   to stderr when the program exits. */
+
+struct DynArrayStats
+{
+   /* The number of times an array was moved to a larger one, and the
+      bytes those larger arrays took. */
+   size_t uGrows;
+   size_t uGrowBytes;
+
+   /* The number of elements moved to open or close a gap for an
+      insertion, removal or merge, and the most moved by one. */
+   size_t uShifts;
+   size_t uMaxShift;
+
+   /* The number of calls of a comparison function by the searches,
+      and by the sorts and merges. */
+   size_t uSearchCompares;
+   size_t uSortCompares;
+
+   /* The most elements an array has held, and has had room for. */
+   size_t uMaxLength;
+   size_t uMaxPhysLength;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Assign the counts kept so far for oDynArray to *psStats.  Return 1
+   (TRUE) in an instrumented build, or 0 (FALSE), having zeroed
+   *psStats, otherwise. */
+
+int DynArray_getStats(DynArray_T oDynArray,
+                      struct DynArrayStats *psStats);
+
+/*--------------------------------------------------------------------*/
+
+/* Assign the counts kept so far over every array to *psStats.  Return
+   1 (TRUE) in an instrumented build, or 0 (FALSE), having zeroed
+   *psStats, otherwise. */
+
+int DynArray_getTotalStats(struct DynArrayStats *psStats);
+
+/*--------------------------------------------------------------------*/
+
+#ifdef DYNARRAY_STATS
+
+/* Count, in an instrumented build, in *psStats and in the totals,
+   the growth of an array to uPhysLength elements of uBytes bytes in
+   all; uShift elements moved by one insertion, removal or merge that
+   left an array uLength long; and uCompares calls of a comparison
+   function by a sort or merge if bSorting is 1 (TRUE), or by a search
+   otherwise.  These are for the arrays of typedarray.h, which keep
+   their counts in *psStats; a DynArray counts itself. */
+
+void DynArray_countGrow(struct DynArrayStats *psStats,
+                        size_t uPhysLength, size_t uBytes);
+void DynArray_countShift(struct DynArrayStats *psStats,
+                         size_t uShift, size_t uLength);
+void DynArray_countCompares(struct DynArrayStats *psStats,
+                            size_t uCompares, int bSorting);
+
+#endif
+
 #endif
@@ -19,21 +19,26 @@ struct path {
    size_t ulLength;
    /* The ordered collection of component strings in the path */
    DynArray_T oDComponents;
+   /* The allocator the path, its string and its components come
+      from */
+   Allocator_T oAAlloc;
 };
 
 /*
-  Frees pcStr. This wrapper is used to match the requirements of the
-  callback function pointer passed to DynArray_map. pvExtra is unused.
+  Frees pcStr, which came from the allocator pvAlloc. This wrapper is
+  used to match the requirements of the callback function pointer
+  passed to DynArray_map.
 */
-static void Path_freeString(char *pcStr, void *pvExtra) {
+static void Path_freeString(char *pcStr, void *pvAlloc) {
    /* pcStr may be NULL, as this is a no-op to free.
-      pvExtra may be NULL, as it is unused. */
-   free(pcStr);
+      pvAlloc may be NULL, for the default allocator. */
+   if(pcStr != NULL)
+      Allocator_release((Allocator_T) pvAlloc, pcStr, strlen(pcStr)+1);
 }
 
 /*
   Sets *poDComponents to be an ordered collection of component strings
-  in pcPath, or NULL if an error occurs.
+  in pcPath, allocated from oAAlloc, or NULL if an error occurs.
   Returns one of the following statuses:
   * SUCCESS if no error occurrs
   * BAD_PATH if pcPath is the empty string,
@@ -41,7 +46,8 @@ static void Path_freeString(char *pcStr, void *pvExtra) {
              or contains consecutive '/' delimiters
   * MEMORY_ERROR if memory could not be allocated to complete request
 */
-static int Path_split(const char *pcPath, DynArray_T *poDComponents) {
+static int Path_split(const char *pcPath, Allocator_T oAAlloc,
+                      DynArray_T *poDComponents) {
    const char *pcStart = pcPath;
    const char *pcEnd = pcPath;
    char *pcCopy;
@@ -56,7 +62,7 @@ static int Path_split(const char *pcPath, DynArray_T *poDComponents) {
       return BAD_PATH;
    }
 
-   oDSubstrings = DynArray_new(0);
+   oDSubstrings = DynArray_newWith(0, oAAlloc);
    if(oDSubstrings == NULL) {
       *poDComponents = NULL;
       return MEMORY_ERROR;
@@ -68,7 +74,7 @@ static int Path_split(const char *pcPath, DynArray_T *poDComponents) {
       /* component can't start with delimiter */
       if(*pcEnd == '/') {
          DynArray_map(oDSubstrings,
-                      (void (*)(void*, void*)) Path_freeString, NULL);
+                      (void (*)(void*, void*)) Path_freeString, oAAlloc);
          DynArray_free(oDSubstrings);
          *poDComponents = NULL;
          return BAD_PATH;
@@ -81,24 +87,26 @@ static int Path_split(const char *pcPath, DynArray_T *poDComponents) {
       /* final component can't end with slash */
       if(*pcEnd == '\0' && *(pcEnd-1) == '/') {
          DynArray_map(oDSubstrings,
-                      (void (*)(void*, void*)) Path_freeString, NULL);
+                      (void (*)(void*, void*)) Path_freeString, oAAlloc);
          DynArray_free(oDSubstrings);
          *poDComponents = NULL;
          return BAD_PATH;
       }
 
-      pcCopy = calloc((size_t)(pcEnd-pcStart+1), sizeof(char));
+      pcCopy = Allocator_calloc(oAAlloc, (size_t)(pcEnd-pcStart+1),
+                                sizeof(char));
       if(pcCopy == NULL) {
          DynArray_map(oDSubstrings,
-                      (void (*)(void*, void*)) Path_freeString, NULL);
+                      (void (*)(void*, void*)) Path_freeString, oAAlloc);
          DynArray_free(oDSubstrings);
          *poDComponents = NULL;
          return MEMORY_ERROR;
       }
 
       if( DynArray_add(oDSubstrings, pcCopy) == 0) {
+         Allocator_release(oAAlloc, pcCopy, (size_t)(pcEnd-pcStart+1));
          DynArray_map(oDSubstrings,
-                      (void (*)(void*, void*)) Path_freeString, NULL);
+                      (void (*)(void*, void*)) Path_freeString, oAAlloc);
          DynArray_free(oDSubstrings);
          *poDComponents = NULL;
          return MEMORY_ERROR;
@@ -119,20 +127,26 @@ static int Path_split(const char *pcPath, DynArray_T *poDComponents) {
 
 
 int Path_new(const char *pcPath, Path_T *poPResult) {
+   return Path_newWith(pcPath, NULL, poPResult);
+}
+
+int Path_newWith(const char *pcPath, Allocator_T oAAlloc,
+                 Path_T *poPResult) {
    struct path *psNew;
    int iSplitResult;
 
    assert(pcPath != NULL);
    assert(poPResult != NULL);
 
-   psNew = calloc(1, sizeof(struct path));
+   psNew = Allocator_calloc(oAAlloc, 1, sizeof(struct path));
    if(psNew == NULL) {
       *poPResult = NULL;
       return MEMORY_ERROR;
    }
+   psNew->oAAlloc = oAAlloc;
 
    /* instantiate and fill list of components */
-   iSplitResult = Path_split(pcPath, &psNew->oDComponents);
+   iSplitResult = Path_split(pcPath, oAAlloc, &psNew->oDComponents);
    if(iSplitResult != SUCCESS) {
       Path_free(psNew);
       *poPResult = NULL;
@@ -140,7 +154,7 @@ int Path_new(const char *pcPath, Path_T *poPResult) {
    }
 
    psNew->ulLength = strlen(pcPath);
-   psNew->pcPath = malloc(psNew->ulLength+1);
+   psNew->pcPath = Allocator_alloc(oAAlloc, psNew->ulLength+1);
    if(psNew->pcPath == NULL) {
       Path_free(psNew);
       *poPResult = NULL;
@@ -154,7 +168,7 @@ int Path_new(const char *pcPath, Path_T *poPResult) {
 
 int Path_prefix(Path_T oPPath, size_t ulDepth, Path_T *poPResult) {
    struct path *psNew;
-   size_t ulIndex, ulLength, ulSum;
+   size_t ulIndex, ulLength, ulSum, ulBuildSize;
    const char *pcComponent;
    char *pcCopy;
    char *pcBuild;
@@ -175,20 +189,22 @@ int Path_prefix(Path_T oPPath, size_t ulDepth, Path_T *poPResult) {
       return NO_SUCH_PATH;
    }
 
-   psNew = calloc(1, sizeof(struct path));
+   psNew = Allocator_calloc(oPPath->oAAlloc, 1, sizeof(struct path));
    if(psNew == NULL) {
       *poPResult = NULL;
       return MEMORY_ERROR;
    }
+   psNew->oAAlloc = oPPath->oAAlloc;
 
-   psNew->oDComponents = DynArray_new(ulDepth);
+   psNew->oDComponents = DynArray_newWith(ulDepth, psNew->oAAlloc);
    if(psNew->oDComponents == NULL) {
       Path_free(psNew);
       *poPResult = NULL;
       return MEMORY_ERROR;
    }
 
-   pcBuild = calloc(Path_getStrLength(oPPath)+1, sizeof(char));
+   ulBuildSize = Path_getStrLength(oPPath)+1;
+   pcBuild = Allocator_calloc(psNew->oAAlloc, ulBuildSize, sizeof(char));
    if(pcBuild == NULL) {
       Path_free(psNew);
       *poPResult = NULL;
@@ -202,9 +218,10 @@ int Path_prefix(Path_T oPPath, size_t ulDepth, Path_T *poPResult) {
       /* deep copy each component to new DynArray */
       pcComponent = Path_getComponent(oPPath, ulIndex);
       ulLength = strlen(pcComponent);
-      pcCopy = calloc(ulLength + 1, sizeof(char));
+      pcCopy = Allocator_calloc(psNew->oAAlloc, ulLength + 1,
+                                sizeof(char));
       if(pcCopy == NULL) {
-         free(pcBuild);
+         Allocator_release(psNew->oAAlloc, pcBuild, ulBuildSize);
          Path_free(psNew);
          *poPResult = NULL;
          return MEMORY_ERROR;
@@ -220,9 +237,10 @@ int Path_prefix(Path_T oPPath, size_t ulDepth, Path_T *poPResult) {
    pcBuild[ulSum-1] = '\0';
 
    /* shrink allocation to fit prefix's pathname string if needed */
-   pcInsert = realloc(pcBuild, ulSum);
+   pcInsert = Allocator_realloc(psNew->oAAlloc, pcBuild, ulBuildSize,
+                                ulSum);
    if(pcInsert == NULL) {
-      free(pcBuild);
+      Allocator_release(psNew->oAAlloc, pcBuild, ulBuildSize);
       Path_free(psNew);
       *poPResult = NULL;
       return MEMORY_ERROR;
@@ -243,15 +261,19 @@ int Path_dup(Path_T oPPath, Path_T *poPResult) {
 
 void Path_free(Path_T oPPath) {
    if(oPPath != NULL) {
-      free((char *)oPPath->pcPath);
+      if(oPPath->pcPath != NULL)
+         Allocator_release(oPPath->oAAlloc, (char *)oPPath->pcPath,
+                           oPPath->ulLength+1);
 
       if(oPPath->oDComponents != NULL) {
          DynArray_map(oPPath->oDComponents,
-                      (void (*)(void*, void*)) Path_freeString, NULL);
+                      (void (*)(void*, void*)) Path_freeString,
+                      oPPath->oAAlloc);
          DynArray_free(oPPath->oDComponents);
       }
+      Allocator_release(oPPath->oAAlloc, (struct path*) oPPath,
+                        sizeof(struct path));
    }
-   free((struct path*) oPPath);
 }
 
 const char *Path_getPathname(Path_T oPPath) {
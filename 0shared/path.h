@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include "a4def.h"
+#include "allocator.h"
 
 /* An object representing an absolute path in a tree */
 typedef const struct path * Path_T;
@@ -23,6 +24,15 @@ typedef const struct path * Path_T;
 */
 int Path_new(const char *pcPath, Path_T *poPResult);
 
+/*
+  Creates a new path object representing the absolute path in pcPath,
+  as Path_new does, taking its memory from oAAlloc (NULL for malloc).
+  Paths made from it by Path_dup and Path_prefix take theirs from
+  oAAlloc too.
+*/
+int Path_newWith(const char *pcPath, Allocator_T oAAlloc,
+                 Path_T *poPResult);
+
 /*
   Creates a "deep copy" of oPPath, duplicating all its contents.
   Returns an int SUCCESS status and sets *poPResult to be the new path
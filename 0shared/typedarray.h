@@ -0,0 +1,507 @@
+/*--------------------------------------------------------------------*/
+/* typedarray.h                                                       */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef TYPEDARRAY_INCLUDED
+#define TYPEDARRAY_INCLUDED
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+#include "dynarray.h"
+
+/* DEFINE_DYNARRAY(Name, Type, Cmp, Key) defines struct Name, an array
+   of Type elements whose length can expand dynamically, and the inline
+   functions below that operate on it.  Unlike a DynArray_T, a struct
+   Name stores its elements by value, is itself meant to be embedded
+   by value in the structure that owns it, and compares elements by
+   calling Cmp directly rather than through a function pointer, so
+   that the comparison can be inlined.
+
+   Cmp must be a function (or a macro) declared before the expansion
+   as
+      int Cmp(const Type *ptElement, const void *pvKey);
+   returning <0, 0, or >0 if *ptElement is less than, equal to, or
+   greater than the sought key pvKey.  Its definition may come later.
+   Key must likewise be a function (or a macro) declared as
+      const void *Key(const Type *ptElement);
+   returning the address of the memory that Cmp reads first for
+   *ptElement, without reading it: ptElement itself for an element
+   compared by value, or the pointer it holds for one compared by
+   what it points to.  Name_bsearch prefetches that memory for the
+   elements its next probe may compare.
+
+   Expand DEFINE_DYNARRAY at file scope, at most once per Name in a
+   translation unit.  A struct Name does not record the allocator its
+   elements come from, since its owner usually does already; the
+   functions that allocate or free them take it as oAAlloc instead
+   (NULL for malloc), which must be the same on every call for the
+   same array.  The functions DEFINE_DYNARRAY defines are:
+
+   int Name_init(struct Name *psArray, size_t uLength,
+                 Allocator_T oAAlloc)
+      Make *psArray an array of uLength zeroed elements.  Return 1
+      (TRUE) if successful, or 0 (FALSE) if insufficient memory is
+      available, in which case *psArray is an empty array.
+   void Name_clear(struct Name *psArray, Allocator_T oAAlloc)
+      Free the elements of *psArray, leaving it an empty array.
+   size_t Name_getLength(const struct Name *psArray)
+   size_t Name_getPhysLength(const struct Name *psArray)
+      Return the length of *psArray, or the number of elements it
+      has room for.
+   Type Name_get(const struct Name *psArray, size_t uIndex)
+      Return the uIndex'th element of *psArray.
+   Type Name_set(struct Name *psArray, size_t uIndex, Type tElement)
+      Assign tElement to the uIndex'th element of *psArray.  Return
+      the old element.
+   int Name_add(struct Name *psArray, Type tElement,
+                Allocator_T oAAlloc)
+   int Name_addAt(struct Name *psArray, size_t uIndex, Type tElement,
+                  Allocator_T oAAlloc)
+      Add tElement at the end of *psArray, or such that it is the
+      uIndex'th element.  Return 1 (TRUE) if successful, or 0 (FALSE)
+      if insufficient memory is available.
+   int Name_mergeSorted(struct Name *psArray, const Type *ptElements,
+                        size_t uCount,
+                        int (*pfCompare)(const Type *ptElement1,
+                                         const Type *ptElement2),
+                        size_t *puDuplicates, Allocator_T oAAlloc)
+      Merge the uCount elements of ptElements into *psArray, both
+      sorted as determined by *pfCompare, in one backward pass, as
+      DynArray_mergeSorted does.  Return 1 (TRUE) if successful, or 0
+      (FALSE) if insufficient memory is available, in which case
+      *psArray is unchanged.
+   Type Name_removeAt(struct Name *psArray, size_t uIndex)
+      Remove and return the uIndex'th element of *psArray.  Removal
+      never reduces the physical length of *psArray (only
+      Name_shrinkToFit does), so adding an element back cannot fail.
+   int Name_reserve(struct Name *psArray, size_t uPhysLength,
+                    Allocator_T oAAlloc)
+      Make the physical length of *psArray at least uPhysLength.
+      Return 1 (TRUE) if successful, or 0 (FALSE) if insufficient
+      memory is available, in which case *psArray is unchanged.
+   int Name_shrinkToFit(struct Name *psArray, Allocator_T oAAlloc)
+      Reduce the physical length of *psArray to its length.  Return 1
+      (TRUE) if successful, or 0 (FALSE) if insufficient memory is
+      available, in which case *psArray is unchanged.
+   void Name_setGrowth(struct Name *psArray, size_t uPercent)
+      Make *psArray grow, whenever it runs out of room, by uPercent
+      percent of its physical length rather than doubling, as
+      DynArray_setGrowth does.  uPercent must be positive.
+   int Name_bsearch(const struct Name *psArray, const void *pvKey,
+                    size_t *puIndex)
+      Binary search *psArray, which must be sorted as determined by
+      Cmp, for pvKey: as DynArray_bsearch does if it is short, and
+      otherwise as DynArray_bsearchBranchless does, prefetching with
+      Key.  If it is found, assign its index to *puIndex and return
+      1; otherwise assign the index where it would belong to *puIndex
+      and return 0.
+   int Name_getStats(const struct Name *psArray,
+                     struct DynArrayStats *psStats)
+      Assign the counts kept so far for *psArray to *psStats, as
+      DynArray_getStats does.  Return 1 (TRUE) in an instrumented
+      build, or 0 (FALSE), having zeroed *psStats, otherwise. */
+
+/* Hint that the memory at pv will soon be read, if the compiler
+   offers a way to. */
+
+#ifdef __GNUC__
+#define TYPEDARRAY_PREFETCH(pv) __builtin_prefetch(pv)
+#else
+#define TYPEDARRAY_PREFETCH(pv) ((void)(pv))
+#endif
+
+/* The percentage by which an array grows its physical length when it
+   runs out of room, unless Name_setGrowth says otherwise: doubling
+   it, as a DynArray does. */
+
+enum {TYPEDARRAY_DEFAULT_GROWTH = 100};
+
+/* The longest array that Name_bsearch searches with the classic
+   binary search rather than the branchless one. */
+
+enum {TYPEDARRAY_SHORT_SEARCH = 1024};
+
+/* Keep the counts of each array, in a build instrumented by defining
+   DYNARRAY_STATS, as a DynArray does: the member that holds them,
+   zeroing them, copying them to *psStats, and counting the growth of
+   *psArray, the elements an operation on it moved, and the
+   comparisons a search or merge of it made.  A search counts even
+   though it does not otherwise change *psArray. */
+
+#ifdef DYNARRAY_STATS
+#define TYPEDARRAY_STATS_MEMBER struct DynArrayStats sStats;
+#define TYPEDARRAY_ZERO_STATS(psArray)                                 \
+   memset(&(psArray)->sStats, 0, sizeof((psArray)->sStats))
+#define TYPEDARRAY_GET_STATS(psArray, psStats)                         \
+   (*(psStats) = (psArray)->sStats, 1)
+#define TYPEDARRAY_COUNT_GROW(psArray, uPhysLength, uBytes)            \
+   DynArray_countGrow(&(psArray)->sStats, (uPhysLength), (uBytes))
+#define TYPEDARRAY_COUNT_SHIFT(psArray, uShift, uLength)               \
+   DynArray_countShift(&(psArray)->sStats, (uShift), (uLength))
+#define TYPEDARRAY_COUNT_COMPARES(psArray, uCompares, bSorting)        \
+   DynArray_countCompares((struct DynArrayStats *)&(psArray)->sStats,  \
+                          (uCompares), (bSorting))
+#else
+#define TYPEDARRAY_STATS_MEMBER
+#define TYPEDARRAY_ZERO_STATS(psArray) ((void)(psArray))
+#define TYPEDARRAY_GET_STATS(psArray, psStats)                         \
+   ((void)(psArray), memset((psStats), 0, sizeof(*(psStats))), 0)
+#define TYPEDARRAY_COUNT_GROW(psArray, uPhysLength, uBytes)            \
+   ((void)(psArray), (void)(uPhysLength), (void)(uBytes))
+#define TYPEDARRAY_COUNT_SHIFT(psArray, uShift, uLength)               \
+   ((void)(psArray), (void)(uShift), (void)(uLength))
+#define TYPEDARRAY_COUNT_COMPARES(psArray, uCompares, bSorting)        \
+   ((void)(psArray), (void)(uCompares), (void)(bSorting))
+#endif
+
+#define DEFINE_DYNARRAY(Name, Type, Cmp, Key)                          \
+                                                                       \
+struct Name                                                            \
+{                                                                      \
+   /* The number of elements from the client's point of view. */       \
+   size_t uLength;                                                     \
+                                                                       \
+   /* The number of elements in the underlying array. */               \
+   size_t uPhysLength;                                                 \
+                                                                       \
+   /* The underlying array, or NULL if uPhysLength is 0. */            \
+   Type *ptArray;                                                      \
+                                                                       \
+   /* The percentage of uPhysLength by which the array grows when it   \
+      runs out of room. */                                             \
+   size_t uGrowthPercent;                                              \
+                                                                       \
+   /* The counts kept for the array by an instrumented build. */       \
+   TYPEDARRAY_STATS_MEMBER                                             \
+};                                                                     \
+                                                                       \
+static inline int Name##_init(struct Name *psArray, size_t uLength,   \
+                              Allocator_T oAAlloc)                     \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   psArray->uLength = 0;                                               \
+   psArray->uPhysLength = 0;                                           \
+   psArray->ptArray = NULL;                                            \
+   psArray->uGrowthPercent = TYPEDARRAY_DEFAULT_GROWTH;                \
+   TYPEDARRAY_ZERO_STATS(psArray);                                     \
+   if (uLength == 0)                                                   \
+      return 1;                                                        \
+                                                                       \
+   psArray->ptArray = (Type *)Allocator_calloc(oAAlloc, uLength,       \
+                                               sizeof(Type));          \
+   if (psArray->ptArray == NULL)                                       \
+      return 0;                                                        \
+   psArray->uLength = uLength;                                         \
+   psArray->uPhysLength = uLength;                                     \
+   return 1;                                                           \
+}                                                                      \
+                                                                       \
+static inline void Name##_clear(struct Name *psArray,                  \
+                                Allocator_T oAAlloc)                   \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   Allocator_release(oAAlloc, psArray->ptArray,                        \
+                     sizeof(Type) * psArray->uPhysLength);             \
+   psArray->uLength = 0;                                               \
+   psArray->uPhysLength = 0;                                           \
+   psArray->ptArray = NULL;                                            \
+}                                                                      \
+                                                                       \
+static inline size_t Name##_getLength(const struct Name *psArray)      \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   return psArray->uLength;                                            \
+}                                                                      \
+                                                                       \
+static inline size_t Name##_getPhysLength(const struct Name *psArray)  \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   return psArray->uPhysLength;                                        \
+}                                                                      \
+                                                                       \
+static inline Type Name##_get(const struct Name *psArray,              \
+                              size_t uIndex)                           \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+   assert(uIndex < psArray->uLength);                                  \
+                                                                       \
+   return psArray->ptArray[uIndex];                                    \
+}                                                                      \
+                                                                       \
+static inline Type Name##_set(struct Name *psArray, size_t uIndex,     \
+                              Type tElement)                           \
+{                                                                      \
+   Type tOldElement;                                                   \
+                                                                       \
+   assert(psArray != NULL);                                            \
+   assert(uIndex < psArray->uLength);                                  \
+                                                                       \
+   tOldElement = psArray->ptArray[uIndex];                             \
+   psArray->ptArray[uIndex] = tElement;                                \
+   return tOldElement;                                                 \
+}                                                                      \
+                                                                       \
+static inline int Name##_reserve(struct Name *psArray,                 \
+                                 size_t uPhysLength,                   \
+                                 Allocator_T oAAlloc)                  \
+{                                                                      \
+   Type *ptNewArray;                                                   \
+                                                                       \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   if (uPhysLength <= psArray->uPhysLength)                            \
+      return 1;                                                        \
+   ptNewArray = (Type *)Allocator_realloc(oAAlloc, psArray->ptArray,   \
+      sizeof(Type) * psArray->uPhysLength, sizeof(Type) * uPhysLength);\
+   if (ptNewArray == NULL)                                             \
+      return 0;                                                        \
+   psArray->uPhysLength = uPhysLength;                                 \
+   psArray->ptArray = ptNewArray;                                      \
+   TYPEDARRAY_COUNT_GROW(psArray, uPhysLength,                         \
+                         sizeof(Type) * uPhysLength);                  \
+   return 1;                                                           \
+}                                                                      \
+                                                                       \
+static inline int Name##_shrinkToFit(struct Name *psArray,             \
+                                     Allocator_T oAAlloc)              \
+{                                                                      \
+   Type *ptNewArray;                                                   \
+                                                                       \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   if (psArray->uLength == psArray->uPhysLength)                       \
+      return 1;                                                        \
+   if (psArray->uLength == 0)                                          \
+   {                                                                   \
+      Name##_clear(psArray, oAAlloc);                                  \
+      return 1;                                                        \
+   }                                                                   \
+   ptNewArray = (Type *)Allocator_realloc(oAAlloc, psArray->ptArray,   \
+      sizeof(Type) * psArray->uPhysLength,                             \
+      sizeof(Type) * psArray->uLength);                                \
+   if (ptNewArray == NULL)                                             \
+      return 0;                                                        \
+   psArray->uPhysLength = psArray->uLength;                            \
+   psArray->ptArray = ptNewArray;                                      \
+   return 1;                                                           \
+}                                                                      \
+                                                                       \
+static inline void Name##_setGrowth(struct Name *psArray,              \
+                                   size_t uPercent)                    \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+   assert(uPercent > 0);                                               \
+                                                                       \
+   psArray->uGrowthPercent = uPercent;                                 \
+}                                                                      \
+                                                                       \
+static inline int Name##_addAt(struct Name *psArray, size_t uIndex,    \
+                               Type tElement, Allocator_T oAAlloc)     \
+{                                                                      \
+   size_t uNewLength;                                                  \
+                                                                       \
+   assert(psArray != NULL);                                            \
+   assert(uIndex <= psArray->uLength);                                 \
+                                                                       \
+   if (psArray->uLength == psArray->uPhysLength)                       \
+   {                                                                   \
+      uNewLength = DynArray_grownLength(psArray->uPhysLength,          \
+                                        psArray->uGrowthPercent);      \
+      if (uNewLength < 2)                                              \
+         uNewLength = 2;                                               \
+      if (!Name##_reserve(psArray, uNewLength, oAAlloc))               \
+         return 0;                                                     \
+   }                                                                   \
+                                                                       \
+   memmove(&psArray->ptArray[uIndex + 1], &psArray->ptArray[uIndex],   \
+      sizeof(Type) * (psArray->uLength - uIndex));                     \
+   psArray->ptArray[uIndex] = tElement;                                \
+   psArray->uLength++;                                                 \
+   TYPEDARRAY_COUNT_SHIFT(psArray, psArray->uLength - uIndex - 1,      \
+                          psArray->uLength);                           \
+   return 1;                                                           \
+}                                                                      \
+                                                                       \
+static inline int Name##_add(struct Name *psArray, Type tElement,      \
+                             Allocator_T oAAlloc)                      \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+                                                                       \
+   return Name##_addAt(psArray, psArray->uLength, tElement, oAAlloc);  \
+}                                                                      \
+                                                                       \
+static inline int Name##_mergeSorted(struct Name *psArray,             \
+   const Type *ptElements, size_t uCount,                              \
+   int (*pfCompare)(const Type *ptElement1, const Type *ptElement2),   \
+   size_t *puDuplicates, Allocator_T oAAlloc)                          \
+{                                                                      \
+   Type *ptArray;                                                      \
+   const Type *ptLastNew = NULL;                                       \
+   size_t uNewLength;                                                  \
+   size_t uOld;                                                        \
+   size_t uNew;                                                        \
+   size_t uTo;                                                         \
+   size_t uEnd;                                                        \
+   size_t uCompares = 0;                                               \
+   int iCompare;                                                       \
+                                                                       \
+   assert(psArray != NULL);                                            \
+   assert(ptElements != NULL || uCount == 0);                          \
+   assert(pfCompare != NULL);                                          \
+                                                                       \
+   uEnd = psArray->uLength + uCount;                                   \
+   if (uEnd > psArray->uPhysLength)                                    \
+   {                                                                   \
+      uNewLength = DynArray_grownLength(psArray->uPhysLength,          \
+                                        psArray->uGrowthPercent);      \
+      if (uNewLength < uEnd)                                           \
+         uNewLength = uEnd;                                            \
+      if (!Name##_reserve(psArray, uNewLength, oAAlloc))               \
+         return 0;                                                     \
+   }                                                                   \
+                                                                       \
+   /* as in DynArray_mergeSorted */                                    \
+   ptArray = psArray->ptArray;                                         \
+   uOld = psArray->uLength;                                            \
+   uNew = uCount;                                                      \
+   uTo = uEnd;                                                         \
+   while (uNew > 0)                                                    \
+   {                                                                   \
+      if (uOld > 0)                                                    \
+      {                                                                \
+         iCompare = (*pfCompare)(&ptArray[uOld - 1],                   \
+                                 &ptElements[uNew - 1]);               \
+         uCompares++;                                                  \
+         if (iCompare > 0)                                             \
+         {                                                             \
+            ptArray[--uTo] = ptArray[--uOld];                          \
+            ptLastNew = NULL;                                          \
+            continue;                                                  \
+         }                                                             \
+         if (iCompare == 0)                                            \
+         {                                                             \
+            uNew--;                                                    \
+            continue;                                                  \
+         }                                                             \
+      }                                                                \
+      if (ptLastNew == NULL ||                                         \
+          (uCompares++,                                                \
+           (*pfCompare)(&ptElements[uNew - 1], ptLastNew) != 0))       \
+      {                                                                \
+         ptLastNew = &ptElements[uNew - 1];                            \
+         ptArray[--uTo] = *ptLastNew;                                  \
+      }                                                                \
+      uNew--;                                                          \
+   }                                                                   \
+                                                                       \
+   if (uTo > uOld)                                                     \
+      memmove(&ptArray[uOld], &ptArray[uTo],                           \
+         sizeof(Type) * (uEnd - uTo));                                 \
+   if (puDuplicates != NULL)                                           \
+      *puDuplicates = uTo - uOld;                                      \
+   TYPEDARRAY_COUNT_COMPARES(psArray, uCompares, 1);                   \
+   TYPEDARRAY_COUNT_SHIFT(psArray, psArray->uLength - uOld +           \
+                          (uTo > uOld ? uEnd - uTo : 0),               \
+                          uEnd - (uTo - uOld));                        \
+   psArray->uLength = uEnd - (uTo - uOld);                             \
+   return 1;                                                           \
+}                                                                      \
+                                                                       \
+static inline Type Name##_removeAt(struct Name *psArray,               \
+                                   size_t uIndex)                      \
+{                                                                      \
+   Type tOldElement;                                                   \
+                                                                       \
+   assert(psArray != NULL);                                            \
+   assert(uIndex < psArray->uLength);                                  \
+                                                                       \
+   tOldElement = psArray->ptArray[uIndex];                             \
+   psArray->uLength--;                                                 \
+   memmove(&psArray->ptArray[uIndex], &psArray->ptArray[uIndex + 1],   \
+      sizeof(Type) * (psArray->uLength - uIndex));                     \
+   TYPEDARRAY_COUNT_SHIFT(psArray, psArray->uLength - uIndex,          \
+                          psArray->uLength);                           \
+   return tOldElement;                                                 \
+}                                                                      \
+                                                                       \
+static inline int Name##_bsearch(const struct Name *psArray,           \
+                                 const void *pvKey, size_t *puIndex)   \
+{                                                                      \
+   const Type *ptBase;                                                 \
+   size_t uLeft;                                                       \
+   size_t uHalf;                                                       \
+   size_t uCompares = 0;                                               \
+   int iCompare;                                                       \
+                                                                       \
+   assert(psArray != NULL);                                            \
+   assert(puIndex != NULL);                                            \
+                                                                       \
+   /* a short array stays in the cache, so a search that can stop      \
+      at a match does better there */                                  \
+   if (psArray->uLength <= TYPEDARRAY_SHORT_SEARCH)                    \
+   {                                                                   \
+      /* as in DynArray_bsearch */                                     \
+      ptBase = psArray->ptArray;                                       \
+      uLeft = psArray->uLength;                                        \
+      while (uLeft > 0)                                                \
+      {                                                                \
+         uHalf = uLeft / 2;                                            \
+         iCompare = Cmp(&ptBase[uHalf], pvKey);                        \
+         uCompares++;                                                  \
+         if (iCompare == 0)                                            \
+         {                                                             \
+            ptBase += uHalf;                                           \
+            break;                                                     \
+         }                                                             \
+         if (iCompare < 0)                                             \
+         {                                                             \
+            ptBase += uHalf + 1;                                       \
+            uLeft -= uHalf + 1;                                        \
+         }                                                             \
+         else                                                          \
+            uLeft = uHalf;                                             \
+      }                                                                \
+      TYPEDARRAY_COUNT_COMPARES(psArray, uCompares, 0);                \
+      *puIndex = (size_t)(ptBase - psArray->ptArray);                  \
+      return uLeft > 0;                                                \
+   }                                                                   \
+                                                                       \
+   /* and a long one a branchless search, as in                        \
+      DynArray_bsearchBranchless */                                    \
+   ptBase = psArray->ptArray;                                          \
+   uLeft = psArray->uLength;                                           \
+   while (uLeft > 1)                                                   \
+   {                                                                   \
+      uHalf = uLeft / 2;                                               \
+      TYPEDARRAY_PREFETCH(Key(&ptBase[uHalf / 2]));                    \
+      TYPEDARRAY_PREFETCH(Key(&ptBase[uHalf + uHalf / 2]));            \
+      iCompare = Cmp(&ptBase[uHalf], pvKey);                           \
+      ptBase = (iCompare <= 0) ? ptBase + uHalf : ptBase;              \
+      uLeft -= uHalf;                                                  \
+      uCompares++;                                                     \
+   }                                                                   \
+                                                                       \
+   iCompare = Cmp(ptBase, pvKey);                                      \
+   TYPEDARRAY_COUNT_COMPARES(psArray, uCompares + 1, 0);               \
+   *puIndex = (size_t)(ptBase - psArray->ptArray) + (iCompare < 0);    \
+   return iCompare == 0;                                               \
+}                                                                      \
+                                                                       \
+static inline int Name##_getStats(const struct Name *psArray,          \
+                                  struct DynArrayStats *psStats)       \
+{                                                                      \
+   assert(psArray != NULL);                                            \
+   assert(psStats != NULL);                                            \
+                                                                       \
+   return TYPEDARRAY_GET_STATS(psArray, psStats);                      \
+}
+
+#endif
@@ -0,0 +1 @@
+../0shared/allocator.h
\ No newline at end of file
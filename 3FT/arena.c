@@ -0,0 +1,238 @@
+/*--------------------------------------------------------------------*/
+/* arena.c                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include "arena.h"
+
+/* The smallest size class is 2^MIN_CLASS_SHIFT bytes, and each
+   following class doubles it. Requests bigger than the largest class
+   get a chunk of their own. */
+enum { MIN_CLASS_SHIFT = 5, NUM_CLASSES = 12 };
+
+/* The number of usable bytes in an ordinary chunk. This is also the
+   size of the largest class. */
+enum { CHUNK_SIZE = 1 << (MIN_CLASS_SHIFT + NUM_CLASSES - 1) };
+
+/* A chunk of memory carved up by the arena. The usable bytes follow
+   the header. */
+struct chunk
+{
+   /* the neighbouring chunks in the arena's list of chunks */
+   struct chunk *psNext;
+   struct chunk *psPrev;
+   /* the number of usable bytes that follow the header */
+   size_t ulSize;
+   /* unused, keeps the usable bytes aligned for any small object */
+   size_t ulPad;
+};
+
+/* A released block, linked into the free list of its size class. */
+struct freeBlock
+{
+   struct freeBlock *psNext;
+};
+
+/* An arena: its chunks, bump pointer and free lists */
+struct arena
+{
+   /* every chunk allocated by the arena */
+   struct chunk *psChunks;
+   /* the next unused byte of the newest ordinary chunk */
+   char *pcNext;
+   /* one past the last usable byte of the newest ordinary chunk */
+   char *pcEnd;
+   /* released blocks, by size class */
+   struct freeBlock *apsFree[NUM_CLASSES];
+   /* bytes in blocks currently handed out */
+   size_t ulLiveBytes;
+   /* bytes in blocks sitting on the free lists */
+   size_t ulFreeBytes;
+};
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Returns the size class of a request of ulSize bytes, or NUM_CLASSES
+  if the request is too big for any class.
+*/
+static size_t Arena_getClass(size_t ulSize)
+{
+   size_t ulClass = 0;
+   size_t ulClassSize = (size_t)1 << MIN_CLASS_SHIFT;
+
+   while (ulClassSize < ulSize && ulClass < NUM_CLASSES)
+   {
+      ulClassSize <<= 1;
+      ulClass++;
+   }
+   return ulClass;
+}
+
+/* Returns the number of bytes in a block of size class ulClass. */
+static size_t Arena_getClassSize(size_t ulClass)
+{
+   assert(ulClass < NUM_CLASSES);
+
+   return (size_t)1 << (ulClass + MIN_CLASS_SHIFT);
+}
+
+/*
+  Allocates a chunk with ulSize usable bytes and links it into
+  oAArena's list of chunks. Returns the chunk, or NULL if memory could
+  not be allocated.
+*/
+static struct chunk *Arena_addChunk(Arena_T oAArena, size_t ulSize)
+{
+   struct chunk *psChunk;
+
+   assert(oAArena != NULL);
+
+   psChunk = malloc(sizeof(struct chunk) + ulSize);
+   if (psChunk == NULL)
+      return NULL;
+
+   psChunk->ulSize = ulSize;
+   psChunk->psPrev = NULL;
+   psChunk->psNext = oAArena->psChunks;
+   if (oAArena->psChunks != NULL)
+      oAArena->psChunks->psPrev = psChunk;
+   oAArena->psChunks = psChunk;
+   return psChunk;
+}
+
+/*--------------------------------------------------------------------*/
+
+Arena_T Arena_new(void)
+{
+   Arena_T oAArena;
+   size_t ulClass;
+
+   oAArena = malloc(sizeof(struct arena));
+   if (oAArena == NULL)
+      return NULL;
+
+   oAArena->psChunks = NULL;
+   oAArena->pcNext = NULL;
+   oAArena->pcEnd = NULL;
+   for (ulClass = 0; ulClass < NUM_CLASSES; ulClass++)
+      oAArena->apsFree[ulClass] = NULL;
+   oAArena->ulLiveBytes = 0;
+   oAArena->ulFreeBytes = 0;
+
+   return oAArena;
+}
+
+void Arena_free(Arena_T oAArena)
+{
+   struct chunk *psChunk;
+   struct chunk *psNext;
+
+   assert(oAArena != NULL);
+
+   for (psChunk = oAArena->psChunks; psChunk != NULL; psChunk = psNext)
+   {
+      psNext = psChunk->psNext;
+      free(psChunk);
+   }
+   free(oAArena);
+}
+
+void *Arena_alloc(Arena_T oAArena, size_t ulSize)
+{
+   struct chunk *psChunk;
+   struct freeBlock *psBlock;
+   size_t ulClass;
+   size_t ulClassSize;
+   char *pcBlock;
+
+   assert(oAArena != NULL);
+
+   ulClass = Arena_getClass(ulSize);
+
+   /* too big for any class: give it a chunk of its own */
+   if (ulClass == NUM_CLASSES)
+   {
+      psChunk = Arena_addChunk(oAArena, ulSize);
+      if (psChunk == NULL)
+         return NULL;
+      oAArena->ulLiveBytes += ulSize;
+      return psChunk + 1;
+   }
+   ulClassSize = Arena_getClassSize(ulClass);
+
+   /* reuse a released block of the same class if there is one */
+   psBlock = oAArena->apsFree[ulClass];
+   if (psBlock != NULL)
+   {
+      oAArena->apsFree[ulClass] = psBlock->psNext;
+      oAArena->ulFreeBytes -= ulClassSize;
+      oAArena->ulLiveBytes += ulClassSize;
+      return psBlock;
+   }
+
+   /* otherwise bump; the rest of a full chunk is abandoned */
+   if ((size_t)(oAArena->pcEnd - oAArena->pcNext) < ulClassSize)
+   {
+      psChunk = Arena_addChunk(oAArena, CHUNK_SIZE);
+      if (psChunk == NULL)
+         return NULL;
+      oAArena->pcNext = (char *)(psChunk + 1);
+      oAArena->pcEnd = oAArena->pcNext + CHUNK_SIZE;
+   }
+   pcBlock = oAArena->pcNext;
+   oAArena->pcNext += ulClassSize;
+   oAArena->ulLiveBytes += ulClassSize;
+   return pcBlock;
+}
+
+void Arena_release(Arena_T oAArena, void *pvBlock, size_t ulSize)
+{
+   struct chunk *psChunk;
+   struct freeBlock *psBlock;
+   size_t ulClass;
+
+   assert(oAArena != NULL);
+   assert(pvBlock != NULL);
+
+   ulClass = Arena_getClass(ulSize);
+
+   /* a chunk of its own goes straight back to the system */
+   if (ulClass == NUM_CLASSES)
+   {
+      psChunk = (struct chunk *)pvBlock - 1;
+      if (psChunk->psPrev != NULL)
+         psChunk->psPrev->psNext = psChunk->psNext;
+      else
+         oAArena->psChunks = psChunk->psNext;
+      if (psChunk->psNext != NULL)
+         psChunk->psNext->psPrev = psChunk->psPrev;
+      oAArena->ulLiveBytes -= psChunk->ulSize;
+      free(psChunk);
+      return;
+   }
+
+   psBlock = pvBlock;
+   psBlock->psNext = oAArena->apsFree[ulClass];
+   oAArena->apsFree[ulClass] = psBlock;
+   oAArena->ulLiveBytes -= Arena_getClassSize(ulClass);
+   oAArena->ulFreeBytes += Arena_getClassSize(ulClass);
+}
+
+size_t Arena_getLiveBytes(Arena_T oAArena)
+{
+   assert(oAArena != NULL);
+
+   return oAArena->ulLiveBytes;
+}
+
+boolean Arena_isFragmented(Arena_T oAArena)
+{
+   assert(oAArena != NULL);
+
+   /* more free than live, and at least a chunk's worth to win back */
+   return (boolean)(oAArena->ulFreeBytes >= CHUNK_SIZE &&
+                    oAArena->ulFreeBytes > oAArena->ulLiveBytes);
+}
@@ -0,0 +1,53 @@
+/*--------------------------------------------------------------------*/
+/* arena.h                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Arena_T is a region of memory that hands out blocks by bumping a
+  pointer through large chunks. Released blocks are kept on free lists
+  by size class for reuse, and freeing the arena releases every block
+  at once.
+*/
+typedef struct arena *Arena_T;
+
+/* Returns a new, empty arena, or NULL if memory could not be
+   allocated. */
+Arena_T Arena_new(void);
+
+/* Frees oAArena along with every block ever allocated from it. */
+void Arena_free(Arena_T oAArena);
+
+/*
+  Returns a block of at least ulSize bytes from oAArena, aligned for
+  any object that fits in a size_t or a pointer, or NULL if memory
+  could not be allocated.
+*/
+void *Arena_alloc(Arena_T oAArena, size_t ulSize);
+
+/*
+  Gives back to oAArena the block pvBlock, which must have been
+  returned by Arena_alloc with the same ulSize.
+*/
+void Arena_release(Arena_T oAArena, void *pvBlock, size_t ulSize);
+
+/*
+  Returns the number of bytes in blocks that are currently allocated
+  from oAArena, rounded up to their size classes.
+*/
+size_t Arena_getLiveBytes(Arena_T oAArena);
+
+/*
+  Returns TRUE if so much of oAArena sits on free lists that copying
+  its live blocks into a fresh arena would be worthwhile, and FALSE
+  otherwise.
+*/
+boolean Arena_isFragmented(Arena_T oAArena);
+
+#endif
@@ -0,0 +1,660 @@
+/*--------------------------------------------------------------------*/
+/* btree.c                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btree.h"
+
+/* The most levels a B+tree has; every page holds at least four
+   entries, so this is never reached. */
+enum { MAX_DEPTH = 32 };
+
+/* The most cells a page holds, counting one being added */
+enum { MAX_CELLS = PAGER_PAGE_SIZE / 4 };
+
+/* The bytes before the key in a leaf cell (key and value lengths) and
+   in an inner cell (key length and child page) */
+enum { LEAF_HEAD = 2 * sizeof(unsigned short) };
+enum { INNER_HEAD = sizeof(unsigned short) + sizeof(size_t) };
+
+/*
+  The start of every page. After it come the cells' offsets, in key
+  order, while the cells themselves fill the page from its end. A
+  leaf cell is its key's length, its value's length, the key, then
+  the value; an inner cell is its key's length, the child page for
+  keys from that key up to the next cell's, then the key.
+*/
+struct pageHeader
+{
+   /* TRUE for a leaf */
+   unsigned short usIsLeaf;
+   /* the number of cells */
+   unsigned short usCount;
+   /* the offset of the lowest cell, where free space ends */
+   unsigned short usCells;
+   /* a leaf's next leaf (0 if it is the last), or an inner page's
+      child for keys below its first cell's */
+   size_t ulLink;
+};
+
+/* A B+tree: its pages and scratch space for rebuilding them */
+struct btree
+{
+   /* the pager holding the pages */
+   Pager_T oPPager;
+   /* the root page */
+   size_t ulRoot;
+   /* a copy of a page being rebuilt, and its cells in order */
+   char acScratch[PAGER_PAGE_SIZE];
+   const char *apcCells[MAX_CELLS];
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Copies the header of the page at pcPage into *psHeader. */
+static void BTree_getHeader(const char *pcPage,
+                            struct pageHeader *psHeader)
+{
+   memcpy(psHeader, pcPage, sizeof(struct pageHeader));
+}
+
+/* Copies *psHeader into the header of the page at pcPage. */
+static void BTree_setHeader(char *pcPage,
+                            const struct pageHeader *psHeader)
+{
+   memcpy(pcPage, psHeader, sizeof(struct pageHeader));
+}
+
+/* Returns cell ulIndex of the page at pcPage. */
+static const char *BTree_cell(const char *pcPage, size_t ulIndex)
+{
+   unsigned short usOffset;
+
+   memcpy(&usOffset, pcPage + sizeof(struct pageHeader)
+          + ulIndex * sizeof(unsigned short), sizeof(unsigned short));
+   return pcPage + usOffset;
+}
+
+/* Sets *ppcKey to the key of the cell at pcCell, of a leaf if bLeaf
+   is TRUE, and returns its length. */
+static size_t BTree_cellKey(const char *pcCell, boolean bLeaf,
+                            const char **ppcKey)
+{
+   unsigned short usKeyLength;
+
+   memcpy(&usKeyLength, pcCell, sizeof(unsigned short));
+   *ppcKey = pcCell + (bLeaf ? LEAF_HEAD : INNER_HEAD);
+   return usKeyLength;
+}
+
+/* Returns the number of bytes of the cell at pcCell, of a leaf if
+   bLeaf is TRUE. */
+static size_t BTree_cellSize(const char *pcCell, boolean bLeaf)
+{
+   unsigned short usKeyLength;
+   unsigned short usValueLength;
+
+   memcpy(&usKeyLength, pcCell, sizeof(unsigned short));
+   if (!bLeaf)
+      return INNER_HEAD + usKeyLength;
+   memcpy(&usValueLength, pcCell + sizeof(unsigned short),
+          sizeof(unsigned short));
+   return LEAF_HEAD + usKeyLength + usValueLength;
+}
+
+/* Returns the child page of the inner cell at pcCell. */
+static size_t BTree_cellChild(const char *pcCell)
+{
+   size_t ulChild;
+
+   memcpy(&ulChild, pcCell + sizeof(unsigned short), sizeof(size_t));
+   return ulChild;
+}
+
+/* Compares the ulLength1-byte key at pcKey1 with the ulLength2-byte
+   key at pcKey2, as for memcmp. */
+static int BTree_compare(const char *pcKey1, size_t ulLength1,
+                         const char *pcKey2, size_t ulLength2)
+{
+   int iResult;
+
+   iResult = memcmp(pcKey1, pcKey2,
+                    ulLength1 < ulLength2 ? ulLength1 : ulLength2);
+   if (iResult != 0)
+      return iResult;
+   if (ulLength1 == ulLength2)
+      return 0;
+   return (ulLength1 < ulLength2) ? -1 : 1;
+}
+
+/*
+  Returns the index of the first cell of the page at pcPage whose key
+  is greater than the ulKeyLength-byte key at pcKey, or, if bOrEqual
+  is TRUE, not less than it. Sets *pbFound (if not NULL) to whether a
+  cell has exactly that key.
+*/
+static size_t BTree_search(const char *pcPage, const char *pcKey,
+                           size_t ulKeyLength, boolean bOrEqual,
+                           boolean *pbFound)
+{
+   struct pageHeader sHeader;
+   const char *pcCellKey;
+   size_t ulCellKeyLength;
+   size_t ulLow = 0;
+   size_t ulHigh;
+   size_t ulMid;
+   int iCompare;
+   boolean bFound = FALSE;
+
+   BTree_getHeader(pcPage, &sHeader);
+   ulHigh = sHeader.usCount;
+   while (ulLow < ulHigh)
+   {
+      ulMid = ulLow + (ulHigh - ulLow) / 2;
+      ulCellKeyLength = BTree_cellKey(BTree_cell(pcPage, ulMid),
+                                      sHeader.usIsLeaf, &pcCellKey);
+      iCompare = BTree_compare(pcCellKey, ulCellKeyLength, pcKey,
+                               ulKeyLength);
+      if (iCompare == 0)
+         bFound = TRUE;
+      if (iCompare < 0 || (iCompare == 0 && !bOrEqual))
+         ulLow = ulMid + 1;
+      else
+         ulHigh = ulMid;
+   }
+   if (pbFound != NULL)
+      *pbFound = bFound;
+   return ulLow;
+}
+
+/* Returns the child of the inner page at pcPage that holds the
+   ulKeyLength-byte key at pcKey. */
+static size_t BTree_childFor(const char *pcPage, const char *pcKey,
+                             size_t ulKeyLength)
+{
+   struct pageHeader sHeader;
+   size_t ulIndex;
+
+   ulIndex = BTree_search(pcPage, pcKey, ulKeyLength, FALSE, NULL);
+   if (ulIndex == 0)
+   {
+      BTree_getHeader(pcPage, &sHeader);
+      return sHeader.ulLink;
+   }
+   return BTree_cellChild(BTree_cell(pcPage, ulIndex - 1));
+}
+
+/*
+  Rewrites the page at pcPage to hold the ulCount cells at ppcCells,
+  in order, which must not point into the page, with leaf flag bLeaf
+  and link ulLink.
+*/
+static void BTree_fill(char *pcPage, boolean bLeaf, size_t ulLink,
+                       const char **ppcCells, size_t ulCount)
+{
+   struct pageHeader sHeader;
+   size_t ulIndex;
+   size_t ulSize;
+   unsigned short usOffset = PAGER_PAGE_SIZE;
+
+   for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+   {
+      ulSize = BTree_cellSize(ppcCells[ulIndex], bLeaf);
+      usOffset = (unsigned short)(usOffset - ulSize);
+      memcpy(pcPage + usOffset, ppcCells[ulIndex], ulSize);
+      memcpy(pcPage + sizeof(struct pageHeader)
+             + ulIndex * sizeof(unsigned short), &usOffset,
+             sizeof(unsigned short));
+   }
+
+   memset(&sHeader, 0, sizeof(struct pageHeader));
+   sHeader.usIsLeaf = (unsigned short)bLeaf;
+   sHeader.usCount = (unsigned short)ulCount;
+   sHeader.usCells = usOffset;
+   sHeader.ulLink = ulLink;
+   BTree_setHeader(pcPage, &sHeader);
+}
+
+/*
+  Copies the page at pcPage to oBTree's scratch space and lists its
+  cells there, with the cell at pcNewCell (if not NULL) added at index
+  ulPosition and the cell at index ulSkip (if not the page's count)
+  left out. Returns the number of cells listed.
+*/
+static size_t BTree_gather(BTree_T oBTree, const char *pcPage,
+                           const char *pcNewCell, size_t ulPosition,
+                           size_t ulSkip)
+{
+   struct pageHeader sHeader;
+   size_t ulIndex;
+   size_t ulCount = 0;
+
+   memcpy(oBTree->acScratch, pcPage, PAGER_PAGE_SIZE);
+   BTree_getHeader(pcPage, &sHeader);
+   for (ulIndex = 0; ulIndex <= sHeader.usCount; ulIndex++)
+   {
+      if (pcNewCell != NULL && ulIndex == ulPosition)
+         oBTree->apcCells[ulCount++] = pcNewCell;
+      if (ulIndex < sHeader.usCount && ulIndex != ulSkip)
+         oBTree->apcCells[ulCount++] =
+            BTree_cell(oBTree->acScratch, ulIndex);
+   }
+   return ulCount;
+}
+
+/*
+  Adds the cell at pcCell at index ulPosition of the page at pcPage if
+  there is room. Returns TRUE if it was added.
+*/
+static boolean BTree_insertCell(char *pcPage, const char *pcCell,
+                                size_t ulPosition)
+{
+   struct pageHeader sHeader;
+   size_t ulSize;
+   size_t ulSlots;
+   unsigned short usOffset;
+   char *pcSlot;
+
+   BTree_getHeader(pcPage, &sHeader);
+   ulSize = BTree_cellSize(pcCell, sHeader.usIsLeaf);
+   ulSlots = sizeof(struct pageHeader)
+             + (sHeader.usCount + 1) * sizeof(unsigned short);
+   if (ulSlots + ulSize > sHeader.usCells)
+      return FALSE;
+
+   usOffset = (unsigned short)(sHeader.usCells - ulSize);
+   memcpy(pcPage + usOffset, pcCell, ulSize);
+   pcSlot = pcPage + sizeof(struct pageHeader)
+            + ulPosition * sizeof(unsigned short);
+   memmove(pcSlot + sizeof(unsigned short), pcSlot,
+           (sHeader.usCount - ulPosition) * sizeof(unsigned short));
+   memcpy(pcSlot, &usOffset, sizeof(unsigned short));
+
+   sHeader.usCount++;
+   sHeader.usCells = usOffset;
+   BTree_setHeader(pcPage, &sHeader);
+   return TRUE;
+}
+
+/*
+  Splits the full page ulPage of oBTree, pinned at pcPage, adding the
+  cell at pcNewCell at index ulPosition, into itself and a new right
+  sibling. Copies the key that divides them to pcSeparator, which has
+  room for BTREE_MAX_ENTRY bytes, and sets *pulSeparatorLength and
+  *pulRight. Returns SUCCESS or the status of a pager failure, leaving
+  the page as it was.
+*/
+static int BTree_split(BTree_T oBTree, char *pcPage,
+                       const char *pcNewCell, size_t ulPosition,
+                       char *pcSeparator, size_t *pulSeparatorLength,
+                       size_t *pulRight)
+{
+   struct pageHeader sHeader;
+   const char *pcLastKey;
+   const char *pcFirstKey;
+   size_t ulLastLength;
+   size_t ulFirstLength;
+   size_t ulCount;
+   size_t ulTotal = 0;
+   size_t ulLeft = 0;
+   size_t ulSplit;
+   size_t ulIndex;
+   size_t ulPrefix = 0;
+   void *pvRight;
+   boolean bLeaf;
+   int iStatus;
+
+   BTree_getHeader(pcPage, &sHeader);
+   bLeaf = sHeader.usIsLeaf;
+   ulCount = BTree_gather(oBTree, pcPage, pcNewCell, ulPosition,
+                          sHeader.usCount);
+
+   /* split by bytes, leaving each side at least one cell, and an inner
+      page's right side one more to give up its first child */
+   for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+      ulTotal += BTree_cellSize(oBTree->apcCells[ulIndex], bLeaf)
+                 + sizeof(unsigned short);
+   for (ulSplit = 0; ulSplit < ulCount - 1 && ulLeft < ulTotal / 2;
+        ulSplit++)
+      ulLeft += BTree_cellSize(oBTree->apcCells[ulSplit], bLeaf)
+                + sizeof(unsigned short);
+   if (ulSplit == 0)
+      ulSplit = 1;
+   if (!bLeaf && ulSplit > ulCount - 2)
+      ulSplit = ulCount - 2;
+
+   iStatus = Pager_allocate(oBTree->oPPager, pulRight, &pvRight);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (bLeaf)
+   {
+      /* the shortest prefix of the right's first key that still sorts
+         after the left's last key is enough to tell them apart */
+      ulLastLength = BTree_cellKey(oBTree->apcCells[ulSplit - 1], TRUE,
+                                   &pcLastKey);
+      ulFirstLength = BTree_cellKey(oBTree->apcCells[ulSplit], TRUE,
+                                    &pcFirstKey);
+      while (ulPrefix < ulLastLength && ulPrefix < ulFirstLength
+             && pcLastKey[ulPrefix] == pcFirstKey[ulPrefix])
+         ulPrefix++;
+      *pulSeparatorLength = ulPrefix + 1;
+      memcpy(pcSeparator, pcFirstKey, ulPrefix + 1);
+
+      BTree_fill(pvRight, TRUE, sHeader.ulLink,
+                 oBTree->apcCells + ulSplit, ulCount - ulSplit);
+      BTree_fill(pcPage, TRUE, *pulRight, oBTree->apcCells, ulSplit);
+   }
+   else
+   {
+      /* the dividing cell moves up, its child leading the right */
+      *pulSeparatorLength = BTree_cellKey(oBTree->apcCells[ulSplit],
+                                          FALSE, &pcFirstKey);
+      memcpy(pcSeparator, pcFirstKey, *pulSeparatorLength);
+
+      BTree_fill(pvRight, FALSE,
+                 BTree_cellChild(oBTree->apcCells[ulSplit]),
+                 oBTree->apcCells + ulSplit + 1, ulCount - ulSplit - 1);
+      BTree_fill(pcPage, FALSE, sHeader.ulLink, oBTree->apcCells,
+                 ulSplit);
+   }
+
+   Pager_release(oBTree->oPPager, pvRight, TRUE);
+   return SUCCESS;
+}
+
+/*
+  Follows the ulKeyLength-byte key at pcKey down from the root of
+  oBTree to its leaf, which is left pinned at *ppcLeaf, and records
+  the pages passed through, from the root, in aulPath, and their
+  number in *pulDepth. Returns SUCCESS or the status of a pager
+  failure.
+*/
+static int BTree_descend(BTree_T oBTree, const char *pcKey,
+                         size_t ulKeyLength, size_t aulPath[],
+                         size_t *pulDepth, char **ppcLeaf)
+{
+   struct pageHeader sHeader;
+   size_t ulPage = oBTree->ulRoot;
+   size_t ulDepth = 0;
+   void *pvPage;
+   int iStatus;
+
+   for (;;)
+   {
+      iStatus = Pager_get(oBTree->oPPager, ulPage, &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      assert(ulDepth < MAX_DEPTH);
+      aulPath[ulDepth++] = ulPage;
+      BTree_getHeader(pvPage, &sHeader);
+      if (sHeader.usIsLeaf)
+         break;
+      ulPage = BTree_childFor(pvPage, pcKey, ulKeyLength);
+      Pager_release(oBTree->oPPager, pvPage, FALSE);
+   }
+
+   *pulDepth = ulDepth;
+   *ppcLeaf = pvPage;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int BTree_new(Pager_T oPPager, BTree_T *poBResult)
+{
+   BTree_T oBTree;
+   void *pvRoot;
+   int iStatus;
+
+   assert(oPPager != NULL);
+   assert(poBResult != NULL);
+
+   *poBResult = NULL;
+   oBTree = malloc(sizeof(struct btree));
+   if (oBTree == NULL)
+      return MEMORY_ERROR;
+   oBTree->oPPager = oPPager;
+
+   iStatus = Pager_allocate(oPPager, &oBTree->ulRoot, &pvRoot);
+   if (iStatus != SUCCESS)
+   {
+      free(oBTree);
+      return iStatus;
+   }
+   BTree_fill(pvRoot, TRUE, 0, NULL, 0);
+   Pager_release(oPPager, pvRoot, TRUE);
+
+   *poBResult = oBTree;
+   return SUCCESS;
+}
+
+void BTree_free(BTree_T oBTree)
+{
+   assert(oBTree != NULL);
+
+   free(oBTree);
+}
+
+int BTree_get(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+              void *pvValue, size_t *pulValueLength)
+{
+   size_t aulPath[MAX_DEPTH];
+   size_t ulDepth;
+   size_t ulIndex;
+   size_t ulKeyInCell;
+   unsigned short usValueLength;
+   const char *pcCell;
+   const char *pcCellKey;
+   char *pcLeaf;
+   boolean bFound;
+   int iStatus;
+
+   assert(oBTree != NULL);
+   assert(pvKey != NULL || ulKeyLength == 0);
+
+   iStatus = BTree_descend(oBTree, pvKey, ulKeyLength, aulPath,
+                           &ulDepth, &pcLeaf);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   ulIndex = BTree_search(pcLeaf, pvKey, ulKeyLength, TRUE, &bFound);
+   if (bFound)
+   {
+      pcCell = BTree_cell(pcLeaf, ulIndex);
+      ulKeyInCell = BTree_cellKey(pcCell, TRUE, &pcCellKey);
+      memcpy(&usValueLength, pcCell + sizeof(unsigned short),
+             sizeof(unsigned short));
+      if (pvValue != NULL)
+         memcpy(pvValue, pcCellKey + ulKeyInCell, usValueLength);
+      if (pulValueLength != NULL)
+         *pulValueLength = usValueLength;
+   }
+   Pager_release(oBTree->oPPager, pcLeaf, FALSE);
+   return bFound ? SUCCESS : NO_SUCH_PATH;
+}
+
+int BTree_put(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+              const void *pvValue, size_t ulValueLength)
+{
+   struct pageHeader sHeader;
+   char acCell[INNER_HEAD + BTREE_MAX_ENTRY];
+   char acSeparator[BTREE_MAX_ENTRY];
+   size_t aulPath[MAX_DEPTH];
+   size_t ulSeparatorLength;
+   size_t ulDepth;
+   size_t ulIndex;
+   size_t ulCount;
+   size_t ulRight;
+   size_t ulNewRoot;
+   unsigned short usLength;
+   char *pcPage;
+   void *pvPage;
+   boolean bFound;
+   int iStatus;
+
+   assert(oBTree != NULL);
+   assert(pvKey != NULL || ulKeyLength == 0);
+   assert(pvValue != NULL || ulValueLength == 0);
+   assert(ulKeyLength + ulValueLength <= BTREE_MAX_ENTRY);
+
+   /* the new leaf cell */
+   usLength = (unsigned short)ulKeyLength;
+   memcpy(acCell, &usLength, sizeof(unsigned short));
+   usLength = (unsigned short)ulValueLength;
+   memcpy(acCell + sizeof(unsigned short), &usLength,
+          sizeof(unsigned short));
+   memcpy(acCell + LEAF_HEAD, pvKey, ulKeyLength);
+   memcpy(acCell + LEAF_HEAD + ulKeyLength, pvValue, ulValueLength);
+
+   iStatus = BTree_descend(oBTree, pvKey, ulKeyLength, aulPath,
+                           &ulDepth, &pcPage);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   ulIndex = BTree_search(pcPage, pvKey, ulKeyLength, TRUE, &bFound);
+   if (bFound)
+   {
+      /* replacing: drop the old cell first */
+      BTree_getHeader(pcPage, &sHeader);
+      ulCount = BTree_gather(oBTree, pcPage, NULL, 0, ulIndex);
+      BTree_fill(pcPage, TRUE, sHeader.ulLink, oBTree->apcCells,
+                 ulCount);
+   }
+
+   /* add the cell, splitting pages up the path while they are full */
+   while (!BTree_insertCell(pcPage, acCell, ulIndex))
+   {
+      iStatus = BTree_split(oBTree, pcPage, acCell, ulIndex,
+                            acSeparator, &ulSeparatorLength, &ulRight);
+      Pager_release(oBTree->oPPager, pcPage, iStatus == SUCCESS
+                    || bFound);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      ulDepth--;
+
+      /* the cell for the parent: the separator and the new page */
+      usLength = (unsigned short)ulSeparatorLength;
+      memcpy(acCell, &usLength, sizeof(unsigned short));
+      memcpy(acCell + sizeof(unsigned short), &ulRight, sizeof(size_t));
+      memcpy(acCell + INNER_HEAD, acSeparator, ulSeparatorLength);
+
+      if (ulDepth == 0)
+      {
+         /* the root split: a new root holds the two halves */
+         iStatus = Pager_allocate(oBTree->oPPager, &ulNewRoot, &pvPage);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         BTree_fill(pvPage, FALSE, oBTree->ulRoot, NULL, 0);
+         (void)BTree_insertCell(pvPage, acCell, 0);
+         Pager_release(oBTree->oPPager, pvPage, TRUE);
+         oBTree->ulRoot = ulNewRoot;
+         return SUCCESS;
+      }
+
+      iStatus = Pager_get(oBTree->oPPager, aulPath[ulDepth - 1],
+                          &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      pcPage = pvPage;
+      ulIndex = BTree_search(pcPage, acSeparator, ulSeparatorLength,
+                             FALSE, NULL);
+      bFound = FALSE;
+   }
+
+   Pager_release(oBTree->oPPager, pcPage, TRUE);
+   return SUCCESS;
+}
+
+int BTree_remove(BTree_T oBTree, const void *pvKey,
+                 size_t ulKeyLength)
+{
+   struct pageHeader sHeader;
+   size_t aulPath[MAX_DEPTH];
+   size_t ulDepth;
+   size_t ulIndex;
+   size_t ulCount;
+   char *pcLeaf;
+   boolean bFound;
+   int iStatus;
+
+   assert(oBTree != NULL);
+   assert(pvKey != NULL || ulKeyLength == 0);
+
+   iStatus = BTree_descend(oBTree, pvKey, ulKeyLength, aulPath,
+                           &ulDepth, &pcLeaf);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   ulIndex = BTree_search(pcLeaf, pvKey, ulKeyLength, TRUE, &bFound);
+   if (!bFound)
+   {
+      Pager_release(oBTree->oPPager, pcLeaf, FALSE);
+      return NO_SUCH_PATH;
+   }
+
+   BTree_getHeader(pcLeaf, &sHeader);
+   ulCount = BTree_gather(oBTree, pcLeaf, NULL, 0, ulIndex);
+   BTree_fill(pcLeaf, TRUE, sHeader.ulLink, oBTree->apcCells, ulCount);
+   Pager_release(oBTree->oPPager, pcLeaf, TRUE);
+   return SUCCESS;
+}
+
+int BTree_scan(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+               boolean (*pfVisit)(const void *pvKey, size_t ulKeyLength,
+                                  const void *pvValue,
+                                  size_t ulValueLength, void *pvExtra),
+               void *pvExtra)
+{
+   struct pageHeader sHeader;
+   size_t aulPath[MAX_DEPTH];
+   size_t ulDepth;
+   size_t ulIndex;
+   size_t ulKeyInCell;
+   unsigned short usValueLength;
+   const char *pcCell;
+   const char *pcCellKey;
+   char *pcLeaf;
+   void *pvPage;
+   int iStatus;
+
+   assert(oBTree != NULL);
+   assert(pvKey != NULL || ulKeyLength == 0);
+   assert(pfVisit != NULL);
+
+   iStatus = BTree_descend(oBTree, pvKey, ulKeyLength, aulPath,
+                           &ulDepth, &pcLeaf);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulIndex = BTree_search(pcLeaf, pvKey, ulKeyLength, TRUE, NULL);
+
+   for (;;)
+   {
+      BTree_getHeader(pcLeaf, &sHeader);
+      for (; ulIndex < sHeader.usCount; ulIndex++)
+      {
+         pcCell = BTree_cell(pcLeaf, ulIndex);
+         ulKeyInCell = BTree_cellKey(pcCell, TRUE, &pcCellKey);
+         memcpy(&usValueLength, pcCell + sizeof(unsigned short),
+                sizeof(unsigned short));
+         if (!pfVisit(pcCellKey, ulKeyInCell, pcCellKey + ulKeyInCell,
+                      usValueLength, pvExtra))
+         {
+            Pager_release(oBTree->oPPager, pcLeaf, FALSE);
+            return SUCCESS;
+         }
+      }
+
+      Pager_release(oBTree->oPPager, pcLeaf, FALSE);
+      if (sHeader.ulLink == 0)
+         return SUCCESS;
+      iStatus = Pager_get(oBTree->oPPager, sHeader.ulLink, &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      pcLeaf = pvPage;
+      ulIndex = 0;
+   }
+}
@@ -0,0 +1,79 @@
+/*--------------------------------------------------------------------*/
+/* btree.h                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef BTREE_INCLUDED
+#define BTREE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "pager.h"
+
+/* The most bytes in an entry's key and value together. */
+enum { BTREE_MAX_ENTRY = 960 };
+
+/*
+  A B+tree maps byte-string keys to byte-string values, in pages of a
+  pager. Keys are ordered as by memcmp, a key sorting before any
+  longer key it is a prefix of. Every entry is in a leaf, and leaves
+  are chained in key order, so a range of keys is read in one pass.
+  Pages emptied by removals are not merged; they fill up again as
+  keys in their range are added.
+*/
+typedef struct btree *BTree_T;
+
+/*
+  Creates an empty B+tree in oPPager's pages. Returns SUCCESS and sets
+  *poBResult, or sets it to NULL and returns the status of the
+  failure, as for Pager_allocate.
+*/
+int BTree_new(Pager_T oPPager, BTree_T *poBResult);
+
+/* Frees oBTree, without giving its pages back to the pager. */
+void BTree_free(BTree_T oBTree);
+
+/*
+  Looks up the ulKeyLength-byte key at pvKey in oBTree. If it is
+  there, copies its value, of which pvValue has room for
+  BTREE_MAX_ENTRY bytes, to pvValue (if not NULL), sets
+  *pulValueLength (if not NULL) and returns SUCCESS. Otherwise
+  returns NO_SUCH_PATH, or the status of a pager failure.
+*/
+int BTree_get(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+              void *pvValue, size_t *pulValueLength);
+
+/*
+  Maps the ulKeyLength-byte key at pvKey in oBTree to the
+  ulValueLength-byte value at pvValue, replacing any value it had.
+  The two together must not be longer than BTREE_MAX_ENTRY bytes.
+  Returns SUCCESS, or the status of a pager failure, after which a
+  replaced entry may be gone.
+*/
+int BTree_put(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+              const void *pvValue, size_t ulValueLength);
+
+/*
+  Removes the ulKeyLength-byte key at pvKey from oBTree. Returns
+  SUCCESS, NO_SUCH_PATH if it is not there, or the status of a pager
+  failure.
+*/
+int BTree_remove(BTree_T oBTree, const void *pvKey,
+                 size_t ulKeyLength);
+
+/*
+  Calls pfVisit on the entries of oBTree in key order, starting at the
+  first key not less than the ulKeyLength-byte key at pvKey, until
+  pfVisit returns FALSE or the entries run out. Each call is passed
+  the entry's key and value, which are only valid during the call, and
+  pvExtra. pfVisit may read other pages of the pager, but not change
+  oBTree.
+  Returns SUCCESS, or the status of a pager failure.
+*/
+int BTree_scan(BTree_T oBTree, const void *pvKey, size_t ulKeyLength,
+               boolean (*pfVisit)(const void *pvKey, size_t ulKeyLength,
+                                  const void *pvValue,
+                                  size_t ulValueLength, void *pvExtra),
+               void *pvExtra);
+
+#endif
@@ -0,0 +1,185 @@
+/*--------------------------------------------------------------------*/
+/* builtinalloc.c                                                     */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builtinalloc.h"
+#include "arena.h"
+
+/* A built-in allocator: the table handed out, followed by the state
+   its functions are given as their context */
+struct builtIn
+{
+   /* the table handed out as the Allocator_T; must come first */
+   struct allocator sAllocator;
+   /* the arena blocks come from, or NULL if they come from oABacking */
+   Arena_T oAArena;
+   /* the allocator a counting allocator passes requests on to */
+   Allocator_T oABacking;
+   /* the counts kept by a counting allocator */
+   struct allocatorCounts sCounts;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns a block of ulSize bytes from the arena of pvBuiltIn. */
+static void *Allocator_arenaAlloc(void *pvBuiltIn, size_t ulSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+
+   return Arena_alloc(psBuiltIn->oAArena, ulSize);
+}
+
+/*
+  Returns a copy of pvBlock, of ulOldSize bytes from the arena of
+  pvBuiltIn, resized to ulNewSize bytes, and releases pvBlock; or
+  returns NULL and leaves pvBlock alone.
+*/
+static void *Allocator_arenaRealloc(void *pvBuiltIn, void *pvBlock,
+                                    size_t ulOldSize, size_t ulNewSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+   void *pvNewBlock;
+
+   pvNewBlock = Arena_alloc(psBuiltIn->oAArena, ulNewSize);
+   if (pvNewBlock == NULL)
+      return NULL;
+   memcpy(pvNewBlock, pvBlock,
+          ulOldSize < ulNewSize ? ulOldSize : ulNewSize);
+   Arena_release(psBuiltIn->oAArena, pvBlock, ulOldSize);
+   return pvNewBlock;
+}
+
+/* Gives pvBlock, of ulSize bytes, back to the arena of pvBuiltIn. */
+static void Allocator_arenaRelease(void *pvBuiltIn, void *pvBlock,
+                                   size_t ulSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+
+   Arena_release(psBuiltIn->oAArena, pvBlock, ulSize);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Adds ulSize bytes to the live bytes counted by psBuiltIn. */
+static void Allocator_countLive(struct builtIn *psBuiltIn, size_t ulSize)
+{
+   psBuiltIn->sCounts.ulLiveBytes += ulSize;
+   if (psBuiltIn->sCounts.ulLiveBytes > psBuiltIn->sCounts.ulPeakBytes)
+      psBuiltIn->sCounts.ulPeakBytes = psBuiltIn->sCounts.ulLiveBytes;
+}
+
+/* Returns a block of ulSize bytes from the backing allocator of
+   pvBuiltIn, and counts it. */
+static void *Allocator_countAlloc(void *pvBuiltIn, size_t ulSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+   void *pvBlock;
+
+   pvBlock = Allocator_alloc(psBuiltIn->oABacking, ulSize);
+   if (pvBlock == NULL)
+      return NULL;
+   psBuiltIn->sCounts.ulAllocs++;
+   Allocator_countLive(psBuiltIn, ulSize);
+   return pvBlock;
+}
+
+/* Resizes pvBlock, of ulOldSize bytes, to ulNewSize bytes with the
+   backing allocator of pvBuiltIn, and counts it. */
+static void *Allocator_countRealloc(void *pvBuiltIn, void *pvBlock,
+                                    size_t ulOldSize, size_t ulNewSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+   void *pvNewBlock;
+
+   pvNewBlock = Allocator_realloc(psBuiltIn->oABacking, pvBlock,
+                                  ulOldSize, ulNewSize);
+   if (pvNewBlock == NULL)
+      return NULL;
+   psBuiltIn->sCounts.ulReallocs++;
+   psBuiltIn->sCounts.ulLiveBytes -= ulOldSize;
+   Allocator_countLive(psBuiltIn, ulNewSize);
+   return pvNewBlock;
+}
+
+/* Gives pvBlock, of ulSize bytes, back to the backing allocator of
+   pvBuiltIn, and counts it. */
+static void Allocator_countRelease(void *pvBuiltIn, void *pvBlock,
+                                   size_t ulSize)
+{
+   struct builtIn *psBuiltIn = pvBuiltIn;
+
+   Allocator_release(psBuiltIn->oABacking, pvBlock, ulSize);
+   psBuiltIn->sCounts.ulReleases++;
+   psBuiltIn->sCounts.ulLiveBytes -= ulSize;
+}
+
+/*--------------------------------------------------------------------*/
+
+Allocator_T Allocator_newArena(void)
+{
+   struct builtIn *psBuiltIn;
+
+   psBuiltIn = calloc(1, sizeof(struct builtIn));
+   if (psBuiltIn == NULL)
+      return NULL;
+   psBuiltIn->oAArena = Arena_new();
+   if (psBuiltIn->oAArena == NULL)
+   {
+      free(psBuiltIn);
+      return NULL;
+   }
+
+   psBuiltIn->sAllocator.pfAlloc = Allocator_arenaAlloc;
+   psBuiltIn->sAllocator.pfRealloc = Allocator_arenaRealloc;
+   psBuiltIn->sAllocator.pfRelease = Allocator_arenaRelease;
+   psBuiltIn->sAllocator.pvContext = psBuiltIn;
+   return &psBuiltIn->sAllocator;
+}
+
+Allocator_T Allocator_newCounting(Allocator_T oABacking)
+{
+   struct builtIn *psBuiltIn;
+
+   psBuiltIn = calloc(1, sizeof(struct builtIn));
+   if (psBuiltIn == NULL)
+      return NULL;
+
+   psBuiltIn->oABacking = oABacking;
+   psBuiltIn->sAllocator.pfAlloc = Allocator_countAlloc;
+   psBuiltIn->sAllocator.pfRealloc = Allocator_countRealloc;
+   psBuiltIn->sAllocator.pfRelease = Allocator_countRelease;
+   psBuiltIn->sAllocator.pvContext = psBuiltIn;
+   return &psBuiltIn->sAllocator;
+}
+
+void Allocator_getCounts(Allocator_T oAAlloc,
+                         struct allocatorCounts *psCounts)
+{
+   const struct builtIn *psBuiltIn;
+
+   assert(oAAlloc != NULL);
+   assert(oAAlloc->pfAlloc == Allocator_countAlloc);
+   assert(psCounts != NULL);
+
+   psBuiltIn = oAAlloc->pvContext;
+   *psCounts = psBuiltIn->sCounts;
+}
+
+void Allocator_free(Allocator_T oAAlloc)
+{
+   struct builtIn *psBuiltIn;
+
+   if (oAAlloc == NULL)
+      return;
+   assert(oAAlloc->pfAlloc == Allocator_arenaAlloc ||
+          oAAlloc->pfAlloc == Allocator_countAlloc);
+
+   psBuiltIn = oAAlloc->pvContext;
+   if (psBuiltIn->oAArena != NULL)
+      Arena_free(psBuiltIn->oAArena);
+   free(psBuiltIn);
+}
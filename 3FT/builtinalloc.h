@@ -0,0 +1,56 @@
+/*--------------------------------------------------------------------*/
+/* builtinalloc.h                                                     */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef BUILTINALLOC_INCLUDED
+#define BUILTINALLOC_INCLUDED
+
+#include <stddef.h>
+#include "allocator.h"
+
+/*
+  The allocators built into the FT. A client may as well pass its own
+  Allocator_T (see allocator.h).
+*/
+
+/* The counts kept by an allocator from Allocator_newCounting. */
+struct allocatorCounts
+{
+   /* the calls to allocate, reallocate and release a block */
+   size_t ulAllocs;
+   size_t ulReallocs;
+   size_t ulReleases;
+   /* the bytes in blocks allocated and not yet released, now and at
+      most */
+   size_t ulLiveBytes;
+   size_t ulPeakBytes;
+};
+
+/*
+  Returns a new allocator that bumps a pointer through large chunks
+  and keeps released blocks for reuse, as an Arena_T does, or NULL if
+  memory could not be allocated. Freeing it releases every block ever
+  allocated from it at once. It must not be used by more than one
+  thread at a time.
+*/
+Allocator_T Allocator_newArena(void);
+
+/*
+  Returns a new allocator that passes each request on to oABacking
+  (NULL for malloc) and counts it, or NULL if memory could not be
+  allocated. It must not be used by more than one thread at a time.
+*/
+Allocator_T Allocator_newCounting(Allocator_T oABacking);
+
+/* Sets *psCounts to the counts kept so far by oAAlloc, which must
+   have come from Allocator_newCounting. */
+void Allocator_getCounts(Allocator_T oAAlloc,
+                         struct allocatorCounts *psCounts);
+
+/* Frees oAAlloc, which must have come from Allocator_newArena or
+   Allocator_newCounting. Nothing allocated from it may be used
+   afterwards. */
+void Allocator_free(Allocator_T oAAlloc);
+
+#endif
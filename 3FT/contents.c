@@ -0,0 +1,1197 @@
+/*--------------------------------------------------------------------*/
+/* contents.c                                                         */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "contents.h"
+#include "arena.h"
+#include "lz.h"
+
+/* The number of buckets the deduplication table starts with. */
+enum { MIN_BUCKETS = 64 };
+
+/* The spill offset of a tiered copy never written to the spill file. */
+#define NO_SPILL ((size_t)-1)
+
+/* The number of decompressed copies each thread keeps. */
+enum { CACHE_SLOTS = 4 };
+
+/* A copy of file contents. The bytes themselves, or their compressed
+   form, follow the header in the same allocation, unless they are in
+   a file mapping or the content tier. */
+struct contents
+{
+   /* the number of file nodes that hold this copy */
+   size_t ulRefs;
+   /* the number of bytes that follow the header */
+   size_t ulLength;
+   /* where a compaction is moving this copy to, if anywhere */
+   Contents_T oCMoved;
+   /* the hash of the bytes, if deduplication is on */
+   size_t ulHash;
+   /* the next copy in the same deduplication bucket */
+   Contents_T oCNext;
+   /* the mapped bytes, or NULL if they follow the header */
+   void *pvMapping;
+   /* the mapped copy whose bytes this slice of it shares, or NULL if
+      this is not a slice */
+   Contents_T oCBase;
+   /* TRUE if the bytes are kept apart, in the content tier */
+   boolean bTiered;
+   /* a tiered copy's bytes while resident, or NULL while they are
+      only in the spill file */
+   char *pcTiered;
+   /* where a tiered copy's bytes are in the spill file, or NO_SPILL */
+   size_t ulSpillOffset;
+   /* the resident tiered copies used just after and just before this
+      one, if it is resident */
+   Contents_T oCNewer;
+   Contents_T oCOlder;
+   /* the length of the compressed form that follows the header, or 0
+      if the bytes are not compressed */
+   size_t ulPacked;
+   /* the number naming a compressed copy in decompression caches,
+      never given to another copy */
+   size_t ulSerial;
+};
+
+/* A decompressed copy in a thread's cache. */
+struct cacheSlot
+{
+   /* the ulSerial of the copy, or 0 if the slot is unused */
+   size_t ulSerial;
+   /* the room in pcBytes */
+   size_t ulSize;
+   /* the decompressed bytes */
+   char *pcBytes;
+};
+
+/* A thread's decompression cache, most recently used slot first. */
+struct cache
+{
+   struct cacheSlot asSlots[CACHE_SLOTS];
+};
+
+/* A free run of bytes in the spill file. */
+struct extent
+{
+   /* where the run starts */
+   size_t ulOffset;
+   /* how many bytes it has */
+   size_t ulLength;
+   /* the next free run, further into the file */
+   struct extent *psNext;
+};
+
+/*
+  The content store, represented as an AO with these state variables:
+*/
+
+/* 1. the arena copies are allocated from, or NULL if they are
+   allocated individually */
+static Arena_T oAArena = NULL;
+/* 2. the arena a compaction is moving copies to */
+static Arena_T oANewArena = NULL;
+/* 3. the copy kept alive by the last retiring release */
+static Contents_T oCRetired = NULL;
+/* 4. the deduplication table, or NULL if deduplication is off */
+static Contents_T *poCBuckets = NULL;
+/* 5. the number of buckets in poCBuckets */
+static size_t ulBucketCount = 0;
+/* 6. the number of copies in poCBuckets */
+static size_t ulUniqueCount = 0;
+/* 7. bytes held by all references, and bytes actually stored */
+static size_t ulLogicalBytes = 0;
+static size_t ulStoredBytes = 0;
+/* 8. whether the content tier is on, its budget of resident bytes,
+   and the length from which new copies go into it */
+static boolean bTierOn = FALSE;
+static size_t ulTierBudget = 0;
+static size_t ulTierThreshold = 0;
+/* 9. the spill file, its end, and its free runs in order */
+static int iSpillFd = -1;
+static size_t ulSpillEnd = 0;
+static struct extent *psFreeExtents = NULL;
+/* 10. the resident tiered copies, newest first, and their bytes */
+static Contents_T oCNewest = NULL;
+static Contents_T oCOldest = NULL;
+static size_t ulResidentBytes = 0;
+/* 11. the number of holds keeping paged-in copies resident */
+static size_t ulTierHolds = 0;
+/* 12. tier reads served from memory and from the spill file, and
+   bytes written to the spill file */
+static size_t ulTierHits = 0;
+static size_t ulTierMisses = 0;
+static size_t ulSpilledBytes = 0;
+/* 13. the lock under which Contents_getBytes changes the tier, so
+   that threads can read copies at once; every other change to the
+   store is made while no other thread uses it */
+static pthread_mutex_t sTierLock = PTHREAD_MUTEX_INITIALIZER;
+/* 14. the length from which new copies are compressed, or 0 if they
+   are not, the buffer they are compressed into first, and the next
+   compressed copy's ulSerial */
+static size_t ulCodecThreshold = 0;
+static char *pcScratch = NULL;
+static size_t ulScratchSize = 0;
+static size_t ulNextSerial = 1;
+/* 15. the bytes compressed copies stand for, and their compressed
+   length */
+static size_t ulPackedRawBytes = 0;
+static size_t ulPackedBytes = 0;
+/* 16. the key to each thread's decompression cache, made once */
+static pthread_key_t sCacheKey;
+static pthread_once_t sCacheOnce = PTHREAD_ONCE_INIT;
+static boolean bCacheKeyMade = FALSE;
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the FNV-1a hash of the ulLength bytes at pvBytes. */
+static size_t Contents_hash(const void *pvBytes, size_t ulLength)
+{
+   const unsigned char *pucByte = pvBytes;
+   size_t ulHash = 2166136261U;
+   size_t ulIndex;
+
+   for (ulIndex = 0; ulIndex < ulLength; ulIndex++)
+   {
+      ulHash ^= pucByte[ulIndex];
+      ulHash *= 16777619U;
+   }
+   return ulHash;
+}
+
+/* Links oCContents into the deduplication table. */
+static void Contents_link(Contents_T oCContents)
+{
+   size_t ulBucket;
+
+   assert(oCContents != NULL);
+   assert(poCBuckets != NULL);
+
+   ulBucket = oCContents->ulHash % ulBucketCount;
+   oCContents->oCNext = poCBuckets[ulBucket];
+   poCBuckets[ulBucket] = oCContents;
+}
+
+/* Unlinks oCContents from the deduplication table. */
+static void Contents_unlink(Contents_T oCContents)
+{
+   Contents_T *poCLink;
+
+   assert(oCContents != NULL);
+   assert(poCBuckets != NULL);
+
+   poCLink = &poCBuckets[oCContents->ulHash % ulBucketCount];
+   while (*poCLink != oCContents)
+   {
+      assert(*poCLink != NULL);
+      poCLink = &(*poCLink)->oCNext;
+   }
+   *poCLink = oCContents->oCNext;
+}
+
+/*
+  Doubles the number of buckets in the deduplication table. If memory
+  runs out, the table keeps its old size and just gets longer chains.
+*/
+static void Contents_growTable(void)
+{
+   Contents_T *poCOld = poCBuckets;
+   size_t ulOldCount = ulBucketCount;
+   Contents_T oCCurr;
+   Contents_T oCNext;
+   size_t ulIndex;
+
+   poCBuckets = calloc(ulOldCount * 2, sizeof(Contents_T));
+   if (poCBuckets == NULL)
+   {
+      poCBuckets = poCOld;
+      return;
+   }
+   ulBucketCount = ulOldCount * 2;
+
+   for (ulIndex = 0; ulIndex < ulOldCount; ulIndex++)
+   {
+      for (oCCurr = poCOld[ulIndex]; oCCurr != NULL; oCCurr = oCNext)
+      {
+         oCNext = oCCurr->oCNext;
+         Contents_link(oCCurr);
+      }
+   }
+   free(poCOld);
+}
+
+/* Links the resident tiered copy oCContents in as the newest. */
+static void Contents_linkNewest(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   oCContents->oCNewer = NULL;
+   oCContents->oCOlder = oCNewest;
+   if (oCNewest != NULL)
+      oCNewest->oCNewer = oCContents;
+   else
+      oCOldest = oCContents;
+   oCNewest = oCContents;
+}
+
+/* Unlinks the resident tiered copy oCContents. */
+static void Contents_unlinkResident(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   if (oCContents->oCNewer != NULL)
+      oCContents->oCNewer->oCOlder = oCContents->oCOlder;
+   else
+      oCNewest = oCContents->oCOlder;
+   if (oCContents->oCOlder != NULL)
+      oCContents->oCOlder->oCNewer = oCContents->oCNewer;
+   else
+      oCOldest = oCContents->oCNewer;
+   oCContents->oCNewer = NULL;
+   oCContents->oCOlder = NULL;
+}
+
+/*
+  Finds room for ulLength bytes in the spill file, in the first free
+  run big enough or else at its end, and returns where it is.
+*/
+static size_t Contents_allocSpill(size_t ulLength)
+{
+   struct extent **ppsLink;
+   struct extent *psExtent;
+   size_t ulOffset;
+
+   for (ppsLink = &psFreeExtents; *ppsLink != NULL;
+        ppsLink = &(*ppsLink)->psNext)
+   {
+      psExtent = *ppsLink;
+      if (psExtent->ulLength >= ulLength)
+      {
+         ulOffset = psExtent->ulOffset;
+         psExtent->ulOffset += ulLength;
+         psExtent->ulLength -= ulLength;
+         if (psExtent->ulLength == 0)
+         {
+            *ppsLink = psExtent->psNext;
+            free(psExtent);
+         }
+         return ulOffset;
+      }
+   }
+
+   ulOffset = ulSpillEnd;
+   ulSpillEnd += ulLength;
+   return ulOffset;
+}
+
+/*
+  Gives the ulLength bytes at ulOffset back to the spill file, merging
+  them with the free runs next to them. If memory runs out, the bytes
+  are just not reused.
+*/
+static void Contents_freeSpill(size_t ulOffset, size_t ulLength)
+{
+   struct extent **ppsLink = &psFreeExtents;
+   struct extent *psPrev = NULL;
+   struct extent *psExtent;
+
+   while (*ppsLink != NULL && (*ppsLink)->ulOffset < ulOffset)
+   {
+      psPrev = *ppsLink;
+      ppsLink = &psPrev->psNext;
+   }
+
+   if (psPrev != NULL && psPrev->ulOffset + psPrev->ulLength == ulOffset)
+   {
+      psPrev->ulLength += ulLength;
+      psExtent = psPrev->psNext;
+      if (psExtent != NULL &&
+          psPrev->ulOffset + psPrev->ulLength == psExtent->ulOffset)
+      {
+         psPrev->ulLength += psExtent->ulLength;
+         psPrev->psNext = psExtent->psNext;
+         free(psExtent);
+      }
+      return;
+   }
+   if (*ppsLink != NULL && ulOffset + ulLength == (*ppsLink)->ulOffset)
+   {
+      (*ppsLink)->ulOffset = ulOffset;
+      (*ppsLink)->ulLength += ulLength;
+      return;
+   }
+
+   psExtent = malloc(sizeof(struct extent));
+   if (psExtent == NULL)
+      return;
+   psExtent->ulOffset = ulOffset;
+   psExtent->ulLength = ulLength;
+   psExtent->psNext = *ppsLink;
+   *ppsLink = psExtent;
+}
+
+/*
+  Reads (if bRead is TRUE) or writes the ulLength bytes at pcBytes
+  from or to offset ulOffset of the spill file. Returns TRUE on
+  success.
+*/
+static boolean Contents_transfer(char *pcBytes, size_t ulLength,
+                                 size_t ulOffset, boolean bRead)
+{
+   size_t ulDone = 0;
+   ssize_t lDone;
+
+   while (ulDone < ulLength)
+   {
+      if (bRead)
+         lDone = pread(iSpillFd, pcBytes + ulDone, ulLength - ulDone,
+                       (off_t)(ulOffset + ulDone));
+      else
+         lDone = pwrite(iSpillFd, pcBytes + ulDone, ulLength - ulDone,
+                        (off_t)(ulOffset + ulDone));
+      if (lDone < 0 && errno == EINTR)
+         continue;
+      if (lDone <= 0)
+         return FALSE;
+      ulDone += (size_t)lDone;
+   }
+   return TRUE;
+}
+
+/*
+  Evicts the resident tiered copy oCContents, writing its bytes to the
+  spill file first unless they are there already: copies never
+  change, so a copy spilled once can be dropped again for free.
+  Returns TRUE on success, or FALSE if it could not be written.
+*/
+static boolean Contents_spill(Contents_T oCContents)
+{
+   size_t ulOffset;
+
+   assert(oCContents != NULL);
+   assert(oCContents->pcTiered != NULL);
+
+   if (oCContents->ulSpillOffset == NO_SPILL)
+   {
+      ulOffset = Contents_allocSpill(oCContents->ulLength);
+      if (!Contents_transfer(oCContents->pcTiered, oCContents->ulLength,
+                             ulOffset, FALSE))
+      {
+         Contents_freeSpill(ulOffset, oCContents->ulLength);
+         return FALSE;
+      }
+      oCContents->ulSpillOffset = ulOffset;
+      ulSpilledBytes += oCContents->ulLength;
+   }
+
+   Contents_unlinkResident(oCContents);
+   free(oCContents->pcTiered);
+   oCContents->pcTiered = NULL;
+   ulResidentBytes -= oCContents->ulLength;
+   return TRUE;
+}
+
+/*
+  Evicts the least recently used resident tiered copies, other than
+  oCKeep (which may be NULL) and the retired copy, until the resident
+  bytes fit the budget or nothing more can be evicted. Does nothing
+  while paged-in copies are held resident.
+*/
+static void Contents_trimTier(Contents_T oCKeep)
+{
+   Contents_T oCVictim = oCOldest;
+
+   if (ulTierHolds != 0)
+      return;
+
+   while (ulResidentBytes > ulTierBudget && oCVictim != NULL)
+   {
+      if (oCVictim == oCKeep || oCVictim == oCRetired)
+         oCVictim = oCVictim->oCNewer;
+      else if (!Contents_spill(oCVictim))
+         return;
+      else
+         oCVictim = oCOldest;
+   }
+}
+
+/*
+  Makes the tiered copy oCContents resident and the newest, reading
+  its bytes back from the spill file if needed. Returns TRUE on
+  success, or FALSE if memory or the spill file failed.
+*/
+static boolean Contents_pageIn(Contents_T oCContents)
+{
+   char *pcBytes;
+
+   assert(oCContents != NULL);
+   assert(oCContents->bTiered);
+
+   if (oCContents->pcTiered != NULL)
+   {
+      ulTierHits++;
+      Contents_unlinkResident(oCContents);
+      Contents_linkNewest(oCContents);
+      return TRUE;
+   }
+
+   ulTierMisses++;
+   pcBytes = malloc(oCContents->ulLength);
+   if (pcBytes == NULL)
+      return FALSE;
+   if (!Contents_transfer(pcBytes, oCContents->ulLength,
+                          oCContents->ulSpillOffset, TRUE))
+   {
+      free(pcBytes);
+      return FALSE;
+   }
+   oCContents->pcTiered = pcBytes;
+   ulResidentBytes += oCContents->ulLength;
+   Contents_linkNewest(oCContents);
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Frees the decompression cache pvCache, a struct cache, as a thread
+   that used it exits. */
+static void Contents_freeCache(void *pvCache)
+{
+   struct cache *psCache = pvCache;
+   size_t ulSlot;
+
+   if (psCache == NULL)
+      return;
+   for (ulSlot = 0; ulSlot < CACHE_SLOTS; ulSlot++)
+      free(psCache->asSlots[ulSlot].pcBytes);
+   free(psCache);
+}
+
+/* Makes the key to the threads' decompression caches. */
+static void Contents_makeCacheKey(void)
+{
+   bCacheKeyMade =
+      (boolean)(pthread_key_create(&sCacheKey, Contents_freeCache) == 0);
+}
+
+/*
+  Returns the bytes of the compressed copy oCContents, decompressed in
+  the calling thread's cache, where they stay until the thread has
+  used CACHE_SLOTS other compressed copies since. Returns NULL if
+  memory could not be allocated, or the compressed form is corrupt.
+*/
+static void *Contents_unpack(Contents_T oCContents)
+{
+   struct cache *psCache;
+   struct cacheSlot sSlot;
+   char *pcBytes;
+   size_t ulSlot;
+
+   assert(oCContents != NULL);
+   assert(oCContents->ulPacked != 0);
+   assert(bCacheKeyMade);
+
+   psCache = pthread_getspecific(sCacheKey);
+   if (psCache == NULL)
+   {
+      psCache = calloc(1, sizeof(struct cache));
+      if (psCache == NULL)
+         return NULL;
+      if (pthread_setspecific(sCacheKey, psCache) != 0)
+      {
+         free(psCache);
+         return NULL;
+      }
+   }
+
+   /* a hit, or else the least recently used slot, moves to the front */
+   for (ulSlot = 0; ulSlot < CACHE_SLOTS - 1; ulSlot++)
+   {
+      if (psCache->asSlots[ulSlot].ulSerial == oCContents->ulSerial)
+         break;
+   }
+   sSlot = psCache->asSlots[ulSlot];
+   memmove(&psCache->asSlots[1], &psCache->asSlots[0],
+           ulSlot * sizeof(struct cacheSlot));
+   if (sSlot.ulSerial != oCContents->ulSerial)
+   {
+      sSlot.ulSerial = 0;
+      if (sSlot.ulSize < oCContents->ulLength)
+      {
+         pcBytes = realloc(sSlot.pcBytes, oCContents->ulLength);
+         if (pcBytes != NULL)
+         {
+            sSlot.pcBytes = pcBytes;
+            sSlot.ulSize = oCContents->ulLength;
+         }
+      }
+      if (sSlot.ulSize >= oCContents->ulLength &&
+          LZ_decompress(oCContents + 1, oCContents->ulPacked,
+                        sSlot.pcBytes, oCContents->ulLength))
+         sSlot.ulSerial = oCContents->ulSerial;
+   }
+   psCache->asSlots[0] = sSlot;
+   if (sSlot.ulSerial == 0)
+      return NULL;
+   return sSlot.pcBytes;
+}
+
+/*
+  Returns TRUE if the bytes of oCContents, which is not mapped, are
+  the same as its ulLength bytes at pvBytes, whose compressed form is
+  the ulPacked bytes at pvPacked (or which were not compressed if
+  ulPacked is 0). A copy that cannot be paged back in or decompressed
+  is taken to differ. Nothing is evicted from the content tier
+  meanwhile.
+*/
+static boolean Contents_equals(Contents_T oCContents,
+                               const void *pvBytes,
+                               const void *pvPacked, size_t ulPacked)
+{
+   void *pvOwn;
+
+   assert(oCContents != NULL);
+   assert(oCContents->pvMapping == NULL);
+
+   /* the codec always compresses the same bytes the same way */
+   if (oCContents->ulPacked != 0 && ulPacked != 0)
+      return (boolean)(oCContents->ulPacked == ulPacked &&
+                       !memcmp(oCContents + 1, pvPacked, ulPacked));
+   if (oCContents->ulPacked != 0)
+   {
+      pvOwn = Contents_unpack(oCContents);
+      return (boolean)(pvOwn != NULL &&
+                       !memcmp(pvOwn, pvBytes, oCContents->ulLength));
+   }
+   if (!oCContents->bTiered)
+      return (boolean)!memcmp(oCContents + 1, pvBytes,
+                              oCContents->ulLength);
+   if (!Contents_pageIn(oCContents))
+      return FALSE;
+   return (boolean)!memcmp(oCContents->pcTiered, pvBytes,
+                           oCContents->ulLength);
+}
+
+/* Returns the number of bytes in the allocation holding oCContents. */
+static size_t Contents_getFootprint(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   if (oCContents->pvMapping != NULL || oCContents->bTiered)
+      return sizeof(struct contents);
+   if (oCContents->ulPacked != 0)
+      return sizeof(struct contents) + oCContents->ulPacked;
+   return sizeof(struct contents) + oCContents->ulLength;
+}
+
+static void Contents_unref(Contents_T oCContents, boolean bRetire);
+
+/* Frees the storage of oCContents, which has no references left. */
+static void Contents_free(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   if (oCContents->oCBase != NULL)
+      Contents_unref(oCContents->oCBase, FALSE);
+   else if (oCContents->pvMapping != NULL)
+      (void)munmap(oCContents->pvMapping, oCContents->ulLength);
+   else if (oCContents->bTiered)
+   {
+      if (oCContents->pcTiered != NULL)
+      {
+         Contents_unlinkResident(oCContents);
+         free(oCContents->pcTiered);
+         ulResidentBytes -= oCContents->ulLength;
+      }
+      if (oCContents->ulSpillOffset != NO_SPILL)
+         Contents_freeSpill(oCContents->ulSpillOffset,
+                            oCContents->ulLength);
+   }
+
+   if (oAArena != NULL)
+      Arena_release(oAArena, oCContents,
+                    Contents_getFootprint(oCContents));
+   else
+      free(oCContents);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Contents_startArena(boolean bDedup)
+{
+   assert(oAArena == NULL);
+   assert(ulStoredBytes == 0);
+
+   oAArena = Arena_new();
+   if (oAArena == NULL)
+      return MEMORY_ERROR;
+
+   if (bDedup)
+   {
+      poCBuckets = calloc(MIN_BUCKETS, sizeof(Contents_T));
+      if (poCBuckets == NULL)
+      {
+         Arena_free(oAArena);
+         oAArena = NULL;
+         return MEMORY_ERROR;
+      }
+      ulBucketCount = MIN_BUCKETS;
+      ulUniqueCount = 0;
+   }
+   return SUCCESS;
+}
+
+void Contents_endArena(void)
+{
+   struct extent *psExtent;
+
+   /* a retired copy may hold a mapping, which the arena cannot free */
+   Contents_freeRetired();
+   if (oAArena == NULL)
+      return;
+
+   /* nor can it free the bytes of resident tiered copies */
+   if (bTierOn)
+   {
+      while (oCNewest != NULL)
+      {
+         free(oCNewest->pcTiered);
+         oCNewest = oCNewest->oCOlder;
+      }
+      oCOldest = NULL;
+      while (psFreeExtents != NULL)
+      {
+         psExtent = psFreeExtents;
+         psFreeExtents = psExtent->psNext;
+         free(psExtent);
+      }
+      (void)close(iSpillFd);
+      iSpillFd = -1;
+      ulSpillEnd = 0;
+      ulResidentBytes = 0;
+      ulTierHits = 0;
+      ulTierMisses = 0;
+      ulSpilledBytes = 0;
+      bTierOn = FALSE;
+   }
+
+   /* other threads' caches went as they exited */
+   if (bCacheKeyMade)
+   {
+      Contents_freeCache(pthread_getspecific(sCacheKey));
+      (void)pthread_setspecific(sCacheKey, NULL);
+   }
+   free(pcScratch);
+   pcScratch = NULL;
+   ulScratchSize = 0;
+   ulCodecThreshold = 0;
+   ulPackedRawBytes = 0;
+   ulPackedBytes = 0;
+
+   /* every copy lives in the arena, so they all go at once */
+   Arena_free(oAArena);
+   oAArena = NULL;
+   free(poCBuckets);
+   poCBuckets = NULL;
+   ulBucketCount = 0;
+   ulUniqueCount = 0;
+   ulLogicalBytes = 0;
+   ulStoredBytes = 0;
+}
+
+boolean Contents_usesArena(void)
+{
+   return (boolean)(oAArena != NULL);
+}
+
+int Contents_startTier(size_t ulBudget, size_t ulThreshold)
+{
+   char acTemp[] = "/tmp/ft_spillXXXXXX";
+
+   assert(oAArena != NULL);
+   assert(!bTierOn);
+   assert(ulStoredBytes == 0);
+
+   iSpillFd = mkstemp(acTemp);
+   if (iSpillFd < 0)
+      return IO_ERROR;
+   (void)unlink(acTemp);
+
+   bTierOn = TRUE;
+   ulTierBudget = ulBudget;
+   /* an empty copy has no bytes to spill */
+   ulTierThreshold = ulThreshold == 0 ? 1 : ulThreshold;
+   return SUCCESS;
+}
+
+int Contents_startCodec(size_t ulThreshold)
+{
+   assert(oAArena != NULL);
+   assert(ulCodecThreshold == 0);
+   assert(ulStoredBytes == 0);
+
+   (void)pthread_once(&sCacheOnce, Contents_makeCacheKey);
+   if (!bCacheKeyMade)
+      return MEMORY_ERROR;
+
+   /* an empty copy has nothing to compress */
+   ulCodecThreshold = ulThreshold == 0 ? 1 : ulThreshold;
+   return SUCCESS;
+}
+
+boolean Contents_getCodecStats(size_t *pulRawBytes,
+                               size_t *pulPackedBytes)
+{
+   assert(pulRawBytes != NULL);
+   assert(pulPackedBytes != NULL);
+
+   *pulRawBytes = ulPackedRawBytes;
+   *pulPackedBytes = ulPackedBytes;
+   return (boolean)(ulCodecThreshold != 0);
+}
+
+void Contents_holdTier(void)
+{
+   (void)pthread_mutex_lock(&sTierLock);
+   ulTierHolds++;
+   (void)pthread_mutex_unlock(&sTierLock);
+}
+
+void Contents_releaseTier(void)
+{
+   (void)pthread_mutex_lock(&sTierLock);
+   assert(ulTierHolds > 0);
+   ulTierHolds--;
+   Contents_trimTier(NULL);
+   (void)pthread_mutex_unlock(&sTierLock);
+}
+
+boolean Contents_getTierStats(size_t *pulHits, size_t *pulMisses,
+                              size_t *pulSpilledBytes)
+{
+   assert(pulHits != NULL);
+   assert(pulMisses != NULL);
+   assert(pulSpilledBytes != NULL);
+
+   *pulHits = ulTierHits;
+   *pulMisses = ulTierMisses;
+   *pulSpilledBytes = ulSpilledBytes;
+   return bTierOn;
+}
+
+/*
+  Compresses the ulLength bytes at pvBytes into pcScratch if the codec
+  is on, they are long enough, and compressing saves at least an
+  eighth of them. Returns the compressed length, or 0 if they are to
+  be kept as they are.
+*/
+static size_t Contents_pack(const void *pvBytes, size_t ulLength)
+{
+   size_t ulCapacity = ulLength - ulLength / 8;
+   char *pcBigger;
+
+   if (ulCodecThreshold == 0 || ulLength < ulCodecThreshold)
+      return 0;
+
+   /* without room to compress into, the bytes are just kept as is */
+   if (ulScratchSize < ulCapacity)
+   {
+      pcBigger = realloc(pcScratch, ulCapacity);
+      if (pcBigger == NULL)
+         return 0;
+      pcScratch = pcBigger;
+      ulScratchSize = ulCapacity;
+   }
+   return LZ_compress(pvBytes, ulLength, pcScratch, ulCapacity);
+}
+
+Contents_T Contents_new(const void *pvBytes, size_t ulLength)
+{
+   Contents_T oCContents;
+   boolean bTiered;
+   size_t ulSize = sizeof(struct contents);
+   size_t ulHash = 0;
+   size_t ulPacked;
+   char *pcTiered = NULL;
+
+   assert(pvBytes != NULL || ulLength == 0);
+
+   /* compressed copies are small enough to stay out of the tier */
+   ulPacked = Contents_pack(pvBytes, ulLength);
+   bTiered = (boolean)(ulPacked == 0 && bTierOn &&
+                       ulLength >= ulTierThreshold);
+   if (ulPacked != 0)
+      ulSize += ulPacked;
+   else if (!bTiered)
+      ulSize += ulLength;
+
+   /* look for an identical copy first. pvBytes may be a tiered copy's
+      own, so nothing is evicted until the new copy is made */
+   if (poCBuckets != NULL)
+   {
+      ulHash = Contents_hash(pvBytes, ulLength);
+      for (oCContents = poCBuckets[ulHash % ulBucketCount];
+           oCContents != NULL; oCContents = oCContents->oCNext)
+      {
+         if (oCContents->ulHash == ulHash &&
+             oCContents->ulLength == ulLength &&
+             Contents_equals(oCContents, pvBytes, pcScratch, ulPacked))
+         {
+            Contents_addRef(oCContents);
+            Contents_trimTier(oCContents);
+            return oCContents;
+         }
+      }
+   }
+
+   if (bTiered)
+   {
+      pcTiered = malloc(ulLength);
+      if (pcTiered == NULL)
+         return NULL;
+   }
+   if (oAArena != NULL)
+      oCContents = Arena_alloc(oAArena, ulSize);
+   else
+      oCContents = malloc(ulSize);
+   if (oCContents == NULL)
+   {
+      free(pcTiered);
+      return NULL;
+   }
+
+   oCContents->ulRefs = 1;
+   oCContents->ulLength = ulLength;
+   oCContents->oCMoved = NULL;
+   oCContents->ulHash = ulHash;
+   oCContents->oCNext = NULL;
+   oCContents->pvMapping = NULL;
+   oCContents->oCBase = NULL;
+   oCContents->bTiered = bTiered;
+   oCContents->pcTiered = pcTiered;
+   oCContents->ulSpillOffset = NO_SPILL;
+   oCContents->oCNewer = NULL;
+   oCContents->oCOlder = NULL;
+   oCContents->ulPacked = ulPacked;
+   oCContents->ulSerial = 0;
+   if (ulPacked != 0)
+   {
+      memcpy(oCContents + 1, pcScratch, ulPacked);
+      oCContents->ulSerial = ulNextSerial++;
+      ulPackedRawBytes += ulLength;
+      ulPackedBytes += ulPacked;
+   }
+   else if (bTiered)
+   {
+      memcpy(pcTiered, pvBytes, ulLength);
+      ulResidentBytes += ulLength;
+      Contents_linkNewest(oCContents);
+   }
+   else if (ulLength != 0)
+      memcpy(oCContents + 1, pvBytes, ulLength);
+   ulLogicalBytes += ulLength;
+   ulStoredBytes += ulLength;
+
+   if (poCBuckets != NULL)
+   {
+      if (ulUniqueCount >= ulBucketCount)
+         Contents_growTable();
+      Contents_link(oCContents);
+      ulUniqueCount++;
+   }
+   if (bTiered)
+      Contents_trimTier(oCContents);
+   return oCContents;
+}
+
+Contents_T Contents_newMapped(void *pvMapping, size_t ulLength)
+{
+   Contents_T oCContents;
+
+   assert(pvMapping != NULL);
+
+   if (oAArena != NULL)
+      oCContents = Arena_alloc(oAArena, sizeof(struct contents));
+   else
+      oCContents = malloc(sizeof(struct contents));
+   if (oCContents == NULL)
+      return NULL;
+
+   /* mapped copies are never hashed, so they are never shared by
+      deduplication either */
+   oCContents->ulRefs = 1;
+   oCContents->ulLength = ulLength;
+   oCContents->oCMoved = NULL;
+   oCContents->ulHash = 0;
+   oCContents->oCNext = NULL;
+   oCContents->pvMapping = pvMapping;
+   oCContents->oCBase = NULL;
+   oCContents->bTiered = FALSE;
+   oCContents->pcTiered = NULL;
+   oCContents->ulSpillOffset = NO_SPILL;
+   oCContents->oCNewer = NULL;
+   oCContents->oCOlder = NULL;
+   oCContents->ulPacked = 0;
+   oCContents->ulSerial = 0;
+   ulLogicalBytes += ulLength;
+   ulStoredBytes += ulLength;
+   return oCContents;
+}
+
+Contents_T Contents_newSlice(Contents_T oCBase, size_t ulOffset,
+                             size_t ulLength)
+{
+   Contents_T oCContents;
+
+   assert(oCBase != NULL);
+   assert(oCBase->pvMapping != NULL);
+   assert(ulOffset <= oCBase->ulLength);
+   assert(ulLength <= oCBase->ulLength - ulOffset);
+
+   /* a slice of a slice shares the same mapping directly */
+   if (oCBase->oCBase != NULL)
+   {
+      ulOffset += (size_t)((char *)oCBase->pvMapping -
+                           (char *)oCBase->oCBase->pvMapping);
+      oCBase = oCBase->oCBase;
+   }
+
+   if (oAArena != NULL)
+      oCContents = Arena_alloc(oAArena, sizeof(struct contents));
+   else
+      oCContents = malloc(sizeof(struct contents));
+   if (oCContents == NULL)
+      return NULL;
+
+   /* the bytes are already counted as stored by the base */
+   oCContents->ulRefs = 1;
+   oCContents->ulLength = ulLength;
+   oCContents->oCMoved = NULL;
+   oCContents->ulHash = 0;
+   oCContents->oCNext = NULL;
+   oCContents->pvMapping = (char *)oCBase->pvMapping + ulOffset;
+   oCContents->oCBase = oCBase;
+   oCContents->bTiered = FALSE;
+   oCContents->pcTiered = NULL;
+   oCContents->ulSpillOffset = NO_SPILL;
+   oCContents->oCNewer = NULL;
+   oCContents->oCOlder = NULL;
+   oCContents->ulPacked = 0;
+   oCContents->ulSerial = 0;
+   oCBase->ulRefs++;
+   ulLogicalBytes += ulLength;
+   return oCContents;
+}
+
+void Contents_addRef(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   oCContents->ulRefs++;
+   ulLogicalBytes += oCContents->ulLength;
+}
+
+/*
+  Drops a reference to oCContents without counting its bytes as
+  logically released, and frees or retires it, as for
+  Contents_release, if that was the last reference.
+*/
+static void Contents_unref(Contents_T oCContents, boolean bRetire)
+{
+   assert(oCContents != NULL);
+   assert(oCContents->ulRefs > 0);
+
+   oCContents->ulRefs--;
+   if (oCContents->ulRefs != 0)
+      return;
+
+   /* no longer available for sharing, even while retired */
+   if (poCBuckets != NULL && oCContents->pvMapping == NULL)
+   {
+      Contents_unlink(oCContents);
+      ulUniqueCount--;
+   }
+   if (oCContents->oCBase == NULL)
+      ulStoredBytes -= oCContents->ulLength;
+   if (oCContents->ulPacked != 0)
+   {
+      ulPackedRawBytes -= oCContents->ulLength;
+      ulPackedBytes -= oCContents->ulPacked;
+   }
+
+   if (bRetire)
+   {
+      Contents_freeRetired();
+      oCRetired = oCContents;
+   }
+   else
+      Contents_free(oCContents);
+}
+
+void Contents_release(Contents_T oCContents, boolean bRetire)
+{
+   assert(oCContents != NULL);
+
+   ulLogicalBytes -= oCContents->ulLength;
+   Contents_unref(oCContents, bRetire);
+}
+
+void Contents_freeRetired(void)
+{
+   if (oCRetired != NULL)
+      Contents_free(oCRetired);
+   oCRetired = NULL;
+}
+
+void *Contents_getBytes(Contents_T oCContents)
+{
+   void *pvBytes = NULL;
+
+   assert(oCContents != NULL);
+
+   if (oCContents->pvMapping != NULL)
+      return oCContents->pvMapping;
+   if (oCContents->ulPacked != 0)
+      return Contents_unpack(oCContents);
+   if (!oCContents->bTiered)
+      return oCContents + 1;
+
+   (void)pthread_mutex_lock(&sTierLock);
+   if (Contents_pageIn(oCContents))
+   {
+      pvBytes = oCContents->pcTiered;
+      Contents_trimTier(oCContents);
+   }
+   (void)pthread_mutex_unlock(&sTierLock);
+   return pvBytes;
+}
+
+size_t Contents_getLength(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   return oCContents->ulLength;
+}
+
+void Contents_getStats(size_t *pulLogicalBytes, size_t *pulStoredBytes)
+{
+   assert(pulLogicalBytes != NULL);
+   assert(pulStoredBytes != NULL);
+
+   *pulLogicalBytes = ulLogicalBytes;
+   *pulStoredBytes = ulStoredBytes;
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean Contents_isFragmented(void)
+{
+   return (boolean)(oAArena != NULL && Arena_isFragmented(oAArena));
+}
+
+int Contents_beginCompaction(void)
+{
+   assert(oAArena != NULL);
+   assert(oANewArena == NULL);
+
+   /* the retired copy is not held by any node, so it cannot move */
+   Contents_freeRetired();
+
+   oANewArena = Arena_new();
+   if (oANewArena == NULL)
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+int Contents_reserveMove(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+   assert(oANewArena != NULL);
+
+   if (oCContents->oCMoved == NULL)
+   {
+      oCContents->oCMoved =
+         Arena_alloc(oANewArena, Contents_getFootprint(oCContents));
+      if (oCContents->oCMoved == NULL)
+         return MEMORY_ERROR;
+   }
+
+   /* a slice's base moves along with it */
+   if (oCContents->oCBase != NULL)
+      return Contents_reserveMove(oCContents->oCBase);
+   return SUCCESS;
+}
+
+void Contents_cancelMove(Contents_T oCContents)
+{
+   assert(oCContents != NULL);
+
+   oCContents->oCMoved = NULL;
+   if (oCContents->oCBase != NULL)
+      Contents_cancelMove(oCContents->oCBase);
+}
+
+void Contents_abortCompaction(void)
+{
+   assert(oANewArena != NULL);
+
+   Arena_free(oANewArena);
+   oANewArena = NULL;
+}
+
+Contents_T Contents_move(Contents_T oCContents)
+{
+   Contents_T oCNew;
+
+   assert(oCContents != NULL);
+   assert(oCContents->oCMoved != NULL);
+
+   /* a copy that has already moved is marked by a zero count */
+   oCNew = oCContents->oCMoved;
+   if (oCContents->ulRefs != 0)
+   {
+      memcpy(oCNew, oCContents, Contents_getFootprint(oCContents));
+      oCNew->oCMoved = NULL;
+      if (oCContents->pcTiered != NULL)
+      {
+         /* take over the old header's place among the resident */
+         if (oCNew->oCNewer != NULL)
+            oCNew->oCNewer->oCOlder = oCNew;
+         else
+            oCNewest = oCNew;
+         if (oCNew->oCOlder != NULL)
+            oCNew->oCOlder->oCNewer = oCNew;
+         else
+            oCOldest = oCNew;
+      }
+      if (oCContents->oCBase != NULL)
+         oCNew->oCBase = Contents_move(oCContents->oCBase);
+      if (poCBuckets != NULL && oCContents->pvMapping == NULL)
+      {
+         Contents_unlink(oCContents);
+         Contents_link(oCNew);
+      }
+      oCContents->ulRefs = 0;
+   }
+   return oCNew;
+}
+
+void Contents_endCompaction(void)
+{
+   assert(oANewArena != NULL);
+
+   Arena_free(oAArena);
+   oAArena = oANewArena;
+   oANewArena = NULL;
+}
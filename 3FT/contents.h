@@ -0,0 +1,200 @@
+/*--------------------------------------------------------------------*/
+/* contents.h                                                         */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef CONTENTS_INCLUDED
+#define CONTENTS_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Contents_T is a copy of file contents owned by the FT, shared by
+  reference count among the file nodes that hold it. Copies are kept
+  in a content store: either individually allocated, or in a content
+  arena, optionally with identical copies stored only once. A copy
+  may also stand for a mapping of a host file instead of holding the
+  bytes itself. Large copies may also be kept compressed, or spilled
+  to a file by a content tier and read back when next used.
+*/
+typedef struct contents *Contents_T;
+
+/*
+  Starts keeping new copies in a content arena. If bDedup is TRUE,
+  copies are also hashed, and a copy identical to an existing one
+  becomes another reference to it rather than being stored again.
+  Must be called while no copies exist.
+  Returns SUCCESS, or MEMORY_ERROR if the arena could not be allocated.
+*/
+int Contents_startArena(boolean bDedup);
+
+/*
+  Frees any retired copy, then the content arena together with every
+  copy in it, and goes back to allocating copies individually. Mapped
+  copies must have been released already, or their mappings leak.
+*/
+void Contents_endArena(void);
+
+/* Returns TRUE if copies are being kept in a content arena. */
+boolean Contents_usesArena(void);
+
+/*
+  Starts compressing new copies of at least ulThreshold bytes with the
+  LZ codec, keeping the compressed form instead of the bytes when it
+  is at least an eighth smaller. A compressed copy's bytes are
+  decompressed by Contents_getBytes into a small cache of the calling
+  thread's, freed as the thread exits. Compressed copies stay out of
+  any content tier. Compression lasts until Contents_endArena. Must be
+  called after Contents_startArena, while no copies exist.
+  Returns SUCCESS, or MEMORY_ERROR if the caches could not be set up.
+*/
+int Contents_startCodec(size_t ulThreshold);
+
+/*
+  Sets *pulRawBytes to the bytes that the compressed copies stand for,
+  and *pulPackedBytes to the bytes their compressed forms take.
+  Returns TRUE if compression is on.
+*/
+boolean Contents_getCodecStats(size_t *pulRawBytes,
+                               size_t *pulPackedBytes);
+
+/*
+  Starts keeping the bytes of new copies of at least ulThreshold bytes
+  in a content tier, apart from the arena: at most ulBudget bytes of
+  them stay in memory, and the least recently used of the rest are
+  written out to a spill file in the temporary directory and read back
+  by Contents_getBytes. A copy spilled once is not written again.
+  Mapped copies and slices are never tiered. The tier lasts until
+  Contents_endArena. Must be called after Contents_startArena, while
+  no copies exist.
+  Returns SUCCESS, or IO_ERROR if the spill file could not be created.
+*/
+int Contents_startTier(size_t ulBudget, size_t ulThreshold);
+
+/*
+  Holds every tiered copy paged in from now on in memory, until the
+  matching Contents_releaseTier, so that the bytes returned by
+  Contents_getBytes stay put while several threads read copies at
+  once. Holds nest.
+*/
+void Contents_holdTier(void);
+
+/* Drops a hold, evicting copies down to the budget after the last. */
+void Contents_releaseTier(void);
+
+/*
+  Sets *pulHits to the number of times a tiered copy's bytes were in
+  memory when asked for, *pulMisses to the number of times they had to
+  be read back from the spill file, and *pulSpilledBytes to the bytes
+  written to the spill file. Returns TRUE if the content tier is on.
+*/
+boolean Contents_getTierStats(size_t *pulHits, size_t *pulMisses,
+                              size_t *pulSpilledBytes);
+
+/*
+  Returns a copy of the ulLength bytes at pvBytes, holding one
+  reference for the caller, or NULL if memory could not be allocated.
+  With deduplication on, this may be an existing identical copy. With
+  a content tier, this may evict other copies, as Contents_getBytes.
+*/
+Contents_T Contents_new(const void *pvBytes, size_t ulLength);
+
+/*
+  Returns a copy whose bytes are the ulLength bytes of the file mapping
+  at pvMapping, holding one reference for the caller, or NULL if memory
+  could not be allocated. The copy takes over the mapping and unmaps
+  it when freed. Mapped copies are never deduplicated.
+*/
+Contents_T Contents_newMapped(void *pvMapping, size_t ulLength);
+
+/*
+  Returns a copy whose bytes are the ulLength bytes at offset ulOffset
+  in mapped copy oCBase (see Contents_newMapped, which may itself be a
+  slice), holding one reference for the caller, or NULL if memory
+  could not be allocated. The slice shares the mapping without copying
+  it, and keeps the whole mapping alive until the slice is freed.
+*/
+Contents_T Contents_newSlice(Contents_T oCBase, size_t ulOffset,
+                             size_t ulLength);
+
+/* Adds a reference to oCContents. */
+void Contents_addRef(Contents_T oCContents);
+
+/*
+  Drops a reference to oCContents. A copy is freed when its last
+  reference goes, unless bRetire is TRUE, in which case it is kept
+  alive until the next Contents_freeRetired, so that it can still be
+  handed back to a client.
+*/
+void Contents_release(Contents_T oCContents, boolean bRetire);
+
+/* Frees the copy retired by the last Contents_release, if any. */
+void Contents_freeRetired(void);
+
+/*
+  Returns a pointer to the bytes of oCContents, or NULL if it is a
+  spilled copy that could not be read back or a compressed copy that
+  could not be decompressed. Reading a tiered copy may evict others,
+  after which their pointers are no longer valid, unless the tier is
+  held (see Contents_holdTier). The bytes of a compressed copy stay
+  valid while the calling thread reads up to three other compressed
+  copies. Threads may call this at
+  once; every other function must be called by one thread at a time
+  while no other thread is using the store.
+*/
+void *Contents_getBytes(Contents_T oCContents);
+
+/* Returns the number of bytes in oCContents. */
+size_t Contents_getLength(Contents_T oCContents);
+
+/*
+  Sets *pulLogicalBytes to the number of bytes held by all references
+  to copies, i.e., what the copies would take without sharing, and
+  *pulStoredBytes to the number of bytes actually stored.
+*/
+void Contents_getStats(size_t *pulLogicalBytes, size_t *pulStoredBytes);
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Moving copies to a fresh arena is driven by the owner of the
+  references, who alone can find and repoint them:
+  Contents_beginCompaction, then Contents_reserveMove on every copy,
+  then either Contents_cancelMove on every copy and
+  Contents_abortCompaction, or Contents_move on every copy and
+  Contents_endCompaction.
+*/
+
+/* Returns TRUE if the content arena is mostly free space. */
+boolean Contents_isFragmented(void);
+
+/*
+  Starts a compaction of the content arena. Returns SUCCESS, or
+  MEMORY_ERROR if the fresh arena could not be allocated.
+*/
+int Contents_beginCompaction(void);
+
+/*
+  Sets aside room in the fresh arena for oCContents, unless that was
+  already done. Returns SUCCESS, or MEMORY_ERROR if there is no room.
+*/
+int Contents_reserveMove(Contents_T oCContents);
+
+/* Forgets the room set aside for oCContents, if any. */
+void Contents_cancelMove(Contents_T oCContents);
+
+/* Ends a compaction that failed, leaving every copy where it was. */
+void Contents_abortCompaction(void);
+
+/*
+  Returns where oCContents lives in the fresh arena, copying it there
+  on the first call for it. The old handle must not be used again.
+*/
+Contents_T Contents_move(Contents_T oCContents);
+
+/* Ends a compaction once every copy has moved, freeing the old
+   arena. */
+void Contents_endCompaction(void);
+
+#endif
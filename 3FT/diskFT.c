@@ -0,0 +1,2265 @@
+/*--------------------------------------------------------------------*/
+/* diskFT.c                                                           */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diskFT.h"
+#include "pager.h"
+#include "btree.h"
+#include "nodeFT.h"
+#include "contents.h"
+#include "path.h"
+#include "dynarray.h"
+
+/*
+  A node's key is its path with each component preceded by a type
+  byte, KEY_DIR for the components of its ancestors and KEY_FILE or
+  KEY_DIR for its own, and with '\0' in place of each '/'. Since
+  '\0' sorts first, a directory's key is followed by the keys of its
+  subtree and then by those of its next sibling, and since KEY_FILE
+  sorts before KEY_DIR, files come before directories, as in
+  FT_toString.
+*/
+enum { KEY_FILE = 1, KEY_DIR = 2 };
+
+/* The most entries a subtree walk collects at a time. */
+enum { BATCH_ENTRIES = 64 };
+
+/* The value of a node's entry */
+struct record
+{
+   /* TRUE for a file, FALSE for a directory */
+   boolean bIsFile;
+   /* the length of a file in bytes */
+   size_t ulLength;
+   /* the first page of a file's stored bytes, or 0 if there are none;
+      bytes past those stored read as zeros */
+   size_t ulBlob;
+};
+
+/* The start of each page of a file's stored bytes */
+struct blobHeader
+{
+   /* the next page, or 0 for the last */
+   size_t ulNext;
+   /* in the first page, the number of files sharing the bytes */
+   size_t ulRefs;
+   /* in the first page, the number of bytes stored */
+   size_t ulLength;
+};
+
+/* The number of a file's bytes stored in each page. */
+enum { BLOB_DATA = PAGER_PAGE_SIZE - sizeof(struct blobHeader) };
+
+/* The longest key, leaving room in an entry for its record. */
+enum { MAX_KEY = BTREE_MAX_ENTRY - sizeof(struct record) };
+
+/* An on-disk FT */
+struct diskFT
+{
+   /* the pager of the page file */
+   Pager_T oPPager;
+   /* the entries of the nodes, by key */
+   BTree_T oBEntries;
+   /* the name of the root, or NULL if there are no nodes */
+   char *pcRoot;
+   /* the copies of contents handed out since the last change */
+   DynArray_T oDHandedOut;
+   /* the bytes stored contents would take if none were shared */
+   size_t ulLogicalBytes;
+   /* the bytes of contents stored */
+   size_t ulStoredBytes;
+};
+
+/* An entry collected by a subtree walk */
+struct entry
+{
+   /* the entry's record */
+   struct record sRecord;
+   /* the number of bytes in its key */
+   size_t ulKeyLength;
+   /* its key */
+   char acKey[1];
+};
+
+/* The state of a subtree walk */
+struct walk
+{
+   /* the key of the top of the subtree */
+   const char *pcTop;
+   /* the number of bytes in pcTop */
+   size_t ulTopLength;
+   /* the key of a subtree to stop at rather than collect, or NULL */
+   const char *pcStop;
+   /* the number of bytes in pcStop */
+   size_t ulStopLength;
+   /* the entries collected in this batch */
+   DynArray_T oDEntries;
+   /* TRUE if this batch ended at the subtree pcStop */
+   boolean bStopped;
+   /* MEMORY_ERROR if an entry could not be collected */
+   int iStatus;
+};
+
+/* --------------------------------------------------------------------
+
+  Keys and records
+*/
+
+/*
+  Appends the component pcName, of type KEY_FILE if bIsFile is TRUE
+  and KEY_DIR otherwise, to the *pulKeyLength-byte key in pcKey,
+  which has room for MAX_KEY bytes. Returns SUCCESS, or BAD_PATH if
+  the key would be too long.
+*/
+static int DiskFT_appendKey(char *pcKey, size_t *pulKeyLength,
+                            const char *pcName, boolean bIsFile)
+{
+   size_t ulLength = *pulKeyLength;
+   size_t ulNameLength = strlen(pcName);
+
+   if (ulLength + ulNameLength + 2 > MAX_KEY)
+      return BAD_PATH;
+
+   if (ulLength != 0)
+      pcKey[ulLength++] = '\0';
+   pcKey[ulLength++] = (char)(bIsFile ? KEY_FILE : KEY_DIR);
+   memcpy(pcKey + ulLength, pcName, ulNameLength);
+   *pulKeyLength = ulLength + ulNameLength;
+   return SUCCESS;
+}
+
+/*
+  Sets pcKey (with room for MAX_KEY bytes) and *pulKeyLength to the key
+  of the first ulDepth components of oPPath, as a file if bIsFile is
+  TRUE. Returns SUCCESS, or BAD_PATH if the key would be too long.
+*/
+static int DiskFT_makeKey(Path_T oPPath, size_t ulDepth,
+                          boolean bIsFile, char *pcKey,
+                          size_t *pulKeyLength)
+{
+   size_t ulLevel;
+   int iStatus;
+
+   assert(ulDepth <= Path_getDepth(oPPath));
+
+   *pulKeyLength = 0;
+   for (ulLevel = 0; ulLevel < ulDepth; ulLevel++)
+   {
+      iStatus = DiskFT_appendKey(pcKey, pulKeyLength,
+                                 Path_getComponent(oPPath, ulLevel),
+                                 bIsFile && ulLevel + 1 == ulDepth);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+   return SUCCESS;
+}
+
+/*
+  Returns the offset in the ulKeyLength-byte key pcKey of the type
+  byte of its last component.
+*/
+static size_t DiskFT_lastComponent(const char *pcKey, size_t ulKeyLength)
+{
+   size_t ulOffset = ulKeyLength;
+
+   while (ulOffset > 0 && pcKey[ulOffset - 1] != '\0')
+      ulOffset--;
+   return ulOffset;
+}
+
+/*
+  Returns TRUE if the ulKeyLength-byte key pcKey is the
+  ulTopLength-byte key pcTop or in its subtree.
+*/
+static boolean DiskFT_inSubtree(const char *pcKey, size_t ulKeyLength,
+                                const char *pcTop, size_t ulTopLength)
+{
+   if (ulKeyLength < ulTopLength ||
+       memcmp(pcKey, pcTop, ulTopLength) != 0)
+      return FALSE;
+   return ulKeyLength == ulTopLength || pcKey[ulTopLength] == '\0';
+}
+
+/* Fills in *psRecord, including the padding between its fields. */
+static void DiskFT_setRecord(struct record *psRecord, boolean bIsFile,
+                             size_t ulLength, size_t ulBlob)
+{
+   memset(psRecord, 0, sizeof(struct record));
+   psRecord->bIsFile = bIsFile;
+   psRecord->ulLength = ulLength;
+   psRecord->ulBlob = ulBlob;
+}
+
+/*
+  Copies the record of the ulKeyLength-byte key pcKey in oDTree to
+  *psRecord. Returns SUCCESS, NO_SUCH_PATH if the key is not there, or
+  the status of a pager failure.
+*/
+static int DiskFT_getRecord(DiskFT_T oDTree, const char *pcKey,
+                            size_t ulKeyLength, struct record *psRecord)
+{
+   char acValue[BTREE_MAX_ENTRY];
+   size_t ulValueLength;
+   int iStatus;
+
+   iStatus = BTree_get(oDTree->oBEntries, pcKey, ulKeyLength, acValue,
+                       &ulValueLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   assert(ulValueLength == sizeof(struct record));
+   memcpy(psRecord, acValue, sizeof(struct record));
+   return SUCCESS;
+}
+
+/* Maps the ulKeyLength-byte key pcKey to *psRecord in oDTree. */
+static int DiskFT_putRecord(DiskFT_T oDTree, const char *pcKey,
+                            size_t ulKeyLength,
+                            const struct record *psRecord)
+{
+   return BTree_put(oDTree->oBEntries, pcKey, ulKeyLength, psRecord,
+                    sizeof(struct record));
+}
+
+/* --------------------------------------------------------------------
+
+  Stored contents: a file's bytes are kept in a chain of pages, the
+  first of which counts the files sharing them.
+*/
+
+/* Copies the header of page ulPage of oDTree to *psHeader. */
+static int DiskFT_readHeader(DiskFT_T oDTree, size_t ulPage,
+                             struct blobHeader *psHeader)
+{
+   void *pvPage;
+   int iStatus;
+
+   iStatus = Pager_get(oDTree->oPPager, ulPage, &pvPage);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   memcpy(psHeader, pvPage, sizeof(struct blobHeader));
+   Pager_release(oDTree->oPPager, pvPage, FALSE);
+   return SUCCESS;
+}
+
+/* Copies *psHeader to the header of page ulPage of oDTree. */
+static int DiskFT_writeHeader(DiskFT_T oDTree, size_t ulPage,
+                              const struct blobHeader *psHeader)
+{
+   void *pvPage;
+   int iStatus;
+
+   iStatus = Pager_get(oDTree->oPPager, ulPage, &pvPage);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   memcpy(pvPage, psHeader, sizeof(struct blobHeader));
+   Pager_release(oDTree->oPPager, pvPage, TRUE);
+   return SUCCESS;
+}
+
+/*
+  Gives the chain of pages starting at ulPage back to oDTree's pager.
+  If a page cannot be read, the rest of the chain is never reused.
+*/
+static void DiskFT_freeChain(DiskFT_T oDTree, size_t ulPage)
+{
+   struct blobHeader sHeader;
+
+   while (ulPage != 0)
+   {
+      if (DiskFT_readHeader(oDTree, ulPage, &sHeader) != SUCCESS)
+         return;
+      Pager_free(oDTree->oPPager, ulPage);
+      ulPage = sHeader.ulNext;
+   }
+}
+
+/*
+  Copies ulLength bytes starting at byte ulOffset of the buffer
+  pvSource to pvDest. Returns SUCCESS.
+*/
+static int DiskFT_fillFromBuffer(void *pvDest, size_t ulOffset,
+                                 size_t ulLength, const void *pvSource)
+{
+   memcpy(pvDest, (const char *)pvSource + ulOffset, ulLength);
+   return SUCCESS;
+}
+
+/*
+  Copies ulLength bytes starting at byte ulOffset of the file node
+  pvSource to pvDest. Returns SUCCESS.
+*/
+static int DiskFT_fillFromNode(void *pvDest, size_t ulOffset,
+                               size_t ulLength, const void *pvSource)
+{
+   size_t ulRead;
+
+   return Node_readFile((Node_T)pvSource, ulOffset, pvDest, ulLength,
+                        &ulRead);
+}
+
+/*
+  Stores ulLength bytes, copied from pvSource by pfFill, in a new
+  chain of pages of oDTree, and sets *pulBlob to its first page (0 if
+  ulLength is 0). Returns SUCCESS, or sets *pulBlob to 0 and returns
+  the status of a pager or pfFill failure.
+*/
+static int DiskFT_newBlob(DiskFT_T oDTree,
+                          int (*pfFill)(void *pvDest, size_t ulOffset,
+                                        size_t ulLength,
+                                        const void *pvSource),
+                          const void *pvSource, size_t ulLength,
+                          size_t *pulBlob)
+{
+   struct blobHeader sHeader;
+   void *pvPage;
+   void *pvPrev = NULL;
+   size_t ulPage;
+   size_t ulOffset;
+   size_t ulChunk;
+   int iStatus = SUCCESS;
+
+   *pulBlob = 0;
+   for (ulOffset = 0; ulOffset < ulLength; ulOffset += ulChunk)
+   {
+      ulChunk = ulLength - ulOffset;
+      if (ulChunk > BLOB_DATA)
+         ulChunk = BLOB_DATA;
+
+      iStatus = Pager_allocate(oDTree->oPPager, &ulPage, &pvPage);
+      if (iStatus != SUCCESS)
+         break;
+
+      /* link the new page in before anything can fail */
+      if (pvPrev == NULL)
+      {
+         *pulBlob = ulPage;
+         sHeader.ulNext = 0;
+         sHeader.ulRefs = 1;
+         sHeader.ulLength = ulLength;
+         memcpy(pvPage, &sHeader, sizeof(struct blobHeader));
+      }
+      else
+      {
+         memcpy(&sHeader, pvPrev, sizeof(struct blobHeader));
+         sHeader.ulNext = ulPage;
+         memcpy(pvPrev, &sHeader, sizeof(struct blobHeader));
+         Pager_release(oDTree->oPPager, pvPrev, TRUE);
+      }
+      pvPrev = pvPage;
+
+      iStatus = pfFill((char *)pvPage + sizeof(struct blobHeader),
+                       ulOffset, ulChunk, pvSource);
+      if (iStatus != SUCCESS)
+         break;
+   }
+   if (pvPrev != NULL)
+      Pager_release(oDTree->oPPager, pvPrev, TRUE);
+
+   if (iStatus != SUCCESS)
+   {
+      DiskFT_freeChain(oDTree, *pulBlob);
+      *pulBlob = 0;
+      return iStatus;
+   }
+
+   oDTree->ulLogicalBytes += ulLength;
+   oDTree->ulStoredBytes += ulLength;
+   return SUCCESS;
+}
+
+/*
+  Copies the stored bytes starting at page ulBlob of oDTree to a new
+  chain of pages and sets *pulCopy to its first page (0 if ulBlob is
+  0). Returns SUCCESS, or sets *pulCopy to 0 and returns the status of
+  a pager failure.
+*/
+static int DiskFT_copyBlob(DiskFT_T oDTree, size_t ulBlob,
+                           size_t *pulCopy)
+{
+   struct blobHeader sHeader;
+   struct blobHeader sHead;
+   void *pvSource;
+   void *pvPage;
+   void *pvPrev = NULL;
+   size_t ulPage;
+   int iStatus = SUCCESS;
+
+   *pulCopy = 0;
+   if (ulBlob == 0)
+      return SUCCESS;
+
+   iStatus = DiskFT_readHeader(oDTree, ulBlob, &sHead);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   while (ulBlob != 0)
+   {
+      iStatus = Pager_allocate(oDTree->oPPager, &ulPage, &pvPage);
+      if (iStatus != SUCCESS)
+         break;
+      iStatus = Pager_get(oDTree->oPPager, ulBlob, &pvSource);
+      if (iStatus != SUCCESS)
+      {
+         Pager_release(oDTree->oPPager, pvPage, FALSE);
+         Pager_free(oDTree->oPPager, ulPage);
+         break;
+      }
+      memcpy(&sHeader, pvSource, sizeof(struct blobHeader));
+      memcpy(pvPage, pvSource, PAGER_PAGE_SIZE);
+      Pager_release(oDTree->oPPager, pvSource, FALSE);
+      ulBlob = sHeader.ulNext;
+
+      sHeader.ulNext = 0;
+      if (pvPrev == NULL)
+      {
+         *pulCopy = ulPage;
+         sHeader.ulRefs = 1;
+      }
+      else
+      {
+         memcpy(&sHeader, pvPrev, sizeof(struct blobHeader));
+         sHeader.ulNext = ulPage;
+         memcpy(pvPrev, &sHeader, sizeof(struct blobHeader));
+         Pager_release(oDTree->oPPager, pvPrev, TRUE);
+         sHeader.ulNext = 0;
+      }
+      memcpy(pvPage, &sHeader, sizeof(struct blobHeader));
+      pvPrev = pvPage;
+   }
+   if (pvPrev != NULL)
+      Pager_release(oDTree->oPPager, pvPrev, TRUE);
+
+   if (iStatus != SUCCESS)
+   {
+      DiskFT_freeChain(oDTree, *pulCopy);
+      *pulCopy = 0;
+      return iStatus;
+   }
+
+   oDTree->ulLogicalBytes += sHead.ulLength;
+   oDTree->ulStoredBytes += sHead.ulLength;
+   return SUCCESS;
+}
+
+/*
+  Lets one more file share the stored bytes starting at page ulBlob
+  of oDTree, if ulBlob is not 0.
+*/
+static int DiskFT_shareBlob(DiskFT_T oDTree, size_t ulBlob)
+{
+   struct blobHeader sHeader;
+   int iStatus;
+
+   if (ulBlob == 0)
+      return SUCCESS;
+
+   iStatus = DiskFT_readHeader(oDTree, ulBlob, &sHeader);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   sHeader.ulRefs++;
+   iStatus = DiskFT_writeHeader(oDTree, ulBlob, &sHeader);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   oDTree->ulLogicalBytes += sHeader.ulLength;
+   return SUCCESS;
+}
+
+/*
+  Lets one fewer file share the stored bytes starting at page ulBlob
+  of oDTree, if ulBlob is not 0, freeing them if no file is left.
+*/
+static int DiskFT_releaseBlob(DiskFT_T oDTree, size_t ulBlob)
+{
+   struct blobHeader sHeader;
+   int iStatus;
+
+   if (ulBlob == 0)
+      return SUCCESS;
+
+   iStatus = DiskFT_readHeader(oDTree, ulBlob, &sHeader);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   oDTree->ulLogicalBytes -= sHeader.ulLength;
+   if (--sHeader.ulRefs > 0)
+      return DiskFT_writeHeader(oDTree, ulBlob, &sHeader);
+
+   oDTree->ulStoredBytes -= sHeader.ulLength;
+   DiskFT_freeChain(oDTree, ulBlob);
+   return SUCCESS;
+}
+
+/*
+  Makes *pulBlob, if not 0, the first page of stored bytes of oDTree
+  that no other file shares, copying them if they are shared.
+*/
+static int DiskFT_ownBlob(DiskFT_T oDTree, size_t *pulBlob)
+{
+   struct blobHeader sHeader;
+   size_t ulCopy;
+   int iStatus;
+
+   if (*pulBlob == 0)
+      return SUCCESS;
+
+   iStatus = DiskFT_readHeader(oDTree, *pulBlob, &sHeader);
+   if (iStatus != SUCCESS || sHeader.ulRefs == 1)
+      return iStatus;
+
+   iStatus = DiskFT_copyBlob(oDTree, *pulBlob, &ulCopy);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   (void)DiskFT_releaseBlob(oDTree, *pulBlob);
+   *pulBlob = ulCopy;
+   return SUCCESS;
+}
+
+/*
+  Copies ulLength bytes starting at byte ulOffset of the stored bytes
+  starting at page ulBlob of oDTree to pvBuf, with zeros for any
+  bytes past those stored. Pages before ulOffset are read only for
+  their links.
+*/
+static int DiskFT_readBlob(DiskFT_T oDTree, size_t ulBlob,
+                           size_t ulOffset, void *pvBuf, size_t ulLength)
+{
+   struct blobHeader sHeader;
+   char *pcBuf = pvBuf;
+   void *pvPage;
+   size_t ulChunk;
+   int iStatus;
+
+   while (ulLength > 0 && ulBlob != 0)
+   {
+      iStatus = Pager_get(oDTree->oPPager, ulBlob, &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      memcpy(&sHeader, pvPage, sizeof(struct blobHeader));
+
+      if (ulOffset < BLOB_DATA)
+      {
+         ulChunk = BLOB_DATA - ulOffset;
+         if (ulChunk > ulLength)
+            ulChunk = ulLength;
+         memcpy(pcBuf,
+                (char *)pvPage + sizeof(struct blobHeader) + ulOffset,
+                ulChunk);
+         pcBuf += ulChunk;
+         ulLength -= ulChunk;
+         ulOffset = 0;
+      }
+      else
+         ulOffset -= BLOB_DATA;
+
+      Pager_release(oDTree->oPPager, pvPage, FALSE);
+      ulBlob = sHeader.ulNext;
+   }
+
+   memset(pcBuf, 0, ulLength);
+   return SUCCESS;
+}
+
+/*
+  Overwrites ulLength bytes starting at byte ulOffset of the stored
+  bytes starting at page *pulBlob of oDTree with those at pvBuf,
+  first copying the stored bytes if they are shared, and adding
+  zeroed pages as needed. Updates *pulBlob, which may be 0 for no
+  stored bytes.
+*/
+static int DiskFT_writeBlob(DiskFT_T oDTree, size_t *pulBlob,
+                            size_t ulOffset, const void *pvBuf,
+                            size_t ulLength)
+{
+   struct blobHeader sHeader;
+   const char *pcBuf = pvBuf;
+   void *pvPage;
+   size_t ulPage;
+   size_t ulNext;
+   size_t ulStart = 0;
+   size_t ulEnd = ulOffset + ulLength;
+   size_t ulFrom;
+   size_t ulTo;
+   int iStatus;
+
+   assert(ulLength > 0);
+
+   iStatus = DiskFT_ownBlob(oDTree, pulBlob);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (*pulBlob == 0)
+   {
+      iStatus = Pager_allocate(oDTree->oPPager, pulBlob, &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      sHeader.ulNext = 0;
+      sHeader.ulRefs = 1;
+      sHeader.ulLength = 0;
+      memcpy(pvPage, &sHeader, sizeof(struct blobHeader));
+      Pager_release(oDTree->oPPager, pvPage, TRUE);
+   }
+
+   ulPage = *pulBlob;
+   while (ulStart < ulEnd)
+   {
+      iStatus = Pager_get(oDTree->oPPager, ulPage, &pvPage);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      memcpy(&sHeader, pvPage, sizeof(struct blobHeader));
+
+      /* the stored length is kept in the first page */
+      if (ulStart == 0 && sHeader.ulLength < ulEnd)
+      {
+         oDTree->ulLogicalBytes += ulEnd - sHeader.ulLength;
+         oDTree->ulStoredBytes += ulEnd - sHeader.ulLength;
+         sHeader.ulLength = ulEnd;
+      }
+
+      if (sHeader.ulNext == 0 && ulStart + BLOB_DATA < ulEnd)
+      {
+         void *pvNext;
+
+         iStatus = Pager_allocate(oDTree->oPPager, &ulNext, &pvNext);
+         if (iStatus != SUCCESS)
+         {
+            Pager_release(oDTree->oPPager, pvPage, FALSE);
+            return iStatus;
+         }
+         Pager_release(oDTree->oPPager, pvNext, TRUE);
+         sHeader.ulNext = ulNext;
+      }
+
+      ulFrom = ulOffset > ulStart ? ulOffset : ulStart;
+      ulTo = ulStart + BLOB_DATA < ulEnd ? ulStart + BLOB_DATA : ulEnd;
+      if (ulFrom < ulTo)
+         memcpy((char *)pvPage + sizeof(struct blobHeader) +
+                (ulFrom - ulStart), pcBuf + (ulFrom - ulOffset),
+                ulTo - ulFrom);
+
+      memcpy(pvPage, &sHeader, sizeof(struct blobHeader));
+      Pager_release(oDTree->oPPager, pvPage, TRUE);
+      ulPage = sHeader.ulNext;
+      ulStart += BLOB_DATA;
+   }
+   return SUCCESS;
+}
+
+/*
+  Drops the stored bytes past byte ulLength (at least 1) of those
+  starting at page *pulBlob of oDTree, first copying them if they are
+  shared, and zeroes the rest of the last page kept, so that the file
+  can later grow with zeros. Updates *pulBlob.
+*/
+static int DiskFT_shrinkBlob(DiskFT_T oDTree, size_t *pulBlob,
+                             size_t ulLength)
+{
+   struct blobHeader sHeader;
+   void *pvPage;
+   size_t ulPage;
+   size_t ulStart = 0;
+   size_t ulRest;
+   int iStatus;
+
+   assert(ulLength > 0);
+
+   iStatus = DiskFT_readHeader(oDTree, *pulBlob, &sHeader);
+   if (iStatus != SUCCESS || sHeader.ulLength <= ulLength)
+      return iStatus;
+
+   iStatus = DiskFT_ownBlob(oDTree, pulBlob);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   oDTree->ulLogicalBytes -= sHeader.ulLength - ulLength;
+   oDTree->ulStoredBytes -= sHeader.ulLength - ulLength;
+   sHeader.ulLength = ulLength;
+   iStatus = DiskFT_writeHeader(oDTree, *pulBlob, &sHeader);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* find the page holding the new last byte */
+   ulPage = *pulBlob;
+   while (ulStart + BLOB_DATA < ulLength)
+   {
+      iStatus = DiskFT_readHeader(oDTree, ulPage, &sHeader);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      ulPage = sHeader.ulNext;
+      ulStart += BLOB_DATA;
+   }
+
+   iStatus = Pager_get(oDTree->oPPager, ulPage, &pvPage);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   memcpy(&sHeader, pvPage, sizeof(struct blobHeader));
+   ulRest = sHeader.ulNext;
+   sHeader.ulNext = 0;
+   memcpy(pvPage, &sHeader, sizeof(struct blobHeader));
+   memset((char *)pvPage + sizeof(struct blobHeader) +
+          (ulLength - ulStart), 0, BLOB_DATA - (ulLength - ulStart));
+   Pager_release(oDTree->oPPager, pvPage, TRUE);
+
+   DiskFT_freeChain(oDTree, ulRest);
+   return SUCCESS;
+}
+
+/*
+  Returns a copy of the contents of the file with record *psRecord,
+  which oDTree frees at its next change, or NULL if the file has no
+  stored bytes or the copy could not be made.
+*/
+static void *DiskFT_handOut(DiskFT_T oDTree,
+                            const struct record *psRecord)
+{
+   void *pvCopy;
+
+   if (psRecord->ulBlob == 0)
+      return NULL;
+
+   pvCopy = malloc(psRecord->ulLength);
+   if (pvCopy == NULL)
+      return NULL;
+   if (DiskFT_readBlob(oDTree, psRecord->ulBlob, 0, pvCopy,
+                       psRecord->ulLength) != SUCCESS ||
+       !DynArray_add(oDTree->oDHandedOut, pvCopy))
+   {
+      free(pvCopy);
+      return NULL;
+   }
+   return pvCopy;
+}
+
+/* Frees the copies of contents that oDTree has handed out. */
+static void DiskFT_forget(DiskFT_T oDTree)
+{
+   size_t ulIndex = DynArray_getLength(oDTree->oDHandedOut);
+
+   while (ulIndex > 0)
+      free(DynArray_removeAt(oDTree->oDHandedOut, --ulIndex));
+}
+
+/* --------------------------------------------------------------------
+
+  Finding nodes
+*/
+
+/*
+  Looks up the node whose path is the first ulDepth components of
+  oPPath in oDTree, as a directory and then as a file. If it is
+  there, sets pcKey (with room for MAX_KEY bytes), *pulKeyLength and
+  *psRecord to its key and record and returns SUCCESS. Otherwise
+  returns NO_SUCH_PATH, BAD_PATH or the status of a pager failure.
+*/
+static int DiskFT_lookup(DiskFT_T oDTree, Path_T oPPath, size_t ulDepth,
+                         char *pcKey, size_t *pulKeyLength,
+                         struct record *psRecord)
+{
+   int iStatus;
+
+   iStatus = DiskFT_makeKey(oPPath, ulDepth, FALSE, pcKey,
+                            pulKeyLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = DiskFT_getRecord(oDTree, pcKey, *pulKeyLength, psRecord);
+   if (iStatus != NO_SUCH_PATH || ulDepth == 1)
+      return iStatus;
+
+   pcKey[DiskFT_lastComponent(pcKey, *pulKeyLength)] = KEY_FILE;
+   return DiskFT_getRecord(oDTree, pcKey, *pulKeyLength, psRecord);
+}
+
+/*
+  Goes as far as possible down oDTree towards oPPath, setting *pulDepth
+  to the number of leading components of oPPath found (0 if oDTree is
+  empty) and *pbIsFile to whether the last of them is a file.
+  Returns SUCCESS, CONFLICTING_PATH if the root is not oPPath's first
+  component, or the status of a lookup failure.
+*/
+static int DiskFT_traverse(DiskFT_T oDTree, Path_T oPPath,
+                           size_t *pulDepth, boolean *pbIsFile)
+{
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   struct record sRecord;
+   size_t ulDepth = Path_getDepth(oPPath);
+   size_t ulFound;
+   int iStatus;
+
+   *pulDepth = 0;
+   *pbIsFile = FALSE;
+
+   if (oDTree->pcRoot == NULL)
+      return SUCCESS;
+   if (strcmp(oDTree->pcRoot, Path_getComponent(oPPath, 0)))
+      return CONFLICTING_PATH;
+
+   for (ulFound = 1; ulFound < ulDepth && !*pbIsFile; ulFound++)
+   {
+      iStatus = DiskFT_lookup(oDTree, oPPath, ulFound + 1, acKey,
+                              &ulKeyLength, &sRecord);
+      if (iStatus == NO_SUCH_PATH)
+         break;
+      if (iStatus != SUCCESS)
+         return iStatus;
+      *pbIsFile = sRecord.bIsFile;
+   }
+
+   *pulDepth = ulFound;
+   return SUCCESS;
+}
+
+/*
+  Finds the node at pcPath in oDTree, setting pcKey (with room for
+  MAX_KEY bytes), *pulKeyLength and *psRecord to its key and record,
+  and *pulDepth to its depth.
+  Returns SUCCESS, or BAD_PATH, CONFLICTING_PATH, NO_SUCH_PATH,
+  MEMORY_ERROR or the status of a pager failure.
+*/
+static int DiskFT_find(DiskFT_T oDTree, const char *pcPath, char *pcKey,
+                       size_t *pulKeyLength, struct record *psRecord,
+                       size_t *pulDepth)
+{
+   Path_T oPPath = NULL;
+   int iStatus;
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (oDTree->pcRoot == NULL)
+      iStatus = NO_SUCH_PATH;
+   else if (strcmp(oDTree->pcRoot, Path_getComponent(oPPath, 0)))
+      iStatus = CONFLICTING_PATH;
+   else
+   {
+      *pulDepth = Path_getDepth(oPPath);
+      iStatus = DiskFT_lookup(oDTree, oPPath, *pulDepth, pcKey,
+                              pulKeyLength, psRecord);
+   }
+
+   Path_free(oPPath);
+   return iStatus;
+}
+
+/*
+  Checks that the directory or file at oPPath could be added to
+  oDTree below a parent that is already there, as for FT_copy.
+  Returns SUCCESS, or ALREADY_IN_TREE, NOT_A_DIRECTORY, NO_SUCH_PATH,
+  BAD_PATH or the status of a traversal failure.
+*/
+static int DiskFT_checkChild(DiskFT_T oDTree, Path_T oPPath)
+{
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth = Path_getDepth(oPPath);
+   size_t ulFound;
+   boolean bIsFile;
+   int iStatus;
+
+   iStatus = DiskFT_traverse(oDTree, oPPath, &ulFound, &bIsFile);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (ulFound == ulDepth)
+      return ALREADY_IN_TREE;
+   if (bIsFile)
+      return NOT_A_DIRECTORY;
+   if (ulFound + 1 != ulDepth)
+      return NO_SUCH_PATH;
+
+   return DiskFT_makeKey(oPPath, ulDepth, TRUE, acKey, &ulKeyLength);
+}
+
+/* --------------------------------------------------------------------
+
+  Walking subtrees: each walk collects a batch of entries in key
+  order, which the caller may then change the B+tree for.
+*/
+
+/* Frees the entries collected by *psWalk. */
+static void DiskFT_clearWalk(struct walk *psWalk)
+{
+   size_t ulIndex = DynArray_getLength(psWalk->oDEntries);
+
+   while (ulIndex > 0)
+      free(DynArray_removeAt(psWalk->oDEntries, --ulIndex));
+}
+
+/*
+  Collects the entry with the ulKeyLength-byte key at pvKey and the
+  value at pvValue into the struct walk pvExtra, if it is in the
+  subtree being walked. Returns FALSE when the batch is done.
+*/
+static boolean DiskFT_collect(const void *pvKey, size_t ulKeyLength,
+                              const void *pvValue, size_t ulValueLength,
+                              void *pvExtra)
+{
+   struct walk *psWalk = pvExtra;
+   struct entry *psEntry;
+
+   assert(ulValueLength == sizeof(struct record));
+
+   if (!DiskFT_inSubtree(pvKey, ulKeyLength, psWalk->pcTop,
+                         psWalk->ulTopLength))
+      return FALSE;
+   if (psWalk->pcStop != NULL &&
+       DiskFT_inSubtree(pvKey, ulKeyLength, psWalk->pcStop,
+                        psWalk->ulStopLength))
+   {
+      psWalk->bStopped = TRUE;
+      return FALSE;
+   }
+   if (DynArray_getLength(psWalk->oDEntries) == BATCH_ENTRIES)
+      return FALSE;
+
+   psEntry = malloc(sizeof(struct entry) + ulKeyLength);
+   if (psEntry == NULL)
+   {
+      psWalk->iStatus = MEMORY_ERROR;
+      return FALSE;
+   }
+   memcpy(&psEntry->sRecord, pvValue, sizeof(struct record));
+   psEntry->ulKeyLength = ulKeyLength;
+   memcpy(psEntry->acKey, pvKey, ulKeyLength);
+   if (!DynArray_add(psWalk->oDEntries, psEntry))
+   {
+      free(psEntry);
+      psWalk->iStatus = MEMORY_ERROR;
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*
+  Starts *psWalk over the subtree whose key is the ulTopLength-byte
+  pcTop, stopping at the subtree pcStop (ulStopLength bytes) if it is
+  not NULL. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int DiskFT_startWalk(struct walk *psWalk, const char *pcTop,
+                            size_t ulTopLength, const char *pcStop,
+                            size_t ulStopLength)
+{
+   psWalk->pcTop = pcTop;
+   psWalk->ulTopLength = ulTopLength;
+   psWalk->pcStop = pcStop;
+   psWalk->ulStopLength = ulStopLength;
+   psWalk->oDEntries = DynArray_new(0);
+   if (psWalk->oDEntries == NULL)
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+/*
+  Replaces the entries of *psWalk by the next batch, starting at the
+  ulFromLength-byte key pcFrom. Returns SUCCESS, or MEMORY_ERROR or
+  the status of a pager failure.
+*/
+static int DiskFT_walk(DiskFT_T oDTree, struct walk *psWalk,
+                       const char *pcFrom, size_t ulFromLength)
+{
+   int iStatus;
+
+   DiskFT_clearWalk(psWalk);
+   psWalk->bStopped = FALSE;
+   psWalk->iStatus = SUCCESS;
+
+   iStatus = BTree_scan(oDTree->oBEntries, pcFrom, ulFromLength,
+                        DiskFT_collect, psWalk);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return psWalk->iStatus;
+}
+
+/* Frees the state of *psWalk. */
+static void DiskFT_endWalk(struct walk *psWalk)
+{
+   DiskFT_clearWalk(psWalk);
+   DynArray_free(psWalk->oDEntries);
+}
+
+/*
+  Sets *pulLongest to the length of the longest key in the subtree of
+  oDTree whose key is the ulTopLength-byte pcTop.
+*/
+static int DiskFT_longestKey(DiskFT_T oDTree, const char *pcTop,
+                             size_t ulTopLength, size_t *pulLongest)
+{
+   struct walk sWalk;
+   struct entry *psEntry;
+   char acFrom[MAX_KEY + 1];
+   size_t ulFromLength = ulTopLength;
+   size_t ulIndex;
+   int iStatus;
+
+   *pulLongest = 0;
+   iStatus = DiskFT_startWalk(&sWalk, pcTop, ulTopLength, NULL, 0);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   memcpy(acFrom, pcTop, ulTopLength);
+   for (;;)
+   {
+      iStatus = DiskFT_walk(oDTree, &sWalk, acFrom, ulFromLength);
+      if (iStatus != SUCCESS ||
+          DynArray_getLength(sWalk.oDEntries) == 0)
+         break;
+
+      for (ulIndex = 0; ulIndex < DynArray_getLength(sWalk.oDEntries);
+           ulIndex++)
+      {
+         psEntry = DynArray_get(sWalk.oDEntries, ulIndex);
+         if (psEntry->ulKeyLength > *pulLongest)
+            *pulLongest = psEntry->ulKeyLength;
+      }
+
+      /* the next batch starts just past the last key */
+      memcpy(acFrom, psEntry->acKey, psEntry->ulKeyLength);
+      acFrom[psEntry->ulKeyLength] = '\0';
+      ulFromLength = psEntry->ulKeyLength + 1;
+   }
+
+   DiskFT_endWalk(&sWalk);
+   return iStatus;
+}
+
+/*
+  Removes the subtree of oDTree whose key is the ulTopLength-byte
+  pcTop, releasing the stored bytes of its files.
+*/
+static int DiskFT_removeSubtree(DiskFT_T oDTree, const char *pcTop,
+                                size_t ulTopLength)
+{
+   struct walk sWalk;
+   struct entry *psEntry;
+   size_t ulIndex;
+   int iStatus;
+
+   iStatus = DiskFT_startWalk(&sWalk, pcTop, ulTopLength, NULL, 0);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* what is removed is gone, so each batch starts at the top again */
+   for (;;)
+   {
+      iStatus = DiskFT_walk(oDTree, &sWalk, pcTop, ulTopLength);
+      if (iStatus != SUCCESS ||
+          DynArray_getLength(sWalk.oDEntries) == 0)
+         break;
+
+      for (ulIndex = 0; ulIndex < DynArray_getLength(sWalk.oDEntries);
+           ulIndex++)
+      {
+         psEntry = DynArray_get(sWalk.oDEntries, ulIndex);
+         iStatus = BTree_remove(oDTree->oBEntries, psEntry->acKey,
+                                psEntry->ulKeyLength);
+         if (iStatus != SUCCESS)
+            break;
+         (void)DiskFT_releaseBlob(oDTree, psEntry->sRecord.ulBlob);
+      }
+      if (iStatus != SUCCESS)
+         break;
+   }
+
+   DiskFT_endWalk(&sWalk);
+   return iStatus;
+}
+
+/*
+  Moves the subtree of oDTree whose key is the ulOldLength-byte pcOld
+  to the ulNewLength-byte key pcNew, which is outside it, keeping the
+  stored bytes of its files where they are.
+*/
+static int DiskFT_moveSubtree(DiskFT_T oDTree, const char *pcOld,
+                              size_t ulOldLength, const char *pcNew,
+                              size_t ulNewLength)
+{
+   struct walk sWalk;
+   struct entry *psEntry;
+   char acKey[MAX_KEY];
+   size_t ulIndex;
+   int iStatus;
+
+   memcpy(acKey, pcNew, ulNewLength);
+   iStatus = DiskFT_startWalk(&sWalk, pcOld, ulOldLength, NULL, 0);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   for (;;)
+   {
+      iStatus = DiskFT_walk(oDTree, &sWalk, pcOld, ulOldLength);
+      if (iStatus != SUCCESS ||
+          DynArray_getLength(sWalk.oDEntries) == 0)
+         break;
+
+      for (ulIndex = 0; ulIndex < DynArray_getLength(sWalk.oDEntries);
+           ulIndex++)
+      {
+         psEntry = DynArray_get(sWalk.oDEntries, ulIndex);
+         memcpy(acKey + ulNewLength, psEntry->acKey + ulOldLength,
+                psEntry->ulKeyLength - ulOldLength);
+         iStatus = DiskFT_putRecord(oDTree, acKey, ulNewLength +
+                                    psEntry->ulKeyLength - ulOldLength,
+                                    &psEntry->sRecord);
+         if (iStatus == SUCCESS)
+            iStatus = BTree_remove(oDTree->oBEntries, psEntry->acKey,
+                                   psEntry->ulKeyLength);
+         if (iStatus != SUCCESS)
+            break;
+      }
+      if (iStatus != SUCCESS)
+         break;
+   }
+
+   DiskFT_endWalk(&sWalk);
+   return iStatus;
+}
+
+/*
+  Copies the subtree of oDTree whose key is the ulSrcLength-byte
+  pcSrc to the ulDstLength-byte key pcDst, which is not yet in
+  oDTree but may be inside the subtree. Copied files share the stored
+  bytes of the originals unless bCopyContents is TRUE. If the copy
+  fails, whatever was copied is removed.
+*/
+static int DiskFT_copySubtree(DiskFT_T oDTree, const char *pcSrc,
+                              size_t ulSrcLength, const char *pcDst,
+                              size_t ulDstLength, boolean bCopyContents)
+{
+   struct walk sWalk;
+   struct entry *psEntry = NULL;
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   char acFrom[MAX_KEY + 1];
+   size_t ulFromLength = ulSrcLength;
+   size_t ulIndex;
+   int iStatus;
+
+   memcpy(acKey, pcDst, ulDstLength);
+   memcpy(acFrom, pcSrc, ulSrcLength);
+   iStatus = DiskFT_startWalk(&sWalk, pcSrc, ulSrcLength, pcDst,
+                              ulDstLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   for (;;)
+   {
+      iStatus = DiskFT_walk(oDTree, &sWalk, acFrom, ulFromLength);
+      if (iStatus != SUCCESS ||
+          (DynArray_getLength(sWalk.oDEntries) == 0 && !sWalk.bStopped))
+         break;
+
+      for (ulIndex = 0; ulIndex < DynArray_getLength(sWalk.oDEntries);
+           ulIndex++)
+      {
+         psEntry = DynArray_get(sWalk.oDEntries, ulIndex);
+         sRecord = psEntry->sRecord;
+         if (bCopyContents)
+            iStatus = DiskFT_copyBlob(oDTree, psEntry->sRecord.ulBlob,
+                                      &sRecord.ulBlob);
+         else
+            iStatus = DiskFT_shareBlob(oDTree, sRecord.ulBlob);
+         if (iStatus != SUCCESS)
+            break;
+
+         memcpy(acKey + ulDstLength, psEntry->acKey + ulSrcLength,
+                psEntry->ulKeyLength - ulSrcLength);
+         iStatus = DiskFT_putRecord(oDTree, acKey, ulDstLength +
+                                    psEntry->ulKeyLength - ulSrcLength,
+                                    &sRecord);
+         if (iStatus != SUCCESS)
+         {
+            (void)DiskFT_releaseBlob(oDTree, sRecord.ulBlob);
+            break;
+         }
+      }
+      if (iStatus != SUCCESS)
+         break;
+
+      /* go on just past the last key, or past the copy if the batch
+         reached it */
+      if (sWalk.bStopped)
+      {
+         memcpy(acFrom, pcDst, ulDstLength);
+         acFrom[ulDstLength] = '\1';
+         ulFromLength = ulDstLength + 1;
+      }
+      else
+      {
+         memcpy(acFrom, psEntry->acKey, psEntry->ulKeyLength);
+         acFrom[psEntry->ulKeyLength] = '\0';
+         ulFromLength = psEntry->ulKeyLength + 1;
+      }
+   }
+
+   DiskFT_endWalk(&sWalk);
+   if (iStatus != SUCCESS)
+      (void)DiskFT_removeSubtree(oDTree, pcDst, ulDstLength);
+   return iStatus;
+}
+
+/*
+  Checks that the subtree of oDTree whose key is the ulOldLength-byte
+  pcOld would still have keys short enough with its top at a key of
+  ulNewLength bytes. Returns SUCCESS, BAD_PATH, or the status of a
+  walk failure.
+*/
+static int DiskFT_checkMove(DiskFT_T oDTree, const char *pcOld,
+                            size_t ulOldLength, size_t ulNewLength)
+{
+   size_t ulLongest;
+   int iStatus;
+
+   if (ulNewLength <= ulOldLength)
+      return SUCCESS;
+
+   iStatus = DiskFT_longestKey(oDTree, pcOld, ulOldLength, &ulLongest);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (ulLongest - ulOldLength + ulNewLength > MAX_KEY)
+      return BAD_PATH;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int DiskFT_new(const char *pcPageFile, size_t ulPoolPages,
+               DiskFT_T *poDResult)
+{
+   DiskFT_T oDTree;
+   int iStatus;
+
+   assert(poDResult != NULL);
+
+   *poDResult = NULL;
+   oDTree = calloc(1, sizeof(struct diskFT));
+   if (oDTree == NULL)
+      return MEMORY_ERROR;
+
+   oDTree->oDHandedOut = DynArray_new(0);
+   if (oDTree->oDHandedOut == NULL)
+   {
+      free(oDTree);
+      return MEMORY_ERROR;
+   }
+
+   iStatus = Pager_open(pcPageFile, ulPoolPages, &oDTree->oPPager);
+   if (iStatus == SUCCESS)
+   {
+      iStatus = BTree_new(oDTree->oPPager, &oDTree->oBEntries);
+      if (iStatus != SUCCESS)
+         Pager_close(oDTree->oPPager);
+   }
+   if (iStatus != SUCCESS)
+   {
+      DynArray_free(oDTree->oDHandedOut);
+      free(oDTree);
+      return iStatus;
+   }
+
+   *poDResult = oDTree;
+   return SUCCESS;
+}
+
+void DiskFT_free(DiskFT_T oDTree)
+{
+   assert(oDTree != NULL);
+
+   DiskFT_forget(oDTree);
+   DynArray_free(oDTree->oDHandedOut);
+   BTree_free(oDTree->oBEntries);
+   Pager_close(oDTree->oPPager);
+   free(oDTree->pcRoot);
+   free(oDTree);
+}
+
+int DiskFT_insert(DiskFT_T oDTree, const char *pcPath, boolean bIsFile,
+                  const void *pvContents, size_t ulLength)
+{
+   Path_T oPPath = NULL;
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth, ulFound, ulLevel;
+   size_t ulBlob = 0;
+   size_t ulAdded = 0;
+   boolean bFoundFile;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulDepth = Path_getDepth(oPPath);
+
+   iStatus = DiskFT_traverse(oDTree, oPPath, &ulFound, &bFoundFile);
+   if (iStatus == SUCCESS)
+   {
+      if (bFoundFile)
+         iStatus = NOT_A_DIRECTORY;
+      else if (ulFound == ulDepth)
+         iStatus = ALREADY_IN_TREE;
+      else if (bIsFile && ulDepth == 1)
+         iStatus = CONFLICTING_PATH;
+      else
+         iStatus = DiskFT_makeKey(oPPath, ulDepth, bIsFile, acKey,
+                                  &ulKeyLength);
+   }
+
+   if (iStatus != SUCCESS)
+   {
+      Path_free(oPPath);
+      return iStatus;
+   }
+
+   if (oDTree->pcRoot == NULL)
+   {
+      oDTree->pcRoot = malloc(strlen(Path_getComponent(oPPath, 0)) + 1);
+      if (oDTree->pcRoot == NULL)
+      {
+         Path_free(oPPath);
+         return MEMORY_ERROR;
+      }
+      strcpy(oDTree->pcRoot, Path_getComponent(oPPath, 0));
+   }
+
+   if (bIsFile && pvContents != NULL)
+      iStatus = DiskFT_newBlob(oDTree, DiskFT_fillFromBuffer,
+                               pvContents, ulLength, &ulBlob);
+
+   /* add the missing directories, then the new node itself */
+   for (ulLevel = ulFound + 1; iStatus == SUCCESS && ulLevel <= ulDepth;
+        ulLevel++)
+   {
+      (void)DiskFT_makeKey(oPPath, ulLevel, bIsFile && ulLevel == ulDepth,
+                           acKey, &ulKeyLength);
+      if (bIsFile && ulLevel == ulDepth)
+         DiskFT_setRecord(&sRecord, TRUE, ulLength, ulBlob);
+      else
+         DiskFT_setRecord(&sRecord, FALSE, 0, 0);
+      iStatus = DiskFT_putRecord(oDTree, acKey, ulKeyLength, &sRecord);
+      if (iStatus == SUCCESS)
+         ulAdded++;
+   }
+
+   if (iStatus != SUCCESS)
+   {
+      /* only a directory can have been added before a failure */
+      if (ulAdded > 0)
+      {
+         (void)DiskFT_makeKey(oPPath, ulFound + 1, FALSE, acKey,
+                              &ulKeyLength);
+         (void)DiskFT_removeSubtree(oDTree, acKey, ulKeyLength);
+      }
+      (void)DiskFT_releaseBlob(oDTree, ulBlob);
+      if (ulFound == 0)
+      {
+         free(oDTree->pcRoot);
+         oDTree->pcRoot = NULL;
+      }
+   }
+
+   Path_free(oPPath);
+   return iStatus;
+}
+
+int DiskFT_remove(DiskFT_T oDTree, const char *pcPath, boolean bIsFile)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (sRecord.bIsFile && !bIsFile)
+      return NOT_A_DIRECTORY;
+   if (!sRecord.bIsFile && bIsFile)
+      return NOT_A_FILE;
+
+   iStatus = DiskFT_removeSubtree(oDTree, acKey, ulKeyLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (ulDepth == 1)
+   {
+      free(oDTree->pcRoot);
+      oDTree->pcRoot = NULL;
+   }
+   return SUCCESS;
+}
+
+int DiskFT_stat(DiskFT_T oDTree, const char *pcPath, boolean *pbIsFile,
+                size_t *pulSize)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   *pbIsFile = sRecord.bIsFile;
+   if (sRecord.bIsFile)
+      *pulSize = sRecord.ulLength;
+   return SUCCESS;
+}
+
+int DiskFT_getContents(DiskFT_T oDTree, const char *pcPath,
+                       void **ppvContents)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+   assert(ppvContents != NULL);
+
+   *ppvContents = NULL;
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!sRecord.bIsFile)
+      return NOT_A_FILE;
+
+   *ppvContents = DiskFT_handOut(oDTree, &sRecord);
+   if (*ppvContents == NULL && sRecord.ulBlob != 0)
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+int DiskFT_replaceContents(DiskFT_T oDTree, const char *pcPath,
+                           const void *pvContents, size_t ulLength,
+                           void **ppvOld)
+{
+   struct record sRecord;
+   struct record sNew;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   size_t ulBlob = 0;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+   assert(ppvOld != NULL);
+
+   DiskFT_forget(oDTree);
+
+   *ppvOld = NULL;
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!sRecord.bIsFile)
+      return NOT_A_FILE;
+
+   *ppvOld = DiskFT_handOut(oDTree, &sRecord);
+   if (*ppvOld == NULL && sRecord.ulBlob != 0)
+      return MEMORY_ERROR;
+
+   if (pvContents != NULL)
+   {
+      iStatus = DiskFT_newBlob(oDTree, DiskFT_fillFromBuffer, pvContents,
+                               ulLength, &ulBlob);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   DiskFT_setRecord(&sNew, TRUE, ulLength, ulBlob);
+   iStatus = DiskFT_putRecord(oDTree, acKey, ulKeyLength, &sNew);
+   if (iStatus != SUCCESS)
+   {
+      (void)DiskFT_releaseBlob(oDTree, ulBlob);
+      return iStatus;
+   }
+
+   (void)DiskFT_releaseBlob(oDTree, sRecord.ulBlob);
+   return SUCCESS;
+}
+
+int DiskFT_readFile(DiskFT_T oDTree, const char *pcPath,
+                    size_t ulOffset, void *pvBuf, size_t ulLength,
+                    size_t *pulRead)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+   assert(pulRead != NULL);
+
+   *pulRead = 0;
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!sRecord.bIsFile)
+      return NOT_A_FILE;
+
+   if (ulOffset >= sRecord.ulLength)
+      return SUCCESS;
+   if (ulLength > sRecord.ulLength - ulOffset)
+      ulLength = sRecord.ulLength - ulOffset;
+
+   iStatus = DiskFT_readBlob(oDTree, sRecord.ulBlob, ulOffset, pvBuf,
+                             ulLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   *pulRead = ulLength;
+   return SUCCESS;
+}
+
+int DiskFT_writeFile(DiskFT_T oDTree, const char *pcPath,
+                     size_t ulOffset, const void *pvBuf,
+                     size_t ulLength, boolean bAppend)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   size_t ulBlob;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!sRecord.bIsFile)
+      return NOT_A_FILE;
+
+   if (bAppend)
+      ulOffset = sRecord.ulLength;
+   if (ulOffset + ulLength < ulOffset)
+      return MEMORY_ERROR;
+
+   ulBlob = sRecord.ulBlob;
+   if (ulLength > 0)
+   {
+      iStatus = DiskFT_writeBlob(oDTree, &ulBlob, ulOffset, pvBuf,
+                                 ulLength);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   /* as in memory, an empty write never grows the file */
+   if (ulLength > 0 && ulOffset + ulLength > sRecord.ulLength)
+      sRecord.ulLength = ulOffset + ulLength;
+   sRecord.ulBlob = ulBlob;
+   return DiskFT_putRecord(oDTree, acKey, ulKeyLength, &sRecord);
+}
+
+int DiskFT_truncateFile(DiskFT_T oDTree, const char *pcPath,
+                        size_t ulLength)
+{
+   struct record sRecord;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength, &sRecord,
+                         &ulDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!sRecord.bIsFile)
+      return NOT_A_FILE;
+
+   /* growing needs no stored bytes, since bytes past them are zeros */
+   if (ulLength == 0)
+   {
+      iStatus = DiskFT_releaseBlob(oDTree, sRecord.ulBlob);
+      sRecord.ulBlob = 0;
+   }
+   else if (sRecord.ulBlob != 0 && ulLength < sRecord.ulLength)
+      iStatus = DiskFT_shrinkBlob(oDTree, &sRecord.ulBlob, ulLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   sRecord.ulLength = ulLength;
+   return DiskFT_putRecord(oDTree, acKey, ulKeyLength, &sRecord);
+}
+
+int DiskFT_rename(DiskFT_T oDTree, const char *pcOldPath,
+                  const char *pcNewPath)
+{
+   Path_T oPNewPath = NULL;
+   struct record sRecord;
+   char acOldKey[MAX_KEY];
+   char acNewKey[MAX_KEY];
+   size_t ulOldLength, ulNewLength;
+   size_t ulOldDepth, ulNewDepth;
+   char *pcNewRoot = NULL;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcOldPath != NULL);
+   assert(pcNewPath != NULL);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = DiskFT_find(oDTree, pcOldPath, acOldKey, &ulOldLength,
+                         &sRecord, &ulOldDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Path_new(pcNewPath, &oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulNewDepth = Path_getDepth(oPNewPath);
+
+   if (ulOldDepth == 1)
+   {
+      /* renaming the root in place: the new path must be a new root */
+      if (ulNewDepth != 1)
+         iStatus = CONFLICTING_PATH;
+      else if (!strcmp(oDTree->pcRoot, pcNewPath))
+         iStatus = ALREADY_IN_TREE;
+      else
+      {
+         pcNewRoot = malloc(strlen(pcNewPath) + 1);
+         if (pcNewRoot == NULL)
+            iStatus = MEMORY_ERROR;
+         else
+            strcpy(pcNewRoot, pcNewPath);
+      }
+   }
+   else
+   {
+      iStatus = DiskFT_checkChild(oDTree, oPNewPath);
+   }
+
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_makeKey(oPNewPath, ulNewDepth, sRecord.bIsFile,
+                               acNewKey, &ulNewLength);
+   /* a directory cannot move underneath itself */
+   if (iStatus == SUCCESS &&
+       DiskFT_inSubtree(acNewKey, ulNewLength, acOldKey, ulOldLength))
+      iStatus = CONFLICTING_PATH;
+   Path_free(oPNewPath);
+
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_checkMove(oDTree, acOldKey, ulOldLength,
+                                 ulNewLength);
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_moveSubtree(oDTree, acOldKey, ulOldLength,
+                                   acNewKey, ulNewLength);
+   if (iStatus != SUCCESS)
+   {
+      free(pcNewRoot);
+      return iStatus;
+   }
+
+   if (pcNewRoot != NULL)
+   {
+      free(oDTree->pcRoot);
+      oDTree->pcRoot = pcNewRoot;
+   }
+   return SUCCESS;
+}
+
+int DiskFT_copy(DiskFT_T oDTree, const char *pcSrcPath,
+                const char *pcDstPath, boolean bCopyContents)
+{
+   Path_T oPDstPath = NULL;
+   struct record sRecord;
+   char acSrcKey[MAX_KEY];
+   char acDstKey[MAX_KEY];
+   size_t ulSrcLength, ulDstLength;
+   size_t ulSrcDepth;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcSrcPath != NULL);
+   assert(pcDstPath != NULL);
+
+   DiskFT_forget(oDTree);
+
+   iStatus = DiskFT_find(oDTree, pcSrcPath, acSrcKey, &ulSrcLength,
+                         &sRecord, &ulSrcDepth);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Path_new(pcDstPath, &oPDstPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = DiskFT_checkChild(oDTree, oPDstPath);
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_makeKey(oPDstPath, Path_getDepth(oPDstPath),
+                               sRecord.bIsFile, acDstKey, &ulDstLength);
+   Path_free(oPDstPath);
+
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_checkMove(oDTree, acSrcKey, ulSrcLength,
+                                 ulDstLength);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   return DiskFT_copySubtree(oDTree, acSrcKey, ulSrcLength, acDstKey,
+                             ulDstLength, bCopyContents);
+}
+
+int DiskFT_checkNewDir(DiskFT_T oDTree, const char *pcPath)
+{
+   Path_T oPPath = NULL;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(pcPath != NULL);
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* in an empty tree, this only lets a depth-1 path through */
+   iStatus = DiskFT_checkChild(oDTree, oPPath);
+   Path_free(oPPath);
+   return iStatus;
+}
+
+/*
+  Adds the children of the in-memory directory oNDir, with their
+  subtrees, below the directory of oDTree whose key is the
+  ulKeyLength-byte pcKey, in which there is room for MAX_KEY bytes.
+  If bNew is FALSE, that directory was already in oDTree: children
+  that are directories there too are merged, and other children
+  already there are an error. If bApply is FALSE, nothing is added,
+  and only the errors are looked for; otherwise the key of each child
+  added to a directory that was already there is recorded in oDAdded.
+  Returns SUCCESS, BAD_PATH, NOT_A_DIRECTORY, ALREADY_IN_TREE,
+  MEMORY_ERROR or the status of a pager failure.
+*/
+static int DiskFT_storeChildren(DiskFT_T oDTree, Node_T oNDir,
+                                char *pcKey, size_t ulKeyLength,
+                                boolean bNew, boolean bApply,
+                                DynArray_T oDAdded)
+{
+   Node_T oNChild = NULL;
+   struct record sRecord;
+   struct entry *psEntry;
+   size_t ulChild;
+   size_t ulChildLength;
+   size_t ulBlob;
+   boolean bIsFile, bChildNew;
+   int iStatus;
+
+   for (ulChild = 0; ulChild < Node_getNumChildren(oNDir); ulChild++)
+   {
+      iStatus = Node_getChild(oNDir, ulChild, &oNChild);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      bIsFile = Node_isFile(oNChild);
+
+      ulChildLength = ulKeyLength;
+      iStatus = DiskFT_appendKey(pcKey, &ulChildLength,
+                                 Node_getName(oNChild), FALSE);
+      if (iStatus != SUCCESS)
+         return iStatus;
+
+      /* look for the child as a directory, then as a file */
+      bChildNew = bNew;
+      if (!bNew)
+      {
+         iStatus = DiskFT_getRecord(oDTree, pcKey, ulChildLength,
+                                    &sRecord);
+         if (iStatus == NO_SUCH_PATH)
+         {
+            pcKey[ulKeyLength + 1] = KEY_FILE;
+            iStatus = DiskFT_getRecord(oDTree, pcKey, ulChildLength,
+                                       &sRecord);
+            pcKey[ulKeyLength + 1] = KEY_DIR;
+         }
+         if (iStatus == SUCCESS)
+         {
+            if (bIsFile)
+               return ALREADY_IN_TREE;
+            if (sRecord.bIsFile)
+               return NOT_A_DIRECTORY;
+         }
+         else if (iStatus == NO_SUCH_PATH)
+            bChildNew = TRUE;
+         else
+            return iStatus;
+      }
+      if (bIsFile)
+         pcKey[ulKeyLength + 1] = KEY_FILE;
+
+      if (bApply && bChildNew)
+      {
+         ulBlob = 0;
+         if (bIsFile)
+         {
+            iStatus = DiskFT_newBlob(oDTree, DiskFT_fillFromNode,
+                                     oNChild, Node_getFileSize(oNChild),
+                                     &ulBlob);
+            if (iStatus != SUCCESS)
+               return iStatus;
+         }
+         DiskFT_setRecord(&sRecord, bIsFile,
+                          bIsFile ? Node_getFileSize(oNChild) : 0,
+                          ulBlob);
+         iStatus = DiskFT_putRecord(oDTree, pcKey, ulChildLength,
+                                    &sRecord);
+         if (iStatus != SUCCESS)
+         {
+            (void)DiskFT_releaseBlob(oDTree, ulBlob);
+            return iStatus;
+         }
+
+         if (!bNew)
+         {
+            psEntry = malloc(sizeof(struct entry) + ulChildLength);
+            if (psEntry == NULL)
+               return MEMORY_ERROR;
+            psEntry->sRecord = sRecord;
+            psEntry->ulKeyLength = ulChildLength;
+            memcpy(psEntry->acKey, pcKey, ulChildLength);
+            if (!DynArray_add(oDAdded, psEntry))
+            {
+               free(psEntry);
+               return MEMORY_ERROR;
+            }
+         }
+      }
+
+      if (!bIsFile)
+      {
+         iStatus = DiskFT_storeChildren(oDTree, oNChild, pcKey,
+                                        ulChildLength, bChildNew, bApply,
+                                        oDAdded);
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+   }
+   return SUCCESS;
+}
+
+int DiskFT_storeTree(DiskFT_T oDTree, const char *pcPath,
+                     Node_T oNTop)
+{
+   Path_T oPPath = NULL;
+   DynArray_T oDAdded;
+   struct entry *psEntry;
+   char acKey[MAX_KEY];
+   size_t ulKeyLength = 0;
+   size_t ulIndex;
+   const char *pcRoot;
+   boolean bTopNew;
+   boolean bNewRoot;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(oNTop != NULL);
+
+   DiskFT_forget(oDTree);
+   bNewRoot = oDTree->pcRoot == NULL;
+
+   if (pcPath != NULL)
+   {
+      /* oNTop is a new directory, so all below it is new too */
+      iStatus = Path_new(pcPath, &oPPath);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      iStatus = DiskFT_checkChild(oDTree, oPPath);
+      if (iStatus == SUCCESS)
+         iStatus = DiskFT_makeKey(oPPath, Path_getDepth(oPPath), FALSE,
+                                  acKey, &ulKeyLength);
+      Path_free(oPPath);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      pcRoot = pcPath;
+      bTopNew = TRUE;
+   }
+   else
+   {
+      /* oNTop is a root to merge with the root of oDTree */
+      pcRoot = Node_getName(oNTop);
+      if (oDTree->pcRoot != NULL && strcmp(oDTree->pcRoot, pcRoot))
+         return CONFLICTING_PATH;
+      iStatus = DiskFT_appendKey(acKey, &ulKeyLength, pcRoot, FALSE);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      bTopNew = oDTree->pcRoot == NULL;
+   }
+
+   /* find any error before anything is added */
+   iStatus = DiskFT_storeChildren(oDTree, oNTop, acKey, ulKeyLength,
+                                  bTopNew, FALSE, NULL);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   oDAdded = DynArray_new(0);
+   if (oDAdded == NULL)
+      return MEMORY_ERROR;
+
+   if (bNewRoot)
+   {
+      oDTree->pcRoot = malloc(strlen(pcRoot) + 1);
+      if (oDTree->pcRoot == NULL)
+      {
+         DynArray_free(oDAdded);
+         return MEMORY_ERROR;
+      }
+      strcpy(oDTree->pcRoot, pcRoot);
+   }
+
+   if (bTopNew)
+   {
+      psEntry = malloc(sizeof(struct entry) + ulKeyLength);
+      if (psEntry == NULL)
+         iStatus = MEMORY_ERROR;
+      else
+      {
+         DiskFT_setRecord(&psEntry->sRecord, FALSE, 0, 0);
+         psEntry->ulKeyLength = ulKeyLength;
+         memcpy(psEntry->acKey, acKey, ulKeyLength);
+         if (!DynArray_add(oDAdded, psEntry))
+         {
+            free(psEntry);
+            iStatus = MEMORY_ERROR;
+         }
+         else
+            iStatus = DiskFT_putRecord(oDTree, acKey, ulKeyLength,
+                                       &psEntry->sRecord);
+      }
+   }
+
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_storeChildren(oDTree, oNTop, acKey, ulKeyLength,
+                                     bTopNew, TRUE, oDAdded);
+
+   /* on failure, take back each new subtree */
+   for (ulIndex = DynArray_getLength(oDAdded); ulIndex > 0; ulIndex--)
+   {
+      psEntry = DynArray_get(oDAdded, ulIndex - 1);
+      if (iStatus != SUCCESS)
+         (void)DiskFT_removeSubtree(oDTree, psEntry->acKey,
+                                    psEntry->ulKeyLength);
+      free(psEntry);
+   }
+   DynArray_free(oDAdded);
+
+   if (iStatus != SUCCESS && bNewRoot)
+   {
+      free(oDTree->pcRoot);
+      oDTree->pcRoot = NULL;
+   }
+   return iStatus;
+}
+
+/*
+  Gives the new file oNFile of an in-memory copy the contents of the
+  file of oDTree with record *psRecord.
+*/
+static int DiskFT_loadContents(DiskFT_T oDTree, Node_T oNFile,
+                               const struct record *psRecord)
+{
+   Contents_T oCContents;
+   void *pvBytes;
+   int iStatus;
+
+   if (psRecord->ulBlob == 0)
+      return Node_truncateFile(oNFile, psRecord->ulLength);
+
+   pvBytes = malloc(psRecord->ulLength);
+   if (pvBytes == NULL)
+      return MEMORY_ERROR;
+   iStatus = DiskFT_readBlob(oDTree, psRecord->ulBlob, 0, pvBytes,
+                             psRecord->ulLength);
+   if (iStatus != SUCCESS)
+   {
+      free(pvBytes);
+      return iStatus;
+   }
+
+   oCContents = Contents_new(pvBytes, psRecord->ulLength);
+   free(pvBytes);
+   if (oCContents == NULL)
+      return MEMORY_ERROR;
+   Node_adoptContents(oNFile, oCContents);
+   return SUCCESS;
+}
+
+/*
+  Adds the node of oDTree with the entry *psEntry to the in-memory
+  copy whose directories along the way down are in oDPath, in which
+  the subtree being copied has a top key of ulTopLength bytes.
+*/
+static int DiskFT_loadEntry(DiskFT_T oDTree, const struct entry *psEntry,
+                            size_t ulTopLength, DynArray_T oDPath)
+{
+   Node_T oNNode = NULL;
+   char acName[MAX_KEY];
+   size_t ulLevel = 0;
+   size_t ulName;
+   size_t ulIndex;
+   int iStatus;
+
+   for (ulIndex = ulTopLength; ulIndex < psEntry->ulKeyLength; ulIndex++)
+      if (psEntry->acKey[ulIndex] == '\0')
+         ulLevel++;
+
+   /* entries come in order, so the parent is the deepest one left */
+   if (DynArray_getLength(oDPath) > ulLevel)
+      DynArray_removeRange(oDPath, ulLevel,
+                           DynArray_getLength(oDPath) - ulLevel, NULL);
+
+   ulName = DiskFT_lastComponent(psEntry->acKey, psEntry->ulKeyLength);
+   memcpy(acName, psEntry->acKey + ulName + 1,
+          psEntry->ulKeyLength - ulName - 1);
+   acName[psEntry->ulKeyLength - ulName - 1] = '\0';
+
+   iStatus = Node_newChild(DynArray_get(oDPath, ulLevel - 1), acName,
+                           psEntry->sRecord.bIsFile, &oNNode);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (psEntry->sRecord.bIsFile)
+      return DiskFT_loadContents(oDTree, oNNode, &psEntry->sRecord);
+   if (!DynArray_add(oDPath, oNNode))
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+int DiskFT_loadTree(DiskFT_T oDTree, const char *pcPath,
+                    Node_T *poNTop)
+{
+   struct walk sWalk;
+   struct entry *psEntry;
+   struct record sRecord;
+   DynArray_T oDPath;
+   Node_T oNTop = NULL;
+   char acKey[MAX_KEY];
+   char acName[MAX_KEY];
+   char acFrom[MAX_KEY + 1];
+   size_t ulKeyLength = 0;
+   size_t ulFromLength;
+   size_t ulDepth;
+   size_t ulName;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(oDTree != NULL);
+   assert(poNTop != NULL);
+
+   *poNTop = NULL;
+   if (pcPath == NULL)
+   {
+      if (oDTree->pcRoot == NULL)
+         return SUCCESS;
+      iStatus = DiskFT_appendKey(acKey, &ulKeyLength, oDTree->pcRoot,
+                                 FALSE);
+   }
+   else
+   {
+      iStatus = DiskFT_find(oDTree, pcPath, acKey, &ulKeyLength,
+                            &sRecord, &ulDepth);
+      if (iStatus == SUCCESS && sRecord.bIsFile)
+         iStatus = NOT_A_DIRECTORY;
+   }
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   ulName = DiskFT_lastComponent(acKey, ulKeyLength);
+   memcpy(acName, acKey + ulName + 1, ulKeyLength - ulName - 1);
+   acName[ulKeyLength - ulName - 1] = '\0';
+   iStatus = Node_new(acName, NULL, NULL, 0, FALSE, &oNTop);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   oDPath = DynArray_new(0);
+   if (oDPath == NULL || !DynArray_add(oDPath, oNTop) ||
+       DiskFT_startWalk(&sWalk, acKey, ulKeyLength, NULL, 0) != SUCCESS)
+   {
+      if (oDPath != NULL)
+         DynArray_free(oDPath);
+      (void)Node_free(oNTop);
+      return MEMORY_ERROR;
+   }
+
+   /* the first batch starts just past the top itself */
+   memcpy(acFrom, acKey, ulKeyLength);
+   acFrom[ulKeyLength] = '\0';
+   ulFromLength = ulKeyLength + 1;
+   for (;;)
+   {
+      iStatus = DiskFT_walk(oDTree, &sWalk, acFrom, ulFromLength);
+      if (iStatus != SUCCESS ||
+          DynArray_getLength(sWalk.oDEntries) == 0)
+         break;
+
+      for (ulIndex = 0; ulIndex < DynArray_getLength(sWalk.oDEntries);
+           ulIndex++)
+      {
+         psEntry = DynArray_get(sWalk.oDEntries, ulIndex);
+         iStatus = DiskFT_loadEntry(oDTree, psEntry, ulKeyLength,
+                                    oDPath);
+         if (iStatus != SUCCESS)
+            break;
+      }
+      if (iStatus != SUCCESS)
+         break;
+
+      memcpy(acFrom, psEntry->acKey, psEntry->ulKeyLength);
+      acFrom[psEntry->ulKeyLength] = '\0';
+      ulFromLength = psEntry->ulKeyLength + 1;
+   }
+
+   DiskFT_endWalk(&sWalk);
+   DynArray_free(oDPath);
+   if (iStatus != SUCCESS)
+   {
+      (void)Node_free(oNTop);
+      return iStatus;
+   }
+
+   *poNTop = oNTop;
+   return SUCCESS;
+}
+
+void DiskFT_getStats(DiskFT_T oDTree, size_t *pulLogicalBytes,
+                     size_t *pulStoredBytes)
+{
+   assert(oDTree != NULL);
+   assert(pulLogicalBytes != NULL);
+   assert(pulStoredBytes != NULL);
+
+   *pulLogicalBytes = oDTree->ulLogicalBytes;
+   *pulStoredBytes = oDTree->ulStoredBytes;
+}
+
+void DiskFT_getPoolStats(DiskFT_T oDTree, size_t *pulHits,
+                         size_t *pulMisses, size_t *pulWrites)
+{
+   assert(oDTree != NULL);
+
+   Pager_getStats(oDTree->oPPager, pulHits, pulMisses, pulWrites);
+}
+
+/* A string of paths being built from keys */
+struct listing
+{
+   /* the string so far */
+   char *pcText;
+   /* the number of characters in it */
+   size_t ulLength;
+   /* the number of bytes allocated for it */
+   size_t ulSize;
+   /* TRUE if memory ran out */
+   boolean bFailed;
+};
+
+/*
+  Appends the path of the ulKeyLength-byte key pvKey and a newline to
+  the struct listing pvExtra. Returns FALSE if memory runs out.
+*/
+static boolean DiskFT_listPath(const void *pvKey, size_t ulKeyLength,
+                               const void *pvValue, size_t ulValueLength,
+                               void *pvExtra)
+{
+   struct listing *psListing = pvExtra;
+   const char *pcKey = pvKey;
+   char *pcText;
+   size_t ulIndex;
+
+   assert(pvValue != NULL);
+   assert(ulValueLength == sizeof(struct record));
+
+   /* the path is shorter than the key, having no type bytes */
+   if (psListing->ulLength + ulKeyLength + 2 > psListing->ulSize)
+   {
+      pcText = realloc(psListing->pcText, 2 * psListing->ulSize +
+                       ulKeyLength + 2);
+      if (pcText == NULL)
+      {
+         psListing->bFailed = TRUE;
+         return FALSE;
+      }
+      psListing->pcText = pcText;
+      psListing->ulSize = 2 * psListing->ulSize + ulKeyLength + 2;
+   }
+
+   for (ulIndex = 0; ulIndex < ulKeyLength; ulIndex++)
+   {
+      if (ulIndex == 0 || pcKey[ulIndex - 1] == '\0')
+         continue;
+      psListing->pcText[psListing->ulLength++] =
+         pcKey[ulIndex] == '\0' ? '/' : pcKey[ulIndex];
+   }
+   psListing->pcText[psListing->ulLength++] = '\n';
+   return TRUE;
+}
+
+char *DiskFT_toString(DiskFT_T oDTree)
+{
+   struct listing sListing;
+
+   assert(oDTree != NULL);
+
+   sListing.pcText = malloc(1);
+   if (sListing.pcText == NULL)
+      return NULL;
+   sListing.ulLength = 0;
+   sListing.ulSize = 1;
+   sListing.bFailed = FALSE;
+
+   if (BTree_scan(oDTree->oBEntries, "", 0, DiskFT_listPath,
+                  &sListing) != SUCCESS || sListing.bFailed)
+   {
+      free(sListing.pcText);
+      return NULL;
+   }
+
+   sListing.pcText[sListing.ulLength] = '\0';
+   return sListing.pcText;
+}
@@ -0,0 +1,151 @@
+/*--------------------------------------------------------------------*/
+/* diskFT.h                                                           */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef DISKFT_INCLUDED
+#define DISKFT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  An on-disk FT holds a hierarchy of directories and files in a
+  B+tree in a page file, rather than in nodes in memory. Each node is
+  one entry, keyed by its full path encoded so that keys sort in the
+  order of FT_toString: every subtree is one contiguous range of keys.
+  Only the pages in the pager's buffer pool are in memory; file
+  contents are kept in chains of pages of their own.
+  Unless noted, each function below takes the same paths and returns
+  the same statuses as the FT function of the same name, and also
+  returns BAD_PATH if a path is too long to be a key (about 900
+  bytes), and IO_ERROR if the page file could not be read or written.
+*/
+typedef struct diskFT *DiskFT_T;
+
+/*
+  Creates an empty on-disk FT whose page file is pcPageFile, or a new
+  file in the temporary directory if pcPageFile is NULL, with a buffer
+  pool of ulPoolPages pages, as for Pager_open.
+  Returns SUCCESS and sets *poDResult, or sets it to NULL and returns
+  IO_ERROR or MEMORY_ERROR.
+*/
+int DiskFT_new(const char *pcPageFile, size_t ulPoolPages,
+               DiskFT_T *poDResult);
+
+/* Frees oDTree and discards its page file. */
+void DiskFT_free(DiskFT_T oDTree);
+
+/*
+  Inserts a directory (if bIsFile is FALSE) or a file with a copy of
+  the ulLength bytes at pvContents (bytes reading as zeros if
+  pvContents is NULL) at pcPath, creating missing ancestors, as for
+  FT_insertDir and FT_insertFile.
+*/
+int DiskFT_insert(DiskFT_T oDTree, const char *pcPath, boolean bIsFile,
+                  const void *pvContents, size_t ulLength);
+
+/*
+  Removes the directory (if bIsFile is FALSE) or file at pcPath, as
+  for FT_rmDir and FT_rmFile.
+*/
+int DiskFT_remove(DiskFT_T oDTree, const char *pcPath, boolean bIsFile);
+
+/* As for FT_stat. */
+int DiskFT_stat(DiskFT_T oDTree, const char *pcPath, boolean *pbIsFile,
+                size_t *pulSize);
+
+/*
+  Sets *ppvContents to a copy of the contents of the file at pcPath,
+  or to NULL if the file has none. The copy belongs to oDTree and is
+  valid until the next change to it.
+*/
+int DiskFT_getContents(DiskFT_T oDTree, const char *pcPath,
+                       void **ppvContents);
+
+/*
+  Replaces the contents of the file at pcPath with a copy of the
+  ulLength bytes at pvContents, and sets *ppvOld to a copy of the old
+  contents as for DiskFT_getContents.
+*/
+int DiskFT_replaceContents(DiskFT_T oDTree, const char *pcPath,
+                           const void *pvContents, size_t ulLength,
+                           void **ppvOld);
+
+/* As for FT_readFile. */
+int DiskFT_readFile(DiskFT_T oDTree, const char *pcPath,
+                    size_t ulOffset, void *pvBuf, size_t ulLength,
+                    size_t *pulRead);
+
+/*
+  As for FT_writeFile, or for FT_appendFile if bAppend is TRUE, in
+  which case ulOffset is ignored.
+*/
+int DiskFT_writeFile(DiskFT_T oDTree, const char *pcPath,
+                     size_t ulOffset, const void *pvBuf,
+                     size_t ulLength, boolean bAppend);
+
+/* As for FT_truncateFile. */
+int DiskFT_truncateFile(DiskFT_T oDTree, const char *pcPath,
+                        size_t ulLength);
+
+/*
+  As for FT_rename, except that each entry of the subtree is moved to
+  its new key, so the cost grows with the size of the subtree.
+*/
+int DiskFT_rename(DiskFT_T oDTree, const char *pcOldPath,
+                  const char *pcNewPath);
+
+/*
+  As for FT_copy. If bCopyContents is FALSE, copied files share their
+  stored contents with the originals until either is changed.
+*/
+int DiskFT_copy(DiskFT_T oDTree, const char *pcSrcPath,
+                const char *pcDstPath, boolean bCopyContents);
+
+/*
+  Returns SUCCESS if pcPath could be added to oDTree as a new
+  directory, and otherwise the status FT_importDir would return.
+*/
+int DiskFT_checkNewDir(DiskFT_T oDTree, const char *pcPath);
+
+/*
+  Stores the in-memory subtree oNTop in oDTree. If pcPath is not NULL,
+  oNTop becomes the new directory pcPath, as for FT_importDir. If it
+  is NULL, oNTop is a root whose directories and files are merged
+  into oDTree, as for FT_importTar. oNTop is left as it was; its
+  contents are copied.
+*/
+int DiskFT_storeTree(DiskFT_T oDTree, const char *pcPath,
+                     Node_T oNTop);
+
+/*
+  Builds a copy in memory of the directory pcPath of oDTree and its
+  subtree, or of the whole of oDTree if pcPath is NULL, and sets
+  *poNTop to its top node, named as pcPath's last component (or NULL
+  if pcPath is NULL and oDTree is empty). The caller frees the copy
+  with Node_free.
+  Returns the same statuses as FT_exportDir for pcPath.
+*/
+int DiskFT_loadTree(DiskFT_T oDTree, const char *pcPath,
+                    Node_T *poNTop);
+
+/*
+  Sets *pulLogicalBytes to the bytes the stored contents would take if
+  every file had its own, and *pulStoredBytes to the bytes stored.
+*/
+void DiskFT_getStats(DiskFT_T oDTree, size_t *pulLogicalBytes,
+                     size_t *pulStoredBytes);
+
+/* Reports on oDTree's buffer pool as for Pager_getStats. */
+void DiskFT_getPoolStats(DiskFT_T oDTree, size_t *pulHits,
+                         size_t *pulMisses, size_t *pulWrites);
+
+/*
+  Returns a string of the paths in oDTree as for FT_toString, or NULL
+  if memory or the page file fails. The caller owns the string.
+*/
+char *DiskFT_toString(DiskFT_T oDTree);
+
+#endif
@@ -10,12 +10,17 @@
 
 #include "ft.h"
 #include "nodeFT.h"
+#include "contents.h"
+#include "hostfs.h"
+#include "tar.h"
+#include "diskFT.h"
+#include "ring.h"
 #include "path.h"
 #include "dynarray.h"
 
 /*
   A File Tree is a representation of a hierarchy of directories
-  and files, represented as an AO with 3 state variables:
+  and files, represented as an AO with these state variables:
 */
 
 /* 1. a flag for being in an initialized state (TRUE) or not (FALSE) */
@@ -24,6 +29,26 @@ static boolean bIsInitialized;
 static Node_T oNRoot;
 /* 3. a counter of the number of nodes in the hierarchy */
 static size_t ulCount;
+/* 4. the on-disk store holding the hierarchy instead of nodes, or
+      NULL if the hierarchy is in memory */
+static DiskFT_T oDTree;
+/* 5. the watches set up by FT_watch, or NULL if there are none, and
+      the identifier of the next */
+static DynArray_T oDWatches;
+static size_t ulNextWatch = 1;
+/* 6. the events waiting to be dispatched, or NULL if there never was
+      a watch, and the number of events lost since the last dispatch */
+static Ring_T oREvents;
+static size_t ulLostEvents;
+/* 7. TRUE while a transaction is open (see FT_begin), its stamp, its
+      undo log of ulUndoLength entries with room for ulUndoSize, and
+      the events it holds back until FT_commit */
+static boolean bInTransaction;
+static size_t ulTransaction;
+static struct undo *psUndoLog;
+static size_t ulUndoLength;
+static size_t ulUndoSize;
+static DynArray_T oDHeldEvents;
 
 /* --------------------------------------------------------------------
 
@@ -36,16 +61,19 @@ static size_t ulCount;
 /*
   Traverses the FT starting at the root as far as possible towards
   absolute path oPPath. If able to traverse, returns an int SUCCESS
-  status and sets *poNFurthest to the furthest node reached (which may
-  be only a prefix of oPPath, or even NULL if the root is NULL).
+  status, sets *poNFurthest to the furthest node reached (which may
+  be only a prefix of oPPath, or even NULL if the root is NULL), and
+  sets *pulDepth to the depth of that node (0 if it is NULL).
   Otherwise, sets *poNFurthest to NULL and returns with status:
   * CONFLICTING_PATH if the root's path is not a prefix of oPPath
-  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  Children are matched by name one component at a time, so no node's
+  full path is needed along the way.
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest)
+static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest,
+                           size_t *pulDepth)
 {
    int iStatus;
-   Path_T oPPrefix = NULL;
    Node_T oNCurr;
    Node_T oNChild = NULL;
    size_t ulDepth;
@@ -54,6 +82,9 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest)
 
    assert(oPPath != NULL);
    assert(poNFurthest != NULL);
+   assert(pulDepth != NULL);
+
+   *pulDepth = 0;
 
    /* root is NULL -> won't find anything */
    if (oNRoot == NULL)
@@ -62,37 +93,20 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest)
       return SUCCESS;
    }
 
-   iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-   if (iStatus != SUCCESS)
-   {
-      *poNFurthest = NULL;
-      return iStatus;
-   }
-
-   if (Path_comparePath(Node_getPath(oNRoot), oPPrefix))
+   if (strcmp(Node_getName(oNRoot), Path_getComponent(oPPath, 0)))
    {
-      Path_free(oPPrefix);
       *poNFurthest = NULL;
       return CONFLICTING_PATH;
    }
-   Path_free(oPPrefix);
-   oPPrefix = NULL;
 
    oNCurr = oNRoot;
    ulDepth = Path_getDepth(oPPath);
-   for (ulIndex = 2; ulIndex <= ulDepth; ulIndex++)
+   for (ulIndex = 1; ulIndex < ulDepth; ulIndex++)
    {
-      iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-      if (iStatus != SUCCESS)
+      if (Node_hasChild(oNCurr, Path_getComponent(oPPath, ulIndex),
+                        &ulChildID))
       {
-         *poNFurthest = NULL;
-         return iStatus;
-      }
-      if (Node_hasChild(oNCurr, Path_getPathname(oPPrefix), &ulChildID))
-      {
-         /* go to that child and continue with next prefix */
-         Path_free(oPPrefix);
-         oPPrefix = NULL;
+         /* go to that child and continue with next component */
          iStatus = Node_getChild(oNCurr, ulChildID, &oNChild);
          if (iStatus != SUCCESS)
          {
@@ -103,14 +117,14 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest)
       }
       else
       {
-         /* oNCurr doesn't have child with path oPPrefix:
+         /* oNCurr doesn't have child with this name:
             this is as far as we can go */
          break;
       }
    }
 
-   Path_free(oPPrefix);
    *poNFurthest = oNCurr;
+   *pulDepth = ulIndex;
    return SUCCESS;
 }
 
@@ -128,6 +142,7 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult)
 {
    Path_T oPPath = NULL;
    Node_T oNFound = NULL;
+   size_t ulFoundDepth;
    int iStatus;
 
    assert(pcPath != NULL);
@@ -147,7 +162,7 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult)
       return iStatus;
    }
 
-   iStatus = FT_traversePath(oPPath, &oNFound);
+   iStatus = FT_traversePath(oPPath, &oNFound, &ulFoundDepth);
    if (iStatus != SUCCESS)
    {
       Path_free(oPPath);
@@ -162,7 +177,7 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult)
       return NO_SUCH_PATH;
    }
 
-   if (Path_comparePath(Node_getPath(oNFound), oPPath) != 0)
+   if (ulFoundDepth != Path_getDepth(oPPath))
    {
       Path_free(oPPath);
       *poNResult = NULL;
@@ -173,6 +188,422 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult)
    *poNResult = oNFound;
    return SUCCESS;
 }
+
+/* --------------------------------------------------------------------
+
+  Change notification: the mutating functions post an event for each
+  change that some watch covers into a ring, from which
+  FT_dispatchEvents hands them to the watches' callbacks, possibly in
+  another thread. Whether a node is covered is told by flags the
+  nodes keep, so that unwatched changes cost only a flag test.
+*/
+
+/* The watch flags of a node: watched itself, watched along with its
+   subtree, or in the subtree of a node watched so. A change to a node
+   is covered if it or its parent has any. */
+enum { WATCH_SELF = 1, WATCH_TREE = 2, WATCH_INHERITED = 4 };
+
+/* The number of events that can wait to be dispatched. */
+enum { EVENT_RING_SIZE = 1024 };
+
+/* A watch set up by FT_watch. */
+struct watch
+{
+   /* the identifier handed to the client */
+   size_t ulId;
+   /* TRUE if the whole subtree is watched, not just the children */
+   boolean bRecursive;
+   /* the client's callback, and its extra argument */
+   void (*pfNotify)(int iEvent, const char *pcPath, void *pvExtra);
+   void *pvExtra;
+   /* the watched path */
+   char acPath[1];
+};
+
+/* A change waiting in oREvents. */
+struct event
+{
+   /* one of the FT_EVENT_ kinds */
+   int iEvent;
+   /* the path of the node that changed */
+   char acPath[1];
+};
+
+/*
+  Sets the watch flags of oNNode and its subtree from scratch: the
+  inherited flag if bInherited is TRUE, passed on below any node
+  watched with its subtree. Watches' own flags are added by FT_markTree.
+*/
+static void FT_clearMarks(Node_T oNNode, boolean bInherited)
+{
+   Node_T oNChild = NULL;
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+
+   Node_setWatchFlags(oNNode, bInherited ? WATCH_INHERITED : 0);
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+   {
+      (void)Node_getChild(oNNode, ulIndex, &oNChild);
+      FT_clearMarks(oNChild, bInherited);
+   }
+}
+
+/* Adds the inherited flag to every node below oNNode. */
+static void FT_markInherited(Node_T oNNode)
+{
+   Node_T oNChild = NULL;
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+   {
+      (void)Node_getChild(oNNode, ulIndex, &oNChild);
+      Node_setWatchFlags(oNChild,
+                         Node_getWatchFlags(oNChild) | WATCH_INHERITED);
+      FT_markInherited(oNChild);
+   }
+}
+
+/*
+  Brings the watch flags of the subtree rooted at oNTop (which may be
+  NULL) up to date, after it was added, moved, or the watches changed.
+  Only watches whose paths lie within the subtree are looked up.
+*/
+static void FT_markTree(Node_T oNTop)
+{
+   struct watch *psWatch;
+   Path_T oPTop;
+   const char *pcTop = NULL;
+   size_t ulTopLength = 0;
+   Node_T oNParent;
+   Node_T oNWatched = NULL;
+   Node_T oNAbove;
+   size_t ulIndex;
+
+   /* without watches the flags are never looked at */
+   if (oNTop == NULL || oDWatches == NULL)
+      return;
+
+   oNParent = Node_getParent(oNTop);
+   FT_clearMarks(oNTop, (boolean)(oNParent != NULL &&
+                                  (Node_getWatchFlags(oNParent) &
+                                   (WATCH_TREE | WATCH_INHERITED))));
+
+   /* without the subtree's path, every watch is looked up */
+   oPTop = Node_getPath(oNTop);
+   if (oPTop != NULL)
+   {
+      pcTop = Path_getPathname(oPTop);
+      ulTopLength = Path_getStrLength(oPTop);
+   }
+
+   for (ulIndex = 0; oDWatches != NULL &&
+                     ulIndex < DynArray_getLength(oDWatches); ulIndex++)
+   {
+      psWatch = DynArray_get(oDWatches, ulIndex);
+      if (pcTop != NULL &&
+          (strncmp(psWatch->acPath, pcTop, ulTopLength) != 0 ||
+           (psWatch->acPath[ulTopLength] != '\0' &&
+            psWatch->acPath[ulTopLength] != '/')))
+         continue;
+      if (FT_findNode(psWatch->acPath, &oNWatched) != SUCCESS)
+         continue;
+
+      /* only nodes in the subtree change */
+      for (oNAbove = oNWatched; oNAbove != NULL && oNAbove != oNTop;
+           oNAbove = Node_getParent(oNAbove))
+         ;
+      if (oNAbove == NULL)
+         continue;
+
+      Node_setWatchFlags(oNWatched, Node_getWatchFlags(oNWatched) |
+                         (psWatch->bRecursive ? WATCH_TREE : WATCH_SELF));
+      if (psWatch->bRecursive)
+         FT_markInherited(oNWatched);
+   }
+}
+
+/* Returns TRUE if a change to oNNode is covered by some watch. */
+static boolean FT_isWatched(Node_T oNNode)
+{
+   Node_T oNParent;
+
+   assert(oNNode != NULL);
+
+   if (oDWatches == NULL)
+      return FALSE;
+   oNParent = Node_getParent(oNNode);
+   return (boolean)(Node_getWatchFlags(oNNode) != 0 ||
+                    (oNParent != NULL &&
+                     Node_getWatchFlags(oNParent) != 0));
+}
+
+/*
+  Returns a new event of kind iEvent for oNNode if some watch covers
+  it, and otherwise NULL. An event that cannot be allocated is counted
+  as lost.
+*/
+static struct event *FT_newEvent(int iEvent, Node_T oNNode)
+{
+   struct event *psEvent;
+   Path_T oPPath;
+
+   assert(oNNode != NULL);
+
+   if (!FT_isWatched(oNNode))
+      return NULL;
+
+   oPPath = Node_getPath(oNNode);
+   psEvent = oPPath == NULL ? NULL :
+      malloc(sizeof(struct event) + Path_getStrLength(oPPath));
+   if (psEvent == NULL)
+   {
+      __atomic_add_fetch(&ulLostEvents, 1, __ATOMIC_RELAXED);
+      return NULL;
+   }
+   psEvent->iEvent = iEvent;
+   strcpy(psEvent->acPath, Path_getPathname(oPPath));
+   return psEvent;
+}
+
+/*
+  Queues psEvent (which may be NULL, for none) for FT_dispatchEvents,
+  or holds it back until FT_commit within a transaction. If the ring
+  is full, the event is counted as lost instead.
+*/
+static void FT_postEvent(struct event *psEvent)
+{
+   if (psEvent == NULL)
+      return;
+   if (bInTransaction)
+   {
+      /* held back until FT_commit */
+      if (oDHeldEvents == NULL)
+         oDHeldEvents = DynArray_new(0);
+      if (oDHeldEvents != NULL && DynArray_add(oDHeldEvents, psEvent))
+         return;
+      free(psEvent);
+      __atomic_add_fetch(&ulLostEvents, 1, __ATOMIC_RELAXED);
+      return;
+   }
+   if (!Ring_push(oREvents, psEvent))
+   {
+      free(psEvent);
+      __atomic_add_fetch(&ulLostEvents, 1, __ATOMIC_RELAXED);
+   }
+}
+
+/* Posts an event of kind iEvent for oNNode if some watch covers it. */
+static void FT_notify(int iEvent, Node_T oNNode)
+{
+   FT_postEvent(FT_newEvent(iEvent, oNNode));
+}
+
+/* Frees the watch pvWatch, as a DynArray_map callback. */
+static void FT_freeWatch(void *pvWatch, void *pvExtra)
+{
+   (void)pvExtra;
+   free(pvWatch);
+}
+
+/* Returns TRUE if the watch psWatch covers a change at pcPath. */
+static boolean FT_covers(const struct watch *psWatch, const char *pcPath)
+{
+   size_t ulLength;
+
+   assert(psWatch != NULL);
+   assert(pcPath != NULL);
+
+   ulLength = strlen(psWatch->acPath);
+   if (strncmp(pcPath, psWatch->acPath, ulLength) != 0)
+      return FALSE;
+   if (pcPath[ulLength] == '\0')
+      return TRUE;
+   if (pcPath[ulLength] != '/')
+      return FALSE;
+   return (boolean)(psWatch->bRecursive ||
+                    strchr(pcPath + ulLength + 1, '/') == NULL);
+}
+
+/* --------------------------------------------------------------------
+
+  Within a transaction, each change is logged as it is made, with what
+  it takes to undo it: removed subtrees are unlinked rather than
+  freed, contents are saved before their first change, and moved
+  nodes keep their old names and paths, so that FT_abort can put every
+  node back as it was without allocating, and FT_commit only has to
+  free what was set aside.
+*/
+
+/* The kinds of undo log entry. */
+enum { UNDO_CREATE, UNDO_REMOVE, UNDO_CONTENTS, UNDO_MOVE };
+
+/* The initial number of entries in the undo log. */
+enum { UNDO_LOG_SIZE = 1024 };
+
+/* An entry of the undo log. */
+struct undo
+{
+   /* one of the UNDO_ kinds */
+   int iKind;
+   /* the node created, removed, changed, or moved */
+   Node_T oNNode;
+   /* for a removal or move, the node's old parent; for a change, its
+      saved contents */
+   Node_T oNOther;
+   /* for a move, the node's old name and path (see Node_saveLink) */
+   Node_T oNSavedLink;
+   /* for a creation or removal, the number of nodes in the subtree */
+   size_t ulNodes;
+};
+
+/*
+  Makes room in the undo log for one more entry, if a transaction is
+  open, so that a change can be logged once it is made. Returns
+  SUCCESS, or MEMORY_ERROR if the log could not be grown.
+*/
+static int FT_reserveUndo(void)
+{
+   struct undo *psBigger;
+   size_t ulSize;
+
+   if (!bInTransaction || ulUndoLength < ulUndoSize)
+      return SUCCESS;
+
+   ulSize = ulUndoSize == 0 ? UNDO_LOG_SIZE : ulUndoSize * 2;
+   psBigger = realloc(psUndoLog, ulSize * sizeof(struct undo));
+   if (psBigger == NULL)
+      return MEMORY_ERROR;
+   psUndoLog = psBigger;
+   ulUndoSize = ulSize;
+   return SUCCESS;
+}
+
+/*
+  Logs a change of kind iKind to oNNode in the room made by
+  FT_reserveUndo, if a transaction is open, with oNOther, oNSavedLink
+  and ulNodes as for struct undo.
+*/
+static void FT_logUndo(int iKind, Node_T oNNode, Node_T oNOther,
+                       Node_T oNSavedLink, size_t ulNodes)
+{
+   struct undo *psEntry;
+
+   if (!bInTransaction)
+      return;
+   assert(ulUndoLength < ulUndoSize);
+
+   psEntry = &psUndoLog[ulUndoLength++];
+   psEntry->iKind = iKind;
+   psEntry->oNNode = oNNode;
+   psEntry->oNOther = oNOther;
+   psEntry->oNSavedLink = oNSavedLink;
+   psEntry->ulNodes = ulNodes;
+}
+
+/*
+  Saves the contents of file oNNode before a change, if a transaction
+  is open, and sets *poNSaved to the saved state for FT_logUndo, or to
+  NULL if there is nothing to save. Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_saveContents(Node_T oNNode, Node_T *poNSaved)
+{
+   int iStatus;
+
+   *poNSaved = NULL;
+   if (!bInTransaction)
+      return SUCCESS;
+
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return Node_saveContents(oNNode, ulTransaction, poNSaved);
+}
+
+/*
+  Logs the change of file oNNode, whose old contents FT_saveContents
+  saved in oNSaved, if iStatus is SUCCESS, and otherwise forgets them.
+  Returns iStatus.
+*/
+static int FT_logContents(Node_T oNNode, Node_T oNSaved, int iStatus)
+{
+   if (oNSaved == NULL)
+      return iStatus;
+   if (iStatus == SUCCESS)
+      FT_logUndo(UNDO_CONTENTS, oNNode, oNSaved, NULL, 0);
+   else
+      (void)Node_free(oNSaved);
+   return iStatus;
+}
+
+/*
+  Wins back the space of removed or replaced contents if it is worth
+  it, except within a transaction, whose set-aside nodes still hold
+  contents that are not in the tree.
+*/
+static void FT_compact(void)
+{
+   if (!bInTransaction)
+      (void)Node_compactContents(oNRoot);
+}
+
+/*
+  Removes oNNode and its subtree: frees them, or within a transaction,
+  unlinks and logs them. The undo log must have room already. Outside
+  a transaction, the parent gives back its spare child slots once few
+  enough are in use; within one, undoing relinks into those slots.
+*/
+static void FT_removeNode(Node_T oNNode)
+{
+   Node_T oNParent = Node_getParent(oNNode);
+   size_t ulNodes;
+
+   if (bInTransaction)
+   {
+      ulNodes = Node_unlink(oNNode);
+      FT_logUndo(UNDO_REMOVE, oNNode, oNParent, NULL, ulNodes);
+   }
+   else
+   {
+      ulNodes = Node_free(oNNode);
+      if (oNParent != NULL)
+         Node_trimChildren(oNParent);
+   }
+   ulCount -= ulNodes;
+   if (ulCount == 0)
+      oNRoot = NULL;
+}
+
+/*
+  Frees what the undo log set aside, without undoing anything, and
+  empties the log.
+*/
+static void FT_clearUndo(void)
+{
+   struct undo *psEntry;
+   size_t ulIndex;
+
+   for (ulIndex = 0; ulIndex < ulUndoLength; ulIndex++)
+   {
+      psEntry = &psUndoLog[ulIndex];
+      if (psEntry->iKind == UNDO_REMOVE)
+         (void)Node_free(psEntry->oNNode);
+      else if (psEntry->iKind == UNDO_CONTENTS)
+         (void)Node_free(psEntry->oNOther);
+      else if (psEntry->iKind == UNDO_MOVE)
+         (void)Node_free(psEntry->oNSavedLink);
+   }
+   ulUndoLength = 0;
+}
+
+/* Frees the event pvEvent, as a DynArray_map callback. */
+static void FT_freeEvent(void *pvEvent, void *pvExtra)
+{
+   (void)pvExtra;
+   free(pvEvent);
+}
 /*--------------------------------------------------------------------*/
 
 int FT_insertDir(const char *pcPath)
@@ -181,7 +612,7 @@ int FT_insertDir(const char *pcPath)
    Path_T oPPath = NULL;
    Node_T oNFirstNew = NULL;
    Node_T oNCurr = NULL;
-   size_t ulDepth, ulIndex;
+   size_t ulDepth, ulIndex, ulCurrDepth;
    size_t ulNewNodes = 0;
 
    assert(pcPath != NULL);
@@ -189,6 +620,11 @@ int FT_insertDir(const char *pcPath)
    /* validate pcPath and generate a Path_T for it */
    if (!bIsInitialized)
       return INITIALIZATION_ERROR;
+   if (oDTree != NULL)
+      return DiskFT_insert(oDTree, pcPath, FALSE, NULL, 0);
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
 
    iStatus = Path_new(pcPath, &oPPath);
    if (iStatus != SUCCESS)
@@ -197,7 +633,7 @@ int FT_insertDir(const char *pcPath)
    }
 
    /* find the closest ancestor of oPPath already in the tree */
-   iStatus = FT_traversePath(oPPath, &oNCurr);
+   iStatus = FT_traversePath(oPPath, &oNCurr, &ulCurrDepth);
    if (iStatus != SUCCESS)
    {
       Path_free(oPPath);
@@ -224,11 +660,10 @@ int FT_insertDir(const char *pcPath)
       ulIndex = 1;
    else
    {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr)) + 1;
+      ulIndex = ulCurrDepth + 1;
 
       /* oNCurr is the node we're trying to insert */
-      if (ulIndex == ulDepth + 1 && !Path_comparePath(oPPath,
-                                                      Node_getPath(oNCurr)))
+      if (ulCurrDepth == ulDepth)
       {
          Path_free(oPPath);
          return ALREADY_IN_TREE;
@@ -283,6 +718,9 @@ int FT_insertDir(const char *pcPath)
    if (oNRoot == NULL)
       oNRoot = oNFirstNew;
    ulCount += ulNewNodes;
+   FT_logUndo(UNDO_CREATE, oNFirstNew, NULL, NULL, ulNewNodes);
+   FT_markTree(oNFirstNew);
+   FT_notify(FT_EVENT_CREATE, oNFirstNew);
 
    return SUCCESS;
 }
@@ -291,9 +729,15 @@ boolean FT_containsDir(const char *pcPath)
 {
    int iStatus;
    Node_T oNFound = NULL;
+   boolean bIsFile;
+   size_t ulSize;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_stat(oDTree, pcPath, &bIsFile, &ulSize) == SUCCESS &&
+             !bIsFile;
+
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus == SUCCESS)
    {
@@ -309,9 +753,13 @@ int FT_rmDir(const char *pcPath)
 {
    int iStatus;
    Node_T oNFound = NULL;
+   struct event *psEvent;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_remove(oDTree, pcPath, FALSE);
+
    iStatus = FT_findNode(pcPath, &oNFound);
 
    if (iStatus != SUCCESS)
@@ -319,10 +767,14 @@ int FT_rmDir(const char *pcPath)
 
    if (Node_isFile(oNFound))
       return NOT_A_DIRECTORY;
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
 
-   ulCount -= Node_free(oNFound);
-   if (ulCount == 0)
-      oNRoot = NULL;
+   psEvent = FT_newEvent(FT_EVENT_REMOVE, oNFound);
+   FT_removeNode(oNFound);
+   FT_postEvent(psEvent);
+   FT_compact();
 
    return SUCCESS;
 }
@@ -334,13 +786,18 @@ int FT_insertFile(const char *pcPath, void *pvContents,
    Path_T oPPath = NULL;
    Node_T oNFirstNew = NULL;
    Node_T oNCurr = NULL;
-   size_t ulDepth, ulIndex;
+   size_t ulDepth, ulIndex, ulCurrDepth;
    size_t ulNewNodes = 0;
 
    assert(pcPath != NULL);
 
    if (!bIsInitialized)
       return INITIALIZATION_ERROR;
+   if (oDTree != NULL)
+      return DiskFT_insert(oDTree, pcPath, TRUE, pvContents, ulLength);
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
 
    /* validate pcPath and generate a Path_T for it */
    iStatus = Path_new(pcPath, &oPPath);
@@ -348,7 +805,7 @@ int FT_insertFile(const char *pcPath, void *pvContents,
       return iStatus;
 
    /* find the closest ancestor of oPPath already in the tree */
-   iStatus = FT_traversePath(oPPath, &oNCurr);
+   iStatus = FT_traversePath(oPPath, &oNCurr, &ulCurrDepth);
    if (iStatus != SUCCESS)
    {
       Path_free(oPPath);
@@ -375,11 +832,10 @@ int FT_insertFile(const char *pcPath, void *pvContents,
       ulIndex = 1;
    else
    {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr)) + 1;
+      ulIndex = ulCurrDepth + 1;
 
       /* oNCurr is the node we're trying to insert */
-      if (ulIndex == ulDepth + 1 && !Path_comparePath(oPPath,
-                                                      Node_getPath(oNCurr)))
+      if (ulCurrDepth == ulDepth)
       {
          Path_free(oPPath);
          return ALREADY_IN_TREE;
@@ -472,6 +928,9 @@ int FT_insertFile(const char *pcPath, void *pvContents,
    if (oNRoot == NULL)
       oNRoot = oNFirstNew;
    ulCount += ulNewNodes;
+   FT_logUndo(UNDO_CREATE, oNFirstNew, NULL, NULL, ulNewNodes);
+   FT_markTree(oNFirstNew);
+   FT_notify(FT_EVENT_CREATE, oNFirstNew);
 
    return SUCCESS;
 }
@@ -480,9 +939,15 @@ boolean FT_containsFile(const char *pcPath)
 {
    int iStatus;
    Node_T oNFound = NULL;
+   boolean bIsFile;
+   size_t ulSize;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_stat(oDTree, pcPath, &bIsFile, &ulSize) == SUCCESS &&
+             bIsFile;
+
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus == SUCCESS)
    {
@@ -496,9 +961,13 @@ int FT_rmFile(const char *pcPath)
 {
    int iStatus;
    Node_T oNFound = NULL;
+   struct event *psEvent;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_remove(oDTree, pcPath, TRUE);
+
    iStatus = FT_findNode(pcPath, &oNFound);
 
    if (iStatus != SUCCESS)
@@ -506,10 +975,14 @@ int FT_rmFile(const char *pcPath)
 
    if (!Node_isFile(oNFound))
       return NOT_A_FILE;
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
 
-   ulCount -= Node_free(oNFound);
-   if (ulCount == 0)
-      oNRoot = NULL;
+   psEvent = FT_newEvent(FT_EVENT_REMOVE, oNFound);
+   FT_removeNode(oNFound);
+   FT_postEvent(psEvent);
+   FT_compact();
 
    return SUCCESS;
 }
@@ -518,9 +991,16 @@ void *FT_getFileContents(const char *pcPath)
 {
    int iStatus;
    Node_T oNFound = NULL;
+   void *pvContents;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+   {
+      (void)DiskFT_getContents(oDTree, pcPath, &pvContents);
+      return pvContents;
+   }
+
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus != SUCCESS)
       return NULL;
@@ -535,82 +1015,1241 @@ void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
 {
    int iStatus;
    Node_T oNFound = NULL;
+   Node_T oNSaved = NULL;
+   void *pvOldContents;
 
    assert(pcPath != NULL);
 
+   if (bIsInitialized && oDTree != NULL)
+   {
+      (void)DiskFT_replaceContents(oDTree, pcPath, pvNewContents,
+                                   ulNewLength, &pvOldContents);
+      return pvOldContents;
+   }
+
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus != SUCCESS)
       return NULL;
 
+   /* compact before rather than after replacing, so that the old
+      contents returned below are not moved */
+   FT_compact();
+   if (FT_saveContents(oNFound, &oNSaved) != SUCCESS)
+      return NULL;
+
    /* our implementation of Node_replaceFileContents will automatically
-   return NULL if the given node is a directory */
-   return Node_replaceFileContents(oNFound, pvNewContents, ulNewLength);
+   return NULL if the given node is a directory. A failed replacement
+   also returns NULL, but logging it anyway only means that FT_abort
+   puts back what is there already */
+   pvOldContents = Node_replaceFileContents(oNFound, pvNewContents,
+                                            ulNewLength);
+   (void)FT_logContents(oNFound, oNSaved, SUCCESS);
+   if (Node_isFile(oNFound))
+      FT_notify(FT_EVENT_MODIFY, oNFound);
+   return pvOldContents;
 }
 
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize)
+int FT_getFileVersions(const char *pcPath, size_t *pulOldest,
+                       size_t *pulCurrent)
 {
    int iStatus;
    Node_T oNFound = NULL;
 
    assert(pcPath != NULL);
-   assert(pbIsFile != NULL);
-   assert(pulSize != NULL);
+   assert(pulOldest != NULL);
+   assert(pulCurrent != NULL);
+
+   if (!bIsInitialized || oDTree != NULL)
+      return INITIALIZATION_ERROR;
 
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus != SUCCESS)
       return iStatus;
-
-   if (Node_isFile(oNFound))
-   {
-      *pbIsFile = TRUE;
-      *pulSize = Node_getFileSize(oNFound);
-   }
-   else
-      *pbIsFile = FALSE;
-
+   if (!Node_isFile(oNFound))
+      return NOT_A_FILE;
+   Node_getVersions(oNFound, pulOldest, pulCurrent);
    return SUCCESS;
 }
 
-int FT_init(void)
+int FT_getFileContentsAt(const char *pcPath, size_t ulVersion,
+                         void **ppvContents, size_t *pulLength)
 {
-   if (bIsInitialized)
-      return INITIALIZATION_ERROR;
+   int iStatus;
+   Node_T oNFound = NULL;
 
-   /* set FT to initialized state */
-   bIsInitialized = TRUE;
-   oNRoot = NULL;
-   ulCount = 0;
+   assert(pcPath != NULL);
+   assert(ppvContents != NULL);
+   assert(pulLength != NULL);
 
-   return SUCCESS;
+   *ppvContents = NULL;
+   *pulLength = 0;
+   if (!bIsInitialized || oDTree != NULL)
+      return INITIALIZATION_ERROR;
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return Node_readVersion(oNFound, ulVersion, ppvContents, pulLength);
 }
 
-int FT_destroy(void)
+int FT_readFile(const char *pcPath, size_t ulOffset, void *pvBuf,
+                size_t ulLength, size_t *pulRead)
 {
-   if (!bIsInitialized)
-      return INITIALIZATION_ERROR;
+   int iStatus;
+   Node_T oNFound = NULL;
 
-   if (oNRoot)
-   {
-      ulCount -= Node_free(oNRoot);
-      oNRoot = NULL;
-   }
+   assert(pcPath != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+   assert(pulRead != NULL);
 
-   bIsInitialized = FALSE;
+   *pulRead = 0;
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_readFile(oDTree, pcPath, ulOffset, pvBuf, ulLength,
+                             pulRead);
 
-   return SUCCESS;
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   return Node_readFile(oNFound, ulOffset, pvBuf, ulLength, pulRead);
 }
 
-/* --------------------------------------------------------------------
+int FT_writeFile(const char *pcPath, size_t ulOffset, const void *pvBuf,
+                 size_t ulLength)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+   Node_T oNSaved = NULL;
 
-  The following auxiliary functions are used for generating the
-  string representation of the FT.
-*/
+   assert(pcPath != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
 
-/*
-  Performs a pre-order traversal of the tree rooted at oNNode,
-  inserting each payload to DynArray_T oDDynArray beginning at
-  index ulIndex. Returns the next unused index in oDDynArray
-  after the insertion(s).
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_writeFile(oDTree, pcPath, ulOffset, pvBuf, ulLength,
+                              FALSE);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_saveContents(oNFound, &oNSaved);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_logContents(oNFound, oNSaved,
+                            Node_writeFile(oNFound, ulOffset, pvBuf,
+                                           ulLength));
+   if (iStatus == SUCCESS)
+      FT_notify(FT_EVENT_MODIFY, oNFound);
+   return iStatus;
+}
+
+int FT_appendFile(const char *pcPath, const void *pvBuf,
+                  size_t ulLength)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+   Node_T oNSaved = NULL;
+
+   assert(pcPath != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_writeFile(oDTree, pcPath, 0, pvBuf, ulLength, TRUE);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_saveContents(oNFound, &oNSaved);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_logContents(oNFound, oNSaved,
+                            Node_writeFile(oNFound,
+                                           Node_getFileSize(oNFound),
+                                           pvBuf, ulLength));
+   if (iStatus == SUCCESS)
+      FT_notify(FT_EVENT_MODIFY, oNFound);
+   return iStatus;
+}
+
+int FT_truncateFile(const char *pcPath, size_t ulLength)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+   Node_T oNSaved = NULL;
+
+   assert(pcPath != NULL);
+
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_truncateFile(oDTree, pcPath, ulLength);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_saveContents(oNFound, &oNSaved);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_logContents(oNFound, oNSaved,
+                            Node_truncateFile(oNFound, ulLength));
+   if (iStatus == SUCCESS)
+      FT_notify(FT_EVENT_MODIFY, oNFound);
+   return iStatus;
+}
+
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_stat(oDTree, pcPath, pbIsFile, pulSize);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (Node_isFile(oNFound))
+   {
+      *pbIsFile = TRUE;
+      *pulSize = Node_getFileSize(oNFound);
+   }
+   else
+      *pbIsFile = FALSE;
+
+   return SUCCESS;
+}
+
+/*
+  Moves oNNode to pcNewPath under oNNewParent as Node_rename does,
+  reporting it as the removal of the old path and the creation of the
+  new one. Returns the status of Node_rename, or MEMORY_ERROR if the
+  move could not be logged for a transaction. Within one, the old name
+  and path are saved beforehand, so that FT_abort can move the node
+  back without allocating.
+*/
+static int FT_move(Node_T oNNode, Node_T oNNewParent,
+                   const char *pcNewPath)
+{
+   struct event *psEvent;
+   Node_T oNOldParent = Node_getParent(oNNode);
+   Node_T oNSavedLink = NULL;
+   int iStatus;
+
+   if (bInTransaction)
+   {
+      iStatus = FT_reserveUndo();
+      if (iStatus != SUCCESS)
+         return iStatus;
+      iStatus = Node_saveLink(oNNode, &oNSavedLink);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   psEvent = FT_newEvent(FT_EVENT_REMOVE, oNNode);
+   FT_logUndo(UNDO_MOVE, oNNode, oNOldParent, oNSavedLink, 0);
+   iStatus = Node_rename(oNNode, oNNewParent, pcNewPath);
+   if (iStatus != SUCCESS)
+   {
+      /* take the entry back out */
+      if (bInTransaction)
+      {
+         ulUndoLength--;
+         (void)Node_free(oNSavedLink);
+      }
+      free(psEvent);
+      return iStatus;
+   }
+
+   /* as FT_removeNode does, once undoing can no longer need them */
+   if (!bInTransaction && oNOldParent != NULL &&
+       oNOldParent != oNNewParent)
+      Node_trimChildren(oNOldParent);
+   FT_postEvent(psEvent);
+   FT_markTree(oNNode);
+   FT_notify(FT_EVENT_CREATE, oNNode);
+   return SUCCESS;
+}
+
+int FT_rename(const char *pcOldPath, const char *pcNewPath)
+{
+   int iStatus;
+   Path_T oPNewPath = NULL;
+   Node_T oNFound = NULL;
+   Node_T oNNewParent = NULL;
+   size_t ulNewDepth, ulParentDepth;
+
+   assert(pcOldPath != NULL);
+   assert(pcNewPath != NULL);
+
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_rename(oDTree, pcOldPath, pcNewPath);
+
+   iStatus = FT_findNode(pcOldPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Path_new(pcNewPath, &oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulNewDepth = Path_getDepth(oPNewPath);
+
+   /* renaming the root in place: the new path must be a new root */
+   if (oNFound == oNRoot)
+   {
+      Path_free(oPNewPath);
+      if (ulNewDepth != 1)
+         return CONFLICTING_PATH;
+      if (!strcmp(Node_getName(oNRoot), pcNewPath))
+         return ALREADY_IN_TREE;
+      return FT_move(oNFound, NULL, pcNewPath);
+   }
+
+   /* find the closest ancestor of the new path already in the tree */
+   iStatus = FT_traversePath(oPNewPath, &oNNewParent, &ulParentDepth);
+   Path_free(oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (ulParentDepth == ulNewDepth)
+      return ALREADY_IN_TREE;
+   if (Node_isFile(oNNewParent))
+      return NOT_A_DIRECTORY;
+   if (ulParentDepth + 1 != ulNewDepth)
+      return NO_SUCH_PATH;
+
+   /* Node_rename rejects moving a directory underneath itself */
+   return FT_move(oNFound, oNNewParent, pcNewPath);
+}
+
+int FT_copy(const char *pcSrcPath, const char *pcDstPath,
+            boolean bCopyContents)
+{
+   int iStatus;
+   Path_T oPDstPath = NULL;
+   Node_T oNSrc = NULL;
+   Node_T oNDstParent = NULL;
+   Node_T oNCopy = NULL;
+   size_t ulDstDepth, ulParentDepth;
+   size_t ulNewNodes = 0;
+
+   assert(pcSrcPath != NULL);
+   assert(pcDstPath != NULL);
+
+   if (bIsInitialized && oDTree != NULL)
+      return DiskFT_copy(oDTree, pcSrcPath, pcDstPath, bCopyContents);
+
+   iStatus = FT_findNode(pcSrcPath, &oNSrc);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Path_new(pcDstPath, &oPDstPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulDstDepth = Path_getDepth(oPDstPath);
+
+   /* find the closest ancestor of the destination already in the FT */
+   iStatus = FT_traversePath(oPDstPath, &oNDstParent, &ulParentDepth);
+   Path_free(oPDstPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (ulParentDepth == ulDstDepth)
+      return ALREADY_IN_TREE;
+   if (Node_isFile(oNDstParent))
+      return NOT_A_DIRECTORY;
+   if (ulParentDepth + 1 != ulDstDepth)
+      return NO_SUCH_PATH;
+
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_clone(oNSrc, oNDstParent, pcDstPath, bCopyContents,
+                        &oNCopy, &ulNewNodes);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   ulCount += ulNewNodes;
+   FT_logUndo(UNDO_CREATE, oNCopy, NULL, NULL, ulNewNodes);
+   FT_markTree(oNCopy);
+   FT_notify(FT_EVENT_CREATE, oNCopy);
+   return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  In the on-disk mode, imports and exports go through a copy in memory
+  of the subtree involved, built or stored by the DiskFT module, so
+  that HostFS and Tar work on nodes as usual.
+*/
+
+/*
+  Imports host directory pcHostPath as FT_importDir does, into the
+  on-disk store.
+*/
+static int FT_importDirOnDisk(const char *pcHostPath,
+                              const char *pcTreePath, boolean bMap,
+                              size_t ulThreads)
+{
+   int iStatus;
+   Path_T oPTreePath = NULL;
+   Node_T oNTop = NULL;
+   size_t ulNewNodes = 0;
+
+   /* report a bad tree path before reading the host at all */
+   iStatus = DiskFT_checkNewDir(oDTree, pcTreePath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Path_new(pcTreePath, &oPTreePath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_new(Path_getComponent(oPTreePath,
+                                        Path_getDepth(oPTreePath) - 1),
+                      NULL, NULL, 0, FALSE, &oNTop);
+   Path_free(oPTreePath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = HostFS_importDir(pcHostPath, oNTop, bMap, ulThreads,
+                              &ulNewNodes);
+   if (iStatus == SUCCESS)
+      iStatus = DiskFT_storeTree(oDTree, pcTreePath, oNTop);
+
+   (void)Node_free(oNTop);
+   return iStatus;
+}
+
+/*
+  Exports directory pcTreePath of the on-disk store to the host as
+  FT_exportDir does.
+*/
+static int FT_exportDirOnDisk(const char *pcTreePath,
+                              const char *pcHostPath, size_t ulThreads)
+{
+   int iStatus;
+   Node_T oNTop = NULL;
+
+   iStatus = DiskFT_loadTree(oDTree, pcTreePath, &oNTop);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = HostFS_exportDir(oNTop, pcHostPath, ulThreads);
+   (void)Node_free(oNTop);
+   return iStatus;
+}
+
+/* Imports a tar archive from iFd as FT_importTar does, on disk. */
+static int FT_importTarOnDisk(int iFd)
+{
+   int iStatus;
+   Node_T oNTop = NULL;
+   size_t ulNewNodes = 0;
+
+   iStatus = Tar_import(iFd, &oNTop, &ulNewNodes);
+   if (iStatus == SUCCESS && oNTop != NULL)
+      iStatus = DiskFT_storeTree(oDTree, NULL, oNTop);
+
+   if (oNTop != NULL)
+      (void)Node_free(oNTop);
+   return iStatus;
+}
+
+/* Writes the on-disk store to iFd as FT_exportTar does. */
+static int FT_exportTarOnDisk(int iFd)
+{
+   int iStatus;
+   Node_T oNTop = NULL;
+
+   iStatus = DiskFT_loadTree(oDTree, NULL, &oNTop);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Tar_export(oNTop, iFd);
+   if (oNTop != NULL)
+      (void)Node_free(oNTop);
+   return iStatus;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_importDir(const char *pcHostPath, const char *pcTreePath,
+                 boolean bMap, size_t ulThreads)
+{
+   int iStatus;
+   Path_T oPTreePath = NULL;
+   Node_T oNParent = NULL;
+   Node_T oNTop = NULL;
+   size_t ulTreeDepth, ulParentDepth;
+   size_t ulNewNodes = 0;
+
+   assert(pcHostPath != NULL);
+   assert(pcTreePath != NULL);
+
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if (oDTree != NULL)
+      return FT_importDirOnDisk(pcHostPath, pcTreePath, bMap, ulThreads);
+
+   iStatus = Path_new(pcTreePath, &oPTreePath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulTreeDepth = Path_getDepth(oPTreePath);
+
+   /* find the closest ancestor of the new directory already in the FT */
+   iStatus = FT_traversePath(oPTreePath, &oNParent, &ulParentDepth);
+   Path_free(oPTreePath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (oNParent == NULL)
+   {
+      /* an empty FT: the import becomes the root */
+      if (ulTreeDepth != 1)
+         return NO_SUCH_PATH;
+   }
+   else
+   {
+      if (ulParentDepth == ulTreeDepth)
+         return ALREADY_IN_TREE;
+      if (Node_isFile(oNParent))
+         return NOT_A_DIRECTORY;
+      if (ulParentDepth + 1 != ulTreeDepth)
+         return NO_SUCH_PATH;
+   }
+
+   iStatus = FT_reserveUndo();
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_new(pcTreePath, oNParent, NULL, 0, FALSE, &oNTop);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* everything below the top is linked straight under its parent */
+   iStatus = HostFS_importDir(pcHostPath, oNTop, bMap, ulThreads,
+                              &ulNewNodes);
+   if (iStatus != SUCCESS)
+   {
+      (void)Node_free(oNTop);
+      FT_compact();
+      return iStatus;
+   }
+
+   if (oNRoot == NULL)
+      oNRoot = oNTop;
+   ulCount += ulNewNodes + 1;
+   FT_logUndo(UNDO_CREATE, oNTop, NULL, NULL, ulNewNodes + 1);
+   FT_markTree(oNTop);
+   FT_notify(FT_EVENT_CREATE, oNTop);
+   return SUCCESS;
+}
+
+int FT_exportDir(const char *pcTreePath, const char *pcHostPath,
+                 size_t ulThreads)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcTreePath != NULL);
+   assert(pcHostPath != NULL);
+
+   if (bIsInitialized && oDTree != NULL)
+      return FT_exportDirOnDisk(pcTreePath, pcHostPath, ulThreads);
+
+   iStatus = FT_findNode(pcTreePath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (Node_isFile(oNFound))
+      return NOT_A_DIRECTORY;
+
+   return HostFS_exportDir(oNFound, pcHostPath, ulThreads);
+}
+
+int FT_importTar(int iFd)
+{
+   int iStatus;
+   size_t ulNewNodes = 0;
+
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if (oDTree != NULL)
+      return FT_importTarOnDisk(iFd);
+   /* entries merge all over the tree, which the undo log cannot
+      follow */
+   if (bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Tar_import(iFd, &oNRoot, &ulNewNodes);
+   if (iStatus != SUCCESS)
+   {
+      FT_compact();
+      return iStatus;
+   }
+
+   /* the entries merge all over the tree, so the root stands for them */
+   ulCount += ulNewNodes;
+   FT_markTree(oNRoot);
+   if (oNRoot != NULL && ulNewNodes != 0)
+      FT_notify(FT_EVENT_MODIFY, oNRoot);
+   return SUCCESS;
+}
+
+int FT_exportTar(int iFd)
+{
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if (oDTree != NULL)
+      return FT_exportTarOnDisk(iFd);
+
+   return Tar_export(oNRoot, iFd);
+}
+
+int FT_getDedupStats(size_t *pulLogicalBytes, size_t *pulStoredBytes,
+                     size_t *pulSavedBytes, double *pdRatio)
+{
+   size_t ulLogical, ulStored;
+
+   assert(pulLogicalBytes != NULL);
+   assert(pulStoredBytes != NULL);
+   assert(pulSavedBytes != NULL);
+   assert(pdRatio != NULL);
+
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   if (oDTree != NULL)
+      DiskFT_getStats(oDTree, &ulLogical, &ulStored);
+   else
+      Contents_getStats(&ulLogical, &ulStored);
+   *pulLogicalBytes = ulLogical;
+   *pulStoredBytes = ulStored;
+   *pulSavedBytes = ulLogical - ulStored;
+   if (ulStored == 0)
+      *pdRatio = 1.0;
+   else
+      *pdRatio = (double)ulLogical / (double)ulStored;
+
+   return SUCCESS;
+}
+
+int FT_init(void)
+{
+   if (bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* set FT to initialized state */
+   bIsInitialized = TRUE;
+   oNRoot = NULL;
+   ulCount = 0;
+
+   return SUCCESS;
+}
+
+/*
+  Sets the FT to an initialized state in the owned-contents mode,
+  storing identical contents only once if bDedup is TRUE. Returns
+  INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if the
+  content store could not be allocated, and SUCCESS otherwise.
+*/
+static int FT_initWithArena(boolean bDedup)
+{
+   int iStatus;
+
+   if (bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Contents_startArena(bDedup);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   return FT_init();
+}
+
+int FT_initOwned(void)
+{
+   return FT_initWithArena(FALSE);
+}
+
+int FT_initDeduped(void)
+{
+   return FT_initWithArena(TRUE);
+}
+
+int FT_initCompressed(boolean bDedup, size_t ulThreshold)
+{
+   int iStatus;
+
+   if (bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Contents_startArena(bDedup);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Contents_startCodec(ulThreshold);
+   if (iStatus != SUCCESS)
+   {
+      Contents_endArena();
+      return iStatus;
+   }
+
+   return FT_init();
+}
+
+int FT_getCompressionStats(size_t *pulRawBytes,
+                           size_t *pulCompressedBytes)
+{
+   assert(pulRawBytes != NULL);
+   assert(pulCompressedBytes != NULL);
+
+   if (!bIsInitialized ||
+       !Contents_getCodecStats(pulRawBytes, pulCompressedBytes))
+      return INITIALIZATION_ERROR;
+   return SUCCESS;
+}
+
+int FT_initTiered(boolean bDedup, size_t ulBudgetBytes,
+                  size_t ulSpillThreshold)
+{
+   int iStatus;
+
+   if (bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Contents_startArena(bDedup);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Contents_startTier(ulBudgetBytes, ulSpillThreshold);
+   if (iStatus != SUCCESS)
+   {
+      Contents_endArena();
+      return iStatus;
+   }
+
+   return FT_init();
+}
+
+int FT_getTierStats(size_t *pulHits, size_t *pulMisses,
+                    size_t *pulSpilledBytes)
+{
+   assert(pulHits != NULL);
+   assert(pulMisses != NULL);
+   assert(pulSpilledBytes != NULL);
+
+   if (!bIsInitialized ||
+       !Contents_getTierStats(pulHits, pulMisses, pulSpilledBytes))
+      return INITIALIZATION_ERROR;
+   return SUCCESS;
+}
+
+int FT_initVersioned(size_t ulMaxVersions, size_t ulMaxBytes)
+{
+   int iStatus;
+
+   iStatus = FT_initWithArena(TRUE);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   Node_startVersions(ulMaxVersions, ulMaxBytes);
+   return SUCCESS;
+}
+
+int FT_initOnDisk(const char *pcPageFile, size_t ulPoolPages)
+{
+   int iStatus;
+
+   if (bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = DiskFT_new(pcPageFile, ulPoolPages, &oDTree);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   return FT_init();
+}
+
+int FT_getPoolStats(size_t *pulHits, size_t *pulMisses,
+                    size_t *pulWrites)
+{
+   assert(pulHits != NULL);
+   assert(pulMisses != NULL);
+   assert(pulWrites != NULL);
+
+   if (!bIsInitialized || oDTree == NULL)
+      return INITIALIZATION_ERROR;
+
+   DiskFT_getPoolStats(oDTree, pulHits, pulMisses, pulWrites);
+   return SUCCESS;
+}
+
+int FT_watch(const char *pcPath, boolean bRecursive,
+             void (*pfNotify)(int iEvent, const char *pcPath,
+                              void *pvExtra),
+             void *pvExtra, size_t *pulWatch)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+   Path_T oPPath;
+   struct watch *psWatch;
+
+   assert(pcPath != NULL);
+   assert(pfNotify != NULL);
+   assert(pulWatch != NULL);
+
+   if (!bIsInitialized || oDTree != NULL)
+      return INITIALIZATION_ERROR;
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   oPPath = Node_getPath(oNFound);
+   if (oPPath == NULL)
+      return MEMORY_ERROR;
+
+   if (oREvents == NULL)
+   {
+      oREvents = Ring_new(EVENT_RING_SIZE);
+      if (oREvents == NULL)
+         return MEMORY_ERROR;
+   }
+   if (oDWatches == NULL)
+   {
+      oDWatches = DynArray_new(0);
+      if (oDWatches == NULL)
+         return MEMORY_ERROR;
+   }
+
+   psWatch = malloc(sizeof(struct watch) + Path_getStrLength(oPPath));
+   if (psWatch == NULL || !DynArray_add(oDWatches, psWatch))
+   {
+      free(psWatch);
+      if (DynArray_getLength(oDWatches) == 0)
+      {
+         DynArray_free(oDWatches);
+         oDWatches = NULL;
+      }
+      return MEMORY_ERROR;
+   }
+   psWatch->ulId = ulNextWatch++;
+   psWatch->bRecursive = bRecursive;
+   psWatch->pfNotify = pfNotify;
+   psWatch->pvExtra = pvExtra;
+   strcpy(psWatch->acPath, Path_getPathname(oPPath));
+
+   FT_markTree(oNRoot);
+   *pulWatch = psWatch->ulId;
+   return SUCCESS;
+}
+
+int FT_unwatch(size_t ulWatch)
+{
+   struct watch *psWatch;
+   size_t ulIndex;
+
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   for (ulIndex = 0; oDWatches != NULL &&
+                     ulIndex < DynArray_getLength(oDWatches); ulIndex++)
+   {
+      psWatch = DynArray_get(oDWatches, ulIndex);
+      if (psWatch->ulId != ulWatch)
+         continue;
+
+      (void)DynArray_removeAt(oDWatches, ulIndex);
+      free(psWatch);
+      if (DynArray_getLength(oDWatches) == 0)
+      {
+         DynArray_free(oDWatches);
+         oDWatches = NULL;
+      }
+      FT_markTree(oNRoot);
+      return SUCCESS;
+   }
+   return NO_SUCH_PATH;
+}
+
+int FT_dispatchEvents(size_t *pulEvents)
+{
+   struct event *psEvent;
+   struct watch *psWatch;
+   size_t ulLost;
+   size_t ulIndex;
+   size_t ulWatches;
+
+   assert(pulEvents != NULL);
+
+   *pulEvents = 0;
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if (oREvents == NULL)
+      return SUCCESS;
+
+   ulWatches = oDWatches == NULL ? 0 : DynArray_getLength(oDWatches);
+   ulLost = __atomic_exchange_n(&ulLostEvents, 0, __ATOMIC_ACQ_REL);
+   if (ulLost != 0)
+   {
+      for (ulIndex = 0; ulIndex < ulWatches; ulIndex++)
+      {
+         psWatch = DynArray_get(oDWatches, ulIndex);
+         (*psWatch->pfNotify)(FT_EVENT_LOST, psWatch->acPath,
+                              psWatch->pvExtra);
+      }
+   }
+
+   while ((psEvent = Ring_pop(oREvents)) != NULL)
+   {
+      for (ulIndex = 0; ulIndex < ulWatches; ulIndex++)
+      {
+         psWatch = DynArray_get(oDWatches, ulIndex);
+         if (FT_covers(psWatch, psEvent->acPath))
+            (*psWatch->pfNotify)(psEvent->iEvent, psEvent->acPath,
+                                 psWatch->pvExtra);
+      }
+      free(psEvent);
+      (*pulEvents)++;
+   }
+   return SUCCESS;
+}
+
+int FT_getHash(const char *pcPath, size_t *pulHash)
+{
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
+   assert(pulHash != NULL);
+
+   if (!bIsInitialized || oDTree != NULL)
+      return INITIALIZATION_ERROR;
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return Node_getHash(oNFound, pulHash);
+}
+
+/* The state of an FT_diff walk. */
+struct diffWalk
+{
+   /* the path of the node being compared, relative to the tops, in a
+      buffer of ulSize bytes */
+   char *pcPath;
+   size_t ulSize;
+   /* the client's callback and its extra argument */
+   void (*pfReport)(int iDiff, const char *pcPath, void *pvExtra);
+   void *pvExtra;
+};
+
+/*
+  Appends the name pcName to the ulLength-byte path of psWalk, growing
+  the buffer if need be. Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_extendDiffPath(struct diffWalk *psWalk, size_t ulLength,
+                             const char *pcName)
+{
+   size_t ulNeeded = ulLength + strlen(pcName) + 2;
+   size_t ulSize = psWalk->ulSize;
+   char *pcPath;
+
+   if (ulNeeded > ulSize)
+   {
+      while (ulSize < ulNeeded)
+         ulSize *= 2;
+      pcPath = realloc(psWalk->pcPath, ulSize);
+      if (pcPath == NULL)
+         return MEMORY_ERROR;
+      psWalk->pcPath = pcPath;
+      psWalk->ulSize = ulSize;
+   }
+   if (ulLength != 0)
+      psWalk->pcPath[ulLength++] = '/';
+   strcpy(psWalk->pcPath + ulLength, pcName);
+   return SUCCESS;
+}
+
+/*
+  Reports the differences between the children of directories oNA and
+  oNB, whose hashes differ, through psWalk, whose path is ulLength
+  bytes long. Children are matched by name in the order they are kept,
+  and matching children with equal hashes are skipped whole.
+  Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_diffChildren(Node_T oNA, Node_T oNB,
+                           struct diffWalk *psWalk, size_t ulLength)
+{
+   Node_T oNChildA = NULL;
+   Node_T oNChildB = NULL;
+   size_t ulIndexA = 0;
+   size_t ulIndexB = 0;
+   size_t ulCountA = Node_getNumChildren(oNA);
+   size_t ulCountB = Node_getNumChildren(oNB);
+   size_t ulHashA;
+   size_t ulHashB;
+   int iCompare;
+   int iStatus;
+
+   while (ulIndexA < ulCountA || ulIndexB < ulCountB)
+   {
+      if (ulIndexA < ulCountA)
+         (void)Node_getChild(oNA, ulIndexA, &oNChildA);
+      if (ulIndexB < ulCountB)
+         (void)Node_getChild(oNB, ulIndexB, &oNChildB);
+      if (ulIndexA == ulCountA)
+         iCompare = 1;
+      else if (ulIndexB == ulCountB)
+         iCompare = -1;
+      else
+         iCompare = strcmp(Node_getName(oNChildA),
+                           Node_getName(oNChildB));
+
+      if (iCompare < 0)
+      {
+         iStatus = FT_extendDiffPath(psWalk, ulLength,
+                                     Node_getName(oNChildA));
+         if (iStatus != SUCCESS)
+            return iStatus;
+         (*psWalk->pfReport)(FT_DIFF_REMOVED, psWalk->pcPath,
+                             psWalk->pvExtra);
+         ulIndexA++;
+         continue;
+      }
+      if (iCompare > 0)
+      {
+         iStatus = FT_extendDiffPath(psWalk, ulLength,
+                                     Node_getName(oNChildB));
+         if (iStatus != SUCCESS)
+            return iStatus;
+         (*psWalk->pfReport)(FT_DIFF_ADDED, psWalk->pcPath,
+                             psWalk->pvExtra);
+         ulIndexB++;
+         continue;
+      }
+
+      ulIndexA++;
+      ulIndexB++;
+      iStatus = Node_getHash(oNChildA, &ulHashA);
+      if (iStatus == SUCCESS)
+         iStatus = Node_getHash(oNChildB, &ulHashB);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      if (ulHashA == ulHashB)
+         continue;
+
+      iStatus = FT_extendDiffPath(psWalk, ulLength,
+                                  Node_getName(oNChildA));
+      if (iStatus != SUCCESS)
+         return iStatus;
+      if (Node_isFile(oNChildA) || Node_isFile(oNChildB))
+         (*psWalk->pfReport)(FT_DIFF_CHANGED, psWalk->pcPath,
+                             psWalk->pvExtra);
+      else
+      {
+         iStatus = FT_diffChildren(oNChildA, oNChildB, psWalk,
+                                   strlen(psWalk->pcPath));
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+   }
+   return SUCCESS;
+}
+
+int FT_diff(const char *pcPathA, const char *pcPathB,
+            void (*pfReport)(int iDiff, const char *pcPath,
+                             void *pvExtra),
+            void *pvExtra)
+{
+   int iStatus;
+   Node_T oNA = NULL;
+   Node_T oNB = NULL;
+   size_t ulHashA;
+   size_t ulHashB;
+   struct diffWalk sWalk;
+
+   assert(pcPathA != NULL);
+   assert(pcPathB != NULL);
+   assert(pfReport != NULL);
+
+   if (!bIsInitialized || oDTree != NULL)
+      return INITIALIZATION_ERROR;
+
+   iStatus = FT_findNode(pcPathA, &oNA);
+   if (iStatus == SUCCESS)
+      iStatus = FT_findNode(pcPathB, &oNB);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (Node_isFile(oNA) || Node_isFile(oNB))
+      return NOT_A_DIRECTORY;
+
+   iStatus = Node_getHash(oNA, &ulHashA);
+   if (iStatus == SUCCESS)
+      iStatus = Node_getHash(oNB, &ulHashB);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (ulHashA == ulHashB)
+      return SUCCESS;
+
+   sWalk.ulSize = 64;
+   sWalk.pcPath = malloc(sWalk.ulSize);
+   if (sWalk.pcPath == NULL)
+      return MEMORY_ERROR;
+   sWalk.pfReport = pfReport;
+   sWalk.pvExtra = pvExtra;
+   iStatus = FT_diffChildren(oNA, oNB, &sWalk, 0);
+   free(sWalk.pcPath);
+   return iStatus;
+}
+
+int FT_begin(void)
+{
+   if (!bIsInitialized || oDTree != NULL || bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   bInTransaction = TRUE;
+   ulTransaction++;
+   ulUndoLength = 0;
+   return SUCCESS;
+}
+
+/*
+  Ends the transaction: hands its held-back events to
+  FT_dispatchEvents if bPost is TRUE, and frees them otherwise.
+*/
+static void FT_endTransaction(boolean bPost)
+{
+   size_t ulIndex;
+
+   bInTransaction = FALSE;
+   if (oDHeldEvents == NULL)
+      return;
+   if (bPost)
+   {
+      for (ulIndex = 0; ulIndex < DynArray_getLength(oDHeldEvents);
+           ulIndex++)
+         FT_postEvent(DynArray_get(oDHeldEvents, ulIndex));
+   }
+   else
+      DynArray_map(oDHeldEvents, FT_freeEvent, NULL);
+   DynArray_free(oDHeldEvents);
+   oDHeldEvents = NULL;
+}
+
+int FT_commit(void)
+{
+   if (!bIsInitialized || !bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   FT_clearUndo();
+   FT_endTransaction(TRUE);
+   FT_compact();
+   return SUCCESS;
+}
+
+int FT_abort(void)
+{
+   struct undo *psEntry;
+
+   if (!bIsInitialized || !bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   /* newest first, so each change is undone on the tree it was made
+      to */
+   while (ulUndoLength != 0)
+   {
+      psEntry = &psUndoLog[--ulUndoLength];
+      switch (psEntry->iKind)
+      {
+         case UNDO_CREATE:
+            if (psEntry->oNNode == oNRoot)
+               oNRoot = NULL;
+            ulCount -= Node_free(psEntry->oNNode);
+            break;
+         case UNDO_REMOVE:
+            Node_relink(psEntry->oNNode, psEntry->oNOther);
+            if (psEntry->oNOther == NULL)
+               oNRoot = psEntry->oNNode;
+            ulCount += psEntry->ulNodes;
+            break;
+         case UNDO_CONTENTS:
+            Node_restoreContents(psEntry->oNNode, psEntry->oNOther);
+            break;
+         default:
+            Node_restoreLink(psEntry->oNNode, psEntry->oNOther,
+                             psEntry->oNSavedLink);
+            break;
+      }
+   }
+
+   FT_endTransaction(FALSE);
+   FT_markTree(oNRoot);
+   FT_compact();
+   return SUCCESS;
+}
+
+int FT_destroy(void)
+{
+   struct event *psEvent;
+
+   if (!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* an open transaction ends, as it stands, with the tree */
+   if (bInTransaction)
+   {
+      FT_clearUndo();
+      FT_endTransaction(FALSE);
+   }
+   free(psUndoLog);
+   psUndoLog = NULL;
+   ulUndoSize = 0;
+
+   if (oNRoot)
+   {
+      ulCount -= Node_free(oNRoot);
+      oNRoot = NULL;
+   }
+   if (oDTree != NULL)
+   {
+      DiskFT_free(oDTree);
+      oDTree = NULL;
+   }
+   Node_endVersions();
+   Contents_endArena();
+
+   /* watches and undelivered events go with the tree */
+   if (oDWatches != NULL)
+   {
+      DynArray_map(oDWatches, FT_freeWatch, NULL);
+      DynArray_free(oDWatches);
+      oDWatches = NULL;
+   }
+   if (oREvents != NULL)
+   {
+      while ((psEvent = Ring_pop(oREvents)) != NULL)
+         free(psEvent);
+      Ring_free(oREvents);
+      oREvents = NULL;
+   }
+   ulLostEvents = 0;
+
+   bIsInitialized = FALSE;
+
+   return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for generating the
+  string representation of the FT.
+*/
+
+/*
+  Performs a pre-order traversal of the tree rooted at oNNode,
+  inserting each payload to DynArray_T oDDynArray beginning at
+  index ulIndex. Returns the next unused index in oDDynArray
+  after the insertion(s).
 */
 static size_t FT_preOrderTraversal(Node_T oNNode,
                                    DynArray_T oDDynArray, size_t ulIndex)
@@ -702,14 +2341,30 @@ char *FT_toString(void)
 {
    DynArray_T oDNodes;
    size_t totalStrlen = 1;
+   size_t ulIndex;
    char *result = NULL;
 
    if (!bIsInitialized)
       return NULL;
+   if (oDTree != NULL)
+      return DiskFT_toString(oDTree);
 
    oDNodes = DynArray_new(ulCount);
+   if (oDNodes == NULL)
+      return NULL;
    (void)FT_preOrderTraversal(oNRoot, oDNodes, 0);
 
+   /* bring every path up to date first, so that the accumulators
+      below never see a stale path left behind by FT_rename */
+   for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+   {
+      if (Node_getPath(DynArray_get(oDNodes, ulIndex)) == NULL)
+      {
+         DynArray_free(oDNodes);
+         return NULL;
+      }
+   }
+
    DynArray_map(oDNodes, (void (*)(void *, void *))FT_strlenAccumulate,
                 (void *)&totalStrlen);
 
@@ -95,11 +95,101 @@ void *FT_getFileContents(const char *pcPath);
   Replaces current contents of the file with absolute path pcPath with
   the parameter pvNewContents of size ulNewLength bytes.
   Returns the old contents if successful. (Note: contents may be NULL.)
+  Outside the owned modes, these are the caller's own buffer, unless
+  the file has since been written to with FT_writeFile: then they are
+  a fresh copy allocated with malloc, which the caller owns and must
+  free, as it would have its original buffer.
   Returns NULL if unable to complete the request for any reason.
 */
 void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  Sets *pulCurrent to the version number of the current contents of
+  the file at pcPath, and *pulOldest to that of the oldest version
+  kept (see FT_initVersioned). A file starts at version 0, and each
+  FT_replaceFileContents adds one. A copy made by FT_copy starts over
+  at 0, with no earlier versions. Without versioning, both are the
+  current version.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not initialized, or is on disk
+  * BAD_PATH, CONFLICTING_PATH or NO_SUCH_PATH, as for FT_stat
+  * NOT_A_FILE if pcPath is a directory
+*/
+int FT_getFileVersions(const char *pcPath, size_t *pulOldest,
+                       size_t *pulCurrent);
+
+/*
+  Sets *ppvContents to a new copy of version ulVersion of the contents
+  of the file at pcPath (see FT_getFileVersions), which the caller
+  frees, or to NULL if that version is empty, and *pulLength to its
+  length.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not initialized, or is on disk
+  * BAD_PATH, CONFLICTING_PATH or NO_SUCH_PATH, as for FT_stat
+  * NOT_A_FILE if pcPath is a directory
+  * NO_SUCH_PATH if the file has no such version, or no longer keeps it
+  * MEMORY_ERROR if memory could not be allocated for the copy
+*/
+int FT_getFileContentsAt(const char *pcPath, size_t ulVersion,
+                         void **ppvContents, size_t *pulLength);
+
+/*
+  Copies up to ulLength bytes of the file with absolute path pcPath,
+  starting at byte ulOffset, into pvBuf, and sets *pulRead to the
+  number of bytes copied. That is less than ulLength only if the end
+  of the file is reached, and 0 if ulOffset is at or past the end.
+  Returns SUCCESS if the read completed.
+  Otherwise, sets *pulRead to 0 and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_readFile(const char *pcPath, size_t ulOffset, void *pvBuf,
+                size_t ulLength, size_t *pulRead);
+
+/*
+  Overwrites ulLength bytes of the file with absolute path pcPath,
+  starting at byte ulOffset, with the bytes at pvBuf. Writing past the
+  end grows the file, and any gap between the old end and ulOffset
+  reads as zeros.
+  The first in-place change to a file moves its contents into chunks
+  owned by the FT; later writes copy only the bytes they change. The
+  caller's original contents buffer is no longer used, and a pointer
+  from FT_getFileContents now makes the FT gather the chunks into one
+  FT-owned copy, valid until the next change to the file. (See
+  FT_replaceFileContents for what replacing such a file returns.)
+  Returns SUCCESS if the write completed.
+  Otherwise, leaves the file's bytes unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_writeFile(const char *pcPath, size_t ulOffset, const void *pvBuf,
+                 size_t ulLength);
+
+/*
+  Appends the ulLength bytes at pvBuf to the end of the file with
+  absolute path pcPath, as FT_writeFile at an offset of the file's
+  size. Returns the same statuses as FT_writeFile.
+*/
+int FT_appendFile(const char *pcPath, const void *pvBuf,
+                  size_t ulLength);
+
+/*
+  Sets the size of the file with absolute path pcPath to ulLength,
+  dropping bytes past it or growing the file with zeros. Like
+  FT_writeFile, this works on the file's chunks in place.
+  Returns the same statuses as FT_writeFile.
+*/
+int FT_truncateFile(const char *pcPath, size_t ulLength);
+
 /*
   Returns SUCCESS if pcPath exists in the hierarchy,
   Otherwise, returns:
@@ -118,6 +208,145 @@ void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
 */
 int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize);
 
+/*
+  Moves the file or directory with absolute path pcOldPath, together
+  with its whole subtree, so that it has absolute path pcNewPath.
+  The subtree is relinked under its new parent in place: file contents
+  are kept as they are and the cost does not depend on subtree size.
+  The new parent must already exist in the FT. Renaming the root to
+  another depth-1 path renames the root.
+  Returns SUCCESS if the subtree is moved successfully.
+  Otherwise, leaves the FT unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if either path does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of either path,
+                     or if pcNewPath lies within the subtree being moved
+  * NO_SUCH_PATH if pcOldPath does not exist in the FT,
+                 or pcNewPath's parent does not exist in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcNewPath exists as a file
+  * ALREADY_IN_TREE if pcNewPath is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_rename(const char *pcOldPath, const char *pcNewPath);
+
+/*
+  Duplicates the file or directory with absolute path pcSrcPath,
+  together with its whole subtree, at absolute path pcDstPath, whose
+  parent must already exist in the FT. The copy is built in a single
+  pass and its nodes are allocated in bulk.
+  If bCopyContents is FALSE, copied files share their contents pointers
+  with the originals. If it is TRUE, each copied file gets a private
+  copy of the bytes owned by the FT, which the FT frees when the file
+  is removed; a pointer to such a copy returned by
+  FT_replaceFileContents remains valid only until the next replace or
+  removal.
+  Returns SUCCESS if the subtree is copied successfully.
+  Otherwise, leaves the FT unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if either path does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of either path
+  * NO_SUCH_PATH if pcSrcPath does not exist in the FT,
+                 or pcDstPath's parent does not exist in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcDstPath exists as a file
+  * ALREADY_IN_TREE if pcDstPath is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_copy(const char *pcSrcPath, const char *pcDstPath,
+            boolean bCopyContents);
+
+/*
+  Creates directory pcTreePath and fills it with a copy of the host
+  directory pcHostPath: its subdirectories and regular files,
+  recursively. Symbolic links and special files are skipped, and are
+  never followed. The parent of pcTreePath must already exist in the
+  FT, unless the FT is empty, in which case pcTreePath becomes the
+  root. Host directories are opened relative to their parents and
+  entries are linked straight under their parent node, so the cost
+  does not grow with the depth of the tree.
+  The FT owns the imported contents and frees them when the files are
+  removed, as for FT_copy with bCopyContents TRUE. If bMap is TRUE,
+  each non-empty file's contents are a private mapping of the host
+  file instead of a copy; the host files must then not be truncated
+  while in the FT. If ulThreads is more than 1, the tree is built
+  first and the files are then read by that many threads.
+  Returns SUCCESS if the directory is imported successfully.
+  Otherwise, leaves the FT unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcTreePath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of
+                     pcTreePath
+  * NO_SUCH_PATH if pcTreePath's parent does not exist in the FT,
+                 or pcHostPath does not exist on the host
+  * NOT_A_DIRECTORY if a proper prefix of pcTreePath exists as a file,
+                    or pcHostPath is not a directory on the host
+  * ALREADY_IN_TREE if pcTreePath is already in the FT
+  * IO_ERROR if a host directory or file could not be read
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_importDir(const char *pcHostPath, const char *pcTreePath,
+                 boolean bMap, size_t ulThreads);
+
+/*
+  Writes the FT directory pcTreePath and everything below it out to
+  the host as real directories and files, creating host directory
+  pcHostPath as its copy. Directories are created in tree order; each
+  file is preallocated to its full size and written with pwrite, by
+  ulThreads threads once every directory exists if ulThreads is more
+  than 1, and as it is reached otherwise.
+  Returns SUCCESS if the directory is exported successfully.
+  Otherwise, leaves the FT unchanged, possibly leaves a partial copy
+  on the host, and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcTreePath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of
+                     pcTreePath
+  * NO_SUCH_PATH if pcTreePath does not exist in the FT,
+                 or pcHostPath's parent does not exist on the host
+  * NOT_A_DIRECTORY if pcTreePath is in the FT as a file,
+                    or a prefix of pcHostPath is not a directory on
+                    the host
+  * ALREADY_IN_TREE if pcHostPath already exists on the host
+  * IO_ERROR if a host directory or file could not be created or
+             written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_exportDir(const char *pcTreePath, const char *pcHostPath,
+                 size_t ulThreads);
+
+/*
+  Reads a tar archive (USTAR, with PAX or GNU long-name extensions)
+  from iFd, starting at its current offset, and inserts its
+  directories and regular files into the FT; other entries are
+  skipped. If the FT is empty, the archive's top directory becomes
+  the root. Missing directories are created and existing ones reused.
+  If iFd is a regular file, the archive is mapped and file contents
+  refer to the mapping, which must then not be truncated while in the
+  FT; otherwise the archive is read as a stream and copied.
+  Returns SUCCESS if the archive is imported successfully.
+  Otherwise, leaves the FT unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if an entry's path is not a well-formatted path
+  * CONFLICTING_PATH if an entry is not under the root
+  * NOT_A_DIRECTORY if a proper prefix of an entry's path exists as a
+                    file
+  * ALREADY_IN_TREE if a file entry is already in the FT
+  * IO_ERROR if iFd could not be read or the archive is malformed
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_importTar(int iFd);
+
+/*
+  Writes the whole FT to iFd as a USTAR archive, in the same order as
+  FT_toString, with PAX headers for paths or sizes USTAR cannot hold.
+  File contents are written straight from where they are stored.
+  Returns SUCCESS if the FT is exported successfully. Otherwise,
+  possibly leaves a partial archive and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if iFd could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_exportTar(int iFd);
+
 /*
   Sets the FT data structure to an initialized state.
   The data structure is initially empty.
@@ -126,9 +355,305 @@ int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize);
 */
 int FT_init(void);
 
+/*
+  Like FT_init, but also puts the FT in the owned-contents mode: the
+  FT keeps its own copy of the contents of every file inserted or
+  replaced, in a content arena that belongs to the FT, so the caller
+  may reuse or free its buffers right away. FT_destroy frees all of
+  the copies at once.
+  In this mode, a pointer returned by FT_getFileContents or
+  FT_replaceFileContents refers to the FT's copy and remains valid
+  only until the next FT_rmDir, FT_rmFile, FT_replaceFileContents or
+  FT_destroy, since removals and replacements may compact the arena.
+  Returns INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if
+  the arena could not be allocated, and SUCCESS otherwise.
+*/
+int FT_initOwned(void);
+
+/*
+  Like FT_initOwned, but the FT also hashes the contents of every file
+  inserted or replaced, so that identical contents are stored only
+  once and shared by reference count. FT_stat still reports each
+  file's own (logical) size.
+  Returns INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if
+  the content store could not be allocated, and SUCCESS otherwise.
+*/
+int FT_initDeduped(void);
+
+/*
+  Like FT_initOwned, or FT_initDeduped if bDedup is TRUE, but the FT
+  compresses its copies of at least ulThreshold bytes with a built-in
+  LZ codec, keeping the compressed form if it saves at least an
+  eighth. Reading a compressed file decompresses it into a small cache
+  of the calling thread's, which keeps the last four files it read.
+  FT_stat still reports each file's own (logical) size.
+  In this mode, a pointer returned by FT_getFileContents or
+  FT_replaceFileContents for a compressed file stays valid, besides as
+  for FT_initOwned, only while the same thread reads up to three other
+  compressed files. If a compressed file cannot be decompressed for
+  want of memory, FT_getFileContents returns NULL and FT_readFile
+  returns MEMORY_ERROR.
+  Returns INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if
+  the content store could not be allocated, and SUCCESS otherwise.
+*/
+int FT_initCompressed(boolean bDedup, size_t ulThreshold);
+
+/*
+  Reports on compression (see FT_initCompressed): sets *pulRawBytes to
+  the logical size of the compressed copies, and *pulCompressedBytes
+  to the bytes they take compressed.
+  Returns INITIALIZATION_ERROR if the FT is not initialized with
+  compression, and SUCCESS otherwise.
+*/
+int FT_getCompressionStats(size_t *pulRawBytes,
+                           size_t *pulCompressedBytes);
+
+/*
+  Like FT_initOwned, or FT_initDeduped if bDedup is TRUE, but with a
+  content tier: the FT's copies of at least ulSpillThreshold bytes are
+  kept apart, and at most ulBudgetBytes of them stay in memory. When
+  a copy pushes them over the budget, the least recently used ones are
+  spilled to a scratch file in the temporary directory, and read back
+  in when next used, by FT_getFileContents, FT_readFile and the
+  like. A copy spilled once is kept there, so evicting it again costs
+  no writing. The most recently used copy always stays in memory,
+  even if it alone is over the budget.
+  In this mode, a pointer returned by FT_getFileContents or
+  FT_replaceFileContents is valid only until the next FT call that
+  reads or adds file contents, as that may evict it. If a spilled
+  copy cannot be read back, FT_getFileContents returns NULL and
+  FT_readFile returns MEMORY_ERROR.
+  Returns INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if
+  the content store could not be allocated, IO_ERROR if the spill
+  file could not be created, and SUCCESS otherwise.
+*/
+int FT_initTiered(boolean bDedup, size_t ulBudgetBytes,
+                  size_t ulSpillThreshold);
+
+/*
+  Reports on the content tier (see FT_initTiered): sets *pulHits to
+  the number of times a copy was in memory when used, *pulMisses to
+  the number of times it had to be read back from the scratch file,
+  and *pulSpilledBytes to the bytes written to the scratch file.
+  Returns INITIALIZATION_ERROR if the FT is not initialized with a
+  content tier, and SUCCESS otherwise.
+*/
+int FT_getTierStats(size_t *pulHits, size_t *pulMisses,
+                    size_t *pulSpilledBytes);
+
+/*
+  Like FT_initDeduped, but FT_replaceFileContents also keeps the
+  contents it replaces as an earlier version of the file, readable by
+  FT_getFileContentsAt. Versions are kept in chunks of 4 KB, stored
+  once however many versions (or files) have them in common, so a
+  history of small changes costs little more than the changes. Each
+  file keeps at most ulMaxVersions earlier versions, and at most
+  ulMaxBytes bytes of them by their own (logical) length, dropping
+  the oldest first; a limit of 0 is no limit. FT_writeFile,
+  FT_appendFile and FT_truncateFile change the current version in
+  place rather than making a new one.
+  Returns INITIALIZATION_ERROR if already initialized, MEMORY_ERROR if
+  the content store could not be allocated, and SUCCESS otherwise.
+*/
+int FT_initVersioned(size_t ulMaxVersions, size_t ulMaxBytes);
+
+/*
+  Like FT_init, but puts the FT in the on-disk mode: the hierarchy is
+  kept in a B+tree keyed by full pathname, in pages of the page file
+  pcPageFile (or of a new file in the temporary directory if
+  pcPageFile is NULL), of which at most ulPoolPages are held in memory
+  at once (but at least 16). Keys sort in the order of FT_toString,
+  so each subtree is one contiguous run of pages, and the directories
+  in use stay in memory while the rest stay on disk. The page file is
+  scratch space, emptied when opened and gone after FT_destroy.
+  In this mode:
+  * the FT stores its own copy of every file's contents in the page
+    file, so the caller may reuse or free its buffers right away
+  * a pointer returned by FT_getFileContents or FT_replaceFileContents
+    refers to a copy owned by the FT, valid only until the next change
+    to the FT; a file without contents gives NULL
+  * FT_rename and FT_copy take time in proportion to the size of the
+    subtree, since every key in it changes; FT_copy with bCopyContents
+    FALSE shares stored contents until either file is changed
+  * FT_importDir, FT_exportDir, FT_importTar and FT_exportTar build
+    the subtree involved in memory on the way in or out
+  * a path too long to be a key (about 900 bytes) is a BAD_PATH, and
+    any function returning a status may return IO_ERROR if the page
+    file could not be read or written
+  Returns INITIALIZATION_ERROR if already initialized, IO_ERROR if the
+  page file could not be created, MEMORY_ERROR if the buffer pool
+  could not be allocated, and SUCCESS otherwise.
+*/
+int FT_initOnDisk(const char *pcPageFile, size_t ulPoolPages);
+
+/*
+  Reports on the buffer pool of the on-disk mode (see FT_initOnDisk):
+  sets *pulHits to the number of page reads served from memory,
+  *pulMisses to the number that went to the page file, and *pulWrites
+  to the number of pages written back to it.
+  Returns INITIALIZATION_ERROR if the FT is not initialized in the
+  on-disk mode, and SUCCESS otherwise.
+*/
+int FT_getPoolStats(size_t *pulHits, size_t *pulMisses,
+                    size_t *pulWrites);
+
+/*
+  Reports how much sharing saves in the FT's own copies of file
+  contents (see FT_initOwned, FT_initDeduped and FT_copy): sets
+  *pulLogicalBytes to the bytes that the copies would take if every
+  file had its own, *pulStoredBytes to the bytes actually stored,
+  *pulSavedBytes to the difference, and *pdRatio to logical bytes per
+  stored byte (1.0 if nothing is stored). Contents borrowed from the
+  caller are not counted. In the on-disk mode, the copies are those
+  in the page file.
+  Returns INITIALIZATION_ERROR if the FT is not in an initialized
+  state, and SUCCESS otherwise.
+*/
+int FT_getDedupStats(size_t *pulLogicalBytes, size_t *pulStoredBytes,
+                     size_t *pulSavedBytes, double *pdRatio);
+
+/* The kinds of change reported to watches (see FT_watch). */
+enum { FT_EVENT_CREATE, FT_EVENT_REMOVE, FT_EVENT_MODIFY,
+       FT_EVENT_LOST };
+
+/*
+  Watches the node at pcPath for changes: the node itself and its
+  children, or its whole subtree if bRecursive is TRUE. Each change
+  is reported by a call (*pfNotify)(iEvent, pcPath, pvExtra) from
+  FT_dispatchEvents, where pcPath is the path of the node concerned,
+  valid only during the call, and iEvent is:
+  * FT_EVENT_CREATE for a node inserted, copied, imported, or renamed
+    to pcPath; a node created along with missing ancestors, or with a
+    subtree, is reported as its topmost new node
+  * FT_EVENT_REMOVE for a node removed, with its subtree, or renamed
+    away from pcPath
+  * FT_EVENT_MODIFY for a file whose contents were replaced, written,
+    appended to or truncated, and for the root after FT_importTar
+    merges entries into the tree
+  * FT_EVENT_LOST, with the watched path, if events were dropped since
+    the last dispatch because they were waiting in too great a number,
+    or memory ran out
+  The watch is kept by path: it lapses while nothing is at pcPath and
+  applies again to a node later created there. Sets *pulWatch to an
+  identifier for FT_unwatch.
+  Changes are queued as they are made, at the cost of a flag test for
+  those no watch covers, and delivered only by FT_dispatchEvents,
+  which may be called by another thread than the one changing the FT.
+  Watching is not available in the on-disk mode.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not initialized, or is on disk
+  * BAD_PATH, CONFLICTING_PATH or NO_SUCH_PATH, as for FT_stat
+  * MEMORY_ERROR if memory could not be allocated for the watch
+*/
+int FT_watch(const char *pcPath, boolean bRecursive,
+             void (*pfNotify)(int iEvent, const char *pcPath,
+                              void *pvExtra),
+             void *pvExtra, size_t *pulWatch);
+
+/*
+  Stops the watch identified by ulWatch. Events already queued are
+  still delivered to the other watches that cover them.
+  Returns INITIALIZATION_ERROR if the FT is not initialized,
+  NO_SUCH_PATH if there is no such watch, and SUCCESS otherwise.
+*/
+int FT_unwatch(size_t ulWatch);
+
+/*
+  Delivers the queued changes, oldest first, to the callbacks of the
+  watches that cover them, and sets *pulEvents to the number of
+  changes delivered. One thread at a time may dispatch, while one
+  other thread changes the FT; FT_watch, FT_unwatch and FT_destroy
+  must not run during a dispatch, nor be called by the callbacks.
+  Returns INITIALIZATION_ERROR if the FT is not initialized, and
+  SUCCESS otherwise.
+*/
+int FT_dispatchEvents(size_t *pulEvents);
+
+/*
+  Sets *pulHash to a hash of the node at pcPath and its subtree: for a
+  file, of its contents; for a directory, of its children's names and
+  hashes, so that equal hashes mean, barring a collision, equal
+  subtrees. The node's own name is not part of it. Hashes are kept
+  with the nodes and recomputed lazily, only along the paths changed
+  since they were last asked for; a copy made by FT_copy starts with
+  its source's. Changes the client makes to the bytes of contents it
+  still owns (see FT_insertFile) are not noticed. Hashes are not
+  available in the on-disk mode.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not initialized, or is on disk
+  * BAD_PATH, CONFLICTING_PATH or NO_SUCH_PATH, as for FT_stat
+  * MEMORY_ERROR if contents could not be read back from the tier
+*/
+int FT_getHash(const char *pcPath, size_t *pulHash);
+
+/* The kinds of difference reported by FT_diff. */
+enum { FT_DIFF_ADDED, FT_DIFF_REMOVED, FT_DIFF_CHANGED };
+
+/*
+  Compares the directories at pcPathA and pcPathB, typically a
+  directory and an earlier FT_copy of it, and reports each difference
+  by a call (*pfReport)(iDiff, pcPath, pvExtra), where pcPath is the
+  path relative to both directories, valid only during the call, and
+  iDiff is:
+  * FT_DIFF_ADDED for a node only under pcPathB; its subtree is not
+    reported separately
+  * FT_DIFF_REMOVED for a node only under pcPathA, likewise
+  * FT_DIFF_CHANGED for a file whose contents differ, or a path that
+    is a file on one side and a directory on the other
+  Differences are reported in FT_toString order. Subtrees with equal
+  hashes (see FT_getHash) are skipped without being walked, so after
+  the first comparison the cost grows with the size of the changes
+  rather than of the trees. pfReport must not change the FT.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not initialized, or is on disk
+  * BAD_PATH, CONFLICTING_PATH or NO_SUCH_PATH, as for FT_stat
+  * NOT_A_DIRECTORY if either path is a file
+  * MEMORY_ERROR if memory could not be allocated, or contents could
+    not be read back from the content tier
+*/
+int FT_diff(const char *pcPathA, const char *pcPathB,
+            void (*pfReport)(int iDiff, const char *pcPath,
+                             void *pvExtra),
+            void *pvExtra);
+
+/*
+  Opens a transaction: the changes made from now on to the FT by the
+  functions that insert, remove, replace, write, append to, truncate,
+  rename, copy and import are kept together by FT_commit, or are all
+  undone by FT_abort. Each change is applied to the tree at once, as
+  usual, so it is seen by the FT calls that follow it, and may fail
+  without affecting the others; alongside, it is logged with what it
+  takes to undo it. Watches (see FT_watch) are told of none of the
+  changes until FT_commit. Removed nodes and replaced contents are set
+  aside until the transaction ends, and contents handed back by
+  FT_replaceFileContents must stay valid until then, as FT_abort may
+  put them back. FT_importTar may not be used in a transaction.
+  Transactions are not available in the on-disk mode.
+  Returns INITIALIZATION_ERROR if the FT is not initialized, is on
+  disk, or already has a transaction open, and SUCCESS otherwise.
+*/
+int FT_begin(void);
+
+/*
+  Ends the open transaction, keeping its changes, and queues its
+  events for FT_dispatchEvents all at once.
+  Returns INITIALIZATION_ERROR if no transaction is open, and SUCCESS
+  otherwise.
+*/
+int FT_commit(void);
+
+/*
+  Ends the open transaction, undoing all of its changes, newest first.
+  Undoing needs no memory, so it cannot fail part way.
+  Returns INITIALIZATION_ERROR if no transaction is open, and SUCCESS
+  otherwise.
+*/
+int FT_abort(void);
+
 /*
   Removes all contents of the data structure and
-  returns it to an uninitialized state.
+  returns it to an uninitialized state, ending any open transaction
+  as it stands.
   Returns INITIALIZATION_ERROR if not already initialized,
   and SUCCESS otherwise.
 */
@@ -3,13 +3,138 @@
 /* Author: Christopher Moretti                                        */
 /*--------------------------------------------------------------------*/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "ft.h"
 
+/* Writes the string pcText, with its terminating '\0', to a new host
+   file with path pcPath. */
+static void writeHostFile(const char *pcPath, const char *pcText) {
+  FILE *psFile = fopen(pcPath, "w");
+  assert(psFile != NULL);
+  assert(fwrite(pcText, 1, strlen(pcText) + 1, psFile) ==
+         strlen(pcText) + 1);
+  assert(fclose(psFile) == 0);
+}
+
+/* Removes the host directory pcPath and everything below it. */
+static void removeHostTree(const char *pcPath) {
+  char acPath[200];
+  struct dirent *psEntry;
+  struct stat sStat;
+  DIR *psDir = opendir(pcPath);
+  assert(psDir != NULL);
+  while ((psEntry = readdir(psDir)) != NULL) {
+    if (!strcmp(psEntry->d_name, ".") || !strcmp(psEntry->d_name, ".."))
+      continue;
+    sprintf(acPath, "%.100s/%.90s", pcPath, psEntry->d_name);
+    assert(lstat(acPath, &sStat) == 0);
+    if (S_ISDIR(sStat.st_mode))
+      removeHostTree(acPath);
+    else
+      assert(unlink(acPath) == 0);
+  }
+  assert(closedir(psDir) == 0);
+  assert(rmdir(pcPath) == 0);
+}
+
+/* Asserts that the host file pcPath holds exactly the ulLength bytes
+   at pvBytes. */
+static void checkHostFile(const char *pcPath, const void *pvBytes,
+                          size_t ulLength) {
+  char acBytes[100];
+  FILE *psFile = fopen(pcPath, "r");
+  assert(psFile != NULL);
+  assert(fread(acBytes, 1, sizeof(acBytes), psFile) == ulLength);
+  assert(!memcmp(acBytes, pvBytes, ulLength));
+  assert(fclose(psFile) == 0);
+}
+
+/* Fills the FT, in whatever mode it is in, with enough nodes to take
+   many pages and some of them long, moves, copies and removes some
+   subtrees, and returns FT_toString, which the caller frees. */
+static char *buildPagedTree(void) {
+  char acPath[100];
+  unsigned long ul;
+
+  for (ul = 0; ul < 3000; ul++) {
+    sprintf(acPath, "1root/d%02lu/sub%03lu/file%05lu", ul % 37,
+            ul % 101, ul);
+    assert(FT_insertFile(acPath, acPath, strlen(acPath) + 1) ==
+           SUCCESS);
+  }
+  assert(FT_insertFile("1root/d01/sub001/file00001", NULL, 0) ==
+         NOT_A_DIRECTORY);
+  assert(FT_insertDir("1root/d01/sub001") == ALREADY_IN_TREE);
+  assert(FT_insertDir("1root/d01/sub001/file00001/x") ==
+         NOT_A_DIRECTORY);
+  assert(FT_insertDir("2root/d01") == CONFLICTING_PATH);
+  assert(FT_rename("1root/d05", "1root/d05/sub005/d05") ==
+         CONFLICTING_PATH);
+  assert(FT_rename("1root/d05", "1root/d06") == ALREADY_IN_TREE);
+  assert(FT_rename("1root/d05", "1root/e05") == SUCCESS);
+  assert(FT_rename("1root/d06/sub006/file00006", "1root/f06") ==
+         SUCCESS);
+  assert(FT_copy("1root/d07", "1root/d07/sub007/d07", FALSE) ==
+         SUCCESS);
+  assert(FT_copy("1root/d08", "1root/z08", TRUE) == SUCCESS);
+  assert(FT_copy("1root/d08", "1root/z08", TRUE) == ALREADY_IN_TREE);
+  assert(FT_rmDir("1root/d09") == SUCCESS);
+  assert(FT_rmDir("1root/d09") == NO_SUCH_PATH);
+  assert(FT_rmFile("1root/d10/sub010") == NOT_A_FILE);
+  assert(FT_rmDir("1root/d10/sub010") == SUCCESS);
+  assert(FT_writeFile("1root/z08/sub008/file00008", 2, "XY", 2) ==
+         SUCCESS);
+  return FT_toString();
+}
+
+/* Appends a line for an FT_watch event to the log pvLog, a char
+   array of ARRLEN bytes: the kind's letter, then iEvent's path. */
+static void logEvent(int iEvent, const char *pcPath, void *pvLog) {
+  char *pcLog = pvLog;
+  size_t ulUsed = strlen(pcLog);
+  assert(ulUsed + strlen(pcPath) + 4 < 1000);
+  sprintf(pcLog + ulUsed, "%c %s\n", "CRML"[iEvent], pcPath);
+}
+
+/* Appends a line for an FT_diff difference to the log pvLog, as for
+   logEvent. */
+static void logDiff(int iDiff, const char *pcPath, void *pvLog) {
+  char *pcLog = pvLog;
+  size_t ulUsed = strlen(pcLog);
+  assert(ulUsed + strlen(pcPath) + 4 < 1000);
+  sprintf(pcLog + ulUsed, "%c %s\n", "ARC"[iDiff], pcPath);
+}
+
+/* Counts an FT_watch event in pvCounts, an array of a count of
+   events and a count of FT_EVENT_LOST reports. */
+static void countEvent(int iEvent, const char *pcPath, void *pvCounts) {
+  size_t *pulCounts = pvCounts;
+  (void)pcPath;
+  pulCounts[iEvent == FT_EVENT_LOST]++;
+}
+
+/* Dispatches FT_watch events until the flag at pvStop is set and no
+   events are left. Returns NULL. */
+static void *dispatchUntilStopped(void *pvStop) {
+  size_t ulEvents;
+  do {
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+  } while (ulEvents != 0 ||
+           !__atomic_load_n((int *)pvStop, __ATOMIC_ACQUIRE));
+  return NULL;
+}
+
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
@@ -235,11 +360,1260 @@ int main(void) {
   fprintf(stderr, "Checkpoint 4.5:\n%s\n", temp);
   free(temp);
 
+  /* rename moves a whole subtree, keeping contents, and the moved
+     descendants report their new paths */
+  assert(FT_rename("1root/x", "1root/y/CHILD2DIR/x") == SUCCESS);
+  assert(FT_containsDir("1root/x") == FALSE);
+  assert(FT_containsDir("1root/y/CHILD2DIR/x") == TRUE);
+  assert(FT_containsFile("1root/y/CHILD2DIR/x/B") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/y/CHILD2DIR/x/C"),
+                 "Ritchie"));
+  assert(FT_rename("1root/y/CHILD2DIR", "1root/z") == SUCCESS);
+  assert(FT_containsFile("1root/z/x/B") == TRUE);
+  assert(FT_insertFile("1root/z/x/c++/D", NULL, 0) == SUCCESS);
+  assert(FT_rename("1root/z/x/c++/D", "1root/y/D") == SUCCESS);
+  assert(FT_containsFile("1root/y/D") == TRUE);
+  assert(FT_rename("1root/z", "1root/z/x/c++/z") == CONFLICTING_PATH);
+  assert(FT_rename("1root/z", "1other/z") == CONFLICTING_PATH);
+  assert(FT_rename("1root/nope", "1root/z2") == NO_SUCH_PATH);
+  assert(FT_rename("1root/z", "1root/nope/z") == NO_SUCH_PATH);
+  assert(FT_rename("1root/z", "1root/y/D/z") == NOT_A_DIRECTORY);
+  assert(FT_rename("1root/z", "1root/y") == ALREADY_IN_TREE);
+  assert(FT_rename("1root/z", "1root/z/") == BAD_PATH);
+  assert(FT_rename("1root", "1root/z") == CONFLICTING_PATH);
+  assert(FT_rename("1root", "0root") == SUCCESS);
+  assert(FT_containsFile("0root/z/x/C") == TRUE);
+  assert(FT_containsDir("1root") == FALSE);
+  assert((temp = FT_toString()) != NULL);
+  fprintf(stderr, "Checkpoint 5:\n%s\n", temp);
+  free(temp);
+
+  /* copy duplicates a subtree, sharing or copying file contents;
+     copying a directory into its own subtree copies the original */
+  assert(FT_copy("0root/z", "0root/w", FALSE) == SUCCESS);
+  assert(FT_getFileContents("0root/w/x/C") ==
+         FT_getFileContents("0root/z/x/C"));
+  assert(FT_copy("0root/z", "0root/z/x/c++/z", TRUE) == SUCCESS);
+  assert(FT_containsDir("0root/z/x/c++/z/x/c++") == TRUE);
+  assert(FT_containsDir("0root/z/x/c++/z/x/c++/z") == FALSE);
+  assert(FT_getFileContents("0root/z/x/c++/z/x/C") !=
+         FT_getFileContents("0root/z/x/C"));
+  assert(!strcmp(FT_getFileContents("0root/z/x/c++/z/x/C"),
+                 "Ritchie"));
+  assert(FT_copy("0root/z/x/c++/z", "0root/v", FALSE) == SUCCESS);
+  assert(FT_getFileContents("0root/v/x/C") ==
+         FT_getFileContents("0root/z/x/c++/z/x/C"));
+  assert(FT_rmDir("0root/z/x/c++/z") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("0root/v/x/C"), "Ritchie"));
+  assert(!strcmp(FT_replaceFileContents("0root/v/x/C", "Kernighan",
+                                        strlen("Kernighan")+1),
+                 "Ritchie"));
+  assert(FT_rename("0root/v/x", "0root/v/u") == SUCCESS);
+  assert(FT_containsFile("0root/v/u/B") == TRUE);
+  assert(FT_copy("0root/z", "0root/w", FALSE) == ALREADY_IN_TREE);
+  assert(FT_copy("0root/nope", "0root/n", FALSE) == NO_SUCH_PATH);
+  assert(FT_copy("0root/z", "0root/y/D/z", FALSE) == NOT_A_DIRECTORY);
+  assert(FT_copy("0root/z", "0root/nope/z", FALSE) == NO_SUCH_PATH);
+  assert(FT_copy("0root", "1root", FALSE) == CONFLICTING_PATH);
+  assert((temp = FT_toString()) != NULL);
+  fprintf(stderr, "Checkpoint 6:\n%s\n", temp);
+  free(temp);
+
   assert(FT_destroy() == SUCCESS);
   assert(FT_destroy() == INITIALIZATION_ERROR);
   assert(FT_containsDir("1root") == FALSE);
   assert(FT_containsFile("1root") == FALSE);
   assert((temp = FT_toString()) == NULL);
 
+  /* In the owned-contents mode the FT keeps its own copy of file
+     contents, so the caller's buffer can be reused right away, and
+     removals that free up most of the arena compact it.
+  */
+  assert(FT_initOwned() == SUCCESS);
+  assert(FT_initOwned() == INITIALIZATION_ERROR);
+  assert(FT_init() == INITIALIZATION_ERROR);
+  strcpy(arr, "owned");
+  assert(FT_insertFile("1root/keep", arr, ARRLEN) == SUCCESS);
+  strcpy(arr, "changed");
+  assert(FT_getFileContents("1root/keep") != arr);
+  assert(!strcmp(FT_getFileContents("1root/keep"), "owned"));
+  assert(FT_insertFile("1root/null", NULL, 0) == SUCCESS);
+  assert(FT_getFileContents("1root/null") == NULL);
+  for (l = 0; l < 200; l++) {
+    sprintf(arr, "1root/d/f%lu", (unsigned long)l);
+    assert(FT_insertFile(arr, arr, ARRLEN) == SUCCESS);
+  }
+  assert(FT_copy("1root/d", "1root/e", TRUE) == SUCCESS);
+  assert(FT_copy("1root/d/f7", "1root/s", FALSE) == SUCCESS);
+  assert(FT_copy("1root/s", "1root/t", FALSE) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/e/f7"), "1root/d/f7"));
+  assert(FT_rmDir("1root/d") == SUCCESS);
+  assert(FT_rmDir("1root/e") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/keep"), "owned"));
+  assert(!strcmp(FT_getFileContents("1root/s"), "1root/d/f7"));
+  assert(FT_getFileContents("1root/s") == FT_getFileContents("1root/t"));
+  assert(!strcmp(FT_replaceFileContents("1root/keep", "again", 6),
+                 "owned"));
+  assert(!strcmp(FT_getFileContents("1root/keep"), "again"));
+  assert(FT_stat("1root/keep", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE);
+  assert(l == 6);
+  assert(FT_destroy() == SUCCESS);
+
+  /* Range reads and in-place writes, appends and truncations work
+     on the file's bytes without replacing the whole file. */
+  assert(FT_init() == SUCCESS);
+  assert(FT_insertFile("1root/r", "hello, world!",
+                       strlen("hello, world!")+1) == SUCCESS);
+  assert(FT_insertDir("1root/d") == SUCCESS);
+  assert(FT_readFile("1root/r", 7, arr, 5, &l) == SUCCESS);
+  assert(l == 5 && !strncmp(arr, "world", 5));
+  assert(FT_readFile("1root/r", 10, arr, 100, &l) == SUCCESS);
+  assert(l == 4);
+  assert(FT_readFile("1root/r", 100, arr, 5, &l) == SUCCESS);
+  assert(l == 0);
+  assert(FT_readFile("1root/d", 0, arr, 5, &l) == NOT_A_FILE);
+  assert(FT_readFile("1root/n", 0, arr, 5, &l) == NO_SUCH_PATH);
+  assert(FT_writeFile("1root/r", 7, "there", 5) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/r"), "hello, there!"));
+  assert(FT_truncateFile("1root/r", 5) == SUCCESS);
+  assert(FT_appendFile("1root/r", "!", 2) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/r"), "hello!"));
+  assert(FT_stat("1root/r", &bIsFile, &l) == SUCCESS);
+  assert(l == 7);
+  assert(FT_writeFile("1root/r", 9000, "far", 4) == SUCCESS);
+  assert(FT_stat("1root/r", &bIsFile, &l) == SUCCESS);
+  assert(l == 9004);
+  assert(FT_readFile("1root/r", 4095, arr, 10, &l) == SUCCESS);
+  assert(l == 10 && arr[0] == 0 && arr[9] == 0);
+  assert(FT_readFile("1root/r", 8999, arr, 10, &l) == SUCCESS);
+  assert(l == 5 && arr[0] == 0 && !strcmp(arr + 1, "far"));
+  assert(FT_truncateFile("1root/r", 3) == SUCCESS);
+  assert(FT_truncateFile("1root/r", 5000) == SUCCESS);
+  assert(FT_readFile("1root/r", 0, arr, 6, &l) == SUCCESS);
+  assert(l == 6 && !strncmp(arr, "hel", 3) && arr[3] == 0 && arr[5] == 0);
+  assert(FT_copy("1root/r", "1root/d/r", FALSE) == SUCCESS);
+  assert(FT_writeFile("1root/d/r", 0, "J", 1) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/d/r"), "Jel"));
+  assert(!strcmp(FT_getFileContents("1root/r"), "hel"));
+  assert(FT_insertFile("1root/z", NULL, 4) == SUCCESS);
+  assert(FT_appendFile("1root/z", "x", 2) == SUCCESS);
+  assert(FT_readFile("1root/z", 0, arr, 10, &l) == SUCCESS);
+  assert(l == 6 && arr[0] == 0 && !strcmp(arr + 4, "x"));
+  assert(FT_writeFile("1root/d", 0, "x", 1) == NOT_A_FILE);
+  assert(FT_truncateFile("1root/d", 0) == NOT_A_FILE);
+  {
+    /* Once written to, a file's old contents come back as a copy
+       the client owns, like the buffer it inserted. */
+    char *pcOld;
+
+    pcOld = FT_replaceFileContents("1root/d/r", "new", 4);
+    assert(pcOld != NULL && !strcmp(pcOld, "Jel"));
+    free(pcOld);
+    assert(!strcmp(FT_getFileContents("1root/d/r"), "new"));
+    assert(!strcmp(FT_replaceFileContents("1root/d/r", "newer", 6),
+                   "new"));
+    assert(FT_writeFile("1root/z", 0, "y", 1) == SUCCESS);
+    assert(FT_getFileContents("1root/z") != NULL);
+    pcOld = FT_replaceFileContents("1root/z", NULL, 0);
+    assert(pcOld != NULL && pcOld[0] == 'y');
+    free(pcOld);
+  }
+  assert(FT_destroy() == SUCCESS);
+
+  /* With deduplication, identical contents are stored once but each
+     file still reports its own size. */
+  assert(FT_initDeduped() == SUCCESS);
+  assert(FT_insertFile("1root/a", "same", 5) == SUCCESS);
+  assert(FT_insertFile("1root/b", "same", 5) == SUCCESS);
+  assert(FT_insertFile("1root/c", "other", 6) == SUCCESS);
+  assert(FT_insertFile("1root/e1", "", 0) == SUCCESS);
+  assert(FT_insertFile("1root/e2", "", 0) == SUCCESS);
+  assert(FT_getFileContents("1root/a") == FT_getFileContents("1root/b"));
+  assert(FT_getFileContents("1root/e1") ==
+         FT_getFileContents("1root/e2"));
+  {
+    size_t ulLogical, ulStored, ulSaved;
+    double dRatio;
+
+    assert(FT_getDedupStats(&ulLogical, &ulStored, &ulSaved,
+                            &dRatio) == SUCCESS);
+    assert(ulLogical == 16 && ulStored == 11 && ulSaved == 5);
+    assert(dRatio > 1.4 && dRatio < 1.5);
+    assert(!strcmp(FT_replaceFileContents("1root/c", "same", 5),
+                   "other"));
+    assert(FT_getFileContents("1root/c") ==
+           FT_getFileContents("1root/a"));
+    assert(!strcmp(FT_replaceFileContents("1root/a", "new", 4),
+                   "same"));
+    assert(!strcmp(FT_getFileContents("1root/b"), "same"));
+    assert(FT_stat("1root/b", &bIsFile, &l) == SUCCESS);
+    assert(l == 5);
+    assert(FT_rmFile("1root/b") == SUCCESS);
+    assert(FT_getDedupStats(&ulLogical, &ulStored, &ulSaved,
+                            &dRatio) == SUCCESS);
+    assert(ulLogical == 9 && ulStored == 9 && ulSaved == 0);
+  }
+  assert(FT_destroy() == SUCCESS);
+
+  /* Importing a host directory tree, first by reading every file,
+     then with mappings, then with several reader threads. Symbolic
+     links are skipped. */
+  {
+    char acTop[] = "/tmp/ft_importXXXXXX";
+    char acPath[100];
+
+    assert(mkdtemp(acTop) != NULL);
+    sprintf(acPath, "%s/a", acTop);
+    writeHostFile(acPath, "alpha");
+    sprintf(acPath, "%s/e", acTop);
+    assert(fclose(fopen(acPath, "w")) == 0);
+    sprintf(acPath, "%s/sub", acTop);
+    assert(mkdir(acPath, 0700) == 0);
+    sprintf(acPath, "%s/sub/b", acTop);
+    writeHostFile(acPath, "bravo");
+    sprintf(acPath, "%s/sub/deeper", acTop);
+    assert(mkdir(acPath, 0700) == 0);
+    sprintf(acPath, "%s/sub/deeper/c", acTop);
+    writeHostFile(acPath, "charlie");
+    sprintf(acPath, "%s/link", acTop);
+    assert(symlink("a", acPath) == 0);
+
+    assert(FT_importDir(acTop, "1root", FALSE, 1) ==
+           INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_importDir(acTop, "1root/x", FALSE, 1) == NO_SUCH_PATH);
+    assert(FT_importDir(acTop, "1root", FALSE, 1) == SUCCESS);
+    assert(FT_importDir(acTop, "1root", FALSE, 1) == ALREADY_IN_TREE);
+    assert(FT_importDir(acTop, "2root", FALSE, 1) == CONFLICTING_PATH);
+    assert(FT_importDir(acTop, "1root/a/x", FALSE, 1) ==
+           NOT_A_DIRECTORY);
+    assert(FT_importDir("/nonexistent/ft", "1root/x", FALSE, 1) ==
+           NO_SUCH_PATH);
+    sprintf(acPath, "%s/a", acTop);
+    assert(FT_importDir(acPath, "1root/x", FALSE, 1) ==
+           NOT_A_DIRECTORY);
+    assert(!FT_containsDir("1root/x"));
+    assert(!strcmp(FT_getFileContents("1root/a"), "alpha"));
+    assert(!strcmp(FT_getFileContents("1root/sub/deeper/c"),
+                   "charlie"));
+    assert(FT_stat("1root/e", &bIsFile, &l) == SUCCESS);
+    assert(bIsFile && l == 0);
+    assert(!FT_containsFile("1root/link"));
+
+    assert(FT_importDir(acTop, "1root/sub/m", TRUE, 1) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/sub/m/sub/b"), "bravo"));
+    assert(FT_importDir(acTop, "1root/p", FALSE, 4) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/p/sub/deeper/c"),
+                   "charlie"));
+    assert(FT_importDir(acTop, "1root/q", TRUE, 3) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/q/a"), "alpha"));
+    assert(FT_writeFile("1root/q/a", 0, "A", 1) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/q/a"), "Alpha"));
+    assert(!strcmp(FT_getFileContents("1root/a"), "alpha"));
+    assert(!strcmp(FT_replaceFileContents("1root/sub/m/a", "new", 4),
+                   "alpha"));
+    temp = FT_toString();
+    assert(temp != NULL);
+    assert(strstr(temp, "1root/p/sub/deeper/c\n") != NULL);
+    free(temp);
+
+    /* and writing trees back out, serially and with threads */
+    {
+      char acOut[] = "/tmp/ft_exportXXXXXX";
+
+      assert(mkdtemp(acOut) != NULL);
+      assert(FT_insertFile("1root/z", NULL, 3) == SUCCESS);
+      sprintf(acPath, "%s/x", acOut);
+      assert(FT_exportDir("1root/p", acPath, 1) == SUCCESS);
+      assert(FT_exportDir("1root/p", acPath, 1) == ALREADY_IN_TREE);
+      assert(FT_exportDir("1root/a", acPath, 1) == NOT_A_DIRECTORY);
+      assert(FT_exportDir("1root/n", acPath, 1) == NO_SUCH_PATH);
+      sprintf(acPath, "%s/x/sub/deeper/c", acOut);
+      checkHostFile(acPath, "charlie", 8);
+      sprintf(acPath, "%s/none/y", acOut);
+      assert(FT_exportDir("1root", acPath, 3) == NO_SUCH_PATH);
+      sprintf(acPath, "%s/y", acOut);
+      assert(FT_exportDir("1root", acPath, 3) == SUCCESS);
+      sprintf(acPath, "%s/y/q/a", acOut);
+      checkHostFile(acPath, "Alpha", 6);
+      sprintf(acPath, "%s/y/z", acOut);
+      checkHostFile(acPath, "\0\0\0", 3);
+      sprintf(acPath, "%s/y/e", acOut);
+      checkHostFile(acPath, "", 0);
+      sprintf(acPath, "%s/y", acOut);
+      assert(FT_importDir(acPath, "1root/back", FALSE, 1) == SUCCESS);
+      assert(!strcmp(FT_getFileContents("1root/back/sub/m/a"), "new"));
+      assert(FT_stat("1root/back/p/sub/deeper", &bIsFile, &l) ==
+             SUCCESS);
+      assert(!bIsFile);
+      removeHostTree(acOut);
+    }
+    assert(FT_rmDir("1root/sub") == SUCCESS);
+    assert(FT_destroy() == SUCCESS);
+
+    /* mapped contents live alongside deduplicated ones */
+    assert(FT_initDeduped() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_importDir(acTop, "1root/c", FALSE, 1) == SUCCESS);
+    assert(FT_importDir(acTop, "1root/m", TRUE, 2) == SUCCESS);
+    assert(FT_getFileContents("1root/m/a") !=
+           FT_getFileContents("1root/c/a"));
+    assert(!strcmp(FT_getFileContents("1root/m/a"), "alpha"));
+    assert(FT_rmDir("1root/c") == SUCCESS);
+    assert(FT_destroy() == SUCCESS);
+
+    removeHostTree(acTop);
+  }
+
+  /* Archiving the FT as a tar file and reading it back, both mapped
+     from a regular file and streamed through a pipe, with paths too
+     long for a plain USTAR name field. */
+  {
+    char acArchive[] = "/tmp/ft_tarXXXXXX";
+    char acLong[300];
+    char acBytes[2048];
+    char *pcBefore;
+    int iFd;
+    int aiPipe[2];
+    ssize_t lArchive;
+
+    assert(FT_exportTar(1) == INITIALIZATION_ERROR);
+    assert(FT_importTar(0) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertFile("1root/a", "alpha", 6) == SUCCESS);
+    assert(FT_insertFile("1root/2child/b", NULL, 5000) == SUCCESS);
+    assert(FT_writeFile("1root/2child/b", 4096, "bravo", 6) == SUCCESS);
+    assert(FT_insertDir("1root/2child/3empty") == SUCCESS);
+    /* a 130-byte path fits a USTAR prefix, a 280-byte one needs PAX */
+    memset(acLong, 'm', sizeof(acLong));
+    memcpy(acLong, "1root/", 6);
+    memset(acLong + 67, 'n', 60);
+    strcpy(acLong + 127, "/c");
+    acLong[66] = '/';
+    assert(FT_insertFile(acLong, "charlie", 8) == SUCCESS);
+    memset(acLong + 6, 'p', 90);
+    memset(acLong + 97, 'q', 90);
+    memset(acLong + 188, 'r', 90);
+    acLong[96] = acLong[187] = '/';
+    strcpy(acLong + 278, "/d");
+    assert(FT_insertFile(acLong, "delta", 6) == SUCCESS);
+    pcBefore = FT_toString();
+    assert(pcBefore != NULL);
+
+    iFd = mkstemp(acArchive);
+    assert(iFd >= 0);
+    assert(FT_exportTar(iFd) == SUCCESS);
+    lArchive = lseek(iFd, 0, SEEK_CUR);
+    assert(lArchive > 0 && lArchive % 512 == 0);
+    assert(FT_destroy() == SUCCESS);
+
+    /* a mapped archive's file contents are slices of the mapping */
+    assert(FT_init() == SUCCESS);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == SUCCESS);
+    temp = FT_toString();
+    assert(temp != NULL && !strcmp(temp, pcBefore));
+    free(temp);
+    assert(!strcmp(FT_getFileContents("1root/a"), "alpha"));
+    assert(!strcmp(FT_getFileContents(acLong), "delta"));
+    assert(FT_readFile("1root/2child/b", 4090, acBytes, 12, &l) ==
+           SUCCESS);
+    assert(l == 12 && !memcmp(acBytes, "\0\0\0\0\0\0bravo", 12));
+    assert(FT_stat("1root/2child/3empty", &bIsFile, &l) == SUCCESS);
+    assert(!bIsFile);
+    assert(FT_writeFile("1root/a", 0, "A", 1) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/a"), "Alpha"));
+
+    /* importing again leaves the FT as it was */
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == ALREADY_IN_TREE);
+    assert(FT_rmFile("1root/a") == SUCCESS);
+    assert(FT_rmFile(acLong) == SUCCESS);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == ALREADY_IN_TREE);
+    assert(!FT_containsFile("1root/a"));
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("2root") == SUCCESS);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == CONFLICTING_PATH);
+    assert(FT_destroy() == SUCCESS);
+
+    /* a streamed archive is copied; a cut-off one is rejected */
+    assert(FT_init() == SUCCESS);
+    assert(pipe(aiPipe) == 0);
+    assert(pread(iFd, acBytes, sizeof(acBytes), 0) ==
+           (ssize_t)sizeof(acBytes));
+    assert(write(aiPipe[1], acBytes, 1000) == 1000);
+    assert(close(aiPipe[1]) == 0);
+    assert(FT_importTar(aiPipe[0]) == IO_ERROR);
+    assert(close(aiPipe[0]) == 0);
+    assert(!FT_containsDir("1root"));
+    assert(pipe(aiPipe) == 0);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    while ((lArchive = read(iFd, acBytes, sizeof(acBytes))) > 0)
+      assert(write(aiPipe[1], acBytes, (size_t)lArchive) == lArchive);
+    assert(close(aiPipe[1]) == 0);
+    assert(FT_importTar(aiPipe[0]) == SUCCESS);
+    assert(close(aiPipe[0]) == 0);
+    temp = FT_toString();
+    assert(temp != NULL && !strcmp(temp, pcBefore));
+    free(temp);
+    assert(!strcmp(FT_getFileContents(acLong), "delta"));
+    assert(FT_destroy() == SUCCESS);
+
+    free(pcBefore);
+    assert(close(iFd) == 0);
+    assert(unlink(acArchive) == 0);
+  }
+
+  /* The on-disk mode keeps the tree in a paged B+tree: with a small
+     buffer pool most pages are on disk, yet every operation gives
+     the same tree as in memory. */
+  {
+    char acHostTop[] = "/tmp/ft_diskXXXXXX";
+    char acHost[64];
+    char acArchive[] = "/tmp/ft_disktarXXXXXX";
+    char acLong[960];
+    char acBytes[100];
+    char *pcInMemory;
+    char *pcOnDisk;
+    size_t ulHits, ulMisses, ulWrites, ulSaved;
+    double dRatio;
+    int iFd;
+
+    assert(FT_getPoolStats(&ulHits, &ulMisses, &ulWrites) ==
+           INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_getPoolStats(&ulHits, &ulMisses, &ulWrites) ==
+           INITIALIZATION_ERROR);
+    pcInMemory = buildPagedTree();
+    assert(pcInMemory != NULL);
+    assert(FT_destroy() == SUCCESS);
+
+    assert(FT_initOnDisk(NULL, 16) == SUCCESS);
+    assert(FT_initOnDisk(NULL, 16) == INITIALIZATION_ERROR);
+    assert((temp = FT_toString()) != NULL && !strcmp(temp, ""));
+    free(temp);
+    assert(FT_insertFile("A", NULL, 0) == CONFLICTING_PATH);
+    assert(FT_containsDir("1root") == FALSE);
+    pcOnDisk = buildPagedTree();
+    assert(pcOnDisk != NULL && !strcmp(pcOnDisk, pcInMemory));
+    free(pcOnDisk);
+    assert(FT_getPoolStats(&ulHits, &ulMisses, &ulWrites) == SUCCESS);
+    assert(ulHits > 0 && ulMisses > 0 && ulWrites > 0);
+
+    /* contents follow their files through renames and copies */
+    assert(FT_containsFile("1root/e05/sub005/file00005"));
+    assert(!FT_containsDir("1root/e05/sub005/file00005"));
+    assert(!strcmp(FT_getFileContents("1root/e05/sub005/file00005"),
+                   "1root/d05/sub005/file00005"));
+    assert(!strcmp(FT_getFileContents("1root/f06"),
+                   "1root/d06/sub006/file00006"));
+    assert(!strcmp(FT_getFileContents("1root/z08/sub008/file00008"),
+                   "1rXYt/d08/sub008/file00008"));
+    assert(!strcmp(FT_getFileContents("1root/d08/sub008/file00008"),
+                   "1root/d08/sub008/file00008"));
+    assert(FT_getFileContents("1root/d08") == NULL);
+
+    /* a shallow copy shares stored bytes until one side changes */
+    assert(FT_getDedupStats(&l, &ulWrites, &ulSaved, &dRatio) ==
+           SUCCESS);
+    assert(ulSaved > 0);
+    assert(FT_writeFile("1root/d07/sub007/d07/sub007/file00007", 0,
+                        "2", 1) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/d07/sub007/file00007"),
+                   "1root/d07/sub007/file00007"));
+    assert(FT_stat("1root/d07", &bIsFile, &l) == SUCCESS && !bIsFile);
+    assert(FT_stat("1root/d07/sub007/file00007", &bIsFile, &l) ==
+           SUCCESS);
+    assert(bIsFile && l == 27);
+
+    /* files spanning several pages, sparse growth and shrinking */
+    assert(FT_insertFile("1root/big", NULL, 10000) == SUCCESS);
+    assert(FT_writeFile("1root/big", 9000, "tail", 4) == SUCCESS);
+    assert(FT_appendFile("1root/big", "end", 4) == SUCCESS);
+    assert(FT_stat("1root/big", &bIsFile, &l) == SUCCESS && l == 10004);
+    assert(FT_readFile("1root/big", 8998, acBytes, 8, &l) == SUCCESS);
+    assert(l == 8 && !memcmp(acBytes, "\0\0tail\0\0", 8));
+    assert(FT_readFile("1root/big", 10000, acBytes, 100, &l) ==
+           SUCCESS);
+    assert(l == 4 && !strcmp(acBytes, "end"));
+    assert(FT_truncateFile("1root/big", 9001) == SUCCESS);
+    assert(FT_truncateFile("1root/big", 9010) == SUCCESS);
+    assert(FT_readFile("1root/big", 8999, acBytes, 100, &l) == SUCCESS);
+    assert(l == 11 && !memcmp(acBytes, "\0t\0\0\0\0\0\0\0\0\0", 11));
+    assert(FT_readFile("1root", 0, acBytes, 1, &l) == NOT_A_FILE);
+    assert(FT_insertFile("1root/f3", "abc", 3) == SUCCESS);
+    assert(FT_writeFile("1root/f3", 10, "", 0) == SUCCESS);
+    assert(FT_stat("1root/f3", &bIsFile, &l) == SUCCESS && l == 3);
+    assert(!strcmp(FT_replaceFileContents("1root/f06", "new", 4),
+                   "1root/d06/sub006/file00006"));
+    assert(!strcmp(FT_getFileContents("1root/f06"), "new"));
+
+    /* a path too long to be a key is rejected */
+    memset(acLong, 'k', sizeof(acLong) - 1);
+    acLong[sizeof(acLong) - 1] = '\0';
+    memcpy(acLong, "1root/", 6);
+    assert(FT_insertFile(acLong, NULL, 0) == BAD_PATH);
+    assert(FT_rmDir("1root/big") == NOT_A_DIRECTORY);
+    assert(FT_rmFile("1root/big") == SUCCESS);
+
+    /* tar archives and host directories round-trip through memory */
+    iFd = mkstemp(acArchive);
+    assert(iFd >= 0);
+    assert(FT_exportTar(iFd) == SUCCESS);
+    pcOnDisk = FT_toString();
+    assert(pcOnDisk != NULL);
+    assert(mkdtemp(acHostTop) != NULL);
+    sprintf(acHost, "%s/out", acHostTop);
+    assert(FT_exportDir("1root/z08", acHost, 2) == SUCCESS);
+    assert(FT_exportDir("1root/f06", acHost, 1) == NOT_A_DIRECTORY);
+    assert(FT_importDir(acHost, "1root/z08", FALSE, 1) ==
+           ALREADY_IN_TREE);
+    assert(FT_importDir(acHost, "1root/y08", TRUE, 1) == SUCCESS);
+    assert(!strcmp(FT_getFileContents("1root/y08/sub008/file00008"),
+                   "1rXYt/d08/sub008/file00008"));
+    assert(FT_rmDir("1root") == SUCCESS);
+    assert(!FT_containsDir("1root"));
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == SUCCESS);
+    temp = FT_toString();
+    assert(temp != NULL && !strcmp(temp, pcOnDisk));
+    free(temp);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == ALREADY_IN_TREE);
+    assert(!strcmp(FT_getFileContents("1root/f06"), "new"));
+    assert(FT_rename("1root", "2root") == SUCCESS);
+    assert(FT_containsFile("2root/f06"));
+    assert(FT_destroy() == SUCCESS);
+
+    /* and the archive reads back the same in memory */
+    assert(FT_init() == SUCCESS);
+    assert(lseek(iFd, 0, SEEK_SET) == 0);
+    assert(FT_importTar(iFd) == SUCCESS);
+    temp = FT_toString();
+    assert(temp != NULL && !strcmp(temp, pcOnDisk));
+    free(temp);
+    assert(FT_destroy() == SUCCESS);
+
+    removeHostTree(acHostTop);
+    free(pcOnDisk);
+    free(pcInMemory);
+    assert(close(iFd) == 0);
+    assert(unlink(acArchive) == 0);
+  }
+
+  /* a content tier keeps only a budget of large contents in memory,
+     spilling the rest to a scratch file and reading them back */
+  {
+    char acBig[2000];
+    char acPath[32];
+    char acHostTop[] = "/tmp/ft_tierXXXXXX";
+    char acHost[64];
+    size_t ulHits, ulMisses, ulSpilled;
+    size_t ulLastMisses;
+    size_t ulIndex;
+    size_t l;
+    char *pcOld;
+
+    assert(FT_init() == SUCCESS);
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) ==
+           INITIALIZATION_ERROR);
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) ==
+           INITIALIZATION_ERROR);
+
+    assert(FT_initTiered(TRUE, 5000, 1000) == SUCCESS);
+    assert(FT_initTiered(TRUE, 5000, 1000) == INITIALIZATION_ERROR);
+    for (ulIndex = 0; ulIndex < 8; ulIndex++)
+    {
+      memset(acBig, 'a' + (int)ulIndex, sizeof(acBig));
+      sprintf(acPath, "1root/big%lu", (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, acBig, sizeof(acBig)) == SUCCESS);
+    }
+    assert(FT_insertFile("1root/small", "tiny", 5) == SUCCESS);
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) == SUCCESS);
+    assert(ulMisses == 0);
+    assert(ulSpilled == 6 * sizeof(acBig));
+
+    /* every spilled file reads back whole, from the oldest on */
+    for (ulIndex = 0; ulIndex < 8; ulIndex++)
+    {
+      memset(acBig, 'a' + (int)ulIndex, sizeof(acBig));
+      sprintf(acPath, "1root/big%lu", (unsigned long)ulIndex);
+      assert(!memcmp(FT_getFileContents(acPath), acBig,
+                     sizeof(acBig)));
+    }
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) == SUCCESS);
+    assert(ulMisses == 8);
+    /* read back copies are already in the scratch file */
+    assert(ulSpilled == 8 * sizeof(acBig));
+
+    /* the most recent stays in memory */
+    assert(!memcmp(FT_getFileContents("1root/big7"), acBig, 10));
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) == SUCCESS);
+    assert(ulHits == 1 && ulMisses == 8);
+    ulLastMisses = ulMisses;
+    assert(FT_readFile("1root/big0", 1990, acBig, 100, &l) == SUCCESS);
+    assert(l == 10 && acBig[0] == 'a' && acBig[9] == 'a');
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) == SUCCESS);
+    assert(ulMisses == ulLastMisses + 1);
+    assert(!strcmp(FT_getFileContents("1root/small"), "tiny"));
+
+    /* identical contents are still found when spilled */
+    memset(acBig, 'b', sizeof(acBig));
+    assert(FT_insertFile("1root/again1", acBig, sizeof(acBig)) ==
+           SUCCESS);
+    assert(FT_copy("1root/big2", "1root/copy2", TRUE) == SUCCESS);
+    assert(FT_getTierStats(&ulHits, &ulMisses, &ulSpilled) == SUCCESS);
+    assert(ulSpilled == 8 * sizeof(acBig));
+
+    /* replaced contents stay readable until the next call */
+    memset(acBig, 'z', sizeof(acBig));
+    pcOld = FT_replaceFileContents("1root/big3", acBig, sizeof(acBig));
+    assert(pcOld != NULL && pcOld[0] == 'd' && pcOld[1999] == 'd');
+    assert(FT_writeFile("1root/big4", 0, "E", 1) == SUCCESS);
+    assert(FT_readFile("1root/big4", 0, acBig, 3, &l) == SUCCESS);
+    assert(l == 3 && !memcmp(acBig, "Eee", 3));
+    assert(FT_rmFile("1root/big5") == SUCCESS);
+
+    /* threads export spilled contents safely */
+    assert(mkdtemp(acHostTop) != NULL);
+    sprintf(acHost, "%s/out", acHostTop);
+    assert(FT_exportDir("1root", acHost, 4) == SUCCESS);
+    assert(FT_importDir(acHost, "1root/back", TRUE, 4) == SUCCESS);
+    assert(FT_readFile("1root/back/big6", 1000, acBig, 2, &l) == SUCCESS);
+    assert(l == 2 && !memcmp(acBig, "gg", 2));
+    assert(!memcmp(FT_getFileContents("1root/back/copy2"), "ccc", 3));
+    assert(FT_getFileContents("1root/back/big3") != NULL);
+    assert(((char *)FT_getFileContents("1root/back/big3"))[1999] == 'z');
+    removeHostTree(acHostTop);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* large contents are kept compressed, and read back decompressed */
+  {
+    char acText[20000];
+    char acNoise[5000];
+    char acRun[70000];
+    char acPath[32];
+    char acHostTop[] = "/tmp/ft_lzXXXXXX";
+    char acHost[64];
+    size_t ulRaw, ulPacked, ulLogical, ulStored, ulSaved;
+    unsigned long ulSeed = 12345;
+    size_t ulIndex;
+    size_t ulUsed;
+    size_t l;
+    double dRatio;
+    char *pcOld;
+
+    assert(FT_init() == SUCCESS);
+    assert(FT_getCompressionStats(&ulRaw, &ulPacked) ==
+           INITIALIZATION_ERROR);
+    assert(FT_destroy() == SUCCESS);
+
+    for (ulUsed = 0, ulIndex = 0; ulUsed < sizeof(acText); ulIndex++)
+    {
+      sprintf(acPath, "line %05lu: ", (unsigned long)ulIndex);
+      for (l = 0; acPath[l] != '\0' && ulUsed < sizeof(acText); l++)
+        acText[ulUsed++] = acPath[l];
+      for (l = 0; l < 24 && ulUsed < sizeof(acText); l++)
+        acText[ulUsed++] = "the quick brown fox\n"[l % 20];
+    }
+    for (ulIndex = 0; ulIndex < sizeof(acNoise); ulIndex++)
+    {
+      ulSeed = ulSeed * 1103515245UL + 12345UL;
+      acNoise[ulIndex] = (char)(ulSeed >> 16);
+    }
+    /* long runs copy from just behind themselves, and from far back */
+    for (ulIndex = 0; ulIndex < sizeof(acRun); ulIndex++)
+      acRun[ulIndex] = ulIndex < 40000 ? "abc"[ulIndex % 3] :
+                       acNoise[ulIndex % sizeof(acNoise)];
+
+    assert(FT_initCompressed(TRUE, 256) == SUCCESS);
+    assert(FT_initCompressed(TRUE, 256) == INITIALIZATION_ERROR);
+    assert(FT_insertFile("1root/text", acText, sizeof(acText)) ==
+           SUCCESS);
+    assert(FT_insertFile("1root/noise", acNoise, sizeof(acNoise)) ==
+           SUCCESS);
+    assert(FT_insertFile("1root/tiny", "tiny", 5) == SUCCESS);
+    assert(FT_insertFile("1root/run", acRun, sizeof(acRun)) == SUCCESS);
+    assert(FT_getCompressionStats(&ulRaw, &ulPacked) == SUCCESS);
+    assert(ulRaw == sizeof(acText) + sizeof(acRun));
+    assert(ulPacked != 0 && ulPacked < ulRaw / 2);
+    assert(FT_stat("1root/text", &bIsFile, &l) == SUCCESS);
+    assert(bIsFile && l == sizeof(acText));
+
+    assert(!memcmp(FT_getFileContents("1root/text"), acText,
+                   sizeof(acText)));
+    assert(!memcmp(FT_getFileContents("1root/noise"), acNoise,
+                   sizeof(acNoise)));
+    assert(!memcmp(FT_getFileContents("1root/run"), acRun,
+                   sizeof(acRun)));
+    assert(!strcmp(FT_getFileContents("1root/tiny"), "tiny"));
+    assert(FT_readFile("1root/text", 19990, acPath, 20, &l) == SUCCESS);
+    assert(l == 10 && !memcmp(acPath, acText + 19990, 10));
+
+    /* identical contents are found by their compressed form */
+    assert(FT_insertFile("1root/text2", acText, sizeof(acText)) ==
+           SUCCESS);
+    assert(FT_getCompressionStats(&ulRaw, &ulUsed) == SUCCESS);
+    assert(ulRaw == sizeof(acText) + sizeof(acRun));
+    assert(ulUsed == ulPacked);
+    assert(FT_getDedupStats(&ulLogical, &ulStored, &ulSaved,
+                            &dRatio) == SUCCESS);
+    assert(ulSaved == sizeof(acText));
+
+    /* more files than the cache holds still read back right */
+    for (ulIndex = 0; ulIndex < 6; ulIndex++)
+    {
+      acText[0] = (char)('A' + ulIndex);
+      sprintf(acPath, "1root/many%lu", (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, acText, sizeof(acText)) == SUCCESS);
+    }
+    for (ulIndex = 0; ulIndex < 6; ulIndex++)
+    {
+      acText[0] = (char)('A' + ulIndex);
+      sprintf(acPath, "1root/many%lu", (unsigned long)ulIndex);
+      assert(!memcmp(FT_getFileContents(acPath), acText,
+                     sizeof(acText)));
+    }
+    acText[0] = 'l';
+
+    /* replaced and written files keep their bytes */
+    pcOld = FT_replaceFileContents("1root/text", "short", 6);
+    assert(pcOld != NULL && !memcmp(pcOld, acText, sizeof(acText)));
+    assert(FT_writeFile("1root/run", 1, "X", 1) == SUCCESS);
+    assert(FT_readFile("1root/run", 0, acPath, 4, &l) == SUCCESS);
+    assert(l == 4 && !memcmp(acPath, "aXca", 4));
+    assert(FT_rmFile("1root/many0") == SUCCESS);
+    assert(FT_getCompressionStats(&ulRaw, &ulUsed) == SUCCESS);
+    assert(ulRaw == 5 * sizeof(acText) + sizeof(acText));
+
+    /* threads each decompress into their own cache */
+    assert(mkdtemp(acHostTop) != NULL);
+    sprintf(acHost, "%s/out", acHostTop);
+    assert(FT_exportDir("1root", acHost, 4) == SUCCESS);
+    assert(FT_importDir(acHost, "1root/back", TRUE, 4) == SUCCESS);
+    assert(!memcmp(FT_getFileContents("1root/back/text2"), acText,
+                   sizeof(acText)));
+    assert(!memcmp(FT_getFileContents("1root/back/noise"), acNoise,
+                   sizeof(acNoise)));
+    acText[0] = 'E';
+    assert(!memcmp(FT_getFileContents("1root/back/many4"), acText,
+                   sizeof(acText)));
+    removeHostTree(acHostTop);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* watches are told of the changes they cover, when dispatched */
+  {
+    char acDir[ARRLEN];
+    char acTree[ARRLEN];
+    char acPath[32];
+    size_t aulCounts[2] = {0, 0};
+    size_t ulDir, ulTree, ulCount, ulEvents;
+    size_t ulIndex;
+    pthread_t sThread;
+    int iStop = 0;
+
+    acDir[0] = '\0';
+    acTree[0] = '\0';
+    assert(FT_watch("1root", TRUE, logEvent, acTree, &ulTree) ==
+           INITIALIZATION_ERROR);
+    assert(FT_initOnDisk(NULL, 16) == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_watch("1root", TRUE, logEvent, acTree, &ulTree) ==
+           INITIALIZATION_ERROR);
+    assert(FT_destroy() == SUCCESS);
+
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root/a") == SUCCESS);
+    assert(FT_insertDir("1root/x") == SUCCESS);
+    assert(FT_watch("1root/a", FALSE, logEvent, acDir, &ulDir) ==
+           SUCCESS);
+    assert(FT_watch("1root", TRUE, logEvent, acTree, &ulTree) ==
+           SUCCESS);
+    assert(ulDir != ulTree);
+    assert(FT_watch("1root/nope", TRUE, logEvent, acTree, &ulCount) ==
+           NO_SUCH_PATH);
+    assert(FT_watch("1root//a", TRUE, logEvent, acTree, &ulCount) ==
+           BAD_PATH);
+
+    assert(FT_insertFile("1root/a/f", "f", 2) == SUCCESS);
+    assert(FT_insertFile("1root/a/b/c/g", "g", 2) == SUCCESS);
+    assert(FT_writeFile("1root/a/b/c/g", 0, "G", 1) == SUCCESS);
+    assert(FT_replaceFileContents("1root/a/f", "F", 2) != NULL);
+    assert(FT_rename("1root/a/f", "1root/x/f") == SUCCESS);
+    assert(FT_copy("1root/a/b", "1root/x/b", TRUE) == SUCCESS);
+    assert(FT_rmDir("1root/a") == SUCCESS);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 8);
+    assert(!strcmp(acDir, "C 1root/a/f\n"
+                          "C 1root/a/b\n"
+                          "M 1root/a/f\n"
+                          "R 1root/a/f\n"
+                          "R 1root/a\n"));
+    assert(!strcmp(acTree, "C 1root/a/f\n"
+                           "C 1root/a/b\n"
+                           "M 1root/a/b/c/g\n"
+                           "M 1root/a/f\n"
+                           "R 1root/a/f\n"
+                           "C 1root/x/f\n"
+                           "C 1root/x/b\n"
+                           "R 1root/a\n"));
+
+    /* a watch lapses with its node, and resumes with a new one; a
+       change no watch covers is not even queued */
+    acDir[0] = '\0';
+    acTree[0] = '\0';
+    assert(FT_unwatch(ulTree) == SUCCESS);
+    assert(FT_unwatch(ulTree) == NO_SUCH_PATH);
+    assert(FT_appendFile("1root/x/f", "more", 4) == SUCCESS);
+    assert(FT_insertDir("1root/a/new") == SUCCESS);
+    assert(FT_insertFile("1root/a/new/deep", NULL, 0) == SUCCESS);
+    assert(FT_truncateFile("1root/x/f", 0) == SUCCESS);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 1);
+    assert(!strcmp(acDir, "C 1root/a\n"));
+    assert(acTree[0] == '\0');
+
+    /* too many undelivered events are reported as lost */
+    acDir[0] = '\0';
+    for (ulIndex = 0; ulIndex < 1500; ulIndex++)
+      assert(FT_writeFile("1root/x/f", 0, "w", 1) == SUCCESS);
+    assert(FT_watch("1root/x", FALSE, countEvent, aulCounts,
+                    &ulCount) == SUCCESS);
+    for (ulIndex = 0; ulIndex < 1500; ulIndex++)
+      assert(FT_writeFile("1root/x/f", 0, "w", 1) == SUCCESS);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 1024);
+    assert(aulCounts[0] == 1024 && aulCounts[1] == 1);
+    assert(!strcmp(acDir, "L 1root/a\n"));
+    assert(FT_unwatch(ulDir) == SUCCESS);
+
+    /* a thread can dispatch while another changes the tree */
+    aulCounts[0] = 0;
+    aulCounts[1] = 0;
+    assert(pthread_create(&sThread, NULL, dispatchUntilStopped,
+                          &iStop) == 0);
+    for (ulIndex = 0; ulIndex < 5000; ulIndex++)
+    {
+      sprintf(acPath, "1root/x/t%lu", (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+    }
+    __atomic_store_n(&iStop, 1, __ATOMIC_RELEASE);
+    assert(pthread_join(sThread, NULL) == 0);
+    /* losses made after the thread's last look at them */
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(aulCounts[0] == 5000 ||
+           (aulCounts[0] < 5000 && aulCounts[1] != 0));
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_dispatchEvents(&ulEvents) == INITIALIZATION_ERROR);
+  }
+
+  /* subtrees hash alike when equal, and FT_diff reports only what
+     differs */
+  {
+    char acLog[ARRLEN];
+    char acPath[32];
+    size_t ulHash, ulOther, ulIndex;
+
+    acLog[0] = '\0';
+    assert(FT_getHash("1root", &ulHash) == INITIALIZATION_ERROR);
+    assert(FT_initDeduped() == SUCCESS);
+    assert(FT_getHash("1root", &ulHash) == NO_SUCH_PATH);
+    for (ulIndex = 0; ulIndex < 2000; ulIndex++)
+    {
+      sprintf(acPath, "1root/a/d%lu/f%lu", (unsigned long)(ulIndex % 50),
+              (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, acPath, strlen(acPath)) == SUCCESS);
+    }
+    assert(FT_insertDir("1root/a/empty") == SUCCESS);
+    assert(FT_copy("1root/a", "1root/snap", FALSE) == SUCCESS);
+    assert(FT_getHash("1root/a", &ulHash) == SUCCESS);
+    assert(FT_getHash("1root/snap", &ulOther) == SUCCESS);
+    assert(ulHash == ulOther);
+    assert(FT_diff("1root/a", "1root/snap", logDiff, acLog) ==
+           SUCCESS);
+    assert(acLog[0] == '\0');
+    assert(FT_diff("1root/a", "1root/a/d0/f0", logDiff, acLog) ==
+           NOT_A_DIRECTORY);
+    assert(FT_diff("1root/a", "1root/b", logDiff, acLog) ==
+           NO_SUCH_PATH);
+
+    /* a file whose bytes go back to what they were hashes as before,
+       however they were changed */
+    assert(FT_writeFile("1root/a/d7/f7", 0, "X", 1) == SUCCESS);
+    assert(FT_getHash("1root/a", &ulOther) == SUCCESS);
+    assert(ulHash != ulOther);
+    assert(FT_writeFile("1root/a/d7/f7", 0, "1", 1) == SUCCESS);
+    assert(FT_getHash("1root/a", &ulOther) == SUCCESS);
+    assert(ulHash == ulOther);
+
+    assert(FT_appendFile("1root/a/d7/f7", "!", 1) == SUCCESS);
+    assert(FT_rmFile("1root/a/d3/f53") == SUCCESS);
+    assert(FT_insertFile("1root/a/d3/new", NULL, 4) == SUCCESS);
+    assert(FT_rmDir("1root/a/d9") == SUCCESS);
+    assert(FT_rmDir("1root/a/empty") == SUCCESS);
+    assert(FT_insertFile("1root/a/empty", NULL, 0) == SUCCESS);
+    assert(FT_rename("1root/a/d4/f4", "1root/a/d4/g4") == SUCCESS);
+    assert(FT_diff("1root/a", "1root/snap", logDiff, acLog) ==
+           SUCCESS);
+    assert(!strcmp(acLog, "A d3/f53\n"
+                          "R d3/new\n"
+                          "A d4/f4\n"
+                          "R d4/g4\n"
+                          "C d7/f7\n"
+                          "A d9\n"
+                          "C empty\n"));
+
+    /* the same holds in the other direction, and for directories
+       equal under different names */
+    acLog[0] = '\0';
+    assert(FT_diff("1root/snap/d0", "1root/a/d0", logDiff, acLog) ==
+           SUCCESS);
+    assert(acLog[0] == '\0');
+    assert(FT_rename("1root/a/d0", "1root/a/zero") == SUCCESS);
+    assert(FT_getHash("1root/a/zero", &ulHash) == SUCCESS);
+    assert(FT_getHash("1root/snap/d0", &ulOther) == SUCCESS);
+    assert(ulHash == ulOther);
+    assert(FT_diff("1root/snap", "1root/a", logDiff, acLog) ==
+           SUCCESS);
+    assert(!strcmp(acLog, "R d0\n"
+                          "R d3/f53\n"
+                          "A d3/new\n"
+                          "R d4/f4\n"
+                          "A d4/g4\n"
+                          "C d7/f7\n"
+                          "R d9\n"
+                          "C empty\n"
+                          "A zero\n"));
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_diff("1root", "1root", logDiff, acLog) ==
+           INITIALIZATION_ERROR);
+  }
+
+  /* versioned files keep their replaced contents, sharing the chunks
+     versions have in common */
+  {
+    static char acBig[5][65536];
+    void *pvOld;
+    size_t ulOldest, ulCurrent, ulLength, ulIndex;
+    size_t ulLogical, ulStored, ulSaved, ulBefore;
+    double dRatio;
+
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           INITIALIZATION_ERROR);
+    assert(FT_initVersioned(3, 0) == SUCCESS);
+    assert(FT_initVersioned(3, 0) == INITIALIZATION_ERROR);
+    for (ulIndex = 0; ulIndex < 5; ulIndex++)
+    {
+      memset(acBig[ulIndex], 'a', sizeof(acBig[ulIndex]));
+      acBig[ulIndex][ulIndex * 10000] = (char)('0' + ulIndex);
+    }
+    assert(FT_insertFile("1root/v", acBig[0], sizeof(acBig[0])) ==
+           SUCCESS);
+    assert(FT_getFileVersions("1root", &ulOldest, &ulCurrent) ==
+           NOT_A_FILE);
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 0 && ulCurrent == 0);
+    assert(FT_getDedupStats(&ulLogical, &ulBefore, &ulSaved,
+                            &dRatio) == SUCCESS);
+
+    for (ulIndex = 1; ulIndex < 5; ulIndex++)
+      assert(FT_replaceFileContents("1root/v", acBig[ulIndex],
+                                    sizeof(acBig[ulIndex])) != NULL);
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 1 && ulCurrent == 4);
+
+    /* three chunked versions cost little more than one: the chunks
+       of all 'a' are stored once */
+    assert(FT_getDedupStats(&ulLogical, &ulStored, &ulSaved,
+                            &dRatio) == SUCCESS);
+    assert(ulStored < ulBefore * 2 + 4 * 4096);
+
+    for (ulIndex = 1; ulIndex < 5; ulIndex++)
+    {
+      assert(FT_getFileContentsAt("1root/v", ulIndex, &pvOld,
+                                  &ulLength) == SUCCESS);
+      assert(ulLength == sizeof(acBig[ulIndex]));
+      assert(!memcmp(pvOld, acBig[ulIndex], ulLength));
+      free(pvOld);
+    }
+    assert(FT_getFileContentsAt("1root/v", 0, &pvOld, &ulLength) ==
+           NO_SUCH_PATH);
+    assert(pvOld == NULL && ulLength == 0);
+    assert(FT_getFileContentsAt("1root/v", 5, &pvOld, &ulLength) ==
+           NO_SUCH_PATH);
+    assert(FT_getFileContentsAt("1root", 1, &pvOld, &ulLength) ==
+           NOT_A_FILE);
+
+    /* writes change the current version; empty and NULL contents are
+       versions too */
+    assert(FT_writeFile("1root/v", 0, "W", 1) == SUCCESS);
+    assert(FT_replaceFileContents("1root/v", NULL, 10) != NULL);
+    assert(FT_replaceFileContents("1root/v", NULL, 0) == NULL);
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 3 && ulCurrent == 6);
+    assert(FT_getFileContentsAt("1root/v", 4, &pvOld, &ulLength) ==
+           SUCCESS);
+    assert(ulLength == 65536 && ((char *)pvOld)[0] == 'W');
+    assert(!memcmp((char *)pvOld + 1, acBig[4] + 1, ulLength - 1));
+    free(pvOld);
+    assert(FT_getFileContentsAt("1root/v", 5, &pvOld, &ulLength) ==
+           SUCCESS);
+    assert(ulLength == 10);
+    assert(!memcmp(pvOld, "\0\0\0\0\0\0\0\0\0\0", 10));
+    free(pvOld);
+    assert(FT_getFileContentsAt("1root/v", 6, &pvOld, &ulLength) ==
+           SUCCESS);
+    assert(pvOld == NULL && ulLength == 0);
+
+    /* a copy starts over; removals compact the arena under the
+       versions */
+    assert(FT_copy("1root/v", "1root/w", TRUE) == SUCCESS);
+    assert(FT_getFileVersions("1root/w", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 0 && ulCurrent == 0);
+    for (ulIndex = 0; ulIndex < 200; ulIndex++)
+    {
+      assert(FT_insertFile("1root/tmp", acBig[ulIndex % 5],
+                           4096 + ulIndex) == SUCCESS);
+      assert(FT_rmFile("1root/tmp") == SUCCESS);
+    }
+    assert(FT_getFileContentsAt("1root/v", 3, &pvOld, &ulLength) ==
+           SUCCESS);
+    assert(!memcmp(pvOld, acBig[3], ulLength));
+    free(pvOld);
+    assert(FT_destroy() == SUCCESS);
+
+    /* the byte limit drops versions that would go over it */
+    assert(FT_initVersioned(0, 100000) == SUCCESS);
+    assert(FT_insertFile("1root/v", acBig[0], 65536) == SUCCESS);
+    assert(FT_replaceFileContents("1root/v", "x", 1) != NULL);
+    assert(FT_replaceFileContents("1root/v", "y", 1) != NULL);
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 0 && ulCurrent == 2);
+    assert(FT_replaceFileContents("1root/v", acBig[1], 65536) != NULL);
+    assert(FT_replaceFileContents("1root/v", "z", 1) != NULL);
+    assert(FT_getFileVersions("1root/v", &ulOldest, &ulCurrent) ==
+           SUCCESS);
+    assert(ulOldest == 1 && ulCurrent == 4);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* a transaction's changes take effect together, or not at all */
+  {
+    char acLog[ARRLEN];
+    char acPath[32];
+    char acBuf[8];
+    char *pcBefore;
+    char *pcAfter;
+    size_t ulWatch, ulEvents, ulRead, ulIndex;
+    boolean bIsFile;
+    size_t ulSize;
+
+    acLog[0] = '\0';
+    assert(FT_begin() == INITIALIZATION_ERROR);
+    assert(FT_initOnDisk(NULL, 16) == SUCCESS);
+    assert(FT_begin() == INITIALIZATION_ERROR);
+    assert(FT_destroy() == SUCCESS);
+
+    assert(FT_initOwned() == SUCCESS);
+    assert(FT_commit() == INITIALIZATION_ERROR);
+    assert(FT_abort() == INITIALIZATION_ERROR);
+    assert(FT_insertFile("1root/a/f", "abcdef", 6) == SUCCESS);
+    assert(FT_insertFile("1root/a/g", "ghi", 3) == SUCCESS);
+    assert(FT_insertDir("1root/b/c") == SUCCESS);
+    assert(FT_watch("1root", TRUE, logEvent, acLog, &ulWatch) ==
+           SUCCESS);
+    pcBefore = FT_toString();
+    assert(pcBefore != NULL);
+
+    assert(FT_begin() == SUCCESS);
+    assert(FT_begin() == INITIALIZATION_ERROR);
+    assert(FT_insertDir("1root/new/deep") == SUCCESS);
+    assert(FT_insertFile("1root/new/deep/h", "h", 1) == SUCCESS);
+    assert(FT_insertDir("1root/new") == ALREADY_IN_TREE);
+    assert(FT_writeFile("1root/a/f", 2, "XY", 2) == SUCCESS);
+    assert(FT_appendFile("1root/a/f", "++", 2) == SUCCESS);
+    assert(FT_replaceFileContents("1root/a/g", "GG", 2) != NULL);
+    assert(FT_truncateFile("1root/a/g", 1) == SUCCESS);
+    assert(FT_rename("1root/a", "1root/b/a") == SUCCESS);
+    assert(FT_copy("1root/b/a", "1root/a", TRUE) == SUCCESS);
+    assert(FT_rmFile("1root/a/f") == SUCCESS);
+    assert(FT_insertFile("1root/a/f", "other", 5) == SUCCESS);
+    assert(FT_rmDir("1root/b") == SUCCESS);
+    assert(FT_importTar(-1) == INITIALIZATION_ERROR);
+
+    /* the changes show at once, but watches hear nothing yet */
+    assert(FT_readFile("1root/a/f", 0, acBuf, sizeof(acBuf),
+                       &ulRead) == SUCCESS);
+    assert(ulRead == 5 && !memcmp(acBuf, "other", 5));
+    assert(FT_stat("1root/b", &bIsFile, &ulSize) == NO_SUCH_PATH);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 0 && acLog[0] == '\0');
+
+    assert(FT_abort() == SUCCESS);
+    assert(FT_abort() == INITIALIZATION_ERROR);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 0 && acLog[0] == '\0');
+    pcAfter = FT_toString();
+    assert(pcAfter != NULL && !strcmp(pcBefore, pcAfter));
+    free(pcAfter);
+    assert(FT_readFile("1root/a/f", 0, acBuf, sizeof(acBuf),
+                       &ulRead) == SUCCESS);
+    assert(ulRead == 6 && !memcmp(acBuf, "abcdef", 6));
+    assert(FT_readFile("1root/a/g", 0, acBuf, sizeof(acBuf),
+                       &ulRead) == SUCCESS);
+    assert(ulRead == 3 && !memcmp(acBuf, "ghi", 3));
+
+    /* even the root can go and come back */
+    assert(FT_begin() == SUCCESS);
+    assert(FT_rmDir("1root") == SUCCESS);
+    assert(FT_insertDir("2root") == SUCCESS);
+    assert(FT_rename("2root", "3root") == SUCCESS);
+    assert(FT_abort() == SUCCESS);
+    pcAfter = FT_toString();
+    assert(pcAfter != NULL && !strcmp(pcBefore, pcAfter));
+    free(pcAfter);
+    free(pcBefore);
+
+    /* a committed transaction's events arrive together */
+    assert(FT_begin() == SUCCESS);
+    assert(FT_writeFile("1root/a/f", 0, "Z", 1) == SUCCESS);
+    assert(FT_rmFile("1root/a/g") == SUCCESS);
+    assert(FT_insertFile("1root/b/g", NULL, 0) == SUCCESS);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 0);
+    assert(FT_commit() == SUCCESS);
+    assert(FT_commit() == INITIALIZATION_ERROR);
+    assert(FT_dispatchEvents(&ulEvents) == SUCCESS);
+    assert(ulEvents == 3);
+    assert(!strcmp(acLog, "M 1root/a/f\n"
+                          "R 1root/a/g\n"
+                          "C 1root/b/g\n"));
+    assert(FT_containsFile("1root/b/g"));
+    assert(!FT_containsFile("1root/a/g"));
+
+    /* a batch of a hundred thousand changes undoes in one go */
+    assert(FT_begin() == SUCCESS);
+    for (ulIndex = 0; ulIndex < 100000; ulIndex++)
+    {
+      sprintf(acPath, "1root/big/%lu", (unsigned long)(ulIndex / 2));
+      if (ulIndex % 2 == 0)
+        assert(FT_insertFile(acPath, acPath, strlen(acPath)) ==
+               SUCCESS);
+      else
+        assert(FT_appendFile(acPath, "!", 1) == SUCCESS);
+    }
+    assert(FT_rmDir("1root/big") == SUCCESS);
+    assert(FT_abort() == SUCCESS);
+    assert(!FT_containsDir("1root/big"));
+    assert(FT_readFile("1root/a/f", 0, acBuf, sizeof(acBuf),
+                       &ulRead) == SUCCESS);
+    assert(ulRead == 6 && !memcmp(acBuf, "Zbcdef", 6));
+
+    /* destroying the FT ends a transaction as it stands */
+    assert(FT_begin() == SUCCESS);
+    assert(FT_rmDir("1root/a") == SUCCESS);
+    assert(FT_replaceFileContents("1root/b/g", "x", 1) == NULL);
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_init() == SUCCESS);
+    assert(FT_begin() == SUCCESS);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* wide directories insert in descending order and remove whole */
+  {
+    char acPath[32];
+    size_t ulIndex;
+    size_t ulSize;
+    boolean bIsFile;
+
+    assert(FT_init() == SUCCESS);
+    for (ulIndex = 60000; ulIndex > 0; ulIndex--)
+    {
+      sprintf(acPath, "1root/wide/%06lu", (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+    }
+    assert(FT_stat("1root/wide/000001", &bIsFile, &ulSize) == SUCCESS);
+    assert(bIsFile && ulSize == 0);
+    assert(FT_rmFile("1root/wide/030000") == SUCCESS);
+    assert(!FT_containsFile("1root/wide/030000"));
+    assert(FT_containsFile("1root/wide/030001"));
+    assert(FT_rmDir("1root/wide") == SUCCESS);
+    assert(!FT_containsDir("1root/wide"));
+    assert(FT_containsDir("1root"));
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* directories emptied by removals and moves give back their room,
+     yet a transaction can still put everything back */
+  {
+    char acPath[32];
+    char *pcBefore;
+    char *pcAfter;
+    size_t ulIndex;
+
+    assert(FT_init() == SUCCESS);
+    for (ulIndex = 0; ulIndex < 1000; ulIndex++)
+    {
+      sprintf(acPath, "1root/d/%04lu", (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+    }
+    for (ulIndex = 0; ulIndex < 990; ulIndex++)
+    {
+      sprintf(acPath, "1root/d/%04lu", (unsigned long)ulIndex);
+      if (ulIndex % 2 == 0)
+        assert(FT_rmFile(acPath) == SUCCESS);
+      else
+      {
+        assert(FT_rename(acPath, "1root/moved") == SUCCESS);
+        assert(FT_rmFile("1root/moved") == SUCCESS);
+      }
+    }
+    assert(!FT_containsFile("1root/d/0989"));
+    assert(FT_containsFile("1root/d/0990"));
+    pcBefore = FT_toString();
+    assert(pcBefore != NULL);
+
+    assert(FT_begin() == SUCCESS);
+    for (ulIndex = 990; ulIndex < 1000; ulIndex++)
+    {
+      sprintf(acPath, "1root/d/%04lu", (unsigned long)ulIndex);
+      assert(FT_rmFile(acPath) == SUCCESS);
+    }
+    assert(FT_rename("1root/d", "1root/e") == SUCCESS);
+    assert(FT_abort() == SUCCESS);
+    pcAfter = FT_toString();
+    assert(pcAfter != NULL && !strcmp(pcBefore, pcAfter));
+    free(pcAfter);
+
+    /* moves into directories the transaction made come back out
+       before those directories go */
+    assert(FT_begin() == SUCCESS);
+    assert(FT_insertDir("1root/x") == SUCCESS);
+    assert(FT_rename("1root/d", "1root/x/d") == SUCCESS);
+    assert(FT_containsFile("1root/x/d/0995"));
+    assert(FT_rename("1root/x/d/0995", "1root/x/f") == SUCCESS);
+    assert(FT_containsFile("1root/x/f"));
+    assert(FT_abort() == SUCCESS);
+    assert(FT_containsFile("1root/d/0995"));
+    assert(!FT_containsDir("1root/x"));
+    pcAfter = FT_toString();
+    assert(pcAfter != NULL && !strcmp(pcBefore, pcAfter));
+    free(pcAfter);
+    free(pcBefore);
+    assert(FT_destroy() == SUCCESS);
+  }
+
   return 0;
 }
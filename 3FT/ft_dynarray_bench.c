@@ -0,0 +1,727 @@
+/*--------------------------------------------------------------------*/
+/* ft_dynarray_bench.c                                                */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dynarray.h"
+#include "typedarray.h"
+#include "path.h"
+#include "builtinalloc.h"
+#include "nodeFT.h"
+#include "ft.h"
+
+/* The shape of the tree built: BRANCHING subdirectories per directory
+   down to DEPTH levels, each directory holding FILES empty files. */
+enum { BRANCHING = 4, DEPTH = 5, FILES = 3 };
+
+/* The number of short arrays, and of lookups made in them. */
+enum { ARRAYS = 100000, LOOKUPS = 4000000 };
+
+/* The longest FT path the benchmark builds. */
+enum { MAX_PATH = 128 };
+
+/* The number of searches made at each fanout, and the length of the
+   names searched for. */
+enum { SEARCHES = 1000000, NAME_LENGTH = 24 };
+
+static int compareName(const char *const *ppcName, const void *pvKey);
+
+/* The name compareName reads, for searches to prefetch */
+#define nameKey(ppcName) ((const void *)*(ppcName))
+
+/* Sorted names searched with compareName inlined */
+DEFINE_DYNARRAY(NameArray, const char *, compareName, nameKey)
+
+/* The number of calls to malloc, calloc and realloc so far. The
+   benchmark is linked with --wrap for each, so every call made from
+   the FT's own objects is counted here first. */
+static size_t ulAllocs;
+
+void *__real_malloc(size_t ulSize);
+void *__real_calloc(size_t ulCount, size_t ulSize);
+void *__real_realloc(void *pvOld, size_t ulSize);
+
+/* Counts a call to malloc, then makes it. */
+void *__wrap_malloc(size_t ulSize)
+{
+   ulAllocs++;
+   return __real_malloc(ulSize);
+}
+
+/* Counts a call to calloc, then makes it. */
+void *__wrap_calloc(size_t ulCount, size_t ulSize)
+{
+   ulAllocs++;
+   return __real_calloc(ulCount, ulSize);
+}
+
+/* Counts a call to realloc, then makes it. */
+void *__wrap_realloc(void *pvOld, size_t ulSize)
+{
+   ulAllocs++;
+   return __real_realloc(pvOld, ulSize);
+}
+
+/* Compares the name at ppcName with the name pvKey, as strcmp. */
+static int compareName(const char *const *ppcName, const void *pvKey)
+{
+   return strcmp(*ppcName, (const char *)pvKey);
+}
+
+/* Compares the names pvName1 and pvName2, as strcmp. */
+static int compareNames(const void *pvName1, const void *pvName2)
+{
+   return strcmp((const char *)pvName1, (const char *)pvName2);
+}
+
+/* Returns the current time in seconds. */
+static double now(void)
+{
+   struct timespec sTime;
+
+   (void)clock_gettime(CLOCK_MONOTONIC, &sTime);
+   return (double)sTime.tv_sec + (double)sTime.tv_nsec / 1e9;
+}
+
+/* Inserts the directory pcDir, at depth ulDepth, and the tree below
+   it into the FT, and adds the number of nodes made to *pulNodes. */
+static void buildTree(const char *pcDir, size_t ulDepth,
+                      size_t *pulNodes)
+{
+   char acPath[MAX_PATH];
+   size_t ulIndex;
+
+   assert(FT_insertDir(pcDir) == SUCCESS);
+   (*pulNodes)++;
+   for (ulIndex = 0; ulIndex < FILES; ulIndex++)
+   {
+      sprintf(acPath, "%s/f%lu", pcDir, (unsigned long)ulIndex);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+      (*pulNodes)++;
+   }
+   if (ulDepth == DEPTH)
+      return;
+   for (ulIndex = 0; ulIndex < BRANCHING; ulIndex++)
+   {
+      sprintf(acPath, "%s/d%lu", pcDir, (unsigned long)ulIndex);
+      buildTree(acPath, ulDepth + 1, pulNodes);
+   }
+}
+
+/* Looks up every file of the tree below pcDir, at depth ulDepth. */
+static void findTree(const char *pcDir, size_t ulDepth)
+{
+   char acPath[MAX_PATH];
+   size_t ulIndex;
+
+   for (ulIndex = 0; ulIndex < FILES; ulIndex++)
+   {
+      sprintf(acPath, "%s/f%lu", pcDir, (unsigned long)ulIndex);
+      assert(FT_containsFile(acPath));
+   }
+   if (ulDepth == DEPTH)
+      return;
+   for (ulIndex = 0; ulIndex < BRANCHING; ulIndex++)
+   {
+      sprintf(acPath, "%s/d%lu", pcDir, (unsigned long)ulIndex);
+      findTree(acPath, ulDepth + 1);
+   }
+}
+
+/* Builds and searches the tree in an FT, and reports the allocations
+   per node and the time per lookup. */
+static void runTree(void)
+{
+   size_t ulNodes = 0;
+   size_t ulStart;
+   double dStart;
+
+   assert(FT_init() == SUCCESS);
+   ulStart = ulAllocs;
+   buildTree("r", 1, &ulNodes);
+   printf("tree of %lu nodes: %6.2f allocations per node\n",
+          (unsigned long)ulNodes,
+          (double)(ulAllocs - ulStart) / (double)ulNodes);
+
+   ulStart = ulAllocs;
+   dStart = now();
+   findTree("r", 1);
+   printf("file lookups:      %6.2f allocations, %7.1f ns each\n",
+          (double)(ulAllocs - ulStart) / (double)ulNodes,
+          (now() - dStart) * 1e9 / (double)ulNodes);
+   assert(FT_destroy() == SUCCESS);
+}
+
+/* Makes and frees paths of a typical depth, and reports the
+   allocations and time per path. */
+static void runPaths(void)
+{
+   enum { PATHS = 200000 };
+   char acPath[MAX_PATH];
+   Path_T oPPath;
+   size_t ulIndex;
+   size_t ulStart;
+   double dStart;
+
+   ulStart = ulAllocs;
+   dStart = now();
+   for (ulIndex = 0; ulIndex < PATHS; ulIndex++)
+   {
+      sprintf(acPath, "r/d%lu/d%lu/f%lu", (unsigned long)(ulIndex % 4),
+              (unsigned long)(ulIndex % 3), (unsigned long)ulIndex);
+      assert(Path_new(acPath, &oPPath) == SUCCESS);
+      Path_free(oPPath);
+   }
+   printf("4-level paths:     %6.2f allocations, %7.1f ns each\n",
+          (double)(ulAllocs - ulStart) / PATHS,
+          (now() - dStart) * 1e9 / PATHS);
+}
+
+/* Fills many arrays of 0 to 4 elements, reads their elements in a
+   scattered order, and reports the allocations per array and the
+   time per lookup. */
+static void runArrays(void)
+{
+   DynArray_T *poDArrays;
+   size_t ulIndex;
+   size_t ulStart;
+   size_t ulSum = 0;
+   double dStart;
+
+   poDArrays = malloc(ARRAYS * sizeof(DynArray_T));
+   assert(poDArrays != NULL);
+
+   ulStart = ulAllocs;
+   for (ulIndex = 0; ulIndex < ARRAYS; ulIndex++)
+   {
+      poDArrays[ulIndex] = DynArray_new(0);
+      assert(poDArrays[ulIndex] != NULL);
+      while (DynArray_getLength(poDArrays[ulIndex]) < 1 + ulIndex % 4)
+         assert(DynArray_add(poDArrays[ulIndex], &ulSum));
+   }
+   printf("arrays of 1-4:     %6.2f allocations each\n",
+          (double)(ulAllocs - ulStart) / ARRAYS);
+
+   dStart = now();
+   for (ulIndex = 0; ulIndex < LOOKUPS; ulIndex++)
+   {
+      /* a large odd stride visits the arrays out of order */
+      DynArray_T oDArray = poDArrays[(ulIndex * 7919) % ARRAYS];
+      ulSum += (size_t)DynArray_get(oDArray,
+                                    ulIndex % DynArray_getLength(oDArray));
+   }
+   printf("element lookups:   %7.1f ns each (%lu)\n",
+          (now() - dStart) * 1e9 / LOOKUPS, (unsigned long)(ulSum & 1));
+
+   for (ulIndex = 0; ulIndex < ARRAYS; ulIndex++)
+      DynArray_free(poDArrays[ulIndex]);
+   free(poDArrays);
+}
+
+/* Times searches for names present and absent in a sorted directory
+   of ulFanout names, with DynArray_bsearch, with
+   DynArray_bsearchBranchless, and with a typed array's bsearch, and
+   reports the time per search of each. */
+static void runSearches(size_t ulFanout)
+{
+   enum { WAYS = 3 };
+   struct NameArray sNames;
+   DynArray_T oDNames;
+   char *pcNames;
+   char *pcKeys;
+   char *pcKey;
+   double adTime[WAYS];
+   double dStart;
+   size_t ulWay;
+   size_t ulIndex;
+   size_t ulFound;
+   size_t ulFirstFound = 0;
+   size_t ulAt;
+   unsigned long ulSeed = 1;
+
+   /* names n0000000, n0000002, ... so that odd numbers are absent */
+   pcNames = malloc(ulFanout * NAME_LENGTH);
+   pcKeys = malloc(SEARCHES * NAME_LENGTH);
+   oDNames = DynArray_new(ulFanout);
+   assert(pcNames != NULL && pcKeys != NULL && oDNames != NULL);
+   assert(NameArray_init(&sNames, ulFanout, NULL));
+   for (ulIndex = 0; ulIndex < ulFanout; ulIndex++)
+   {
+      sprintf(pcNames + ulIndex * NAME_LENGTH, "n%07lu",
+              (unsigned long)(2 * ulIndex));
+      (void)DynArray_set(oDNames, ulIndex,
+                         pcNames + ulIndex * NAME_LENGTH);
+      (void)NameArray_set(&sNames, ulIndex,
+                          pcNames + ulIndex * NAME_LENGTH);
+   }
+
+   /* the same random keys for every way, made before timing */
+   for (ulIndex = 0; ulIndex < SEARCHES; ulIndex++)
+   {
+      ulSeed = ulSeed * 1103515245UL + 12345UL;
+      sprintf(pcKeys + ulIndex * NAME_LENGTH, "n%07lu",
+              (ulSeed >> 8) % (2 * (unsigned long)ulFanout));
+   }
+
+   for (ulWay = 0; ulWay < WAYS; ulWay++)
+   {
+      /* a loop of its own for each way, so that none pays for
+         choosing it */
+      ulFound = 0;
+      dStart = now();
+      if (ulWay == 0)
+         for (ulIndex = 0; ulIndex < SEARCHES; ulIndex++)
+         {
+            pcKey = pcKeys + ulIndex * NAME_LENGTH;
+            ulFound += (size_t)DynArray_bsearch(oDNames, pcKey, &ulAt,
+                                                compareNames);
+         }
+      else if (ulWay == 1)
+         for (ulIndex = 0; ulIndex < SEARCHES; ulIndex++)
+         {
+            pcKey = pcKeys + ulIndex * NAME_LENGTH;
+            ulFound += (size_t)DynArray_bsearchBranchless(
+               oDNames, pcKey, &ulAt, compareNames);
+         }
+      else
+         for (ulIndex = 0; ulIndex < SEARCHES; ulIndex++)
+         {
+            pcKey = pcKeys + ulIndex * NAME_LENGTH;
+            ulFound += (size_t)NameArray_bsearch(&sNames, pcKey, &ulAt);
+         }
+      adTime[ulWay] = (now() - dStart) * 1e9 / SEARCHES;
+      /* every way finds the same names */
+      if (ulWay == 0)
+         ulFirstFound = ulFound;
+      assert(ulFound == ulFirstFound);
+   }
+   printf("fanout %7lu:   %7.1f %11.1f %10.1f ns\n",
+          (unsigned long)ulFanout, adTime[0], adTime[1], adTime[2]);
+
+   NameArray_clear(&sNames, NULL);
+   DynArray_free(oDNames);
+   free(pcKeys);
+   free(pcNames);
+}
+
+/* Times sorting SORTED_PATHS paths of a deep tree, shuffled and then
+   again once sorted, with DynArray_sort and with
+   DynArray_sortStrings, and reports the time each took. */
+static void runSorts(void)
+{
+   enum { SORTED_PATHS = 1000000 };
+   DynArray_T oDPaths;
+   char *pcPaths;
+   double dStart;
+   double dShuffled;
+   size_t ulWay;
+   size_t ulIndex;
+   unsigned long ulSeed = 1;
+
+   pcPaths = malloc(SORTED_PATHS * MAX_PATH);
+   oDPaths = DynArray_new(SORTED_PATHS);
+   assert(pcPaths != NULL && oDPaths != NULL);
+
+   for (ulWay = 0; ulWay < 2; ulWay++)
+   {
+      for (ulIndex = 0; ulIndex < SORTED_PATHS; ulIndex++)
+      {
+         ulSeed = ulSeed * 1103515245UL + 12345UL;
+         sprintf(pcPaths + ulIndex * MAX_PATH,
+                 "1root/src/module%lu/include/sub%lu/file%lu.h",
+                 (ulSeed >> 8) % 64, (ulSeed >> 16) % 16,
+                 (unsigned long)ulIndex);
+         (void)DynArray_set(oDPaths, ulIndex,
+                            pcPaths + ulIndex * MAX_PATH);
+      }
+
+      dStart = now();
+      if (ulWay == 0)
+         DynArray_sort(oDPaths, compareNames);
+      else
+         DynArray_sortStrings(oDPaths);
+      dShuffled = now() - dStart;
+      for (ulIndex = 1; ulIndex < SORTED_PATHS; ulIndex++)
+         assert(strcmp(DynArray_get(oDPaths, ulIndex - 1),
+                       DynArray_get(oDPaths, ulIndex)) < 0);
+
+      dStart = now();
+      if (ulWay == 0)
+         DynArray_sort(oDPaths, compareNames);
+      else
+         DynArray_sortStrings(oDPaths);
+      printf("%-22s %8.1f ms shuffled, %7.1f ms sorted\n",
+             ulWay == 0 ? "DynArray_sort:" : "DynArray_sortStrings:",
+             dShuffled * 1e3, (now() - dStart) * 1e3);
+   }
+
+   DynArray_free(oDPaths);
+   free(pcPaths);
+}
+
+/* Reverses the name pvName in place, as a DynArray_parallelMap
+   callback: enough work per element to be worth spreading out, and
+   undone by a second pass. pvExtra is unused. */
+static void reverseName(void *pvName, void *pvExtra)
+{
+   char *pcFront = pvName;
+   char *pcBack = pcFront + strlen(pcFront);
+   char cChar;
+
+   (void)pvExtra;
+   while (pcBack - pcFront > 1)
+   {
+      cChar = *pcFront;
+      *pcFront++ = *--pcBack;
+      *pcBack = cChar;
+   }
+}
+
+/* Times DynArray_parallelMap, applying reverseName twice, and
+   DynArray_parallelSort on PARALLEL_PATHS shuffled paths with 1, 2,
+   4, 8 and 16 threads and with as many as the processors online, and
+   reports the time each took and its speedup over 1 thread. */
+static void runParallel(void)
+{
+   enum { PARALLEL_PATHS = 1000000 };
+   static const size_t aulThreads[] = { 1, 2, 4, 8, 16, 0 };
+   DynArray_T oDPaths;
+   char *pcPaths;
+   double dStart;
+   double dMap;
+   double dSort;
+   double dMapOne = 0.0;
+   double dSortOne = 0.0;
+   size_t ulWay;
+   size_t ulIndex;
+   unsigned long ulSeed = 1;
+
+   pcPaths = malloc(PARALLEL_PATHS * MAX_PATH);
+   oDPaths = DynArray_new(PARALLEL_PATHS);
+   assert(pcPaths != NULL && oDPaths != NULL);
+
+   printf("threads:          map ms  speedup    sort ms  speedup\n");
+   for (ulWay = 0; ulWay < sizeof(aulThreads) / sizeof(aulThreads[0]);
+        ulWay++)
+   {
+      for (ulIndex = 0; ulIndex < PARALLEL_PATHS; ulIndex++)
+      {
+         ulSeed = ulSeed * 1103515245UL + 12345UL;
+         sprintf(pcPaths + ulIndex * MAX_PATH,
+                 "1root/src/module%lu/include/sub%lu/file%lu.h",
+                 (ulSeed >> 8) % 64, (ulSeed >> 16) % 16,
+                 (unsigned long)ulIndex);
+         (void)DynArray_set(oDPaths, ulIndex,
+                            pcPaths + ulIndex * MAX_PATH);
+      }
+
+      dStart = now();
+      DynArray_parallelMap(oDPaths, reverseName, NULL,
+                           aulThreads[ulWay]);
+      DynArray_parallelMap(oDPaths, reverseName, NULL,
+                           aulThreads[ulWay]);
+      dMap = now() - dStart;
+      assert(strncmp(DynArray_get(oDPaths, 0), "1root/", 6) == 0);
+
+      dStart = now();
+      DynArray_parallelSort(oDPaths, compareNames, aulThreads[ulWay]);
+      dSort = now() - dStart;
+      for (ulIndex = 1; ulIndex < PARALLEL_PATHS; ulIndex++)
+         assert(strcmp(DynArray_get(oDPaths, ulIndex - 1),
+                       DynArray_get(oDPaths, ulIndex)) < 0);
+
+      if (ulWay == 0)
+      {
+         dMapOne = dMap;
+         dSortOne = dSort;
+      }
+      if (aulThreads[ulWay] == 0)
+         printf("auto:         ");
+      else
+         printf("%2lu:           ", (unsigned long)aulThreads[ulWay]);
+      printf("%9.1f %7.2fx %10.1f %7.2fx\n", dMap * 1e3,
+             dMapOne / dMap, dSort * 1e3, dSortOne / dSort);
+   }
+
+   DynArray_free(oDPaths);
+   free(pcPaths);
+}
+
+/* Adds the tree below the directory node oNDir, at depth ulDepth,
+   with Node_newChild, builds the path of each node added, and adds
+   the number of nodes made to *pulNodes. */
+static void buildNodes(Node_T oNDir, size_t ulDepth, size_t *pulNodes)
+{
+   char acName[MAX_PATH];
+   Node_T oNChild;
+   size_t ulIndex;
+
+   for (ulIndex = 0; ulIndex < FILES; ulIndex++)
+   {
+      sprintf(acName, "f%lu", (unsigned long)ulIndex);
+      assert(Node_newChild(oNDir, acName, TRUE, &oNChild) == SUCCESS);
+      assert(Node_getPath(oNChild) != NULL);
+      (*pulNodes)++;
+   }
+   if (ulDepth == DEPTH)
+      return;
+   for (ulIndex = 0; ulIndex < BRANCHING; ulIndex++)
+   {
+      sprintf(acName, "d%lu", (unsigned long)ulIndex);
+      assert(Node_newChild(oNDir, acName, FALSE, &oNChild) == SUCCESS);
+      assert(Node_getPath(oNChild) != NULL);
+      (*pulNodes)++;
+      buildNodes(oNChild, ulDepth + 1, pulNodes);
+   }
+}
+
+/* Builds the tree as nodes, with their paths, and frees it, taking
+   memory from malloc, from a counting allocator and from an arena,
+   and reports the time per node each took and what the counting
+   allocator saw. */
+static void runAllocators(void)
+{
+   enum { WAYS = 3, ROUNDS = 20 };
+   static const char *const apcWays[WAYS] =
+      { "malloc:", "counting:", "arena:" };
+   struct allocatorCounts sCounts;
+   Allocator_T oAAlloc;
+   Node_T oNRoot;
+   size_t ulNodes = 0;
+   size_t ulWay;
+   size_t ulRound;
+   double dStart;
+
+   for (ulWay = 0; ulWay < WAYS; ulWay++)
+   {
+      oAAlloc = NULL;
+      if (ulWay == 1)
+         oAAlloc = Allocator_newCounting(NULL);
+      else if (ulWay == 2)
+         oAAlloc = Allocator_newArena();
+      assert(ulWay == 0 || oAAlloc != NULL);
+
+      dStart = now();
+      for (ulRound = 0; ulRound < ROUNDS; ulRound++)
+      {
+         ulNodes = 1;
+         assert(Node_newWith("r", NULL, NULL, 0, FALSE, oAAlloc,
+                             &oNRoot) == SUCCESS);
+         buildNodes(oNRoot, 1, &ulNodes);
+         assert(Node_free(oNRoot) == ulNodes);
+      }
+      printf("nodes from %-10s %7.1f ns each\n", apcWays[ulWay],
+             (now() - dStart) * 1e9 / (double)(ROUNDS * ulNodes));
+
+      if (ulWay == 1)
+      {
+         Allocator_getCounts(oAAlloc, &sCounts);
+         /* every block was given back, with the size it was given */
+         assert(sCounts.ulLiveBytes == 0);
+         printf("   %6.2f allocations, %6.2f reallocations and "
+                "%6.1f peak bytes per node\n",
+                (double)sCounts.ulAllocs / (double)(ROUNDS * ulNodes),
+                (double)sCounts.ulReallocs / (double)(ROUNDS * ulNodes),
+                (double)sCounts.ulPeakBytes / (double)ulNodes);
+      }
+      Allocator_free(oAAlloc);
+   }
+}
+
+/* Adds a million elements to a DynArray growing by each percentage,
+   and to one reserved up front, and a hundred thousand children to a
+   directory likewise, then gives a directory a hundred thousand
+   children and removes all but a thousand, and reports what a
+   counting allocator saw of each, before and after trimming. */
+static void runGrowth(void)
+{
+   enum { WAYS = 4, ELEMENTS = 1000000 };
+   enum { CHILDREN = 100000, KEPT = 1000 };
+   static const size_t aulPercents[WAYS] = { 100, 50, 25, 0 };
+   struct allocatorCounts sCounts;
+   Allocator_T oAAlloc;
+   DynArray_T oDArray;
+   Node_T oNRoot;
+   Node_T oNChild;
+   char acName[MAX_PATH];
+   size_t ulWay;
+   size_t ulIndex;
+   double dStart;
+
+   printf("growth:            reallocs  peak bytes       time\n");
+   for (ulWay = 0; ulWay < WAYS; ulWay++)
+   {
+      oAAlloc = Allocator_newCounting(NULL);
+      assert(oAAlloc != NULL);
+      dStart = now();
+      oDArray = DynArray_newWith(0, oAAlloc);
+      assert(oDArray != NULL);
+      if (aulPercents[ulWay] == 0)
+         assert(DynArray_reserve(oDArray, ELEMENTS));
+      else
+         DynArray_setGrowth(oDArray, aulPercents[ulWay]);
+      for (ulIndex = 0; ulIndex < ELEMENTS; ulIndex++)
+         assert(DynArray_add(oDArray, &ulIndex));
+      Allocator_getCounts(oAAlloc, &sCounts);
+      DynArray_free(oDArray);
+      if (aulPercents[ulWay] == 0)
+         printf("   reserved     ");
+      else
+         printf("   by %3lu%%      ", (unsigned long)aulPercents[ulWay]);
+      printf("%10lu %11lu %7.2f ms\n", (unsigned long)sCounts.ulReallocs,
+             (unsigned long)sCounts.ulPeakBytes, (now() - dStart) * 1e3);
+      Allocator_free(oAAlloc);
+   }
+
+   /* a directory's children grow as its own policy says */
+   for (ulWay = 0; ulWay < WAYS; ulWay++)
+   {
+      oAAlloc = Allocator_newCounting(NULL);
+      assert(oAAlloc != NULL);
+      dStart = now();
+      assert(Node_newWith("r", NULL, NULL, 0, FALSE, oAAlloc, &oNRoot)
+             == SUCCESS);
+      if (aulPercents[ulWay] == 0)
+         assert(Node_reserveChildren(oNRoot, CHILDREN) == SUCCESS);
+      else
+         Node_setChildGrowth(oNRoot, aulPercents[ulWay]);
+      for (ulIndex = 0; ulIndex < CHILDREN; ulIndex++)
+      {
+         sprintf(acName, "c%06lu", (unsigned long)ulIndex);
+         assert(Node_newChild(oNRoot, acName, TRUE, &oNChild) ==
+                SUCCESS);
+      }
+      Allocator_getCounts(oAAlloc, &sCounts);
+      (void)Node_free(oNRoot);
+      if (aulPercents[ulWay] == 0)
+         printf("   dir reserved ");
+      else
+         printf("   dir by %3lu%%  ", (unsigned long)aulPercents[ulWay]);
+      printf("%10lu %11lu %7.2f ms\n", (unsigned long)sCounts.ulReallocs,
+             (unsigned long)sCounts.ulPeakBytes, (now() - dStart) * 1e3);
+      Allocator_free(oAAlloc);
+   }
+
+   oAAlloc = Allocator_newCounting(NULL);
+   assert(oAAlloc != NULL);
+   assert(Node_newWith("r", NULL, NULL, 0, FALSE, oAAlloc, &oNRoot)
+          == SUCCESS);
+   for (ulIndex = 0; ulIndex < CHILDREN; ulIndex++)
+   {
+      sprintf(acName, "c%06lu", (unsigned long)ulIndex);
+      assert(Node_newChild(oNRoot, acName, TRUE, &oNChild) == SUCCESS);
+   }
+   for (ulIndex = CHILDREN; ulIndex > KEPT; ulIndex--)
+   {
+      assert(Node_getChild(oNRoot, ulIndex - 1, &oNChild) == SUCCESS);
+      assert(Node_free(oNChild) == 1);
+   }
+   Allocator_getCounts(oAAlloc, &sCounts);
+   printf("churned directory: %lu live bytes before trimming, ",
+          (unsigned long)sCounts.ulLiveBytes);
+   Node_trimChildren(oNRoot);
+   assert(Node_getNumChildren(oNRoot) == KEPT);
+   Allocator_getCounts(oAAlloc, &sCounts);
+   printf("%lu after\n", (unsigned long)sCounts.ulLiveBytes);
+   (void)Node_free(oNRoot);
+   Allocator_getCounts(oAAlloc, &sCounts);
+   assert(sCounts.ulLiveBytes == 0);
+   Allocator_free(oAAlloc);
+}
+
+/* Gives a directory of a hundred thousand children ten thousand more,
+   whose names fall between theirs, one at a time with Node_newChild
+   and all at once with Node_newChildren, and reports the time per
+   child each took. */
+static void runMerge(void)
+{
+   enum { CHILDREN = 100000, ADDED = 10000, WAYS = 2 };
+   static const char *const apcWays[WAYS] =
+      { "one at a time:", "merged:" };
+   char (*pacNames)[NAME_LENGTH];
+   char acName[NAME_LENGTH];
+   const char **ppcNames;
+   Node_T *poNChildren;
+   Node_T oNRoot;
+   Node_T oNChild;
+   size_t ulWay;
+   size_t ulIndex;
+   double dStart;
+
+   pacNames = malloc(ADDED * sizeof(*pacNames));
+   ppcNames = malloc(ADDED * sizeof(const char *));
+   poNChildren = malloc(ADDED * sizeof(Node_T));
+   assert(pacNames != NULL && ppcNames != NULL && poNChildren != NULL);
+   /* each new name falls between two old ones, spread over them all */
+   for (ulIndex = 0; ulIndex < ADDED; ulIndex++)
+   {
+      sprintf(pacNames[ulIndex], "c%07lu",
+              (unsigned long)(ulIndex * 100 + 5));
+      ppcNames[ulIndex] = pacNames[ulIndex];
+   }
+
+   for (ulWay = 0; ulWay < WAYS; ulWay++)
+   {
+      assert(Node_new("r", NULL, NULL, 0, FALSE, &oNRoot) == SUCCESS);
+      for (ulIndex = 0; ulIndex < CHILDREN; ulIndex++)
+      {
+         sprintf(acName, "c%07lu", (unsigned long)(ulIndex * 10));
+         assert(Node_newChild(oNRoot, acName, TRUE, &oNChild)
+                == SUCCESS);
+      }
+
+      dStart = now();
+      if (ulWay == 0)
+         for (ulIndex = 0; ulIndex < ADDED; ulIndex++)
+            assert(Node_newChild(oNRoot, ppcNames[ulIndex], TRUE,
+                                 &poNChildren[ulIndex]) == SUCCESS);
+      else
+         assert(Node_newChildren(oNRoot, ppcNames, ADDED, TRUE,
+                                 poNChildren) == SUCCESS);
+      printf("children added %-15s %7.1f ns each\n", apcWays[ulWay],
+             (now() - dStart) * 1e9 / ADDED);
+      assert(Node_getNumChildren(oNRoot) == CHILDREN + ADDED);
+      assert(Node_getChild(oNRoot, 1, &oNChild) == SUCCESS);
+      assert(oNChild == poNChildren[0]);
+      assert(Node_free(oNRoot) == 1 + CHILDREN + ADDED);
+   }
+
+   free(poNChildren);
+   free(ppcNames);
+   free(pacNames);
+}
+
+/* Counts the allocations, and times the lookups, of short DynArrays
+   alone, of paths, and of a tree of small directories, then times
+   each way of searching directories from 16 to a million names, and
+   of sorting a million paths, how the parallel map and sort scale
+   with threads, how a tree of nodes fares with each allocator, what
+   each growth policy and trimming cost in memory, and how much
+   merging saves over adding children one at a time. Returns 0. */
+int main(void)
+{
+   static const size_t aulFanouts[] = { 16, 256, 4096, 65536, 1000000 };
+   size_t ulIndex;
+
+   runArrays();
+   runPaths();
+   runTree();
+
+   printf("searches:            bsearch  branchless      typed\n");
+   for (ulIndex = 0;
+        ulIndex < sizeof(aulFanouts) / sizeof(aulFanouts[0]); ulIndex++)
+      runSearches(aulFanouts[ulIndex]);
+   runSorts();
+   runParallel();
+   runAllocators();
+   runGrowth();
+   runMerge();
+   return 0;
+}
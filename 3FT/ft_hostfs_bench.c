@@ -0,0 +1,274 @@
+/*--------------------------------------------------------------------*/
+/* ft_hostfs_bench.c                                                  */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ft.h"
+
+/* The shape of the synthetic host tree: BRANCHING subdirectories per
+   directory down to DEPTH levels, each directory holding FILES files
+   of FILE_SIZE bytes. */
+enum { BRANCHING = 4, DEPTH = 4, FILES = 24, FILE_SIZE = 2048 };
+
+/* The longest host or FT path the benchmark builds. */
+enum { MAX_PATH = 512 };
+
+/* Returns the current time in seconds. */
+static double now(void)
+{
+   struct timespec sTime;
+
+   (void)clock_gettime(CLOCK_MONOTONIC, &sTime);
+   return (double)sTime.tv_sec + (double)sTime.tv_nsec / 1e9;
+}
+
+/* Builds the synthetic tree under host directory pcDir, whose depth
+   below the top is ulDepth, and adds the number of files made to
+   *pulFiles. */
+static void makeTree(const char *pcDir, size_t ulDepth,
+                     size_t *pulFiles)
+{
+   char acPath[MAX_PATH];
+   char acBytes[FILE_SIZE];
+   FILE *psFile;
+   size_t ulIndex;
+
+   memset(acBytes, 'x', sizeof(acBytes));
+   for (ulIndex = 0; ulIndex < FILES; ulIndex++)
+   {
+      sprintf(acPath, "%s/file%lu", pcDir, (unsigned long)ulIndex);
+      psFile = fopen(acPath, "w");
+      assert(psFile != NULL);
+      acBytes[0] = (char)ulIndex;
+      assert(fwrite(acBytes, 1, sizeof(acBytes), psFile) ==
+             sizeof(acBytes));
+      assert(fclose(psFile) == 0);
+      (*pulFiles)++;
+   }
+
+   if (ulDepth == DEPTH)
+      return;
+   for (ulIndex = 0; ulIndex < BRANCHING; ulIndex++)
+   {
+      sprintf(acPath, "%s/dir%lu", pcDir, (unsigned long)ulIndex);
+      assert(mkdir(acPath, 0700) == 0);
+      makeTree(acPath, ulDepth + 1, pulFiles);
+   }
+}
+
+/* Removes the host tree under pcDir, then pcDir itself. */
+static void removeTree(const char *pcDir)
+{
+   char acPath[MAX_PATH];
+   struct dirent *psEntry;
+   struct stat sStat;
+   DIR *psDir;
+
+   psDir = opendir(pcDir);
+   assert(psDir != NULL);
+   while ((psEntry = readdir(psDir)) != NULL)
+   {
+      if (!strcmp(psEntry->d_name, ".") || !strcmp(psEntry->d_name, ".."))
+         continue;
+      sprintf(acPath, "%s/%s", pcDir, psEntry->d_name);
+      assert(lstat(acPath, &sStat) == 0);
+      if (S_ISDIR(sStat.st_mode))
+         removeTree(acPath);
+      else
+         assert(unlink(acPath) == 0);
+   }
+   assert(closedir(psDir) == 0);
+   assert(rmdir(pcDir) == 0);
+}
+
+/* The client loop FT_importDir replaces: mirrors host directory
+   pcHost at FT path pcTree with readdir and one FT_insertDir or
+   FT_insertFile, each walking from the root, per entry. */
+static void clientLoop(const char *pcHost, const char *pcTree)
+{
+   char acHost[MAX_PATH];
+   char acTree[MAX_PATH];
+   char acBytes[FILE_SIZE];
+   struct dirent *psEntry;
+   struct stat sStat;
+   FILE *psFile;
+   size_t ulLength;
+   DIR *psDir;
+
+   assert(FT_insertDir(pcTree) == SUCCESS);
+   psDir = opendir(pcHost);
+   assert(psDir != NULL);
+   while ((psEntry = readdir(psDir)) != NULL)
+   {
+      if (!strcmp(psEntry->d_name, ".") || !strcmp(psEntry->d_name, ".."))
+         continue;
+      sprintf(acHost, "%s/%s", pcHost, psEntry->d_name);
+      sprintf(acTree, "%s/%s", pcTree, psEntry->d_name);
+      assert(lstat(acHost, &sStat) == 0);
+      if (S_ISDIR(sStat.st_mode))
+         clientLoop(acHost, acTree);
+      else
+      {
+         psFile = fopen(acHost, "r");
+         assert(psFile != NULL);
+         ulLength = fread(acBytes, 1, sizeof(acBytes), psFile);
+         assert(fclose(psFile) == 0);
+         assert(FT_insertFile(acTree, acBytes, ulLength) == SUCCESS);
+      }
+   }
+   assert(closedir(psDir) == 0);
+}
+
+/* The single-threaded write loop FT_exportDir replaces: writes the
+   FT directory pcTree out to new host directory pcOut, using host
+   directory pcHost, which it mirrors, to find the entries. */
+static void clientWriteLoop(const char *pcHost, const char *pcTree,
+                            const char *pcOut)
+{
+   char acHost[MAX_PATH];
+   char acTree[MAX_PATH];
+   char acOut[MAX_PATH];
+   struct dirent *psEntry;
+   struct stat sStat;
+   boolean bIsFile;
+   size_t ulLength;
+   FILE *psFile;
+   DIR *psDir;
+
+   assert(mkdir(pcOut, 0700) == 0);
+   psDir = opendir(pcHost);
+   assert(psDir != NULL);
+   while ((psEntry = readdir(psDir)) != NULL)
+   {
+      if (!strcmp(psEntry->d_name, ".") || !strcmp(psEntry->d_name, ".."))
+         continue;
+      sprintf(acHost, "%s/%s", pcHost, psEntry->d_name);
+      sprintf(acTree, "%s/%s", pcTree, psEntry->d_name);
+      sprintf(acOut, "%s/%s", pcOut, psEntry->d_name);
+      assert(lstat(acHost, &sStat) == 0);
+      if (S_ISDIR(sStat.st_mode))
+         clientWriteLoop(acHost, acTree, acOut);
+      else
+      {
+         assert(FT_stat(acTree, &bIsFile, &ulLength) == SUCCESS);
+         psFile = fopen(acOut, "w");
+         assert(psFile != NULL);
+         assert(fwrite(FT_getFileContents(acTree), 1, ulLength, psFile)
+                == ulLength);
+         assert(fclose(psFile) == 0);
+      }
+   }
+   assert(closedir(psDir) == 0);
+}
+
+/* Times each way of importing the tree at pcTop into an owned-mode
+   FT, best of ulRounds. */
+static void runImports(const char *pcTop, size_t ulRounds)
+{
+   static const char *apcNames[] = { "client loop", "import, read",
+                                     "import, mmap",
+                                     "import, read, 4 threads",
+                                     "import, mmap, 4 threads" };
+   enum { NUM_WAYS = 5 };
+   double dStart, dBest, dTime;
+   size_t ulWay, ulRound;
+   int iStatus;
+
+   for (ulWay = 0; ulWay < NUM_WAYS; ulWay++)
+   {
+      dBest = 0;
+      for (ulRound = 0; ulRound < ulRounds; ulRound++)
+      {
+         assert(FT_initOwned() == SUCCESS);
+         dStart = now();
+         if (ulWay == 0)
+         {
+            clientLoop(pcTop, "bench");
+            iStatus = SUCCESS;
+         }
+         else
+            iStatus = FT_importDir(pcTop, "bench",
+                                   (boolean)(ulWay % 2 == 0),
+                                   ulWay < 3 ? 1 : 4);
+         dTime = now() - dStart;
+         assert(iStatus == SUCCESS);
+         assert(FT_destroy() == SUCCESS);
+         if (ulRound == 0 || dTime < dBest)
+            dBest = dTime;
+      }
+      printf("%-26s %8.2f ms\n", apcNames[ulWay], dBest * 1e3);
+   }
+}
+
+/* Times each way of writing the tree at pcTop, once imported into an
+   owned-mode FT, out to new directories under pcTop, best of
+   ulRounds. */
+static void runExports(const char *pcTop, size_t ulRounds)
+{
+   static const char *apcNames[] = { "client write loop",
+                                     "export", "export, 4 threads" };
+   enum { NUM_WAYS = 3 };
+   char acOut[MAX_PATH];
+   double dStart, dBest, dTime;
+   size_t ulWay, ulRound;
+   int iStatus;
+
+   assert(FT_initOwned() == SUCCESS);
+   assert(FT_importDir(pcTop, "bench", FALSE, 1) == SUCCESS);
+   sprintf(acOut, "%.400s.out", pcTop);
+
+   for (ulWay = 0; ulWay < NUM_WAYS; ulWay++)
+   {
+      dBest = 0;
+      for (ulRound = 0; ulRound < ulRounds; ulRound++)
+      {
+         dStart = now();
+         if (ulWay == 0)
+         {
+            clientWriteLoop(pcTop, "bench", acOut);
+            iStatus = SUCCESS;
+         }
+         else
+            iStatus = FT_exportDir("bench", acOut, ulWay == 1 ? 1 : 4);
+         dTime = now() - dStart;
+         assert(iStatus == SUCCESS);
+         removeTree(acOut);
+         if (ulRound == 0 || dTime < dBest)
+            dBest = dTime;
+      }
+      printf("%-26s %8.2f ms\n", apcNames[ulWay], dBest * 1e3);
+   }
+   assert(FT_destroy() == SUCCESS);
+}
+
+/* Builds a synthetic tree in the directory named by argv[1] (by
+   default /dev/shm, normally a tmpfs), times importing it and
+   exporting it again every way, and removes it. Returns 0. */
+int main(int argc, char *argv[])
+{
+   char acTop[MAX_PATH];
+   size_t ulFiles = 0;
+
+   sprintf(acTop, "%.400s/ft_benchXXXXXX",
+           argc > 1 ? argv[1] : "/dev/shm");
+   assert(mkdtemp(acTop) != NULL);
+   makeTree(acTop, 1, &ulFiles);
+   printf("%lu files of %d bytes under %s\n", (unsigned long)ulFiles,
+          FILE_SIZE, acTop);
+
+   runImports(acTop, 5);
+   runExports(acTop, 5);
+
+   removeTree(acTop);
+   return 0;
+}
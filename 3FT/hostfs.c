@@ -0,0 +1,955 @@
+/*--------------------------------------------------------------------*/
+/* hostfs.c                                                           */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "hostfs.h"
+#include "contents.h"
+#include "dynarray.h"
+
+/* The most zero bytes written to a host file at a time, for contents
+   that read as zeros without being stored. */
+enum { WRITE_CHUNK = 1 << 16 };
+
+/* A file left for the worker threads to read or write */
+struct pendingFile
+{
+   /* the file's node, already linked into the tree */
+   Node_T oNFile;
+   /* the bytes read, or the mapping made, by an importing thread */
+   void *pvBytes;
+   /* the number of bytes at pvBytes */
+   size_t ulLength;
+   /* TRUE if pvBytes is a mapping rather than a malloc'd buffer */
+   boolean bMapped;
+   /* how reading or writing the file went */
+   int iStatus;
+};
+
+/* The files of one host directory, read together by one thread */
+struct batch
+{
+   /* the directory's path relative to the top of the import */
+   char *pcRelPath;
+   /* the directory's struct pendingFile objects */
+   DynArray_T oDFiles;
+};
+
+/* The state of one import */
+struct import
+{
+   /* TRUE if file contents are to be mapped rather than copied */
+   boolean bMap;
+   /* the struct batch objects left for the reader threads, or NULL if
+      files are read as soon as they are found */
+   DynArray_T oDBatches;
+   /* the number of nodes created so far */
+   size_t ulCount;
+};
+
+/* The state shared by the threads working through a list of batches */
+struct workers
+{
+   /* the struct batch objects to work through */
+   DynArray_T oDBatches;
+   /* an open descriptor for the top host directory */
+   int iTopFd;
+   /* does the work for one file, whose host directory is open as
+      iDirFd, and returns how it went */
+   int (*pfWork)(int iDirFd, struct pendingFile *psPending,
+                 boolean bMap);
+   /* passed on to pfWork */
+   boolean bMap;
+   /* the index of the next batch to hand out */
+   size_t ulNext;
+   /* guards ulNext */
+   pthread_mutex_t sLock;
+};
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Reads the host file pcName in the directory open as iDirFd. Sets
+  *ppvBytes to a malloc'd buffer of its bytes, or, if bMap is TRUE and
+  the file can be mapped, to a private mapping of it, setting
+  *pbMapped accordingly, and *pulLength to the number of bytes. An
+  empty file gives NULL and 0.
+  Returns SUCCESS, IO_ERROR if the file could not be read, or
+  MEMORY_ERROR if memory could not be allocated.
+*/
+static int HostFS_readFile(int iDirFd, const char *pcName, boolean bMap,
+                           void **ppvBytes, size_t *pulLength,
+                           boolean *pbMapped)
+{
+   struct stat sStat;
+   void *pvMapping;
+   char *pcBuf;
+   size_t ulSize;
+   size_t ulDone = 0;
+   ssize_t lRead;
+   int iFd;
+
+   assert(pcName != NULL);
+   assert(ppvBytes != NULL);
+   assert(pulLength != NULL);
+   assert(pbMapped != NULL);
+
+   *ppvBytes = NULL;
+   *pulLength = 0;
+   *pbMapped = FALSE;
+
+   iFd = openat(iDirFd, pcName, O_RDONLY | O_NOFOLLOW);
+   if (iFd < 0)
+      return IO_ERROR;
+   if (fstat(iFd, &sStat) != 0)
+   {
+      (void)close(iFd);
+      return IO_ERROR;
+   }
+   ulSize = (size_t)sStat.st_size;
+   if (ulSize == 0)
+   {
+      (void)close(iFd);
+      return SUCCESS;
+   }
+
+   if (bMap)
+   {
+      /* writable but private, so clients may scribble on their copy */
+      pvMapping = mmap(NULL, ulSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, iFd, 0);
+      if (pvMapping != MAP_FAILED)
+      {
+         (void)close(iFd);
+         *ppvBytes = pvMapping;
+         *pulLength = ulSize;
+         *pbMapped = TRUE;
+         return SUCCESS;
+      }
+      /* otherwise read it like any other file */
+   }
+
+   pcBuf = malloc(ulSize);
+   if (pcBuf == NULL)
+   {
+      (void)close(iFd);
+      return MEMORY_ERROR;
+   }
+   while (ulDone < ulSize)
+   {
+      lRead = read(iFd, pcBuf + ulDone, ulSize - ulDone);
+      if (lRead < 0 && errno == EINTR)
+         continue;
+      if (lRead < 0)
+      {
+         free(pcBuf);
+         (void)close(iFd);
+         return IO_ERROR;
+      }
+      /* the file may have shrunk since it was measured */
+      if (lRead == 0)
+         break;
+      ulDone += (size_t)lRead;
+   }
+   (void)close(iFd);
+
+   *ppvBytes = pcBuf;
+   *pulLength = ulDone;
+   return SUCCESS;
+}
+
+/* Frees the bytes read by HostFS_readFile. */
+static void HostFS_discardBytes(void *pvBytes, size_t ulLength,
+                                boolean bMapped)
+{
+   if (bMapped)
+      (void)munmap(pvBytes, ulLength);
+   else
+      free(pvBytes);
+}
+
+/*
+  Makes the bytes read by HostFS_readFile the contents of file node
+  oNFile, which takes care of them from then on, even on failure.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated.
+*/
+static int HostFS_adoptBytes(Node_T oNFile, void *pvBytes,
+                             size_t ulLength, boolean bMapped)
+{
+   Contents_T oCContents = NULL;
+
+   assert(oNFile != NULL);
+
+   if (bMapped)
+      oCContents = Contents_newMapped(pvBytes, ulLength);
+   else if (ulLength != 0)
+      oCContents = Contents_new(pvBytes, ulLength);
+
+   if (oCContents == NULL && ulLength != 0)
+   {
+      HostFS_discardBytes(pvBytes, ulLength, bMapped);
+      return MEMORY_ERROR;
+   }
+   if (!bMapped)
+      free(pvBytes);
+
+   Node_adoptContents(oNFile, oCContents);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Reads psPending's file into it, as a struct workers pfWork. */
+static int HostFS_readPending(int iDirFd, struct pendingFile *psPending,
+                              boolean bMap)
+{
+   assert(psPending != NULL);
+
+   return HostFS_readFile(iDirFd, Node_getName(psPending->oNFile), bMap,
+                          &psPending->pvBytes, &psPending->ulLength,
+                          &psPending->bMapped);
+}
+
+/*
+  Adds file node oNFile, in the host directory with path pcRelPath
+  relative to the top of the import or export, to that directory's
+  batch *ppsBatch in oDBatches, starting the batch if it is NULL.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated.
+*/
+static int HostFS_addPending(DynArray_T oDBatches, const char *pcRelPath,
+                             struct batch **ppsBatch, Node_T oNFile)
+{
+   struct batch *psBatch = *ppsBatch;
+   struct pendingFile *psPending;
+
+   assert(oDBatches != NULL);
+   assert(pcRelPath != NULL);
+   assert(oNFile != NULL);
+
+   if (psBatch == NULL)
+   {
+      psBatch = malloc(sizeof(struct batch));
+      if (psBatch == NULL)
+         return MEMORY_ERROR;
+      psBatch->pcRelPath = malloc(strlen(pcRelPath) + 1);
+      psBatch->oDFiles = DynArray_new(0);
+      if (psBatch->pcRelPath == NULL || psBatch->oDFiles == NULL ||
+          !DynArray_add(oDBatches, psBatch))
+      {
+         free(psBatch->pcRelPath);
+         if (psBatch->oDFiles != NULL)
+            DynArray_free(psBatch->oDFiles);
+         free(psBatch);
+         return MEMORY_ERROR;
+      }
+      strcpy(psBatch->pcRelPath, pcRelPath);
+      *ppsBatch = psBatch;
+   }
+
+   psPending = malloc(sizeof(struct pendingFile));
+   if (psPending == NULL)
+      return MEMORY_ERROR;
+   psPending->oNFile = oNFile;
+   psPending->pvBytes = NULL;
+   psPending->ulLength = 0;
+   psPending->bMapped = FALSE;
+   psPending->iStatus = SUCCESS;
+   if (!DynArray_add(psBatch->oDFiles, psPending))
+   {
+      free(psPending);
+      return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+static int HostFS_importEntries(int iDirFd, const char *pcRelPath,
+                                Node_T oNDir, struct import *psImport);
+
+/*
+  Imports the entries of the host subdirectory of the directory open
+  as iDirFd, whose path relative to the top of the import is
+  pcRelPath, that directory node oNChild was made for. Returns as
+  HostFS_importDir.
+*/
+static int HostFS_importSubdir(int iDirFd, const char *pcRelPath,
+                               Node_T oNChild, struct import *psImport)
+{
+   const char *pcName;
+   char *pcChildPath = NULL;
+   int iChildFd;
+   int iStatus;
+
+   assert(pcRelPath != NULL);
+   assert(oNChild != NULL);
+   assert(psImport != NULL);
+
+   pcName = Node_getName(oNChild);
+
+   /* the reader threads find a directory again by its relative path */
+   if (psImport->oDBatches != NULL)
+   {
+      pcChildPath = malloc(strlen(pcRelPath) + strlen(pcName) + 2);
+      if (pcChildPath == NULL)
+         return MEMORY_ERROR;
+      strcpy(pcChildPath, pcRelPath);
+      strcat(pcChildPath, "/");
+      strcat(pcChildPath, pcName);
+   }
+
+   iChildFd = openat(iDirFd, pcName, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+   if (iChildFd < 0)
+   {
+      free(pcChildPath);
+      return IO_ERROR;
+   }
+
+   iStatus = HostFS_importEntries(iChildFd,
+                                  pcChildPath != NULL ? pcChildPath
+                                                      : pcRelPath,
+                                  oNChild, psImport);
+   free(pcChildPath);
+   return iStatus;
+}
+
+/*
+  Gives file node oNFile the contents of the host file of the
+  directory open as iDirFd that it was made for: reading it right
+  away, or adding it to batch *ppsBatch if the reader threads are to
+  read it. Returns as HostFS_importDir.
+*/
+static int HostFS_importFile(int iDirFd, const char *pcRelPath,
+                             Node_T oNFile, struct batch **ppsBatch,
+                             struct import *psImport)
+{
+   void *pvBytes;
+   size_t ulLength;
+   boolean bMapped;
+   int iStatus;
+
+   assert(oNFile != NULL);
+   assert(ppsBatch != NULL);
+   assert(psImport != NULL);
+
+   if (psImport->oDBatches != NULL)
+      return HostFS_addPending(psImport->oDBatches, pcRelPath, ppsBatch,
+                               oNFile);
+
+   iStatus = HostFS_readFile(iDirFd, Node_getName(oNFile), psImport->bMap,
+                             &pvBytes, &ulLength, &bMapped);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return HostFS_adoptBytes(oNFile, pvBytes, ulLength, bMapped);
+}
+
+/*
+  Frees pcName. This wrapper is used to match the requirements of the
+  callback function pointer passed to DynArray_map. pvExtra is unused.
+*/
+static void HostFS_freeName(char *pcName, void *pvExtra)
+{
+   (void)pvExtra;
+   free(pcName);
+}
+
+/*
+  Makes a child of directory node oNDir for each host directory and
+  regular file of the directory open as iDirFd whose name is in
+  oDNames, which is sorted, merging the files and then the
+  directories into oNDir's children in one pass each. Sets
+  *ppoNChildren to a new array, which the caller must free, holding
+  the file nodes and then the directory nodes, and *pulFiles and
+  *pulDirs to how many there are of each. Returns as HostFS_importDir.
+*/
+static int HostFS_addChildren(int iDirFd, DynArray_T oDNames,
+                              Node_T oNDir, struct import *psImport,
+                              Node_T **ppoNChildren, size_t *pulFiles,
+                              size_t *pulDirs)
+{
+   struct stat sStat;
+   const char **ppcNames;
+   const char *pcName;
+   Node_T *poNChildren;
+   size_t ulNames;
+   size_t ulFiles = 0;
+   size_t ulDirs = 0;
+   size_t ulIndex;
+   size_t ulLast;
+   int iStatus;
+
+   assert(oDNames != NULL);
+   assert(oNDir != NULL);
+   assert(psImport != NULL);
+   assert(ppoNChildren != NULL);
+   assert(pulFiles != NULL);
+   assert(pulDirs != NULL);
+
+   *ppoNChildren = NULL;
+   *pulFiles = 0;
+   *pulDirs = 0;
+   ulNames = DynArray_getLength(oDNames);
+   if (ulNames == 0)
+      return SUCCESS;
+
+   ppcNames = malloc(ulNames * sizeof(const char *));
+   poNChildren = malloc(ulNames * sizeof(Node_T));
+   if (ppcNames == NULL || poNChildren == NULL)
+   {
+      free(ppcNames);
+      free(poNChildren);
+      return MEMORY_ERROR;
+   }
+
+   /* files go from the front of ppcNames, directories from the back */
+   for (ulIndex = 0; ulIndex < ulNames; ulIndex++)
+   {
+      pcName = DynArray_get(oDNames, ulIndex);
+      if (fstatat(iDirFd, pcName, &sStat, AT_SYMLINK_NOFOLLOW) != 0)
+      {
+         free(ppcNames);
+         free(poNChildren);
+         return IO_ERROR;
+      }
+      if (S_ISREG(sStat.st_mode))
+         ppcNames[ulFiles++] = pcName;
+      else if (S_ISDIR(sStat.st_mode))
+         ppcNames[ulNames - ++ulDirs] = pcName;
+   }
+   /* and then the directories are turned back into sorted order */
+   for (ulIndex = ulNames - ulDirs, ulLast = ulNames - 1;
+        ulIndex < ulLast; ulIndex++, ulLast--)
+   {
+      pcName = ppcNames[ulIndex];
+      ppcNames[ulIndex] = ppcNames[ulLast];
+      ppcNames[ulLast] = pcName;
+   }
+
+   /* size oNDir's children once; if that fails, each merge still
+      grows them as it goes */
+   (void)Node_reserveChildren(oNDir, Node_getNumChildren(oNDir) +
+                              ulFiles + ulDirs);
+   iStatus = Node_newChildren(oNDir, ppcNames, ulFiles, TRUE,
+                              poNChildren);
+   if (iStatus == SUCCESS)
+   {
+      *pulFiles = ulFiles;
+      psImport->ulCount += ulFiles;
+      iStatus = Node_newChildren(oNDir, ppcNames + ulNames - ulDirs,
+                                 ulDirs, FALSE, poNChildren + ulFiles);
+   }
+   if (iStatus == SUCCESS)
+   {
+      *pulDirs = ulDirs;
+      psImport->ulCount += ulDirs;
+   }
+
+   free(ppcNames);
+   *ppoNChildren = poNChildren;
+   return iStatus;
+}
+
+/*
+  Adds the entries of the host directory open as iDirFd, whose path
+  relative to the top of the import is pcRelPath, to directory node
+  oNDir, recursively: all of its children at once, and then what is
+  in each. Closes iDirFd. Returns as HostFS_importDir.
+*/
+static int HostFS_importEntries(int iDirFd, const char *pcRelPath,
+                                Node_T oNDir, struct import *psImport)
+{
+   DIR *psDir;
+   struct dirent *psEntry;
+   struct batch *psBatch = NULL;
+   DynArray_T oDNames;
+   Node_T *poNChildren = NULL;
+   const char *pcName;
+   char *pcCopy;
+   size_t ulFiles = 0;
+   size_t ulDirs = 0;
+   size_t ulIndex;
+   int iStatus = SUCCESS;
+
+   assert(pcRelPath != NULL);
+   assert(oNDir != NULL);
+   assert(psImport != NULL);
+
+   psDir = fdopendir(iDirFd);
+   if (psDir == NULL)
+   {
+      (void)close(iDirFd);
+      return IO_ERROR;
+   }
+   iDirFd = dirfd(psDir);
+   oDNames = DynArray_new(0);
+   if (oDNames == NULL)
+   {
+      (void)closedir(psDir);
+      return MEMORY_ERROR;
+   }
+
+   for (;;)
+   {
+      errno = 0;
+      psEntry = readdir(psDir);
+      if (psEntry == NULL)
+      {
+         if (errno != 0)
+            iStatus = IO_ERROR;
+         break;
+      }
+
+      pcName = psEntry->d_name;
+      if (!strcmp(pcName, ".") || !strcmp(pcName, ".."))
+         continue;
+
+      pcCopy = malloc(strlen(pcName) + 1);
+      if (pcCopy == NULL)
+      {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      strcpy(pcCopy, pcName);
+      if (!DynArray_add(oDNames, pcCopy))
+      {
+         free(pcCopy);
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+   }
+
+   if (iStatus == SUCCESS)
+   {
+      DynArray_sortStrings(oDNames);
+      iStatus = HostFS_addChildren(iDirFd, oDNames, oNDir, psImport,
+                                   &poNChildren, &ulFiles, &ulDirs);
+   }
+   for (ulIndex = 0; iStatus == SUCCESS && ulIndex < ulFiles + ulDirs;
+        ulIndex++)
+   {
+      if (ulIndex < ulFiles)
+         iStatus = HostFS_importFile(iDirFd, pcRelPath,
+                                     poNChildren[ulIndex], &psBatch,
+                                     psImport);
+      else
+         iStatus = HostFS_importSubdir(iDirFd, pcRelPath,
+                                       poNChildren[ulIndex], psImport);
+   }
+   free(poNChildren);
+
+   DynArray_map(oDNames, (void (*)(void *, void *))HostFS_freeName,
+                NULL);
+   DynArray_free(oDNames);
+   (void)closedir(psDir);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Does the work for the files of the batches handed out from
+  pvWorkers, a struct workers, until there are none left. Each batch's
+  directory is opened relative to the top host directory. Always
+  returns NULL.
+*/
+static void *HostFS_workBatches(void *pvWorkers)
+{
+   struct workers *psWorkers = pvWorkers;
+   struct batch *psBatch;
+   struct pendingFile *psPending;
+   size_t ulBatch;
+   size_t ulIndex;
+   int iDirFd;
+
+   for (;;)
+   {
+      (void)pthread_mutex_lock(&psWorkers->sLock);
+      ulBatch = psWorkers->ulNext++;
+      (void)pthread_mutex_unlock(&psWorkers->sLock);
+      if (ulBatch >= DynArray_getLength(psWorkers->oDBatches))
+         break;
+
+      psBatch = DynArray_get(psWorkers->oDBatches, ulBatch);
+      iDirFd = openat(psWorkers->iTopFd, psBatch->pcRelPath,
+                      O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+      for (ulIndex = 0; ulIndex < DynArray_getLength(psBatch->oDFiles);
+           ulIndex++)
+      {
+         psPending = DynArray_get(psBatch->oDFiles, ulIndex);
+         if (iDirFd < 0)
+            psPending->iStatus = IO_ERROR;
+         else
+            psPending->iStatus = (*psWorkers->pfWork)(iDirFd, psPending,
+                                                      psWorkers->bMap);
+      }
+      if (iDirFd >= 0)
+         (void)close(iDirFd);
+   }
+   return NULL;
+}
+
+/*
+  Does the work pfWork for the files of all batches in oDBatches, with
+  ulThreads threads, the calling thread among them. Fewer threads are
+  used if some could not be started. The tree must not change
+  meanwhile.
+*/
+static void HostFS_runInParallel(DynArray_T oDBatches, int iTopFd,
+                                 int (*pfWork)(int, struct pendingFile *,
+                                               boolean),
+                                 boolean bMap, size_t ulThreads)
+{
+   struct workers sWorkers;
+   pthread_t *psThreads;
+   size_t ulStarted = 0;
+   size_t ulIndex;
+
+   assert(oDBatches != NULL);
+   assert(pfWork != NULL);
+   assert(ulThreads > 1);
+
+   sWorkers.oDBatches = oDBatches;
+   sWorkers.iTopFd = iTopFd;
+   sWorkers.pfWork = pfWork;
+   sWorkers.bMap = bMap;
+   sWorkers.ulNext = 0;
+   (void)pthread_mutex_init(&sWorkers.sLock, NULL);
+
+   psThreads = malloc((ulThreads - 1) * sizeof(pthread_t));
+   if (psThreads != NULL)
+   {
+      while (ulStarted < ulThreads - 1 &&
+             pthread_create(&psThreads[ulStarted], NULL,
+                            HostFS_workBatches, &sWorkers) == 0)
+         ulStarted++;
+   }
+
+   (void)HostFS_workBatches(&sWorkers);
+
+   for (ulIndex = 0; ulIndex < ulStarted; ulIndex++)
+      (void)pthread_join(psThreads[ulIndex], NULL);
+   free(psThreads);
+   (void)pthread_mutex_destroy(&sWorkers.sLock);
+}
+
+/*
+  Frees the batches in oDBatches (which may be NULL). If bAdopt is
+  TRUE and iStatus is SUCCESS, the bytes read for each file are first
+  handed to its node; otherwise they are just freed.
+  Returns iStatus, or the first failure along the way.
+*/
+static int HostFS_finishBatches(DynArray_T oDBatches, boolean bAdopt,
+                                int iStatus)
+{
+   struct batch *psBatch;
+   struct pendingFile *psPending;
+   size_t ulBatch;
+   size_t ulIndex;
+
+   if (oDBatches == NULL)
+      return iStatus;
+
+   for (ulBatch = 0; ulBatch < DynArray_getLength(oDBatches); ulBatch++)
+   {
+      psBatch = DynArray_get(oDBatches, ulBatch);
+      for (ulIndex = 0; ulIndex < DynArray_getLength(psBatch->oDFiles);
+           ulIndex++)
+      {
+         psPending = DynArray_get(psBatch->oDFiles, ulIndex);
+         if (iStatus == SUCCESS)
+            iStatus = psPending->iStatus;
+         if (iStatus == SUCCESS && bAdopt)
+            iStatus = HostFS_adoptBytes(psPending->oNFile,
+                                        psPending->pvBytes,
+                                        psPending->ulLength,
+                                        psPending->bMapped);
+         else if (psPending->pvBytes != NULL)
+            HostFS_discardBytes(psPending->pvBytes,
+                                psPending->ulLength,
+                                psPending->bMapped);
+         free(psPending);
+      }
+      DynArray_free(psBatch->oDFiles);
+      free(psBatch->pcRelPath);
+      free(psBatch);
+   }
+   DynArray_free(oDBatches);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int HostFS_importDir(const char *pcHostPath, Node_T oNDir, boolean bMap,
+                     size_t ulThreads, size_t *pulCount)
+{
+   struct import sImport;
+   int iTopFd;
+   int iWalkFd;
+   int iStatus;
+
+   assert(pcHostPath != NULL);
+   assert(oNDir != NULL);
+   assert(pulCount != NULL);
+
+   *pulCount = 0;
+
+   iTopFd = open(pcHostPath, O_RDONLY | O_DIRECTORY);
+   if (iTopFd < 0)
+   {
+      if (errno == ENOENT)
+         return NO_SUCH_PATH;
+      if (errno == ENOTDIR)
+         return NOT_A_DIRECTORY;
+      return IO_ERROR;
+   }
+
+   sImport.bMap = bMap;
+   sImport.ulCount = 0;
+   sImport.oDBatches = NULL;
+   if (ulThreads > 1)
+   {
+      sImport.oDBatches = DynArray_new(0);
+      if (sImport.oDBatches == NULL)
+      {
+         (void)close(iTopFd);
+         return MEMORY_ERROR;
+      }
+   }
+
+   /* the walk closes its descriptor, but the readers need the top */
+   iWalkFd = dup(iTopFd);
+   if (iWalkFd < 0)
+      iStatus = IO_ERROR;
+   else
+      iStatus = HostFS_importEntries(iWalkFd, ".", oNDir, &sImport);
+
+   if (iStatus == SUCCESS && sImport.oDBatches != NULL)
+      HostFS_runInParallel(sImport.oDBatches, iTopFd, HostFS_readPending,
+                           bMap, ulThreads);
+   iStatus = HostFS_finishBatches(sImport.oDBatches, TRUE, iStatus);
+   (void)close(iTopFd);
+
+   *pulCount = sImport.ulCount;
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Creates a host file named after file node oNFile in the directory
+  open as iDirFd and writes the node's contents to it straight from
+  where they are stored, preallocating its full size first. Returns
+  SUCCESS, or IO_ERROR if the file could not be created or written.
+*/
+static int HostFS_writeFile(int iDirFd, Node_T oNFile)
+{
+   static const char acZeros[WRITE_CHUNK];
+   const void *pvSpan;
+   size_t ulLength;
+   size_t ulDone = 0;
+   size_t ulSpan;
+   size_t ulWritten;
+   ssize_t lWritten;
+   int iFd;
+   int iError;
+
+   assert(oNFile != NULL);
+
+   iFd = openat(iDirFd, Node_getName(oNFile),
+                O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0666);
+   if (iFd < 0)
+      return IO_ERROR;
+
+   /* a file system that cannot preallocate just writes as it goes */
+   ulLength = Node_getFileSize(oNFile);
+   if (ulLength != 0)
+   {
+      iError = posix_fallocate(iFd, 0, (off_t)ulLength);
+      if (iError != 0 && iError != EINVAL && iError != EOPNOTSUPP)
+      {
+         (void)close(iFd);
+         return IO_ERROR;
+      }
+   }
+
+   /* Node_getFileSpan only reads the node, so threads may share it */
+   while (ulDone < ulLength)
+   {
+      ulSpan = Node_getFileSpan(oNFile, ulDone, &pvSpan);
+      if (ulSpan == 0)
+         break;
+      if (pvSpan == NULL)
+      {
+         pvSpan = acZeros;
+         if (ulSpan > sizeof(acZeros))
+            ulSpan = sizeof(acZeros);
+      }
+      for (ulWritten = 0; ulWritten < ulSpan; )
+      {
+         lWritten = pwrite(iFd, (const char *)pvSpan + ulWritten,
+                           ulSpan - ulWritten,
+                           (off_t)(ulDone + ulWritten));
+         if (lWritten < 0 && errno == EINTR)
+            continue;
+         if (lWritten < 0)
+         {
+            (void)close(iFd);
+            return IO_ERROR;
+         }
+         ulWritten += (size_t)lWritten;
+      }
+      ulDone += ulSpan;
+   }
+
+   /* a span ends early only if the contents could not be read */
+   if (close(iFd) != 0 || ulDone < ulLength)
+      return IO_ERROR;
+   return SUCCESS;
+}
+
+/*
+  Writes psPending's file out, as a struct workers pfWork. bMap only
+  matters to reads, which may map the host file; writes never do.
+*/
+static int HostFS_writePending(int iDirFd, struct pendingFile *psPending,
+                               boolean bMap)
+{
+   assert(psPending != NULL);
+
+   (void)bMap;
+
+   return HostFS_writeFile(iDirFd, psPending->oNFile);
+}
+
+/*
+  Creates the children of directory node oNDir in the host directory
+  open as iDirFd, whose path relative to the top of the export is
+  pcRelPath, in tree order and recursively. Files are written right
+  away if oDBatches is NULL, and otherwise added to it for the writer
+  threads. Returns as HostFS_exportDir.
+*/
+static int HostFS_exportEntries(int iDirFd, const char *pcRelPath,
+                                Node_T oNDir, DynArray_T oDBatches)
+{
+   struct batch *psBatch = NULL;
+   Node_T oNChild = NULL;
+   char *pcChildPath = NULL;
+   const char *pcName;
+   size_t ulIndex;
+   int iChildFd;
+   int iStatus;
+
+   assert(pcRelPath != NULL);
+   assert(oNDir != NULL);
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNDir); ulIndex++)
+   {
+      (void)Node_getChild(oNDir, ulIndex, &oNChild);
+      pcName = Node_getName(oNChild);
+
+      if (Node_isFile(oNChild))
+      {
+         if (oDBatches != NULL)
+            iStatus = HostFS_addPending(oDBatches, pcRelPath, &psBatch,
+                                        oNChild);
+         else
+            iStatus = HostFS_writeFile(iDirFd, oNChild);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         continue;
+      }
+
+      if (mkdirat(iDirFd, pcName, 0777) != 0)
+         return IO_ERROR;
+      iChildFd = openat(iDirFd, pcName,
+                        O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+      if (iChildFd < 0)
+         return IO_ERROR;
+
+      /* the writer threads find a directory again by its relative
+         path */
+      if (oDBatches != NULL)
+      {
+         pcChildPath = malloc(strlen(pcRelPath) + strlen(pcName) + 2);
+         if (pcChildPath == NULL)
+         {
+            (void)close(iChildFd);
+            return MEMORY_ERROR;
+         }
+         strcpy(pcChildPath, pcRelPath);
+         strcat(pcChildPath, "/");
+         strcat(pcChildPath, pcName);
+      }
+
+      iStatus = HostFS_exportEntries(iChildFd,
+                                     pcChildPath != NULL ? pcChildPath
+                                                         : pcRelPath,
+                                     oNChild, oDBatches);
+      free(pcChildPath);
+      pcChildPath = NULL;
+      (void)close(iChildFd);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+   return SUCCESS;
+}
+
+int HostFS_exportDir(Node_T oNDir, const char *pcHostPath,
+                     size_t ulThreads)
+{
+   DynArray_T oDBatches = NULL;
+   int iTopFd;
+   int iStatus;
+
+   assert(oNDir != NULL);
+   assert(pcHostPath != NULL);
+
+   if (mkdir(pcHostPath, 0777) != 0)
+   {
+      if (errno == EEXIST)
+         return ALREADY_IN_TREE;
+      if (errno == ENOENT)
+         return NO_SUCH_PATH;
+      if (errno == ENOTDIR)
+         return NOT_A_DIRECTORY;
+      return IO_ERROR;
+   }
+   iTopFd = open(pcHostPath, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+   if (iTopFd < 0)
+      return IO_ERROR;
+
+   if (ulThreads > 1)
+   {
+      oDBatches = DynArray_new(0);
+      if (oDBatches == NULL)
+      {
+         (void)close(iTopFd);
+         return MEMORY_ERROR;
+      }
+   }
+
+   /* every directory exists before any thread starts writing files */
+   iStatus = HostFS_exportEntries(iTopFd, ".", oNDir, oDBatches);
+   if (iStatus == SUCCESS && oDBatches != NULL)
+   {
+      /* no thread's contents may be evicted under another's feet */
+      Contents_holdTier();
+      HostFS_runInParallel(oDBatches, iTopFd, HostFS_writePending, FALSE,
+                           ulThreads);
+      Contents_releaseTier();
+   }
+   iStatus = HostFS_finishBatches(oDBatches, FALSE, iStatus);
+   (void)close(iTopFd);
+   return iStatus;
+}
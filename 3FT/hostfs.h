@@ -0,0 +1,55 @@
+/*--------------------------------------------------------------------*/
+/* hostfs.h                                                           */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef HOSTFS_INCLUDED
+#define HOSTFS_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  Fills the empty directory node oNDir with the contents of the host
+  directory at pcHostPath: its subdirectories and regular files,
+  recursively. Symbolic links and special files are skipped, and are
+  never followed. Each directory is opened relative to its parent's
+  open descriptor, and each entry is linked directly under its parent
+  node, so no path is ever resolved from the top more than once.
+  File contents become FT-owned copies, or, if bMap is TRUE, private
+  mappings of the host files (which must then not be truncated while
+  in the FT). If ulThreads is more than 1, the tree is built first and
+  the files are then read by that many threads.
+  Sets *pulCount to the number of nodes created under oNDir.
+  Returns SUCCESS, or, leaving oNDir partly filled for the caller to
+  free:
+  * NO_SUCH_PATH if pcHostPath does not exist on the host
+  * NOT_A_DIRECTORY if pcHostPath is not a directory on the host
+  * IO_ERROR if a host directory or file could not be read
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int HostFS_importDir(const char *pcHostPath, Node_T oNDir, boolean bMap,
+                     size_t ulThreads, size_t *pulCount);
+
+/*
+  Creates host directory pcHostPath and writes the subtree rooted at
+  directory node oNDir out to it as real directories and files.
+  Directories are created in tree order, each relative to its parent's
+  open descriptor. Each file is preallocated to its full size and then
+  written with pwrite, either as it is reached or, if ulThreads is
+  more than 1, by that many threads once every directory exists. The
+  subtree is only read, so it must not change meanwhile.
+  Returns SUCCESS, or, possibly leaving a partial copy on the host:
+  * ALREADY_IN_TREE if pcHostPath already exists on the host
+  * NO_SUCH_PATH if pcHostPath's parent does not exist on the host
+  * NOT_A_DIRECTORY if a prefix of pcHostPath is not a directory on
+                    the host
+  * IO_ERROR if a host directory or file could not be created or
+             written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int HostFS_exportDir(Node_T oNDir, const char *pcHostPath,
+                     size_t ulThreads);
+
+#endif
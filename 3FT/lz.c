@@ -0,0 +1,239 @@
+/*--------------------------------------------------------------------*/
+/* lz.c                                                               */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <string.h>
+#include "lz.h"
+
+/* The shortest copy worth encoding, and the farthest one can reach. */
+enum { MIN_MATCH = 4, MAX_OFFSET = 65535 };
+
+/* The number of bits in a hash of MIN_MATCH bytes. */
+enum { HASH_BITS = 12 };
+
+/* The largest count that fits in either half of a sequence's first
+   byte; a larger one goes on in extra bytes. */
+enum { NIBBLE_MAX = 15 };
+
+/*--------------------------------------------------------------------*/
+
+/* Returns a HASH_BITS-bit hash of the MIN_MATCH bytes at pucBytes. */
+static size_t LZ_hash(const unsigned char *pucBytes)
+{
+   unsigned long ulWord;
+
+   ulWord = (unsigned long)pucBytes[0]
+            | (unsigned long)pucBytes[1] << 8
+            | (unsigned long)pucBytes[2] << 16
+            | (unsigned long)pucBytes[3] << 24;
+   return (size_t)(((ulWord * 2654435761UL) & 0xffffffffUL)
+                   >> (32 - HASH_BITS));
+}
+
+/*
+  Appends the part of count ulCount past NIBBLE_MAX at *ppucOut, as
+  bytes of 255 and a last byte less than 255, and advances *ppucOut.
+  Returns FALSE if that would go past pucEnd.
+*/
+static boolean LZ_putCount(unsigned char **ppucOut,
+                           const unsigned char *pucEnd, size_t ulCount)
+{
+   unsigned char *pucOut = *ppucOut;
+
+   if (ulCount < NIBBLE_MAX)
+      return TRUE;
+   ulCount -= NIBBLE_MAX;
+   while (ulCount >= 255)
+   {
+      if (pucOut == pucEnd)
+         return FALSE;
+      *pucOut++ = 255;
+      ulCount -= 255;
+   }
+   if (pucOut == pucEnd)
+      return FALSE;
+   *pucOut++ = (unsigned char)ulCount;
+   *ppucOut = pucOut;
+   return TRUE;
+}
+
+/*
+  Appends a sequence to *ppucOut: the ulLiterals bytes at pucLiterals,
+  then, if ulMatch is not 0, a copy of ulMatch bytes from ulOffset
+  back. Advances *ppucOut, and returns FALSE if the sequence would go
+  past pucEnd.
+*/
+static boolean LZ_putSequence(unsigned char **ppucOut,
+                              const unsigned char *pucEnd,
+                              const unsigned char *pucLiterals,
+                              size_t ulLiterals, size_t ulOffset,
+                              size_t ulMatch)
+{
+   unsigned char *pucToken = *ppucOut;
+   size_t ulMatchCount = ulMatch == 0 ? 0 : ulMatch - MIN_MATCH;
+
+   if (pucToken == pucEnd)
+      return FALSE;
+   *pucToken = (unsigned char)
+      ((ulLiterals < NIBBLE_MAX ? ulLiterals : NIBBLE_MAX) << 4
+       | (ulMatchCount < NIBBLE_MAX ? ulMatchCount : NIBBLE_MAX));
+   *ppucOut = pucToken + 1;
+
+   if (!LZ_putCount(ppucOut, pucEnd, ulLiterals))
+      return FALSE;
+   if ((size_t)(pucEnd - *ppucOut) < ulLiterals)
+      return FALSE;
+   memcpy(*ppucOut, pucLiterals, ulLiterals);
+   *ppucOut += ulLiterals;
+   if (ulMatch == 0)
+      return TRUE;
+
+   if (pucEnd - *ppucOut < 2)
+      return FALSE;
+   (*ppucOut)[0] = (unsigned char)(ulOffset & 0xff);
+   (*ppucOut)[1] = (unsigned char)(ulOffset >> 8);
+   *ppucOut += 2;
+   return LZ_putCount(ppucOut, pucEnd, ulMatchCount);
+}
+
+/*
+  Reads the rest of a count that started as ulCount in a sequence's
+  first byte from *ppucIn, before pucEnd, and advances *ppucIn. Sets
+  *pulCount to the count. Returns FALSE if the input runs out or the
+  count goes past ulLimit.
+*/
+static boolean LZ_getCount(const unsigned char **ppucIn,
+                           const unsigned char *pucEnd, size_t ulCount,
+                           size_t ulLimit, size_t *pulCount)
+{
+   unsigned char ucByte;
+
+   if (ulCount == NIBBLE_MAX)
+   {
+      do
+      {
+         if (*ppucIn == pucEnd)
+            return FALSE;
+         ucByte = *(*ppucIn)++;
+         ulCount += ucByte;
+         if (ulCount > ulLimit)
+            return FALSE;
+      } while (ucByte == 255);
+   }
+   *pulCount = ulCount;
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t LZ_compress(const void *pvSrc, size_t ulLength, void *pvDst,
+                   size_t ulCapacity)
+{
+   const unsigned char *pucIn = pvSrc;
+   unsigned char *pucOut = pvDst;
+   const unsigned char *pucEnd = pucOut + ulCapacity;
+   size_t aulTable[1 << HASH_BITS];
+   size_t ulAnchor = 0;
+   size_t ulPos = 0;
+   size_t ulCandidate;
+   size_t ulMatch;
+   size_t ulHash;
+
+   assert(pvSrc != NULL || ulLength == 0);
+   assert(pvDst != NULL || ulCapacity == 0);
+
+   /* a stale or zeroed entry is caught by comparing its bytes */
+   memset(aulTable, 0, sizeof(aulTable));
+
+   while (ulLength >= MIN_MATCH && ulPos <= ulLength - MIN_MATCH)
+   {
+      ulHash = LZ_hash(pucIn + ulPos);
+      ulCandidate = aulTable[ulHash];
+      aulTable[ulHash] = ulPos;
+      if (ulCandidate >= ulPos || ulPos - ulCandidate > MAX_OFFSET ||
+          memcmp(pucIn + ulCandidate, pucIn + ulPos, MIN_MATCH) != 0)
+      {
+         /* skip ahead faster the longer nothing has matched */
+         ulPos += 1 + ((ulPos - ulAnchor) >> 6);
+         continue;
+      }
+
+      ulMatch = MIN_MATCH;
+      while (ulPos + ulMatch < ulLength &&
+             pucIn[ulCandidate + ulMatch] == pucIn[ulPos + ulMatch])
+         ulMatch++;
+      if (!LZ_putSequence(&pucOut, pucEnd, pucIn + ulAnchor,
+                          ulPos - ulAnchor, ulPos - ulCandidate,
+                          ulMatch))
+         return 0;
+      ulPos += ulMatch;
+      ulAnchor = ulPos;
+   }
+
+   /* the last sequence is just literals, possibly none */
+   if (!LZ_putSequence(&pucOut, pucEnd, pucIn + ulAnchor,
+                       ulLength - ulAnchor, 0, 0))
+      return 0;
+   return (size_t)(pucOut - (unsigned char *)pvDst);
+}
+
+boolean LZ_decompress(const void *pvSrc, size_t ulPacked, void *pvDst,
+                      size_t ulLength)
+{
+   const unsigned char *pucIn = pvSrc;
+   const unsigned char *pucInEnd = pucIn + ulPacked;
+   unsigned char *pucStart = pvDst;
+   unsigned char *pucOut = pucStart;
+   size_t ulLeft;
+   size_t ulCount;
+   size_t ulOffset;
+   unsigned char ucToken;
+
+   assert(pvSrc != NULL || ulPacked == 0);
+   assert(pvDst != NULL || ulLength == 0);
+
+   while (pucIn != pucInEnd)
+   {
+      ucToken = *pucIn++;
+      ulLeft = ulLength - (size_t)(pucOut - pucStart);
+
+      /* the literals */
+      if (!LZ_getCount(&pucIn, pucInEnd, (size_t)(ucToken >> 4), ulLeft,
+                       &ulCount))
+         return FALSE;
+      if (ulCount > ulLeft || ulCount > (size_t)(pucInEnd - pucIn))
+         return FALSE;
+      memcpy(pucOut, pucIn, ulCount);
+      pucOut += ulCount;
+      pucIn += ulCount;
+      if (pucIn == pucInEnd)
+         break;
+
+      /* the copy, which may overlap what it produces */
+      if (pucInEnd - pucIn < 2)
+         return FALSE;
+      ulOffset = (size_t)pucIn[0] | (size_t)pucIn[1] << 8;
+      pucIn += 2;
+      if (ulOffset == 0 || ulOffset > (size_t)(pucOut - pucStart))
+         return FALSE;
+      ulLeft = ulLength - (size_t)(pucOut - pucStart);
+      if (!LZ_getCount(&pucIn, pucInEnd, (size_t)(ucToken & NIBBLE_MAX),
+                       ulLeft, &ulCount))
+         return FALSE;
+      ulCount += MIN_MATCH;
+      if (ulCount > ulLeft)
+         return FALSE;
+      if (ulOffset >= ulCount)
+         memcpy(pucOut, pucOut - ulOffset, ulCount);
+      else
+      {
+         for (; ulCount > 0; ulCount--, pucOut++)
+            *pucOut = *(pucOut - ulOffset);
+         continue;
+      }
+      pucOut += ulCount;
+   }
+   return (boolean)(pucOut == pucStart + ulLength);
+}
@@ -0,0 +1,37 @@
+/*--------------------------------------------------------------------*/
+/* lz.h                                                               */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef LZ_INCLUDED
+#define LZ_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A fast LZ77 codec in the style of LZ4: the compressed form is a run
+  of sequences, each some literal bytes followed by a copy of earlier
+  output at most 64 KB back. It favors speed over ratio, needs no
+  state between calls, and always compresses the same bytes the same
+  way, so compressed forms can be compared instead of the originals.
+*/
+
+/*
+  Compresses the ulLength bytes at pvSrc into pvDst, which has room
+  for ulCapacity bytes. Returns the compressed length, or 0 if it
+  would be more than ulCapacity.
+*/
+size_t LZ_compress(const void *pvSrc, size_t ulLength, void *pvDst,
+                   size_t ulCapacity);
+
+/*
+  Decompresses the ulPacked bytes at pvSrc, produced by LZ_compress,
+  into the ulLength bytes at pvDst. Returns TRUE if they decompress to
+  exactly ulLength bytes, and FALSE if they are malformed, without
+  ever writing outside pvDst.
+*/
+boolean LZ_decompress(const void *pvSrc, size_t ulPacked, void *pvDst,
+                      size_t ulLength);
+
+#endif
@@ -4,28 +4,220 @@
 /*--------------------------------------------------------------------*/
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 #include "nodeFT.h"
-#include "dynarray.h"
+#include "typedarray.h"
+#include "contents.h"
+#include "rope.h"
+
+static int Node_compareChild(const Node_T *poNChild, const void *pvName);
+
+/* The child node that Node_compareChild reads first, for searches to
+   prefetch */
+#define Node_childKey(poNChild) ((const void *)*(poNChild))
+
+/* A sorted array of a directory's children, whose searches compare
+   names with Node_compareChild directly */
+DEFINE_DYNARRAY(NodeArray, Node_T, Node_compareChild, Node_childKey)
 
 /* A node in a DT */
 struct node
 {
-   /* the object corresponding to the node's absolute path */
+   /* this node's own name, i.e., the last component of its path */
+   char *pcName;
+   /* the object corresponding to the node's absolute path. This is a
+   cache that is rebuilt from the parent links when an ancestor has
+   been renamed, so it must always be read through Node_getPath */
    Path_T oPPath;
+   /* stamp identifying the current value of oPPath */
+   size_t ulPathStamp;
+   /* the parent's ulPathStamp at the time oPPath was built */
+   size_t ulParentStamp;
    /* this node's parent */
    Node_T oNParent;
-   /* the object containing links to this node's children,
-   if it's a directory */
-   DynArray_T oDChildren;
-   /* a pointer to the file contents, if it's a file */
+   /* the links to this node's children, sorted by name, if it's a
+   directory; empty if it's a file */
+   struct NodeArray sChildren;
+   /* a pointer to the file contents, if it's a file and they are the
+   client's */
    void *pvContents;
+   /* the FT's own copy of the contents, or NULL if they are the
+   client's; its bytes are looked up on each use (see Node_getBytes),
+   since the content tier may move them */
+   Contents_T oCOwned;
+   /* the chunks holding the contents instead, once the file has been
+   written to in place; pvContents and oCOwned are NULL meanwhile */
+   Rope_T oRChunks;
+   /* TRUE if, outside the owned modes, the contents have been written
+   to in place, so that they are the FT's rather than the buffer the
+   client inserted; replacing them then hands back a copy the client
+   owns, as it would have got its own buffer back */
+   boolean bWritten;
    /* file length, if it's a file */
    size_t ulLength;
    /* a boolean to determine if the node represents a file or directory */
    boolean bIsFile;
+   /* the block this node was bulk-allocated in by Node_clone, or NULL
+   if the node was allocated on its own */
+   struct nodeBlock *psBlock;
+   /* TRUE if pcName lives in psBlock rather than in its own allocation */
+   boolean bNameInBlock;
+   /* the FT's flags for the watches covering this node */
+   unsigned int uiWatchFlags;
+   /* the hash of the subtree rooted at this node (see Node_getHash),
+   valid only if bHashValid is TRUE; a valid hash implies valid hashes
+   throughout the subtree, and an invalid one, invalid hashes in every
+   ancestor */
+   size_t ulHash;
+   boolean bHashValid;
+   /* the number of the file's current contents, counting replacements
+   (see Node_startVersions) */
+   size_t ulVersion;
+   /* the file's earlier versions, newest first, or NULL */
+   struct version *psHistory;
+   /* the stamp of the last Node_saveContents of this node */
+   size_t ulSaveStamp;
+   /* the allocator that this node, its name, its path and its
+   children array come from */
+   Allocator_T oAAlloc;
+};
+
+/* Header of a block holding a whole subtree made by Node_clone: the
+   nodes themselves follow the header, then all of their names. */
+struct nodeBlock
+{
+   /* the number of nodes in the block that have not been freed */
+   size_t ulLive;
+   /* the size of the whole block in bytes, and the allocator it and
+   the children arrays of its nodes come from */
+   size_t ulSize;
+   Allocator_T oAAlloc;
+};
+
+/* An earlier version of a file's contents, kept as FT-owned copies of
+   its VERSION_CHUNK-byte chunks, so that versions with chunks in
+   common share them through deduplication. */
+struct version
+{
+   /* the version's number */
+   size_t ulVersion;
+   /* its length in bytes */
+   size_t ulLength;
+   /* the next older version, or NULL */
+   struct version *psOlder;
+   /* its chunks, each NULL if it reads as zeros */
+   Contents_T aoCChunks[1];
 };
 
+/* The size of the chunks earlier versions are split into. */
+enum { VERSION_CHUNK = 4096 };
+
+/* The fewest slots a directory's children must take up before
+   Node_trimChildren gives any back, and the most of them, in
+   quarters, that may be in use for it to do so */
+enum { TRIM_MIN_SLOTS = 16, TRIM_MAX_QUARTERS = 1 };
+
+/* TRUE if replacements keep earlier versions, and the most of them
+   each file keeps, by count and by bytes (0 for no limit) */
+static boolean bVersioned;
+static size_t ulMaxVersions;
+static size_t ulMaxVersionBytes;
+
+/* The next stamp to hand out to a freshly built path cache. Stamps
+   are never reused, so a child can tell that its parent's path has
+   changed since the child's own path was last built. */
+static size_t ulNextPathStamp = 1;
+
+/* The FNV-1a parameters, truncated to the width of a size_t. */
+#define NODE_HASH_BASIS ((size_t)14695981039346656037ULL)
+#define NODE_HASH_PRIME ((size_t)1099511628211ULL)
+
+/*
+  Returns the last component of the path string pcPath, which is
+  pcPath itself if it has only one component.
+*/
+static const char *Node_lastComponent(const char *pcPath)
+{
+   const char *pcSlash;
+
+   assert(pcPath != NULL);
+
+   pcSlash = strrchr(pcPath, '/');
+   if (pcSlash == NULL)
+      return pcPath;
+   return pcSlash + 1;
+}
+
+/*
+  Makes oNNode's cached path current, rebuilding it (and any stale
+  ancestor's) from the parent links if an ancestor has been renamed
+  since it was last built. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated for a rebuilt path, in which case the old
+  cache is left in place.
+*/
+static int Node_refreshPath(Node_T oNNode)
+{
+   Node_T oNParent;
+   Path_T oPNewPath = NULL;
+   const char *pcParentPath;
+   size_t ulParentLength;
+   char *pcBuild;
+   int iStatus;
+
+   assert(oNNode != NULL);
+
+   oNParent = oNNode->oNParent;
+   if (oNParent == NULL)
+   {
+      /* the root's path is only ever replaced by Node_rename */
+      assert(oNNode->oPPath != NULL);
+      return SUCCESS;
+   }
+
+   iStatus = Node_refreshPath(oNParent);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (oNNode->oPPath != NULL &&
+       oNNode->ulParentStamp == oNParent->ulPathStamp)
+      return SUCCESS;
+
+   /* rebuild as parent's pathname + '/' + own name */
+   pcParentPath = Path_getPathname(oNParent->oPPath);
+   ulParentLength = Path_getStrLength(oNParent->oPPath);
+   pcBuild = malloc(ulParentLength + strlen(oNNode->pcName) + 2);
+   if (pcBuild == NULL)
+      return MEMORY_ERROR;
+   strcpy(pcBuild, pcParentPath);
+   pcBuild[ulParentLength] = '/';
+   strcpy(pcBuild + ulParentLength + 1, oNNode->pcName);
+
+   iStatus = Path_newWith(pcBuild, oNNode->oAAlloc, &oPNewPath);
+   free(pcBuild);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   Path_free(oNNode->oPPath);
+   oNNode->oPPath = oPNewPath;
+   oNNode->ulPathStamp = ulNextPathStamp++;
+   oNNode->ulParentStamp = oNParent->ulPathStamp;
+   return SUCCESS;
+}
+
+/*
+  Marks the hashes of oNNode and of its ancestors as out of date. Stops
+  at the first one that already is, as all of its ancestors are too.
+*/
+static void Node_staleHash(Node_T oNNode)
+{
+   while (oNNode != NULL && oNNode->bHashValid)
+   {
+      oNNode->bHashValid = FALSE;
+      oNNode = oNNode->oNParent;
+   }
+}
+
 /*
   Links new child oNChild into oNParent's children array at index
   ulIndex. Returns SUCCESS if the new child was added successfully,
@@ -39,46 +231,572 @@ static int Node_addChild(Node_T oNParent, Node_T oNChild,
 
    if (oNParent->bIsFile)
       return NOT_A_DIRECTORY;
-   else if (DynArray_addAt(oNParent->oDChildren, ulIndex, oNChild))
+   else if (NodeArray_addAt(&oNParent->sChildren, ulIndex, oNChild,
+                            oNParent->oAAlloc))
+   {
+      Node_staleHash(oNParent);
       return SUCCESS;
+   }
+   else
+      return MEMORY_ERROR;
+}
+
+/*
+  Compares the name of the child at poNChild with a string pvName
+  representing a node's name, i.e., the last component of its path.
+  Returns <0, 0, or >0 if the child is "less than", "equal to", or
+  "greater than" pvName, respectively.
+*/
+static int Node_compareChild(const Node_T *poNChild, const void *pvName)
+{
+   assert(poNChild != NULL);
+   assert(*poNChild != NULL);
+   assert(pvName != NULL);
+
+   return strcmp((*poNChild)->pcName, (const char *)pvName);
+}
+
+/*
+  Returns TRUE if oNAncestor is oNNode or one of oNNode's ancestors,
+  and FALSE otherwise.
+*/
+static boolean Node_isAncestor(Node_T oNAncestor, Node_T oNNode)
+{
+   assert(oNAncestor != NULL);
+
+   while (oNNode != NULL)
+   {
+      if (oNNode == oNAncestor)
+         return TRUE;
+      oNNode = oNNode->oNParent;
+   }
+   return FALSE;
+}
+
+/*
+  Validates that a node with absolute path oPNewPath could become a
+  new child of oNParent and, if so, stores in *pulIndex the index it
+  would take in oNParent's children. Returns SUCCESS, or:
+  * NOT_A_DIRECTORY if oNParent is a file
+  * NO_SUCH_PATH if oNParent's path is not oPNewPath's direct parent
+  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int Node_checkNewChild(Node_T oNParent, Path_T oPNewPath,
+                              size_t *pulIndex)
+{
+   Path_T oPParentPath;
+   size_t ulParentDepth;
+
+   assert(oNParent != NULL);
+   assert(oPNewPath != NULL);
+   assert(pulIndex != NULL);
+
+   if (Node_isFile(oNParent))
+      return NOT_A_DIRECTORY;
+
+   oPParentPath = Node_getPath(oNParent);
+   if (oPParentPath == NULL)
+      return MEMORY_ERROR;
+
+   ulParentDepth = Path_getDepth(oPParentPath);
+   if (Path_getDepth(oPNewPath) != ulParentDepth + 1 ||
+       Path_getSharedPrefixDepth(oPNewPath, oPParentPath) !=
+       ulParentDepth)
+      return NO_SUCH_PATH;
+
+   if (Node_hasChild(oNParent, Path_getPathname(oPNewPath), pulIndex))
+      return ALREADY_IN_TREE;
+
+   return SUCCESS;
+}
+
+/*
+  Returns a pointer to the contents of file oNNode, or NULL if it has
+  none, or if its FT-owned copy could not be read back from the
+  content tier.
+*/
+static void *Node_getBytes(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   if (oNNode->oCOwned != NULL)
+      return Contents_getBytes(oNNode->oCOwned);
+   return oNNode->pvContents;
+}
+
+/* Returns TRUE if file oNNode has contents that are not in chunks. */
+static boolean Node_hasBytes(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   return (boolean)(oNNode->oCOwned != NULL ||
+                    oNNode->pvContents != NULL);
+}
+
+/*
+  Sets oNNode's contents to the ulLength bytes at pvContents: in the
+  arena mode as a fresh FT-owned copy, and otherwise by borrowing the
+  client's pointer. Any previous contents must already be released.
+  Returns SUCCESS, or MEMORY_ERROR if the copy could not be allocated.
+*/
+static int Node_takeContents(Node_T oNNode, void *pvContents,
+                             size_t ulLength)
+{
+   assert(oNNode != NULL);
+   assert(oNNode->oCOwned == NULL);
+
+   if (Contents_usesArena() && pvContents != NULL)
+   {
+      oNNode->oCOwned = Contents_new(pvContents, ulLength);
+      if (oNNode->oCOwned == NULL)
+         return MEMORY_ERROR;
+      oNNode->pvContents = NULL;
+   }
    else
+      oNNode->pvContents = pvContents;
+   oNNode->ulLength = ulLength;
+   return SUCCESS;
+}
+
+/*
+  Drops oNNode's reference to the FT-owned copy of its contents, if
+  it has one. See Contents_release for the meaning of bRetire.
+*/
+static void Node_releaseContents(Node_T oNNode, boolean bRetire)
+{
+   assert(oNNode != NULL);
+
+   if (oNNode->oCOwned == NULL)
+      return;
+
+   Contents_release(oNNode->oCOwned, bRetire);
+   oNNode->oCOwned = NULL;
+}
+
+/* Frees the versions from psVersion on, and their chunks. */
+static void Node_freeVersions(struct version *psVersion)
+{
+   struct version *psOlder;
+   size_t ulChunk;
+
+   for (; psVersion != NULL; psVersion = psOlder)
+   {
+      psOlder = psVersion->psOlder;
+      for (ulChunk = 0;
+           ulChunk * VERSION_CHUNK < psVersion->ulLength; ulChunk++)
+      {
+         if (psVersion->aoCChunks[ulChunk] != NULL)
+            Contents_release(psVersion->aoCChunks[ulChunk], FALSE);
+      }
+      free(psVersion);
+   }
+}
+
+/*
+  Returns a new version holding chunked copies of the ulLength bytes
+  at pvBytes (zeros if pvBytes is NULL), numbered ulVersion, or NULL if
+  memory could not be allocated.
+*/
+static struct version *Node_newVersion(const void *pvBytes,
+                                       size_t ulLength, size_t ulVersion)
+{
+   struct version *psVersion;
+   size_t ulChunks = (ulLength + VERSION_CHUNK - 1) / VERSION_CHUNK;
+   size_t ulChunk;
+   size_t ulSize;
+
+   psVersion = malloc(sizeof(struct version) +
+                      ulChunks * sizeof(Contents_T));
+   if (psVersion == NULL)
+      return NULL;
+   psVersion->ulVersion = ulVersion;
+   psVersion->ulLength = 0;
+   psVersion->psOlder = NULL;
+
+   for (ulChunk = 0; ulChunk < ulChunks; ulChunk++)
+   {
+      ulSize = ulLength - ulChunk * VERSION_CHUNK;
+      if (ulSize > VERSION_CHUNK)
+         ulSize = VERSION_CHUNK;
+      psVersion->aoCChunks[ulChunk] = NULL;
+      if (pvBytes != NULL)
+      {
+         psVersion->aoCChunks[ulChunk] = Contents_new(
+            (const char *)pvBytes + ulChunk * VERSION_CHUNK, ulSize);
+         if (psVersion->aoCChunks[ulChunk] == NULL)
+         {
+            Node_freeVersions(psVersion);
+            return NULL;
+         }
+      }
+      /* counts only the chunks filled in, for Node_freeVersions */
+      psVersion->ulLength += ulSize;
+   }
+   return psVersion;
+}
+
+/*
+  Adds psVersion to the history of oNNode as its newest earlier
+  version, then drops the oldest ones past the retention limits.
+*/
+static void Node_pushVersion(Node_T oNNode, struct version *psVersion)
+{
+   struct version **ppsLink;
+   size_t ulKept = 0;
+   size_t ulBytes = 0;
+
+   psVersion->psOlder = oNNode->psHistory;
+   oNNode->psHistory = psVersion;
+
+   for (ppsLink = &oNNode->psHistory; *ppsLink != NULL;
+        ppsLink = &(*ppsLink)->psOlder)
+   {
+      ulKept++;
+      ulBytes += (*ppsLink)->ulLength;
+      if ((ulMaxVersions != 0 && ulKept > ulMaxVersions) ||
+          (ulMaxVersionBytes != 0 && ulBytes > ulMaxVersionBytes))
+      {
+         Node_freeVersions(*ppsLink);
+         *ppsLink = NULL;
+         break;
+      }
+   }
+}
+
+/*
+  Turns the chunks of a file that has been written to in place back
+  into a single FT-owned copy of its contents, so that they can be
+  handed out as one pointer. Does nothing for other nodes.
+  Returns SUCCESS, or MEMORY_ERROR (leaving the chunks in place) if
+  memory could not be allocated.
+*/
+static int Node_flatten(Node_T oNNode)
+{
+   char *pcBuf;
+   size_t ulLength;
+
+   assert(oNNode != NULL);
+
+   if (oNNode->oRChunks == NULL)
+      return SUCCESS;
+
+   ulLength = Rope_getLength(oNNode->oRChunks);
+   pcBuf = malloc(ulLength + 1);
+   if (pcBuf == NULL)
+      return MEMORY_ERROR;
+   Rope_flatten(oNNode->oRChunks, pcBuf);
+
+   oNNode->oCOwned = Contents_new(pcBuf, ulLength);
+   free(pcBuf);
+   if (oNNode->oCOwned == NULL)
+      return MEMORY_ERROR;
+
+   Rope_free(oNNode->oRChunks);
+   oNNode->oRChunks = NULL;
+   return SUCCESS;
+}
+
+/*
+  Adds to *pulNodes the number of nodes in the subtree rooted at
+  oNNode, and to *pulNameBytes the bytes needed to store all of their
+  names including terminating '\0's.
+*/
+static void Node_measure(Node_T oNNode, size_t *pulNodes,
+                         size_t *pulNameBytes)
+{
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+   assert(pulNodes != NULL);
+   assert(pulNameBytes != NULL);
+
+   (*pulNodes)++;
+   *pulNameBytes += strlen(oNNode->pcName) + 1;
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+      Node_measure(NodeArray_get(&oNNode->sChildren, ulIndex),
+                   pulNodes, pulNameBytes);
+}
+
+/*
+  Fills in the nodes of psBlock, starting at *pulNext, with a copy
+  of the subtree rooted at oNSrc whose top node is named pcName and
+  has parent oNParent. Names are written starting at *ppcNames. Each
+  copied file shares oNSrc's contents if bCopyContents is FALSE and
+  gets its own FT-owned copy of them otherwise.
+  Advances *pulNext and *ppcNames past what was used, and sets
+  *poNResult to the copy of oNSrc. Returns SUCCESS, or MEMORY_ERROR if
+  a children array or contents copy could not be allocated; in that
+  case every node before *pulNext has all of its fields set, so that
+  Node_freeBlockNodes can undo the work.
+*/
+static int Node_fillBlock(Node_T oNSrc, Node_T oNParent,
+                          const char *pcName, boolean bCopyContents,
+                          struct nodeBlock *psBlock, size_t *pulNext,
+                          char **ppcNames, Node_T *poNResult)
+{
+   Node_T oNCopy;
+   Node_T oNChild = NULL;
+   void *pvBytes;
+   size_t ulIndex;
+   size_t ulChildren;
+   int iStatus;
+
+   assert(oNSrc != NULL);
+   assert(pcName != NULL);
+   assert(psBlock != NULL);
+   assert(pulNext != NULL);
+   assert(ppcNames != NULL);
+   assert(poNResult != NULL);
+
+   oNCopy = (struct node *)(psBlock + 1) + *pulNext;
+   (*pulNext)++;
+
+   strcpy(*ppcNames, pcName);
+   oNCopy->pcName = *ppcNames;
+   *ppcNames += strlen(pcName) + 1;
+   oNCopy->bNameInBlock = TRUE;
+   oNCopy->psBlock = psBlock;
+
+   /* the path is built from the parent links on first use */
+   oNCopy->oPPath = NULL;
+   oNCopy->ulPathStamp = 0;
+   oNCopy->ulParentStamp = 0;
+   oNCopy->oNParent = oNParent;
+   oNCopy->bIsFile = oNSrc->bIsFile;
+   oNCopy->pvContents = NULL;
+   oNCopy->oCOwned = NULL;
+   oNCopy->uiWatchFlags = 0;
+   /* a copy has the same hash, so a snapshot is compared quickly */
+   oNCopy->ulHash = oNSrc->ulHash;
+   oNCopy->bHashValid = oNSrc->bHashValid;
+   /* but its history starts afresh */
+   oNCopy->ulVersion = 0;
+   oNCopy->psHistory = NULL;
+   oNCopy->ulSaveStamp = 0;
+   oNCopy->oRChunks = NULL;
+   oNCopy->bWritten = FALSE;
+   oNCopy->ulLength = 0;
+   oNCopy->oAAlloc = psBlock->oAAlloc;
+   (void)NodeArray_init(&oNCopy->sChildren, 0, oNCopy->oAAlloc);
+   *poNResult = oNCopy;
+
+   if (oNSrc->bIsFile)
+   {
+      /* copies are made from, or share, a single copy of the bytes */
+      if (Node_flatten(oNSrc) != SUCCESS)
+         return MEMORY_ERROR;
+
+      oNCopy->ulLength = oNSrc->ulLength;
+      if (!bCopyContents || !Node_hasBytes(oNSrc))
+      {
+         /* share the source's contents, counting the new reference
+            if the FT owns them */
+         oNCopy->pvContents = oNSrc->pvContents;
+         oNCopy->oCOwned = oNSrc->oCOwned;
+         oNCopy->bWritten = oNSrc->bWritten;
+         if (oNCopy->oCOwned != NULL)
+            Contents_addRef(oNCopy->oCOwned);
+      }
+      else
+      {
+         pvBytes = Node_getBytes(oNSrc);
+         if (pvBytes == NULL)
+            return MEMORY_ERROR;
+         oNCopy->oCOwned = Contents_new(pvBytes, oNSrc->ulLength);
+         if (oNCopy->oCOwned == NULL)
+            return MEMORY_ERROR;
+      }
+      return SUCCESS;
+   }
+
+   /* presize the children array, then fill it in sorted order */
+   ulChildren = Node_getNumChildren(oNSrc);
+   if (!NodeArray_init(&oNCopy->sChildren, ulChildren, oNCopy->oAAlloc))
       return MEMORY_ERROR;
+
+   for (ulIndex = 0; ulIndex < ulChildren; ulIndex++)
+   {
+      Node_T oNSrcChild = NodeArray_get(&oNSrc->sChildren, ulIndex);
+
+      iStatus = Node_fillBlock(oNSrcChild, oNCopy, oNSrcChild->pcName,
+                               bCopyContents, psBlock, pulNext,
+                               ppcNames, &oNChild);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      (void)NodeArray_set(&oNCopy->sChildren, ulIndex, oNChild);
+   }
+
+   return SUCCESS;
+}
+
+/*
+  Undoes a failed Node_fillBlock: releases the children arrays and
+  contents of the first ulFilled nodes of psBlock, then the block.
+*/
+static void Node_freeBlockNodes(struct nodeBlock *psBlock,
+                                size_t ulFilled)
+{
+   Node_T oNNode;
+   size_t ulIndex;
+
+   assert(psBlock != NULL);
+
+   for (ulIndex = 0; ulIndex < ulFilled; ulIndex++)
+   {
+      oNNode = (struct node *)(psBlock + 1) + ulIndex;
+      NodeArray_clear(&oNNode->sChildren, oNNode->oAAlloc);
+      Node_releaseContents(oNNode, FALSE);
+      Node_freeVersions(oNNode->psHistory);
+      Path_free(oNNode->oPPath);
+   }
+   Allocator_release(psBlock->oAAlloc, psBlock, psBlock->ulSize);
+}
+
+#ifdef DYNARRAY_STATS
+
+/* The number of directories that an instrumented build ranks by how
+   many of their children were shifted and compared */
+enum {RANKED_DIRS = 5};
+
+/* A directory ranked by an instrumented build: its path when it was
+   freed, and the counts kept for its array of children */
+struct rankedDir
+{
+   char *pcPath;
+   struct DynArrayStats sStats;
+};
+
+/* the directories ranked so far, the worst first; how deeply calls
+   of Node_free are nested; and whether writing the ranking out at
+   exit has been arranged yet */
+static struct rankedDir asRanked[RANKED_DIRS];
+static size_t ulFreeDepth = 0;
+static boolean bRankingDumped = FALSE;
+
+/*
+  Writes the directories ranked so far to stderr, freeing their paths.
+*/
+static void Node_dumpRanking(void)
+{
+   size_t ulIndex;
+
+   fprintf(stderr, "Directories whose children moved the most:\n");
+   for (ulIndex = 0; ulIndex < RANKED_DIRS; ulIndex++)
+   {
+      if (asRanked[ulIndex].pcPath == NULL)
+         break;
+      fprintf(stderr, "   %s: %lu shifted, %lu search compares, "
+              "%lu sort compares, %lu children at most\n",
+              asRanked[ulIndex].pcPath,
+              (unsigned long)asRanked[ulIndex].sStats.uShifts,
+              (unsigned long)asRanked[ulIndex].sStats.uSearchCompares,
+              (unsigned long)asRanked[ulIndex].sStats.uSortCompares,
+              (unsigned long)asRanked[ulIndex].sStats.uMaxLength);
+      free(asRanked[ulIndex].pcPath);
+      asRanked[ulIndex].pcPath = NULL;
+   }
+}
+
+/*
+  Returns TRUE if *psStats1 ranks above *psStats2: if more children
+  were shifted, or as many and more were compared.
+*/
+static boolean Node_ranksAbove(const struct DynArrayStats *psStats1,
+                               const struct DynArrayStats *psStats2)
+{
+   assert(psStats1 != NULL);
+   assert(psStats2 != NULL);
+
+   if (psStats1->uShifts != psStats2->uShifts)
+      return (boolean)(psStats1->uShifts > psStats2->uShifts);
+   return (boolean)(psStats1->uSearchCompares + psStats1->uSortCompares >
+                    psStats2->uSearchCompares + psStats2->uSortCompares);
 }
 
 /*
-  Compares the string representation of oNfirst with a string
-  pcSecond representing a node's path.
-  Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
-  "greater than" pcSecond, respectively.
+  Ranks directory oNDir among those freed so far by the counts kept
+  for its array of children. A directory whose children were never
+  shifted or compared is not ranked, nor is one whose path cannot be
+  copied.
 */
-static int Node_compareString(const Node_T oNFirst,
-                              const char *pcSecond)
+static void Node_rankDir(Node_T oNDir)
 {
-   assert(oNFirst != NULL);
-   assert(pcSecond != NULL);
+   struct DynArrayStats sStats;
+   Path_T oPPath;
+   char *pcPath;
+   size_t ulIndex;
+
+   assert(oNDir != NULL);
+
+   (void)Node_getChildStats(oNDir, &sStats);
+   if (sStats.uShifts == 0 && sStats.uSearchCompares == 0 &&
+       sStats.uSortCompares == 0)
+      return;
+
+   /* find its place, below every directory that ranks as high */
+   ulIndex = RANKED_DIRS;
+   while (ulIndex > 0 &&
+          (asRanked[ulIndex - 1].pcPath == NULL ||
+           Node_ranksAbove(&sStats, &asRanked[ulIndex - 1].sStats)))
+      ulIndex--;
+   if (ulIndex == RANKED_DIRS)
+      return;
 
-   return Path_compareString(oNFirst->oPPath, pcSecond);
+   oPPath = Node_getPath(oNDir);
+   pcPath = malloc(Path_getStrLength(oPPath) + 1);
+   if (pcPath == NULL)
+      return;
+   strcpy(pcPath, Path_getPathname(oPPath));
+
+   if (!bRankingDumped)
+   {
+      (void)atexit(Node_dumpRanking);
+      bRankingDumped = TRUE;
+   }
+   free(asRanked[RANKED_DIRS - 1].pcPath);
+   memmove(&asRanked[ulIndex + 1], &asRanked[ulIndex],
+           sizeof(struct rankedDir) * (RANKED_DIRS - 1 - ulIndex));
+   asRanked[ulIndex].pcPath = pcPath;
+   asRanked[ulIndex].sStats = sStats;
 }
 
 /*
-  Compares oNFirst and oNSecond lexicographically based on their paths.
-  Returns <0, 0, or >0 if onFirst is "less than", "equal to", or
-  "greater than" oNSecond, respectively.
+  Ranks every directory in the subtree rooted at oNNode.
 */
-static int Node_compare(Node_T oNFirst, Node_T oNSecond)
+static void Node_rankTree(Node_T oNNode)
 {
-   assert(oNFirst != NULL);
-   assert(oNSecond != NULL);
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
 
-   return Path_comparePath(oNFirst->oPPath, oNSecond->oPPath);
+   if (Node_isFile(oNNode))
+      return;
+   Node_rankDir(oNNode);
+   for (ulIndex = 0; ulIndex < NodeArray_getLength(&oNNode->sChildren);
+        ulIndex++)
+      Node_rankTree(NodeArray_get(&oNNode->sChildren, ulIndex));
 }
 
+#endif
+
 int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
              size_t ulLength, boolean bIsFile, Node_T *poNResult)
+{
+   return Node_newWith(pcPath, oNParent, pvContents, ulLength, bIsFile,
+                       oNParent == NULL ? NULL : oNParent->oAAlloc,
+                       poNResult);
+}
+
+int Node_newWith(const char *pcPath, Node_T oNParent, void *pvContents,
+                 size_t ulLength, boolean bIsFile, Allocator_T oAAlloc,
+                 Node_T *poNResult)
 {
    Node_T oNNewNode;
    Path_T oPParentPath = NULL;
    Path_T oPNewPath = NULL;
+   const char *pcName;
    size_t ulParentDepth;
    size_t ulIndex = 0;
    int iStatus;
@@ -87,7 +805,7 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
    assert(poNResult != NULL);
 
    /* allocate space for a new node */
-   oNNewNode = malloc(sizeof(struct node));
+   oNNewNode = Allocator_alloc(oAAlloc, sizeof(struct node));
    if (oNNewNode == NULL)
    {
       *poNResult = NULL;
@@ -95,10 +813,10 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
    }
 
    /* set the new node's path */
-   iStatus = Path_new(pcPath, &oPNewPath);
+   iStatus = Path_newWith(pcPath, oAAlloc, &oPNewPath);
    if (iStatus != SUCCESS)
    {
-      free(oNNewNode);
+      Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
       *poNResult = NULL;
       return iStatus;
    }
@@ -109,15 +827,22 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
    {
       size_t ulSharedDepth;
 
-      oPParentPath = oNParent->oPPath;
-      ulParentDepth = Path_getDepth(oPParentPath);
-      ulSharedDepth = Path_getSharedPrefixDepth(oNNewNode->oPPath,
+      oPParentPath = Node_getPath(oNParent);
+      if (oPParentPath == NULL)
+      {
+         Path_free(oNNewNode->oPPath);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
+         *poNResult = NULL;
+         return MEMORY_ERROR;
+      }
+      ulParentDepth = Path_getDepth(oPParentPath);
+      ulSharedDepth = Path_getSharedPrefixDepth(oNNewNode->oPPath,
                                                 oPParentPath);
       /* parent must be an ancestor of child */
       if (ulSharedDepth < ulParentDepth)
       {
          Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
          *poNResult = NULL;
          return CONFLICTING_PATH;
       }
@@ -126,7 +851,7 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
       if (Path_getDepth(oNNewNode->oPPath) != ulParentDepth + 1)
       {
          Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
          *poNResult = NULL;
          return NO_SUCH_PATH;
       }
@@ -135,10 +860,11 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
       if (Node_hasChild(oNParent, pcPath, &ulIndex))
       {
          Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
          *poNResult = NULL;
          return ALREADY_IN_TREE;
       }
+      oNNewNode->ulParentStamp = oNParent->ulPathStamp;
    }
    else
    {
@@ -147,7 +873,7 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
       if (Path_getDepth(oNNewNode->oPPath) != 1)
       {
          Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
          *poNResult = NULL;
          return NO_SUCH_PATH;
       }
@@ -155,157 +881,1196 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
       if (bIsFile)
       {
          Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
          *poNResult = NULL;
          return CONFLICTING_PATH;
       }
+      oNNewNode->ulParentStamp = 0;
+   }
+   oNNewNode->oNParent = oNParent;
+   oNNewNode->ulPathStamp = ulNextPathStamp++;
+
+   /* keep a private copy of the node's own name */
+   pcName = Node_lastComponent(pcPath);
+   oNNewNode->pcName = Allocator_alloc(oAAlloc, strlen(pcName) + 1);
+   if (oNNewNode->pcName == NULL)
+   {
+      Path_free(oNNewNode->oPPath);
+      Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
+      *poNResult = NULL;
+      return MEMORY_ERROR;
+   }
+   strcpy(oNNewNode->pcName, pcName);
+   oNNewNode->bNameInBlock = FALSE;
+   oNNewNode->psBlock = NULL;
+   oNNewNode->oCOwned = NULL;
+   oNNewNode->uiWatchFlags = 0;
+   oNNewNode->ulHash = 0;
+   oNNewNode->bHashValid = FALSE;
+   oNNewNode->ulVersion = 0;
+   oNNewNode->psHistory = NULL;
+   oNNewNode->ulSaveStamp = 0;
+   oNNewNode->oRChunks = NULL;
+   oNNewNode->bWritten = FALSE;
+   oNNewNode->oAAlloc = oAAlloc;
+
+   /* initialize the new node */
+   if (bIsFile) /* file initialization */
+   {
+      (void)NodeArray_init(&oNNewNode->sChildren, 0, oAAlloc);
+      oNNewNode->bIsFile = TRUE;
+      if (Node_takeContents(oNNewNode, pvContents, ulLength) != SUCCESS)
+      {
+         Allocator_release(oAAlloc, oNNewNode->pcName,
+                           strlen(oNNewNode->pcName) + 1);
+         Path_free(oNNewNode->oPPath);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
+         *poNResult = NULL;
+         return MEMORY_ERROR;
+      }
+   }
+   else /* directory initialization */
+   {
+      oNNewNode->pvContents = NULL;
+      oNNewNode->ulLength = 0;
+      oNNewNode->bIsFile = FALSE;
+      /* an empty array allocates nothing until the first child */
+      (void)NodeArray_init(&oNNewNode->sChildren, 0, oAAlloc);
+   }
+
+   /* Link into parent's children list */
+   if (oNParent != NULL)
+   {
+      iStatus = Node_addChild(oNParent, oNNewNode, ulIndex);
+      if (iStatus != SUCCESS)
+      {
+         Node_releaseContents(oNNewNode, FALSE);
+         NodeArray_clear(&oNNewNode->sChildren, oAAlloc);
+         Allocator_release(oAAlloc, oNNewNode->pcName,
+                           strlen(oNNewNode->pcName) + 1);
+         Path_free(oNNewNode->oPPath);
+         Allocator_release(oAAlloc, oNNewNode, sizeof(struct node));
+         *poNResult = NULL;
+         return iStatus;
+      }
+   }
+
+   *poNResult = oNNewNode;
+
+   return SUCCESS;
+}
+
+size_t Node_free(Node_T oNNode)
+{
+   size_t ulIndex = 0;
+   size_t ulCount = 0;
+   Node_T oNChild;
+
+   assert(oNNode != NULL);
+
+#ifdef DYNARRAY_STATS
+   /* rank the subtree's directories while their paths can still be
+      built from the parent links, which freeing it takes apart */
+   if (ulFreeDepth++ == 0)
+      Node_rankTree(oNNode);
+#endif
+
+   Contents_freeRetired();
+
+   /* Remove from parent's list */
+   if (oNNode->oNParent != NULL)
+   {
+      if (NodeArray_bsearch(&oNNode->oNParent->sChildren,
+                            oNNode->pcName, &ulIndex))
+         (void)NodeArray_removeAt(&oNNode->oNParent->sChildren,
+                                  ulIndex);
+      Node_staleHash(oNNode->oNParent);
+   }
+
+   /* If it's a directory, recursively remove children; they are
+      detached first so that none searches or shifts this array */
+   if (!Node_isFile(oNNode))
+   {
+      for (ulIndex = NodeArray_getLength(&oNNode->sChildren);
+           ulIndex > 0; ulIndex--)
+      {
+         oNChild = NodeArray_get(&oNNode->sChildren, ulIndex - 1);
+         oNChild->oNParent = NULL;
+         ulCount += Node_free(oNChild);
+      }
+      NodeArray_clear(&oNNode->sChildren, oNNode->oAAlloc);
+   }
+
+   /* Remove contents, earlier versions, name and path */
+   Node_releaseContents(oNNode, FALSE);
+   Node_freeVersions(oNNode->psHistory);
+   if (oNNode->oRChunks != NULL)
+      Rope_free(oNNode->oRChunks);
+   if (!oNNode->bNameInBlock)
+      Allocator_release(oNNode->oAAlloc, oNNode->pcName,
+                        strlen(oNNode->pcName) + 1);
+   Path_free(oNNode->oPPath);
+
+   /* Finally, free the struct node, or give back its share of the
+      block it was cloned into */
+   if (oNNode->psBlock == NULL)
+      Allocator_release(oNNode->oAAlloc, oNNode, sizeof(struct node));
+   else
+   {
+      oNNode->psBlock->ulLive--;
+      if (oNNode->psBlock->ulLive == 0)
+         Allocator_release(oNNode->psBlock->oAAlloc, oNNode->psBlock,
+                           oNNode->psBlock->ulSize);
+   }
+#ifdef DYNARRAY_STATS
+   ulFreeDepth--;
+#endif
+   ulCount++;
+   return ulCount;
+}
+
+int Node_rename(Node_T oNNode, Node_T oNNewParent, const char *pcNewPath)
+{
+   Path_T oPNewPath = NULL;
+   Node_T oNOldParent;
+   const char *pcName;
+   char *pcNewName;
+   size_t ulOldIndex = 0;
+   size_t ulNewIndex = 0;
+   int iStatus;
+
+   assert(oNNode != NULL);
+   assert(pcNewPath != NULL);
+
+   oNOldParent = oNNode->oNParent;
+
+   /* the root can only be renamed in place, and nothing else can
+      become the root */
+   if ((oNOldParent == NULL) != (oNNewParent == NULL))
+      return CONFLICTING_PATH;
+
+   iStatus = Path_newWith(pcNewPath, oNNode->oAAlloc, &oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   if (oNNewParent == NULL)
+   {
+      if (Path_getDepth(oPNewPath) != 1)
+      {
+         Path_free(oPNewPath);
+         return NO_SUCH_PATH;
+      }
+   }
+   else
+   {
+      /* a directory cannot be moved underneath itself */
+      if (!Node_isFile(oNNewParent) &&
+          Node_isAncestor(oNNode, oNNewParent))
+      {
+         Path_free(oPNewPath);
+         return CONFLICTING_PATH;
+      }
+
+      iStatus = Node_checkNewChild(oNNewParent, oPNewPath, &ulNewIndex);
+      if (iStatus != SUCCESS)
+      {
+         Path_free(oPNewPath);
+         return iStatus;
+      }
+   }
+
+   pcName = Node_lastComponent(pcNewPath);
+   pcNewName = Allocator_alloc(oNNode->oAAlloc, strlen(pcName) + 1);
+   if (pcNewName == NULL)
+   {
+      Path_free(oPNewPath);
+      return MEMORY_ERROR;
+   }
+   strcpy(pcNewName, pcName);
+
+   /* relink: unlink from the old parent, then link into the new one
+      at the position the new name sorts to */
+   if (oNOldParent != NULL)
+   {
+      if (NodeArray_bsearch(&oNOldParent->sChildren, oNNode->pcName,
+                            &ulOldIndex))
+         (void)NodeArray_removeAt(&oNOldParent->sChildren, ulOldIndex);
+      Node_staleHash(oNOldParent);
+
+      (void)NodeArray_bsearch(&oNNewParent->sChildren, pcNewName,
+                              &ulNewIndex);
+      iStatus = Node_addChild(oNNewParent, oNNode, ulNewIndex);
+      if (iStatus != SUCCESS)
+      {
+         /* removal never shrinks, so restoring the old link cannot
+            fail */
+         (void)NodeArray_addAt(&oNOldParent->sChildren, ulOldIndex,
+                               oNNode, oNOldParent->oAAlloc);
+         Allocator_release(oNNode->oAAlloc, pcNewName,
+                           strlen(pcNewName) + 1);
+         Path_free(oPNewPath);
+         return iStatus;
+      }
+   }
+
+   if (!oNNode->bNameInBlock)
+      Allocator_release(oNNode->oAAlloc, oNNode->pcName,
+                        strlen(oNNode->pcName) + 1);
+   oNNode->pcName = pcNewName;
+   oNNode->bNameInBlock = FALSE;
+   oNNode->oNParent = oNNewParent;
+
+   /* only this node's path is rebuilt now; its descendants see the
+      new stamp and rebuild their own paths on their next use */
+   Path_free(oNNode->oPPath);
+   oNNode->oPPath = oPNewPath;
+   oNNode->ulPathStamp = ulNextPathStamp++;
+   if (oNNewParent != NULL)
+      oNNode->ulParentStamp = oNNewParent->ulPathStamp;
+
+   return SUCCESS;
+}
+
+int Node_clone(Node_T oNSrc, Node_T oNParent, const char *pcPath,
+               boolean bCopyContents, Node_T *poNResult,
+               size_t *pulCount)
+{
+   Path_T oPNewPath = NULL;
+   struct nodeBlock *psBlock;
+   Node_T oNCopy = NULL;
+   char *pcNames;
+   size_t ulNodes = 0;
+   size_t ulNameBytes = 0;
+   size_t ulBlockSize;
+   size_t ulFilled = 0;
+   size_t ulIndex = 0;
+   int iStatus;
+
+   assert(oNSrc != NULL);
+   assert(oNParent != NULL);
+   assert(pcPath != NULL);
+   assert(poNResult != NULL);
+   assert(pulCount != NULL);
+
+   *poNResult = NULL;
+   *pulCount = 0;
+
+   iStatus = Path_new(pcPath, &oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_checkNewChild(oNParent, oPNewPath, &ulIndex);
+   Path_free(oPNewPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* size everything up front so the copy takes a single block */
+   Node_measure(oNSrc, &ulNodes, &ulNameBytes);
+   ulNameBytes += strlen(Node_lastComponent(pcPath));
+   ulNameBytes -= strlen(oNSrc->pcName);
+
+   ulBlockSize = sizeof(struct nodeBlock) +
+                 ulNodes * sizeof(struct node) + ulNameBytes;
+   psBlock = Allocator_alloc(oNParent->oAAlloc, ulBlockSize);
+   if (psBlock == NULL)
+      return MEMORY_ERROR;
+   psBlock->ulLive = ulNodes;
+   psBlock->ulSize = ulBlockSize;
+   psBlock->oAAlloc = oNParent->oAAlloc;
+   pcNames = (char *)((struct node *)(psBlock + 1) + ulNodes);
+
+   /* the copy is not linked in until it is complete, so copying a
+      directory into its own subtree sees only the original nodes */
+   iStatus = Node_fillBlock(oNSrc, oNParent, Node_lastComponent(pcPath),
+                            bCopyContents, psBlock, &ulFilled,
+                            &pcNames, &oNCopy);
+   if (iStatus != SUCCESS)
+   {
+      Node_freeBlockNodes(psBlock, ulFilled);
+      return iStatus;
+   }
+   assert(ulFilled == ulNodes);
+
+   iStatus = Node_addChild(oNParent, oNCopy, ulIndex);
+   if (iStatus != SUCCESS)
+   {
+      Node_freeBlockNodes(psBlock, ulFilled);
+      return iStatus;
+   }
+
+   *poNResult = oNCopy;
+   *pulCount = ulNodes;
+   return SUCCESS;
+}
+
+/*
+  Returns a new node named pcName, a file if bIsFile is TRUE, whose
+  parent is oNParent, but that oNParent does not link to yet; or NULL
+  if memory could not be allocated.
+*/
+static Node_T Node_makeChild(Node_T oNParent, const char *pcName,
+                             boolean bIsFile)
+{
+   Node_T oNNewNode;
+
+   assert(oNParent != NULL);
+   assert(pcName != NULL);
+
+   oNNewNode = Allocator_alloc(oNParent->oAAlloc, sizeof(struct node));
+   if (oNNewNode == NULL)
+      return NULL;
+
+   oNNewNode->pcName = Allocator_alloc(oNParent->oAAlloc,
+                                       strlen(pcName) + 1);
+   if (oNNewNode->pcName == NULL)
+   {
+      Allocator_release(oNParent->oAAlloc, oNNewNode,
+                        sizeof(struct node));
+      return NULL;
+   }
+   strcpy(oNNewNode->pcName, pcName);
+   oNNewNode->bNameInBlock = FALSE;
+   oNNewNode->psBlock = NULL;
+
+   /* the path is built from the parent links on first use */
+   oNNewNode->oPPath = NULL;
+   oNNewNode->ulPathStamp = 0;
+   oNNewNode->ulParentStamp = 0;
+   oNNewNode->oNParent = oNParent;
+   oNNewNode->bIsFile = bIsFile;
+   oNNewNode->pvContents = NULL;
+   oNNewNode->oCOwned = NULL;
+   oNNewNode->uiWatchFlags = 0;
+   oNNewNode->ulHash = 0;
+   oNNewNode->bHashValid = FALSE;
+   oNNewNode->ulVersion = 0;
+   oNNewNode->psHistory = NULL;
+   oNNewNode->ulSaveStamp = 0;
+   oNNewNode->oRChunks = NULL;
+   oNNewNode->bWritten = FALSE;
+   oNNewNode->ulLength = 0;
+   oNNewNode->oAAlloc = oNParent->oAAlloc;
+   (void)NodeArray_init(&oNNewNode->sChildren, 0, oNNewNode->oAAlloc);
+   return oNNewNode;
+}
+
+/* Frees oNNode, made by Node_makeChild and never linked in. */
+static void Node_unmakeChild(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   NodeArray_clear(&oNNode->sChildren, oNNode->oAAlloc);
+   Allocator_release(oNNode->oAAlloc, oNNode->pcName,
+                     strlen(oNNode->pcName) + 1);
+   Allocator_release(oNNode->oAAlloc, oNNode, sizeof(struct node));
+}
+
+/*
+  Compares the names of the children at poNChild1 and poNChild2, as
+  strcmp does.
+*/
+static int Node_compareChildren(const Node_T *poNChild1,
+                                const Node_T *poNChild2)
+{
+   assert(poNChild1 != NULL);
+   assert(poNChild2 != NULL);
+
+   return strcmp((*poNChild1)->pcName, (*poNChild2)->pcName);
+}
+
+int Node_newChild(Node_T oNParent, const char *pcName, boolean bIsFile,
+                  Node_T *poNResult)
+{
+   Node_T oNNewNode;
+   size_t ulIndex = 0;
+   int iStatus;
+
+   assert(oNParent != NULL);
+   assert(pcName != NULL);
+   assert(poNResult != NULL);
+
+   *poNResult = NULL;
+
+   if (*pcName == '\0' || strchr(pcName, '/') != NULL)
+      return BAD_PATH;
+   if (oNParent->bIsFile)
+      return NOT_A_DIRECTORY;
+   if (Node_hasChild(oNParent, pcName, &ulIndex))
+      return ALREADY_IN_TREE;
+
+   oNNewNode = Node_makeChild(oNParent, pcName, bIsFile);
+   if (oNNewNode == NULL)
+      return MEMORY_ERROR;
+
+   iStatus = Node_addChild(oNParent, oNNewNode, ulIndex);
+   if (iStatus != SUCCESS)
+   {
+      Node_unmakeChild(oNNewNode);
+      return iStatus;
+   }
+
+   *poNResult = oNNewNode;
+   return SUCCESS;
+}
+
+int Node_newChildren(Node_T oNParent, const char *const *ppcNames,
+                     size_t ulCount, boolean bIsFile,
+                     Node_T *poNChildren)
+{
+   size_t ulIndex;
+   size_t ulSlot;
+   size_t ulDuplicates;
+
+   assert(oNParent != NULL);
+   assert(ppcNames != NULL || ulCount == 0);
+   assert(poNChildren != NULL || ulCount == 0);
+
+   if (oNParent->bIsFile)
+      return NOT_A_DIRECTORY;
+
+   /* check every name first, so that nothing need be undone later */
+   for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+   {
+      if (*ppcNames[ulIndex] == '\0' ||
+          strchr(ppcNames[ulIndex], '/') != NULL)
+         return BAD_PATH;
+      if (ulIndex > 0 &&
+          strcmp(ppcNames[ulIndex - 1], ppcNames[ulIndex]) >= 0)
+         return ALREADY_IN_TREE;
+      if (NodeArray_bsearch(&oNParent->sChildren, ppcNames[ulIndex],
+                            &ulSlot))
+         return ALREADY_IN_TREE;
+   }
+
+   for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+   {
+      poNChildren[ulIndex] = Node_makeChild(oNParent, ppcNames[ulIndex],
+                                            bIsFile);
+      if (poNChildren[ulIndex] == NULL)
+         break;
+   }
+   if (ulIndex < ulCount ||
+       !NodeArray_mergeSorted(&oNParent->sChildren, poNChildren, ulCount,
+                              Node_compareChildren, &ulDuplicates,
+                              oNParent->oAAlloc))
+   {
+      while (ulIndex > 0)
+         Node_unmakeChild(poNChildren[--ulIndex]);
+      return MEMORY_ERROR;
+   }
+   assert(ulDuplicates == 0);
+
+   if (ulCount > 0)
+      Node_staleHash(oNParent);
+   return SUCCESS;
+}
+
+void Node_adoptContents(Node_T oNNode, Contents_T oCContents)
+{
+   assert(oNNode != NULL);
+   assert(oNNode->bIsFile);
+
+   Contents_freeRetired();
+   Node_releaseContents(oNNode, FALSE);
+   if (oNNode->oRChunks != NULL)
+   {
+      Rope_free(oNNode->oRChunks);
+      oNNode->oRChunks = NULL;
+   }
+
+   Node_staleHash(oNNode);
+   oNNode->oCOwned = oCContents;
+   oNNode->pvContents = NULL;
+   oNNode->bWritten = FALSE;
+   if (oCContents == NULL)
+      oNNode->ulLength = 0;
+   else
+      oNNode->ulLength = Contents_getLength(oCContents);
+}
+
+Path_T Node_getPath(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   if (Node_refreshPath(oNNode) != SUCCESS)
+      return NULL;
+   return oNNode->oPPath;
+}
+
+const char *Node_getName(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   return oNNode->pcName;
+}
+
+/* We attempted to make this simpler by using char *pcPath
+   instead of Path_T oPPath. Children are ordered by name, so only the
+   last component of pcPath takes part in the search. */
+boolean Node_hasChild(Node_T oNParent, const char *pcPath,
+                      size_t *pulChildID)
+{
+   assert(oNParent != NULL);
+   assert(pcPath != NULL);
+   assert(pulChildID != NULL);
+
+   if (Node_isFile(oNParent))
+      return FALSE;
+
+   /* *pulChildID is the index into oNParent->sChildren */
+   return NodeArray_bsearch(&oNParent->sChildren,
+                            Node_lastComponent(pcPath), pulChildID);
+}
+
+size_t Node_getNumChildren(Node_T oNParent)
+{
+   assert(oNParent != NULL);
+
+   if (Node_isFile(oNParent))
+      return 0;
+   return NodeArray_getLength(&oNParent->sChildren);
+}
+
+int Node_getChild(Node_T oNParent, size_t ulChildID,
+                  Node_T *poNResult)
+{
+
+   assert(oNParent != NULL);
+   assert(poNResult != NULL);
+
+   /* ulChildID is the index into oNParent->sChildren */
+   if (ulChildID >= Node_getNumChildren(oNParent))
+   {
+      *poNResult = NULL;
+      return NO_SUCH_PATH;
+   }
+   else
+   {
+      *poNResult = NodeArray_get(&oNParent->sChildren, ulChildID);
+      return SUCCESS;
+   }
+}
+
+int Node_reserveChildren(Node_T oNParent, size_t ulCount)
+{
+   assert(oNParent != NULL);
+   assert(!Node_isFile(oNParent));
+
+   if (!NodeArray_reserve(&oNParent->sChildren, ulCount,
+                          oNParent->oAAlloc))
+      return MEMORY_ERROR;
+   return SUCCESS;
+}
+
+void Node_trimChildren(Node_T oNParent)
+{
+   size_t ulSlots;
+
+   assert(oNParent != NULL);
+
+   if (Node_isFile(oNParent))
+      return;
+   ulSlots = NodeArray_getPhysLength(&oNParent->sChildren);
+   if (ulSlots < TRIM_MIN_SLOTS ||
+       NodeArray_getLength(&oNParent->sChildren) * 4 >
+       ulSlots * TRIM_MAX_QUARTERS)
+      return;
+   /* keeping the slots is harmless if they cannot be given back */
+   (void)NodeArray_shrinkToFit(&oNParent->sChildren, oNParent->oAAlloc);
+}
+
+void Node_setChildGrowth(Node_T oNParent, size_t ulPercent)
+{
+   assert(oNParent != NULL);
+   assert(!Node_isFile(oNParent));
+   assert(ulPercent > 0);
+
+   NodeArray_setGrowth(&oNParent->sChildren, ulPercent);
+}
+
+boolean Node_getChildStats(Node_T oNParent,
+                           struct DynArrayStats *psStats)
+{
+   assert(oNParent != NULL);
+   assert(psStats != NULL);
+
+   return (boolean)NodeArray_getStats(&oNParent->sChildren, psStats);
+}
+
+Node_T Node_getParent(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   return oNNode->oNParent;
+}
+
+unsigned int Node_getWatchFlags(Node_T oNNode)
+{
+   assert(oNNode != NULL);
+
+   return oNNode->uiWatchFlags;
+}
+
+void Node_setWatchFlags(Node_T oNNode, unsigned int uiFlags)
+{
+   assert(oNNode != NULL);
+
+   oNNode->uiWatchFlags = uiFlags;
+}
+
+/*
+  Continues the FNV-1a hash ulHash over the ulLength bytes at pvBytes,
+  or over ulLength zeros if pvBytes is NULL, and returns the result.
+*/
+static size_t Node_hashBytes(size_t ulHash, const void *pvBytes,
+                             size_t ulLength)
+{
+   const unsigned char *pucByte = pvBytes;
+   size_t ulIndex;
+
+   if (pucByte == NULL)
+   {
+      for (ulIndex = 0; ulIndex < ulLength; ulIndex++)
+         ulHash *= NODE_HASH_PRIME;
+      return ulHash;
+   }
+   for (ulIndex = 0; ulIndex < ulLength; ulIndex++)
+   {
+      ulHash ^= pucByte[ulIndex];
+      ulHash *= NODE_HASH_PRIME;
+   }
+   return ulHash;
+}
+
+int Node_getHash(Node_T oNNode, size_t *pulHash)
+{
+   const void *pvSpan;
+   Node_T oNChild;
+   size_t ulHash;
+   size_t ulChildHash;
+   size_t ulOffset;
+   size_t ulSpan;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(oNNode != NULL);
+   assert(pulHash != NULL);
+
+   if (oNNode->bHashValid)
+   {
+      *pulHash = oNNode->ulHash;
+      return SUCCESS;
+   }
+
+   /* the kind comes first, so that a file never hashes as a
+      directory */
+   ulHash = Node_hashBytes(NODE_HASH_BASIS, oNNode->bIsFile ? "f" : "d",
+                           1);
+   if (oNNode->bIsFile)
+   {
+      for (ulOffset = 0; ulOffset < oNNode->ulLength; ulOffset += ulSpan)
+      {
+         ulSpan = Node_getFileSpan(oNNode, ulOffset, &pvSpan);
+         if (ulSpan == 0)
+            return MEMORY_ERROR;
+         ulHash = Node_hashBytes(ulHash, pvSpan, ulSpan);
+      }
+   }
+   else
+   {
+      /* each child's name, with its terminator, then its hash */
+      for (ulIndex = 0; ulIndex < NodeArray_getLength(&oNNode->sChildren);
+           ulIndex++)
+      {
+         oNChild = NodeArray_get(&oNNode->sChildren, ulIndex);
+         iStatus = Node_getHash(oNChild, &ulChildHash);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         ulHash = Node_hashBytes(ulHash, oNChild->pcName,
+                                 strlen(oNChild->pcName) + 1);
+         ulHash = Node_hashBytes(ulHash, &ulChildHash, sizeof(size_t));
+      }
+   }
+
+   oNNode->ulHash = ulHash;
+   oNNode->bHashValid = TRUE;
+   *pulHash = ulHash;
+   return SUCCESS;
+}
+
+void Node_startVersions(size_t ulMaxCount, size_t ulMaxBytes)
+{
+   bVersioned = TRUE;
+   ulMaxVersions = ulMaxCount;
+   ulMaxVersionBytes = ulMaxBytes;
+}
+
+void Node_endVersions(void)
+{
+   bVersioned = FALSE;
+   ulMaxVersions = 0;
+   ulMaxVersionBytes = 0;
+}
+
+void Node_getVersions(Node_T oNNode, size_t *pulOldest,
+                      size_t *pulCurrent)
+{
+   struct version *psVersion;
+
+   assert(oNNode != NULL);
+   assert(pulOldest != NULL);
+   assert(pulCurrent != NULL);
+
+   *pulCurrent = oNNode->ulVersion;
+   *pulOldest = oNNode->ulVersion;
+   for (psVersion = oNNode->psHistory; psVersion != NULL;
+        psVersion = psVersion->psOlder)
+      *pulOldest = psVersion->ulVersion;
+}
+
+int Node_readVersion(Node_T oNNode, size_t ulVersion,
+                     void **ppvBytes, size_t *pulLength)
+{
+   struct version *psVersion;
+   char *pcBuf;
+   void *pvChunk;
+   size_t ulRead;
+   size_t ulChunk;
+   size_t ulSize;
+   int iStatus;
+
+   assert(oNNode != NULL);
+   assert(ppvBytes != NULL);
+   assert(pulLength != NULL);
+
+   *ppvBytes = NULL;
+   *pulLength = 0;
+   if (!oNNode->bIsFile)
+      return NOT_A_FILE;
+
+   if (ulVersion == oNNode->ulVersion)
+   {
+      if (oNNode->ulLength == 0)
+         return SUCCESS;
+      pcBuf = malloc(oNNode->ulLength);
+      if (pcBuf == NULL)
+         return MEMORY_ERROR;
+      iStatus = Node_readFile(oNNode, 0, pcBuf, oNNode->ulLength,
+                              &ulRead);
+      if (iStatus != SUCCESS)
+      {
+         free(pcBuf);
+         return iStatus;
+      }
+      *ppvBytes = pcBuf;
+      *pulLength = ulRead;
+      return SUCCESS;
    }
-   oNNewNode->oNParent = oNParent;
 
-   /* initialize the new node */
-   if (bIsFile) /* file initialization */
+   for (psVersion = oNNode->psHistory; psVersion != NULL;
+        psVersion = psVersion->psOlder)
    {
-      oNNewNode->pvContents = (char *)pvContents;
-      oNNewNode->ulLength = ulLength;
-      oNNewNode->bIsFile = TRUE;
+      if (psVersion->ulVersion == ulVersion)
+         break;
    }
-   else /* directory initialization */
+   if (psVersion == NULL)
+      return NO_SUCH_PATH;
+   if (psVersion->ulLength == 0)
+      return SUCCESS;
+
+   pcBuf = malloc(psVersion->ulLength);
+   if (pcBuf == NULL)
+      return MEMORY_ERROR;
+   for (ulChunk = 0; ulChunk * VERSION_CHUNK < psVersion->ulLength;
+        ulChunk++)
    {
-      oNNewNode->bIsFile = FALSE;
-      oNNewNode->oDChildren = DynArray_new(0);
-      if (oNNewNode->oDChildren == NULL)
+      ulSize = psVersion->ulLength - ulChunk * VERSION_CHUNK;
+      if (ulSize > VERSION_CHUNK)
+         ulSize = VERSION_CHUNK;
+      if (psVersion->aoCChunks[ulChunk] == NULL)
       {
-         Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
-         *poNResult = NULL;
+         memset(pcBuf + ulChunk * VERSION_CHUNK, 0, ulSize);
+         continue;
+      }
+      pvChunk = Contents_getBytes(psVersion->aoCChunks[ulChunk]);
+      if (pvChunk == NULL)
+      {
+         free(pcBuf);
          return MEMORY_ERROR;
       }
+      memcpy(pcBuf + ulChunk * VERSION_CHUNK, pvChunk, ulSize);
    }
+   *ppvBytes = pcBuf;
+   *pulLength = psVersion->ulLength;
+   return SUCCESS;
+}
 
-   /* Link into parent's children list */
-   if (oNParent != NULL)
+size_t Node_unlink(Node_T oNNode)
+{
+   size_t ulIndex = 0;
+   size_t ulNodes = 0;
+   size_t ulNameBytes = 0;
+
+   assert(oNNode != NULL);
+
+   if (oNNode->oNParent != NULL)
    {
-      iStatus = Node_addChild(oNParent, oNNewNode, ulIndex);
-      if (iStatus != SUCCESS)
-      {
-         Path_free(oNNewNode->oPPath);
-         free(oNNewNode);
-         *poNResult = NULL;
-         return iStatus;
-      }
+      if (NodeArray_bsearch(&oNNode->oNParent->sChildren,
+                            oNNode->pcName, &ulIndex))
+         (void)NodeArray_removeAt(&oNNode->oNParent->sChildren,
+                                  ulIndex);
+      Node_staleHash(oNNode->oNParent);
+      oNNode->oNParent = NULL;
    }
 
-   *poNResult = oNNewNode;
-
-   return SUCCESS;
+   Node_measure(oNNode, &ulNodes, &ulNameBytes);
+   return ulNodes;
 }
 
-size_t Node_free(Node_T oNNode)
+void Node_relink(Node_T oNNode, Node_T oNParent)
 {
    size_t ulIndex = 0;
-   size_t ulCount = 0;
 
    assert(oNNode != NULL);
+   assert(oNNode->oNParent == NULL);
 
-   /* Remove from parent's list */
-   if (oNNode->oNParent != NULL)
+   oNNode->oNParent = oNParent;
+   if (oNParent == NULL)
+      return;
+
+   /* removal never shrinks, and Node_trimChildren is not called
+      meanwhile, so the slot given up by Node_unlink is still there */
+   (void)NodeArray_bsearch(&oNParent->sChildren, oNNode->pcName,
+                           &ulIndex);
+   (void)NodeArray_addAt(&oNParent->sChildren, ulIndex, oNNode,
+                         oNParent->oAAlloc);
+   Node_staleHash(oNParent);
+}
+
+int Node_saveLink(Node_T oNNode, Node_T *poNSaved)
+{
+   Node_T oNSaved;
+   Path_T oPPath;
+   char *pcName;
+   int iStatus;
+
+   assert(oNNode != NULL);
+   assert(poNSaved != NULL);
+
+   *poNSaved = NULL;
+   oPPath = Node_getPath(oNNode);
+   if (oPPath == NULL)
+      return MEMORY_ERROR;
+   pcName = Allocator_alloc(oNNode->oAAlloc, strlen(oNNode->pcName) + 1);
+   if (pcName == NULL)
+      return MEMORY_ERROR;
+   strcpy(pcName, oNNode->pcName);
+   oNSaved = Allocator_alloc(oNNode->oAAlloc, sizeof(struct node));
+   if (oNSaved == NULL)
+   {
+      Allocator_release(oNNode->oAAlloc, pcName, strlen(pcName) + 1);
+      return MEMORY_ERROR;
+   }
+   iStatus = Path_dup(oPPath, &oNSaved->oPPath);
+   if (iStatus != SUCCESS)
    {
-      if (DynArray_bsearch(
-              oNNode->oNParent->oDChildren,
-              oNNode, &ulIndex,
-              (int (*)(const void *, const void *))Node_compare))
-         (void)DynArray_removeAt(oNNode->oNParent->oDChildren,
-                                 ulIndex);
+      Allocator_release(oNNode->oAAlloc, oNSaved, sizeof(struct node));
+      Allocator_release(oNNode->oAAlloc, pcName, strlen(pcName) + 1);
+      return iStatus;
    }
 
-   /* If it's a directory, recursively remove children */
-   if (!Node_isFile(oNNode))
+   /* a bare, empty file node, with no parent, that Node_free frees
+      along with the name and path it holds */
+   oNSaved->pcName = pcName;
+   oNSaved->bNameInBlock = FALSE;
+   oNSaved->psBlock = NULL;
+   oNSaved->ulPathStamp = 0;
+   oNSaved->ulParentStamp = 0;
+   oNSaved->oNParent = NULL;
+   oNSaved->oAAlloc = oNNode->oAAlloc;
+   (void)NodeArray_init(&oNSaved->sChildren, 0, oNSaved->oAAlloc);
+   oNSaved->bIsFile = TRUE;
+   oNSaved->pvContents = NULL;
+   oNSaved->oCOwned = NULL;
+   oNSaved->oRChunks = NULL;
+   oNSaved->bWritten = FALSE;
+   oNSaved->ulLength = 0;
+   oNSaved->uiWatchFlags = 0;
+   oNSaved->ulHash = 0;
+   oNSaved->bHashValid = FALSE;
+   oNSaved->ulVersion = 0;
+   oNSaved->psHistory = NULL;
+   oNSaved->ulSaveStamp = 0;
+
+   *poNSaved = oNSaved;
+   return SUCCESS;
+}
+
+void Node_restoreLink(Node_T oNNode, Node_T oNParent, Node_T oNSaved)
+{
+   size_t ulIndex = 0;
+
+   assert(oNNode != NULL);
+   assert(oNSaved != NULL);
+
+   if (oNNode->oNParent != NULL)
    {
-      while (DynArray_getLength(oNNode->oDChildren) != 0)
-      {
-         ulCount += Node_free(DynArray_get(oNNode->oDChildren, 0));
-      }
-      DynArray_free(oNNode->oDChildren);
+      if (NodeArray_bsearch(&oNNode->oNParent->sChildren,
+                            oNNode->pcName, &ulIndex))
+         (void)NodeArray_removeAt(&oNNode->oNParent->sChildren,
+                                  ulIndex);
+      Node_staleHash(oNNode->oNParent);
    }
 
-   /* Remove path */
+   /* the saved name and path take the place of the current ones */
+   if (!oNNode->bNameInBlock)
+      Allocator_release(oNNode->oAAlloc, oNNode->pcName,
+                        strlen(oNNode->pcName) + 1);
+   oNNode->pcName = oNSaved->pcName;
+   oNNode->bNameInBlock = FALSE;
    Path_free(oNNode->oPPath);
+   oNNode->oPPath = oNSaved->oPPath;
+   oNNode->ulPathStamp = ulNextPathStamp++;
+   oNNode->oNParent = oNParent;
+   Allocator_release(oNSaved->oAAlloc, oNSaved, sizeof(struct node));
 
-   /* Finally, free the struct node */
-   free(oNNode);
-   ulCount++;
-   return ulCount;
+   if (oNParent == NULL)
+      return;
+   oNNode->ulParentStamp = oNParent->ulPathStamp;
+
+   /* as in Node_relink, the slot given up by the move is still there */
+   (void)NodeArray_bsearch(&oNParent->sChildren, oNNode->pcName,
+                           &ulIndex);
+   (void)NodeArray_addAt(&oNParent->sChildren, ulIndex, oNNode,
+                         oNParent->oAAlloc);
+   Node_staleHash(oNParent);
 }
 
-Path_T Node_getPath(Node_T oNNode)
+int Node_saveContents(Node_T oNNode, size_t ulStamp, Node_T *poNSaved)
 {
+   Node_T oNSaved;
+
    assert(oNNode != NULL);
+   assert(ulStamp != 0);
+   assert(poNSaved != NULL);
 
-   return oNNode->oPPath;
+   *poNSaved = NULL;
+   if (!oNNode->bIsFile || oNNode->ulSaveStamp == ulStamp)
+      return SUCCESS;
+
+   /* the saved state shares a single copy of the bytes, which a
+      later write copies into chunks rather than changing */
+   if (Node_flatten(oNNode) != SUCCESS)
+      return MEMORY_ERROR;
+   oNSaved = Allocator_alloc(oNNode->oAAlloc, sizeof(struct node));
+   if (oNSaved == NULL)
+      return MEMORY_ERROR;
+
+   /* a bare file node, with no name or path, that Node_free frees */
+   oNSaved->pcName = NULL;
+   oNSaved->bNameInBlock = TRUE;
+   oNSaved->psBlock = NULL;
+   oNSaved->oPPath = NULL;
+   oNSaved->ulPathStamp = 0;
+   oNSaved->ulParentStamp = 0;
+   oNSaved->oNParent = NULL;
+   oNSaved->oAAlloc = oNNode->oAAlloc;
+   (void)NodeArray_init(&oNSaved->sChildren, 0, oNSaved->oAAlloc);
+   oNSaved->bIsFile = TRUE;
+   oNSaved->pvContents = oNNode->pvContents;
+   oNSaved->oCOwned = oNNode->oCOwned;
+   if (oNSaved->oCOwned != NULL)
+      Contents_addRef(oNSaved->oCOwned);
+   oNSaved->oRChunks = NULL;
+   oNSaved->bWritten = oNNode->bWritten;
+   oNSaved->ulLength = oNNode->ulLength;
+   oNSaved->uiWatchFlags = 0;
+   oNSaved->ulHash = 0;
+   oNSaved->bHashValid = FALSE;
+   oNSaved->ulVersion = oNNode->ulVersion;
+   oNSaved->psHistory = NULL;
+   oNSaved->ulSaveStamp = 0;
+
+   oNNode->ulSaveStamp = ulStamp;
+   *poNSaved = oNSaved;
+   return SUCCESS;
 }
 
-/* We attempted to make this simpler by using char *pcPath
-   instead of Path_T oPPath */
-boolean Node_hasChild(Node_T oNParent, const char *pcPath,
-                      size_t *pulChildID)
+void Node_restoreContents(Node_T oNNode, Node_T oNSaved)
 {
-   assert(oNParent != NULL);
-   assert(pcPath != NULL);
-   assert(pulChildID != NULL);
+   struct version *psVersion;
 
-   if (Node_isFile(oNParent))
-      return FALSE;
+   assert(oNNode != NULL);
+   assert(oNSaved != NULL);
+   assert(oNNode->bIsFile);
+
+   Contents_freeRetired();
+   Node_releaseContents(oNNode, FALSE);
+   if (oNNode->oRChunks != NULL)
+   {
+      Rope_free(oNNode->oRChunks);
+      oNNode->oRChunks = NULL;
+   }
+   oNNode->pvContents = oNSaved->pvContents;
+   oNNode->oCOwned = oNSaved->oCOwned;
+   oNNode->bWritten = oNSaved->bWritten;
+   oNNode->ulLength = oNSaved->ulLength;
 
-   /* *pulChildID is the index into oNParent->oDChildren */
-   return DynArray_bsearch(oNParent->oDChildren, (char *)pcPath, pulChildID,
-                           (int (*)(const void *, const void *))Node_compareString);
+   /* versions kept since are dropped again */
+   while (oNNode->psHistory != NULL &&
+          oNNode->psHistory->ulVersion >= oNSaved->ulVersion)
+   {
+      psVersion = oNNode->psHistory;
+      oNNode->psHistory = psVersion->psOlder;
+      psVersion->psOlder = NULL;
+      Node_freeVersions(psVersion);
+   }
+   oNNode->ulVersion = oNSaved->ulVersion;
+   Node_staleHash(oNNode);
+   Allocator_release(oNSaved->oAAlloc, oNSaved, sizeof(struct node));
 }
 
-size_t Node_getNumChildren(Node_T oNParent)
+char *Node_toString(Node_T oNNode)
 {
-   assert(oNParent != NULL);
+   Path_T oPPath;
+   char *copyPath;
+
+   assert(oNNode != NULL);
+
+   oPPath = Node_getPath(oNNode);
+   if (oPPath == NULL)
+      return NULL;
 
-   return DynArray_getLength(oNParent->oDChildren);
+   copyPath = malloc(Path_getStrLength(oPPath) + 1);
+   if (copyPath == NULL)
+      return NULL;
+   else
+      return strcpy(copyPath, Path_getPathname(oPPath));
 }
 
-int Node_getChild(Node_T oNParent, size_t ulChildID,
-                  Node_T *poNResult)
+/*
+  Reserves room in the fresh content arena for every FT-owned copy of
+  contents in the subtree rooted at oNNode. Returns SUCCESS, or
+  MEMORY_ERROR if the fresh arena ran out of memory.
+*/
+static int Node_reserveMoves(Node_T oNNode)
 {
+   struct version *psVersion;
+   size_t ulIndex;
+   int iStatus;
 
-   assert(oNParent != NULL);
-   assert(poNResult != NULL);
+   assert(oNNode != NULL);
 
-   /* ulChildID is the index into oNParent->oDChildren */
-   if (ulChildID >= Node_getNumChildren(oNParent))
+   if (oNNode->oCOwned != NULL)
    {
-      *poNResult = NULL;
-      return NO_SUCH_PATH;
+      iStatus = Contents_reserveMove(oNNode->oCOwned);
+      if (iStatus != SUCCESS)
+         return iStatus;
    }
-   else
+   for (psVersion = oNNode->psHistory; psVersion != NULL;
+        psVersion = psVersion->psOlder)
    {
-      *poNResult = DynArray_get(oNParent->oDChildren, ulChildID);
-      return SUCCESS;
+      for (ulIndex = 0; ulIndex * VERSION_CHUNK < psVersion->ulLength;
+           ulIndex++)
+      {
+         if (psVersion->aoCChunks[ulIndex] == NULL)
+            continue;
+         iStatus = Contents_reserveMove(psVersion->aoCChunks[ulIndex]);
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+   }
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+   {
+      iStatus = Node_reserveMoves(NodeArray_get(&oNNode->sChildren,
+                                               ulIndex));
+      if (iStatus != SUCCESS)
+         return iStatus;
    }
+   return SUCCESS;
 }
 
-Node_T Node_getParent(Node_T oNNode)
+/* Forgets the room reserved by Node_reserveMoves in the subtree rooted
+   at oNNode. */
+static void Node_cancelMoves(Node_T oNNode)
 {
+   struct version *psVersion;
+   size_t ulIndex;
+
    assert(oNNode != NULL);
 
-   return oNNode->oNParent;
+   if (oNNode->oCOwned != NULL)
+      Contents_cancelMove(oNNode->oCOwned);
+   for (psVersion = oNNode->psHistory; psVersion != NULL;
+        psVersion = psVersion->psOlder)
+   {
+      for (ulIndex = 0; ulIndex * VERSION_CHUNK < psVersion->ulLength;
+           ulIndex++)
+      {
+         if (psVersion->aoCChunks[ulIndex] != NULL)
+            Contents_cancelMove(psVersion->aoCChunks[ulIndex]);
+      }
+   }
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+      Node_cancelMoves(NodeArray_get(&oNNode->sChildren, ulIndex));
 }
 
-char *Node_toString(Node_T oNNode)
+/* Moves every FT-owned copy of contents in the subtree rooted at
+   oNNode to the fresh content arena, and repoints the nodes. */
+static void Node_applyMoves(Node_T oNNode)
 {
-   char *copyPath;
+   struct version *psVersion;
+   size_t ulIndex;
 
    assert(oNNode != NULL);
 
-   copyPath = malloc(Path_getStrLength(Node_getPath(oNNode)) + 1);
-   if (copyPath == NULL)
-      return NULL;
-   else
-      return strcpy(copyPath, Path_getPathname(Node_getPath(oNNode)));
+   if (oNNode->oCOwned != NULL)
+      oNNode->oCOwned = Contents_move(oNNode->oCOwned);
+   for (psVersion = oNNode->psHistory; psVersion != NULL;
+        psVersion = psVersion->psOlder)
+   {
+      for (ulIndex = 0; ulIndex * VERSION_CHUNK < psVersion->ulLength;
+           ulIndex++)
+      {
+         if (psVersion->aoCChunks[ulIndex] != NULL)
+            psVersion->aoCChunks[ulIndex] =
+               Contents_move(psVersion->aoCChunks[ulIndex]);
+      }
+   }
+
+   for (ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+      Node_applyMoves(NodeArray_get(&oNNode->sChildren, ulIndex));
+}
+
+int Node_compactContents(Node_T oNRoot)
+{
+   int iStatus;
+
+   Contents_freeRetired();
+   if (!Contents_isFragmented())
+      return SUCCESS;
+
+   iStatus = Contents_beginCompaction();
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   /* reserve everything first, so running out of memory part way
+      leaves every node where it was */
+   if (oNRoot != NULL)
+   {
+      iStatus = Node_reserveMoves(oNRoot);
+      if (iStatus != SUCCESS)
+      {
+         Node_cancelMoves(oNRoot);
+         Contents_abortCompaction();
+         return iStatus;
+      }
+      Node_applyMoves(oNRoot);
+   }
+
+   Contents_endCompaction();
+   return SUCCESS;
 }
 
 /* New functions for nodeFT */
@@ -318,8 +2083,10 @@ boolean Node_isFile(Node_T oNNode)
 void *Node_getFileContents(Node_T oNNode)
 {
    assert(oNNode != NULL);
-   /* If the given node is a directory, pvContents will be NULL */
-   return oNNode->pvContents;
+   if (Node_flatten(oNNode) != SUCCESS)
+      return NULL;
+   /* If the given node is a directory, it has no bytes */
+   return Node_getBytes(oNNode);
 }
 
 size_t Node_getFileSize(Node_T oNNode)
@@ -333,6 +2100,10 @@ void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents,
                                size_t ulNewLength)
 {
    void *pvOldContents;
+   char *pcCopy = NULL;
+   Contents_T oCOldOwned;
+   struct version *psVersion = NULL;
+
    assert(oNNode != NULL);
 
    /* Prevents us from accidentally giving directories non-null
@@ -340,10 +2111,231 @@ void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents,
    if (!Node_isFile(oNNode))
       return NULL;
 
-   /* Not a directory - replace pvContents and ulLength */
+   /* the old contents are returned as one pointer: one the client
+      owns if they were its buffer before being written to in place */
+   if (oNNode->bWritten)
+   {
+      pcCopy = malloc(oNNode->ulLength + 1);
+      if (pcCopy == NULL)
+         return NULL;
+      if (oNNode->oRChunks != NULL)
+         Rope_flatten(oNNode->oRChunks, pcCopy);
+      else
+      {
+         pvOldContents = Node_getBytes(oNNode);
+         if (pvOldContents == NULL && Node_hasBytes(oNNode))
+         {
+            free(pcCopy);
+            return NULL;
+         }
+         if (pvOldContents != NULL)
+            memcpy(pcCopy, pvOldContents, oNNode->ulLength);
+      }
+   }
+   else if (Node_flatten(oNNode) != SUCCESS)
+      return NULL;
+
+   /* and kept, if versioning, before anything changes */
+   if (bVersioned)
+   {
+      pvOldContents = pcCopy != NULL ? pcCopy : Node_getBytes(oNNode);
+      if (pvOldContents == NULL && Node_hasBytes(oNNode))
+         return NULL;
+      psVersion = Node_newVersion(pvOldContents, oNNode->ulLength,
+                                  oNNode->ulVersion);
+      if (psVersion == NULL)
+      {
+         free(pcCopy);
+         return NULL;
+      }
+   }
+
+   /* Not a directory - replace pvContents and ulLength. Owned old
+      contents are retired rather than freed, so that they can still
+      be returned */
+   Contents_freeRetired();
    pvOldContents = oNNode->pvContents;
-   oNNode->pvContents = pvNewContents;
-   oNNode->ulLength = ulNewLength;
+   oCOldOwned = oNNode->oCOwned;
+   oNNode->oCOwned = NULL;
+   if (Node_takeContents(oNNode, pvNewContents, ulNewLength) != SUCCESS)
+   {
+      /* leave the old contents in place */
+      oNNode->pvContents = pvOldContents;
+      oNNode->oCOwned = oCOldOwned;
+      Node_freeVersions(psVersion);
+      free(pcCopy);
+      return NULL;
+   }
+   if (psVersion != NULL)
+      Node_pushVersion(oNNode, psVersion);
+   oNNode->ulVersion++;
+   if (pcCopy != NULL)
+   {
+      /* the FT's own bytes are no longer needed */
+      if (oNNode->oRChunks != NULL)
+      {
+         Rope_free(oNNode->oRChunks);
+         oNNode->oRChunks = NULL;
+      }
+      if (oCOldOwned != NULL)
+         Contents_release(oCOldOwned, FALSE);
+      oNNode->bWritten = FALSE;
+      pvOldContents = pcCopy;
+   }
+   else if (oCOldOwned != NULL)
+   {
+      /* looked up once retired, so that the content tier keeps it */
+      Contents_release(oCOldOwned, TRUE);
+      pvOldContents = Contents_getBytes(oCOldOwned);
+   }
+   Node_staleHash(oNNode);
 
    return pvOldContents;
 }
+
+/*
+  Makes sure that the file oNNode holds its contents in chunks, so it
+  can be changed in place, copying them there on the first call.
+  Returns SUCCESS, or MEMORY_ERROR (leaving oNNode unchanged) if
+  memory could not be allocated.
+*/
+static int Node_toChunks(Node_T oNNode)
+{
+   Rope_T oRChunks;
+   void *pvBytes;
+
+   assert(oNNode != NULL);
+   assert(oNNode->bIsFile);
+
+   if (oNNode->oRChunks != NULL)
+      return SUCCESS;
+
+   /* NULL contents read as zeros */
+   if (Node_hasBytes(oNNode))
+   {
+      pvBytes = Node_getBytes(oNNode);
+      if (pvBytes == NULL)
+         return MEMORY_ERROR;
+      oRChunks = Rope_new(pvBytes, oNNode->ulLength);
+   }
+   else
+   {
+      oRChunks = Rope_new(NULL, 0);
+      if (oRChunks != NULL &&
+          Rope_truncate(oRChunks, oNNode->ulLength) != SUCCESS)
+      {
+         Rope_free(oRChunks);
+         oRChunks = NULL;
+      }
+   }
+   if (oRChunks == NULL)
+      return MEMORY_ERROR;
+
+   Node_releaseContents(oNNode, FALSE);
+   oNNode->pvContents = NULL;
+   oNNode->oRChunks = oRChunks;
+   if (!Contents_usesArena())
+      oNNode->bWritten = TRUE;
+   return SUCCESS;
+}
+
+int Node_readFile(Node_T oNNode, size_t ulOffset, void *pvBuf,
+                  size_t ulLength, size_t *pulRead)
+{
+   void *pvBytes;
+
+   assert(oNNode != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+   assert(pulRead != NULL);
+
+   *pulRead = 0;
+   if (!oNNode->bIsFile)
+      return NOT_A_FILE;
+
+   if (oNNode->oRChunks != NULL)
+   {
+      *pulRead = Rope_read(oNNode->oRChunks, ulOffset, pvBuf, ulLength);
+      return SUCCESS;
+   }
+
+   if (ulOffset >= oNNode->ulLength)
+      return SUCCESS;
+   if (ulLength > oNNode->ulLength - ulOffset)
+      ulLength = oNNode->ulLength - ulOffset;
+   pvBytes = Node_getBytes(oNNode);
+   if (pvBytes == NULL && Node_hasBytes(oNNode))
+      return MEMORY_ERROR;
+   if (pvBytes == NULL)
+      memset(pvBuf, 0, ulLength);
+   else
+      memcpy(pvBuf, (char *)pvBytes + ulOffset, ulLength);
+   *pulRead = ulLength;
+   return SUCCESS;
+}
+
+size_t Node_getFileSpan(Node_T oNNode, size_t ulOffset,
+                        const void **ppvBytes)
+{
+   void *pvBytes;
+
+   assert(oNNode != NULL);
+   assert(ppvBytes != NULL);
+
+   *ppvBytes = NULL;
+   if (!oNNode->bIsFile)
+      return 0;
+
+   if (oNNode->oRChunks != NULL)
+      return Rope_getSpan(oNNode->oRChunks, ulOffset, ppvBytes);
+
+   if (ulOffset >= oNNode->ulLength)
+      return 0;
+   if (Node_hasBytes(oNNode))
+   {
+      pvBytes = Node_getBytes(oNNode);
+      if (pvBytes == NULL)
+         return 0;
+      *ppvBytes = (char *)pvBytes + ulOffset;
+   }
+   return oNNode->ulLength - ulOffset;
+}
+
+int Node_writeFile(Node_T oNNode, size_t ulOffset, const void *pvBuf,
+                   size_t ulLength)
+{
+   int iStatus;
+
+   assert(oNNode != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   if (!oNNode->bIsFile)
+      return NOT_A_FILE;
+
+   iStatus = Node_toChunks(oNNode);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   Node_staleHash(oNNode);
+   iStatus = Rope_write(oNNode->oRChunks, ulOffset, pvBuf, ulLength);
+   oNNode->ulLength = Rope_getLength(oNNode->oRChunks);
+   return iStatus;
+}
+
+int Node_truncateFile(Node_T oNNode, size_t ulLength)
+{
+   int iStatus;
+
+   assert(oNNode != NULL);
+
+   if (!oNNode->bIsFile)
+      return NOT_A_FILE;
+
+   iStatus = Node_toChunks(oNNode);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   Node_staleHash(oNNode);
+   iStatus = Rope_truncate(oNNode->oRChunks, ulLength);
+   oNNode->ulLength = Rope_getLength(oNNode->oRChunks);
+   return iStatus;
+}
@@ -9,16 +9,23 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "a4def.h"
+#include "allocator.h"
 #include "path.h"
+#include "contents.h"
 
 /* A Node_T is a node in a File Tree */
 typedef struct node *Node_T;
 
+/* The counts of dynarray.h, which Node_getChildStats reports */
+struct DynArrayStats;
+
 /*
   Creates a new node in the File Tree, with pathname pcPath and
   parent oNParent. If bIsFile is TRUE, set pvContents and ulLength to
   the contents and length specified by the caller. If bIsFile is
-  FALSE, pvContents and ulLength will be ignored.
+  FALSE, pvContents and ulLength will be ignored. The node takes its
+  memory from oNParent's allocator (see Node_newWith), or from malloc
+  if oNParent is NULL.
   Returns an int SUCCESS status and sets *poNResult
   to be the new node if successful. Otherwise, sets *poNResult to NULL
   and returns status:
@@ -32,6 +39,17 @@ typedef struct node *Node_T;
 int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
              size_t ulLength, boolean bIsFile, Node_T *poNResult);
 
+/*
+  Creates a new node as Node_new does, but taking the memory for the
+  node, its name, its path and its children array from oAAlloc (NULL
+  for malloc) rather than from oNParent's allocator. Nodes made under
+  it by Node_new, Node_newChild and Node_clone take theirs from
+  oAAlloc too, so giving a root an allocator gives one to its tree.
+*/
+int Node_newWith(const char *pcPath, Node_T oNParent, void *pvContents,
+                 size_t ulLength, boolean bIsFile, Allocator_T oAAlloc,
+                 Node_T *poNResult);
+
 /*
   Destroys and frees all memory allocated for the subtree rooted at
   oNNode, i.e., deletes this node and all its descendents. Returns the
@@ -39,12 +57,100 @@ int Node_new(const char *pcPath, Node_T oNParent, void *pvContents,
 */
 size_t Node_free(Node_T oNNode);
 
-/* Returns the path object representing oNNode's absolute path. */
+/*
+  Moves the subtree rooted at oNNode so that it becomes the child of
+  oNNewParent with absolute path pcNewPath. Only oNNode itself is
+  relinked; the paths of its descendants are derived from their
+  parent links and are brought up to date lazily.
+  Returns SUCCESS if the subtree was moved. Otherwise, leaves the tree
+  unchanged and returns status:
+  * BAD_PATH if pcNewPath does not represent a well-formatted path
+  * CONFLICTING_PATH if exactly one of oNNode's current parent and
+                     oNNewParent is NULL (only the root can be the
+                     root), or if oNNewParent is within oNNode's subtree
+  * NOT_A_DIRECTORY if oNNewParent is a file
+  * NO_SUCH_PATH if oNNewParent's path is not pcNewPath's direct parent
+                 or oNNewParent is NULL but pcNewPath is not of depth 1
+  * ALREADY_IN_TREE if oNNewParent already has a child with this path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_rename(Node_T oNNode, Node_T oNNewParent, const char *pcNewPath);
+
+/*
+  Creates a copy of the subtree rooted at oNSrc as a new child of
+  oNParent with absolute path pcPath. All nodes of the copy and their
+  names are allocated together in one block. If bCopyContents is
+  FALSE, each copied file shares its contents pointer with the
+  original (FT-owned contents are reference counted); if TRUE, each
+  copied file gets its own FT-owned copy of the bytes.
+  Returns SUCCESS, sets *poNResult to the top node of the copy and
+  *pulCount to the number of nodes created if successful. Otherwise,
+  sets *poNResult to NULL and *pulCount to 0 and returns status:
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * NOT_A_DIRECTORY if oNParent is a file
+  * NO_SUCH_PATH if oNParent's path is not pcPath's direct parent
+  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_clone(Node_T oNSrc, Node_T oNParent, const char *pcPath,
+               boolean bCopyContents, Node_T *poNResult,
+               size_t *pulCount);
+
+/*
+  Creates a new child of oNParent named pcName, i.e., with the path of
+  oNParent followed by the single component pcName. Unlike Node_new,
+  this needs no path for the child, which is built on first use. A new
+  file is empty until given contents with Node_adoptContents.
+  Returns SUCCESS and sets *poNResult to the new node if successful.
+  Otherwise, sets *poNResult to NULL and returns status:
+  * BAD_PATH if pcName is empty or contains a '/'
+  * NOT_A_DIRECTORY if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child named pcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_newChild(Node_T oNParent, const char *pcName, boolean bIsFile,
+                  Node_T *poNResult);
+
+/*
+  Creates ulCount new children of oNParent, files if bIsFile is TRUE
+  and directories otherwise, named by ppcNames, which must be in
+  strictly increasing strcmp order, and stores them in poNChildren in
+  the same order. They are merged into oNParent's children in a
+  single pass, so adding k children to a directory of n costs O(n + k)
+  rather than the O(n * k) of k calls to Node_newChild.
+  Returns SUCCESS if successful. Otherwise, adds none of them and
+  returns status:
+  * BAD_PATH if a name is empty or contains a '/'
+  * NOT_A_DIRECTORY if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child of one of the
+                    names, or ppcNames is not strictly increasing
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_newChildren(Node_T oNParent, const char *const *ppcNames,
+                     size_t ulCount, boolean bIsFile,
+                     Node_T *poNChildren);
+
+/*
+  Makes FT-owned copy oCContents (which may be NULL for no contents)
+  the contents of file oNNode, taking over the caller's reference.
+  Any previous contents of oNNode are released.
+*/
+void Node_adoptContents(Node_T oNNode, Contents_T oCContents);
+
+/*
+  Returns the path object representing oNNode's absolute path, or
+  NULL if memory could not be allocated to bring it up to date after
+  an ancestor was renamed. The object remains owned by oNNode and is
+  only valid until the next Node_rename.
+*/
 Path_T Node_getPath(Node_T oNNode);
 
+/* Returns oNNode's name, i.e., the last component of its path. */
+const char *Node_getName(Node_T oNNode);
+
 /*
-  Returns TRUE if oNParent has a child with pathname pcPath. Returns
-  FALSE if it does not.
+  Returns TRUE if oNParent has a child whose name is the last
+  component of pcPath. Returns FALSE if it does not.
 
   If oNParent has such a child, stores in *pulChildID the child's
   identifier (as used in Node_getChild). If oNParent does not have
@@ -66,12 +172,162 @@ size_t Node_getNumChildren(Node_T oNParent);
 int Node_getChild(Node_T oNParent, size_t ulChildID,
                   Node_T *poNResult);
 
+/*
+  Makes room for directory oNParent to hold ulCount children without
+  allocating any more memory, so that a bulk load can size it once.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated,
+  in which case oNParent is unchanged.
+*/
+int Node_reserveChildren(Node_T oNParent, size_t ulCount);
+
+/*
+  Gives back the memory held for children oNParent no longer has, if
+  it has at least 16 slots for them and uses no more than a quarter
+  of those. Does nothing if oNParent is a file, or if the memory
+  cannot be given back.
+*/
+void Node_trimChildren(Node_T oNParent);
+
+/*
+  Makes directory oNParent grow its room for children, whenever it
+  runs out, by ulPercent percent (which must be positive) rather than
+  doubling it. A smaller percentage wastes less memory on a large
+  directory, but copies its children more often.
+*/
+void Node_setChildGrowth(Node_T oNParent, size_t ulPercent);
+
+/*
+  Assigns to *psStats the counts kept for the array of oNParent's
+  children: how many were shifted to make or close a gap, and how
+  many comparisons searching and sorting them took. Returns TRUE in a
+  build instrumented by defining DYNARRAY_STATS, or FALSE, having
+  zeroed *psStats, otherwise. An instrumented build also writes the
+  directories that rank highest by these counts, as each is freed, to
+  stderr at exit.
+*/
+boolean Node_getChildStats(Node_T oNParent,
+                           struct DynArrayStats *psStats);
+
 /*
   Returns a the parent node of oNNode.
   Returns NULL if oNNode is the root and thus has no parent.
 */
 Node_T Node_getParent(Node_T oNNode);
 
+/*
+  Returns the watch flags of oNNode, which the node keeps for the FT's
+  change notifications without looking at them. New nodes, including
+  copies, start with none.
+*/
+unsigned int Node_getWatchFlags(Node_T oNNode);
+
+/* Sets the watch flags of oNNode to uiFlags. */
+void Node_setWatchFlags(Node_T oNNode, unsigned int uiFlags);
+
+/*
+  Sets *pulHash to a hash of the subtree rooted at oNNode: for a file,
+  of its contents; for a directory, of its children's names and
+  hashes. The node's own name is left out, so equal subtrees under
+  different names hash alike. Hashes are kept in the nodes and only
+  recomputed below nodes changed since they were last asked for;
+  copies made by Node_clone keep their source's. Changes the client
+  makes to its own contents' bytes behind the FT's back go unseen.
+  Returns SUCCESS, or MEMORY_ERROR if contents could not be read back
+  from the content tier.
+*/
+int Node_getHash(Node_T oNNode, size_t *pulHash);
+
+/*
+  Starts keeping earlier versions of file contents: each replacement
+  by Node_replaceFileContents numbers the new contents one past the
+  old, and keeps the old as FT-owned copies of their chunks, so that
+  with deduplication on (see Contents_startArena) versions share the
+  chunks they have in common. Each file keeps at most ulMaxCount
+  earlier versions and ulMaxBytes bytes of them, counted by length,
+  dropping the oldest first; a limit of 0 is no limit. In-place
+  changes by Node_writeFile and Node_truncateFile change the current
+  version. Must be called after Contents_startArena, while no nodes
+  exist.
+*/
+void Node_startVersions(size_t ulMaxCount, size_t ulMaxBytes);
+
+/* Stops keeping earlier versions. Must be called while no nodes
+   exist. */
+void Node_endVersions(void);
+
+/*
+  Sets *pulCurrent to the number of the current version of file
+  oNNode's contents, and *pulOldest to that of the oldest version it
+  keeps. Files start at version 0, and copies made by Node_clone start
+  over at 0 with no earlier versions.
+*/
+void Node_getVersions(Node_T oNNode, size_t *pulOldest,
+                      size_t *pulCurrent);
+
+/*
+  Sets *ppvBytes to a new copy of version ulVersion of the contents of
+  file oNNode, which the caller frees, or to NULL if that version is
+  empty, and *pulLength to its length.
+  Returns SUCCESS, or:
+  * NOT_A_FILE if oNNode is a directory
+  * NO_SUCH_PATH if the file has no such version (any more)
+  * MEMORY_ERROR if memory could not be allocated for the copy
+*/
+int Node_readVersion(Node_T oNNode, size_t ulVersion,
+                     void **ppvBytes, size_t *pulLength);
+
+/*
+  Unlinks oNNode from its parent, if it has one, leaving oNNode and
+  its subtree as they are, so that Node_relink can put it back or
+  Node_free can free it. Returns the number of nodes in the subtree.
+*/
+size_t Node_unlink(Node_T oNNode);
+
+/*
+  Links oNNode, unlinked by Node_unlink, back into oNParent (which may
+  be NULL, for the root), where it was. Cannot fail, provided that
+  every child oNParent has gained since has been removed again and
+  Node_trimChildren has not been called on oNParent since.
+*/
+void Node_relink(Node_T oNNode, Node_T oNParent);
+
+/*
+  Saves the name and path of oNNode, so that Node_restoreLink can move
+  it back after Node_rename without allocating. Sets *poNSaved to the
+  saved state, a bare node that only Node_free and Node_restoreLink
+  accept. Returns SUCCESS, or MEMORY_ERROR if memory could not be
+  allocated.
+*/
+int Node_saveLink(Node_T oNNode, Node_T *poNSaved);
+
+/*
+  Moves oNNode back under oNParent (which may be NULL, for the root)
+  with the name and path saved in oNSaved, and frees oNSaved. Cannot
+  fail, provided that oNParent was oNNode's parent when oNSaved was
+  saved, and that, as for Node_relink, every child oNParent has gained
+  since has been removed again.
+*/
+void Node_restoreLink(Node_T oNNode, Node_T oNParent, Node_T oNSaved);
+
+/*
+  Saves the contents of file oNNode, unless they were saved with the
+  same stamp ulStamp (which is not 0) already, so that
+  Node_restoreContents can put them back after later changes. Sets
+  *poNSaved to the saved state, a bare node that only Node_free and
+  Node_restoreContents accept, or to NULL if nothing was saved (also
+  for a directory). The saved state shares the contents, including
+  the client's, which must stay valid as long as the state is kept.
+  Returns SUCCESS, or MEMORY_ERROR if memory could not be allocated.
+*/
+int Node_saveContents(Node_T oNNode, size_t ulStamp, Node_T *poNSaved);
+
+/*
+  Puts back the contents of file oNNode saved in oNSaved, and frees
+  oNSaved. Versions kept since (see Node_startVersions) are dropped;
+  versions dropped since to keep within the limits are not restored.
+*/
+void Node_restoreContents(Node_T oNNode, Node_T oNSaved);
+
 /*
   Returns a string representation for oNNode, or NULL if
   there is an allocation error.
@@ -87,7 +343,9 @@ Returns TRUE if oNNode is a file, FALSE if it is a directory. */
 boolean Node_isFile(Node_T oNNode);
 
 /* Return the contents of a given file node oNNode, or
-NULL if unable to complete the request for any reason */
+NULL if unable to complete the request for any reason. If the file
+has been written to in place, its chunks are first gathered into a
+single FT-owned copy. */
 void *Node_getFileContents(Node_T oNNode);
 
 /* Return the size of a given file node oNNode, or
@@ -97,8 +355,70 @@ size_t Node_getFileSize(Node_T oNNode);
 /* Replace current contents of the file node oNNode with
   absolute path pcPath with pvNewContents of size ulNewLength bytes.
   Return the old contents if successful. (Note: contents may be NULL.)
+  If the old contents were an FT-owned copy (see Node_clone), they
+  remain valid only until the next replacement or removal of a node.
+  If, outside the arena mode, oNNode has been written to in place
+  since its contents were last set, they are returned as a malloc'd
+  copy that the caller owns.
   Returns NULL if unable to complete the request for any reason. */
 void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents,
                                size_t ulNewLength);
 
+/*
+  Frees any retired old contents. Then, in the owned-contents mode
+  (see Contents_startArena), if the content arena has become mostly
+  free space, moves the contents of every file in the tree rooted at
+  oNRoot (which may be NULL) into a fresh, densely packed arena.
+  Contents pointers obtained earlier become invalid.
+  Returns SUCCESS, or MEMORY_ERROR if the new arena could not be
+  filled, in which case nothing is moved.
+*/
+int Node_compactContents(Node_T oNRoot);
+
+/*
+  Copies up to ulLength bytes of the file oNNode, starting at byte
+  ulOffset, into pvBuf and sets *pulRead to the number of bytes
+  copied, which is less than ulLength only at the end of the file.
+  NULL contents read as zeros. Returns SUCCESS, NOT_A_FILE (with
+  *pulRead set to 0) if oNNode is a directory, or MEMORY_ERROR if its
+  contents could not be read back from the content tier.
+*/
+int Node_readFile(Node_T oNNode, size_t ulOffset, void *pvBuf,
+                  size_t ulLength, size_t *pulRead);
+
+/*
+  Sets *ppvBytes to where the bytes of file oNNode starting at byte
+  ulOffset are stored, or to NULL if they read as zeros, and returns
+  how many bytes from there on are stored together, so that a file can
+  be read in place without being flattened or copied. Returns 0 at or
+  past the end of the file, for a directory, and if the contents could
+  not be read back from the content tier. Like Node_readFile, this
+  only reads oNNode; threads may share it if the content tier is held
+  (see Contents_holdTier).
+*/
+size_t Node_getFileSpan(Node_T oNNode, size_t ulOffset,
+                        const void **ppvBytes);
+
+/*
+  Overwrites ulLength bytes of the file oNNode, starting at byte
+  ulOffset, with the bytes at pvBuf, growing the file if they go past
+  its end; a gap before ulOffset reads as zeros. The first such write
+  moves the contents into FT-owned chunks, after which writes only
+  touch the chunks they cover.
+  Returns SUCCESS, or:
+  * NOT_A_FILE if oNNode is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_writeFile(Node_T oNNode, size_t ulOffset, const void *pvBuf,
+                   size_t ulLength);
+
+/*
+  Sets the length of the file oNNode to ulLength, dropping bytes past
+  it or growing the file with zeros, in the same chunked form as
+  Node_writeFile. Returns SUCCESS, or:
+  * NOT_A_FILE if oNNode is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_truncateFile(Node_T oNNode, size_t ulLength);
+
 #endif
@@ -0,0 +1,436 @@
+/*--------------------------------------------------------------------*/
+/* pager.c                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "pager.h"
+
+/* Marks the end of a list of frames, and a frame holding no page */
+#define NO_FRAME ((size_t)-1)
+
+/* A slot of the buffer pool */
+struct frame
+{
+   /* the page held, or 0 if none */
+   size_t ulPage;
+   /* the number of pins on the page */
+   size_t ulPins;
+   /* TRUE if the page changed since it was read */
+   boolean bDirty;
+   /* the frames used just before and just after this one */
+   size_t ulNewer;
+   size_t ulOlder;
+   /* the next frame in the same hash bucket */
+   size_t ulHashNext;
+};
+
+/* A pager: its page file and buffer pool */
+struct pager
+{
+   /* the page file's descriptor */
+   int iFd;
+   /* the number of pages the page file has room for, counting the
+      unused page 0 */
+   size_t ulPages;
+   /* the numbers of freed pages, for reuse */
+   size_t *pulFree;
+   size_t ulFreeCount;
+   size_t ulFreeCap;
+   /* the buffer pool: ulFrames frames, whose bytes are in pcPool */
+   struct frame *psFrames;
+   char *pcPool;
+   size_t ulFrames;
+   /* the most and least recently used frames */
+   size_t ulNewest;
+   size_t ulOldest;
+   /* hash buckets of frames by page number; ulBuckets is a power of
+      two */
+   size_t *pulBuckets;
+   size_t ulBuckets;
+   /* see Pager_getStats */
+   size_t ulHits;
+   size_t ulMisses;
+   size_t ulWrites;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the hash bucket of page ulPage in oPPager. */
+static size_t Pager_bucket(Pager_T oPPager, size_t ulPage)
+{
+   return (ulPage * 2654435761UL) & (oPPager->ulBuckets - 1);
+}
+
+/* Returns the frame of oPPager holding page ulPage, or NO_FRAME. */
+static size_t Pager_lookup(Pager_T oPPager, size_t ulPage)
+{
+   size_t ulFrame;
+
+   for (ulFrame = oPPager->pulBuckets[Pager_bucket(oPPager, ulPage)];
+        ulFrame != NO_FRAME;
+        ulFrame = oPPager->psFrames[ulFrame].ulHashNext)
+   {
+      if (oPPager->psFrames[ulFrame].ulPage == ulPage)
+         return ulFrame;
+   }
+   return NO_FRAME;
+}
+
+/* Takes frame ulFrame of oPPager out of the hash bucket of its page,
+   and marks it as holding no page. */
+static void Pager_unhash(Pager_T oPPager, size_t ulFrame)
+{
+   size_t *pulLink;
+
+   pulLink = &oPPager->pulBuckets[
+      Pager_bucket(oPPager, oPPager->psFrames[ulFrame].ulPage)];
+   while (*pulLink != ulFrame)
+      pulLink = &oPPager->psFrames[*pulLink].ulHashNext;
+   *pulLink = oPPager->psFrames[ulFrame].ulHashNext;
+   oPPager->psFrames[ulFrame].ulPage = 0;
+}
+
+/* Makes frame ulFrame of oPPager hold page ulPage. */
+static void Pager_hash(Pager_T oPPager, size_t ulFrame, size_t ulPage)
+{
+   size_t ulBucket = Pager_bucket(oPPager, ulPage);
+
+   oPPager->psFrames[ulFrame].ulPage = ulPage;
+   oPPager->psFrames[ulFrame].ulHashNext = oPPager->pulBuckets[ulBucket];
+   oPPager->pulBuckets[ulBucket] = ulFrame;
+}
+
+/* Moves frame ulFrame of oPPager to the most recently used end, or,
+   if bOldest is TRUE, to the least recently used end. */
+static void Pager_touch(Pager_T oPPager, size_t ulFrame, boolean bOldest)
+{
+   struct frame *psFrame = &oPPager->psFrames[ulFrame];
+
+   /* unlink */
+   if (psFrame->ulNewer != NO_FRAME)
+      oPPager->psFrames[psFrame->ulNewer].ulOlder = psFrame->ulOlder;
+   else
+      oPPager->ulNewest = psFrame->ulOlder;
+   if (psFrame->ulOlder != NO_FRAME)
+      oPPager->psFrames[psFrame->ulOlder].ulNewer = psFrame->ulNewer;
+   else
+      oPPager->ulOldest = psFrame->ulNewer;
+
+   /* and link at the chosen end */
+   if (bOldest)
+   {
+      psFrame->ulNewer = oPPager->ulOldest;
+      psFrame->ulOlder = NO_FRAME;
+      if (oPPager->ulOldest != NO_FRAME)
+         oPPager->psFrames[oPPager->ulOldest].ulOlder = ulFrame;
+      else
+         oPPager->ulNewest = ulFrame;
+      oPPager->ulOldest = ulFrame;
+   }
+   else
+   {
+      psFrame->ulOlder = oPPager->ulNewest;
+      psFrame->ulNewer = NO_FRAME;
+      if (oPPager->ulNewest != NO_FRAME)
+         oPPager->psFrames[oPPager->ulNewest].ulNewer = ulFrame;
+      else
+         oPPager->ulOldest = ulFrame;
+      oPPager->ulNewest = ulFrame;
+   }
+}
+
+/* Returns the bytes of frame ulFrame of oPPager. */
+static char *Pager_bytes(Pager_T oPPager, size_t ulFrame)
+{
+   return oPPager->pcPool + ulFrame * PAGER_PAGE_SIZE;
+}
+
+/*
+  Reads (if bRead is TRUE) or writes page ulPage of oPPager's page
+  file into or from pcBytes. A page past the end of the file reads as
+  zeros. Returns SUCCESS or IO_ERROR.
+*/
+static int Pager_transfer(Pager_T oPPager, size_t ulPage, char *pcBytes,
+                          boolean bRead)
+{
+   size_t ulDone = 0;
+   ssize_t lDone;
+   off_t lOffset = (off_t)ulPage * PAGER_PAGE_SIZE;
+
+   while (ulDone < PAGER_PAGE_SIZE)
+   {
+      if (bRead)
+         lDone = pread(oPPager->iFd, pcBytes + ulDone,
+                       PAGER_PAGE_SIZE - ulDone, lOffset + (off_t)ulDone);
+      else
+         lDone = pwrite(oPPager->iFd, pcBytes + ulDone,
+                        PAGER_PAGE_SIZE - ulDone, lOffset + (off_t)ulDone);
+      if (lDone < 0 && errno == EINTR)
+         continue;
+      if (lDone < 0 || (lDone == 0 && !bRead))
+         return IO_ERROR;
+      if (lDone == 0)
+      {
+         memset(pcBytes + ulDone, 0, PAGER_PAGE_SIZE - ulDone);
+         break;
+      }
+      ulDone += (size_t)lDone;
+   }
+   return SUCCESS;
+}
+
+/*
+  Finds a frame of oPPager for page ulPage, taking the least recently
+  used unpinned one and writing its page back if it is dirty, and
+  pins it. Sets *pulFrame to it. Returns SUCCESS, IO_ERROR, or
+  MEMORY_ERROR if every frame is pinned.
+*/
+static int Pager_claim(Pager_T oPPager, size_t ulPage, size_t *pulFrame)
+{
+   struct frame *psFrame;
+   size_t ulFrame;
+   int iStatus;
+
+   for (ulFrame = oPPager->ulOldest; ulFrame != NO_FRAME;
+        ulFrame = oPPager->psFrames[ulFrame].ulNewer)
+   {
+      if (oPPager->psFrames[ulFrame].ulPins == 0)
+         break;
+   }
+   if (ulFrame == NO_FRAME)
+      return MEMORY_ERROR;
+
+   psFrame = &oPPager->psFrames[ulFrame];
+   if (psFrame->ulPage != 0)
+   {
+      if (psFrame->bDirty)
+      {
+         iStatus = Pager_transfer(oPPager, psFrame->ulPage,
+                                  Pager_bytes(oPPager, ulFrame), FALSE);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         oPPager->ulWrites++;
+      }
+      Pager_unhash(oPPager, ulFrame);
+   }
+
+   psFrame->bDirty = FALSE;
+   psFrame->ulPins = 1;
+   Pager_hash(oPPager, ulFrame, ulPage);
+   Pager_touch(oPPager, ulFrame, FALSE);
+   *pulFrame = ulFrame;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Pager_open(const char *pcPath, size_t ulPoolPages,
+               Pager_T *poPResult)
+{
+   Pager_T oPPager;
+   char acTemp[] = "/tmp/ft_pagesXXXXXX";
+   size_t ulFrame;
+
+   assert(poPResult != NULL);
+
+   *poPResult = NULL;
+   if (ulPoolPages < PAGER_MIN_POOL)
+      ulPoolPages = PAGER_MIN_POOL;
+
+   oPPager = calloc(1, sizeof(struct pager));
+   if (oPPager == NULL)
+      return MEMORY_ERROR;
+   oPPager->ulFrames = ulPoolPages;
+   for (oPPager->ulBuckets = 1; oPPager->ulBuckets < 2 * ulPoolPages; )
+      oPPager->ulBuckets *= 2;
+   oPPager->psFrames = calloc(ulPoolPages, sizeof(struct frame));
+   oPPager->pcPool = malloc(ulPoolPages * PAGER_PAGE_SIZE);
+   oPPager->pulBuckets = malloc(oPPager->ulBuckets * sizeof(size_t));
+   if (oPPager->psFrames == NULL || oPPager->pcPool == NULL
+       || oPPager->pulBuckets == NULL)
+   {
+      free(oPPager->psFrames);
+      free(oPPager->pcPool);
+      free(oPPager->pulBuckets);
+      free(oPPager);
+      return MEMORY_ERROR;
+   }
+
+   if (pcPath == NULL)
+      oPPager->iFd = mkstemp(acTemp);
+   else
+      oPPager->iFd = open(pcPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (oPPager->iFd < 0)
+   {
+      free(oPPager->psFrames);
+      free(oPPager->pcPool);
+      free(oPPager->pulBuckets);
+      free(oPPager);
+      return IO_ERROR;
+   }
+   (void)unlink(pcPath == NULL ? acTemp : pcPath);
+
+   /* every frame starts out empty, in one list from newest to oldest */
+   for (ulFrame = 0; ulFrame < oPPager->ulBuckets; ulFrame++)
+      oPPager->pulBuckets[ulFrame] = NO_FRAME;
+   for (ulFrame = 0; ulFrame < ulPoolPages; ulFrame++)
+   {
+      oPPager->psFrames[ulFrame].ulNewer =
+         (ulFrame == 0) ? NO_FRAME : ulFrame - 1;
+      oPPager->psFrames[ulFrame].ulOlder =
+         (ulFrame + 1 == ulPoolPages) ? NO_FRAME : ulFrame + 1;
+   }
+   oPPager->ulNewest = 0;
+   oPPager->ulOldest = ulPoolPages - 1;
+   oPPager->ulPages = 1;
+
+   *poPResult = oPPager;
+   return SUCCESS;
+}
+
+void Pager_close(Pager_T oPPager)
+{
+   assert(oPPager != NULL);
+
+   (void)close(oPPager->iFd);
+   free(oPPager->pulFree);
+   free(oPPager->psFrames);
+   free(oPPager->pcPool);
+   free(oPPager->pulBuckets);
+   free(oPPager);
+}
+
+int Pager_get(Pager_T oPPager, size_t ulPage, void **ppvPage)
+{
+   size_t ulFrame;
+   int iStatus;
+
+   assert(oPPager != NULL);
+   assert(ulPage != 0 && ulPage < oPPager->ulPages);
+   assert(ppvPage != NULL);
+
+   ulFrame = Pager_lookup(oPPager, ulPage);
+   if (ulFrame != NO_FRAME)
+   {
+      oPPager->ulHits++;
+      oPPager->psFrames[ulFrame].ulPins++;
+      Pager_touch(oPPager, ulFrame, FALSE);
+      *ppvPage = Pager_bytes(oPPager, ulFrame);
+      return SUCCESS;
+   }
+
+   iStatus = Pager_claim(oPPager, ulPage, &ulFrame);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Pager_transfer(oPPager, ulPage,
+                            Pager_bytes(oPPager, ulFrame), TRUE);
+   if (iStatus != SUCCESS)
+   {
+      /* leave the frame empty for the next claim */
+      Pager_unhash(oPPager, ulFrame);
+      oPPager->psFrames[ulFrame].ulPins = 0;
+      Pager_touch(oPPager, ulFrame, TRUE);
+      return iStatus;
+   }
+   oPPager->ulMisses++;
+   *ppvPage = Pager_bytes(oPPager, ulFrame);
+   return SUCCESS;
+}
+
+int Pager_allocate(Pager_T oPPager, size_t *pulPage, void **ppvPage)
+{
+   size_t ulPage;
+   size_t ulFrame;
+   int iStatus;
+
+   assert(oPPager != NULL);
+   assert(pulPage != NULL);
+   assert(ppvPage != NULL);
+
+   if (oPPager->ulFreeCount > 0)
+      ulPage = oPPager->pulFree[oPPager->ulFreeCount - 1];
+   else
+      ulPage = oPPager->ulPages;
+
+   /* a new page is never read, just zeroed and written back later */
+   iStatus = Pager_claim(oPPager, ulPage, &ulFrame);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (oPPager->ulFreeCount > 0)
+      oPPager->ulFreeCount--;
+   else
+      oPPager->ulPages++;
+
+   memset(Pager_bytes(oPPager, ulFrame), 0, PAGER_PAGE_SIZE);
+   oPPager->psFrames[ulFrame].bDirty = TRUE;
+   *pulPage = ulPage;
+   *ppvPage = Pager_bytes(oPPager, ulFrame);
+   return SUCCESS;
+}
+
+void Pager_release(Pager_T oPPager, void *pvPage, boolean bDirty)
+{
+   size_t ulFrame;
+
+   assert(oPPager != NULL);
+   assert(pvPage != NULL);
+
+   ulFrame = (size_t)((char *)pvPage - oPPager->pcPool) / PAGER_PAGE_SIZE;
+   assert(ulFrame < oPPager->ulFrames);
+   assert(oPPager->psFrames[ulFrame].ulPins > 0);
+
+   oPPager->psFrames[ulFrame].ulPins--;
+   if (bDirty)
+      oPPager->psFrames[ulFrame].bDirty = TRUE;
+}
+
+void Pager_free(Pager_T oPPager, size_t ulPage)
+{
+   size_t *pulFree;
+   size_t ulFrame;
+
+   assert(oPPager != NULL);
+   assert(ulPage != 0 && ulPage < oPPager->ulPages);
+
+   /* its frame is the first to be reused */
+   ulFrame = Pager_lookup(oPPager, ulPage);
+   if (ulFrame != NO_FRAME)
+   {
+      assert(oPPager->psFrames[ulFrame].ulPins == 0);
+      Pager_unhash(oPPager, ulFrame);
+      Pager_touch(oPPager, ulFrame, TRUE);
+   }
+
+   if (oPPager->ulFreeCount == oPPager->ulFreeCap)
+   {
+      pulFree = realloc(oPPager->pulFree,
+                        (2 * oPPager->ulFreeCap + 16) * sizeof(size_t));
+      if (pulFree == NULL)
+         return;
+      oPPager->pulFree = pulFree;
+      oPPager->ulFreeCap = 2 * oPPager->ulFreeCap + 16;
+   }
+   oPPager->pulFree[oPPager->ulFreeCount++] = ulPage;
+}
+
+void Pager_getStats(Pager_T oPPager, size_t *pulHits,
+                    size_t *pulMisses, size_t *pulWrites)
+{
+   assert(oPPager != NULL);
+   assert(pulHits != NULL);
+   assert(pulMisses != NULL);
+   assert(pulWrites != NULL);
+
+   *pulHits = oPPager->ulHits;
+   *pulMisses = oPPager->ulMisses;
+   *pulWrites = oPPager->ulWrites;
+}
@@ -0,0 +1,81 @@
+/*--------------------------------------------------------------------*/
+/* pager.h                                                            */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef PAGER_INCLUDED
+#define PAGER_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/* The number of bytes in a page. */
+enum { PAGER_PAGE_SIZE = 4096 };
+
+/* The fewest pages a pager's buffer pool holds. */
+enum { PAGER_MIN_POOL = 16 };
+
+/*
+  A pager keeps fixed-size pages in a page file, of which at most a
+  configured number are held in memory at once, in a buffer pool. A
+  page must be pinned by Pager_get or Pager_allocate to be used, and
+  unpinned by Pager_release; the least recently used unpinned page is
+  written back, if it changed, when its frame is needed for another.
+  Page numbers start at 1, so 0 never names a page.
+*/
+typedef struct pager *Pager_T;
+
+/*
+  Creates a pager whose page file is pcPath, or a new file in the
+  temporary directory if pcPath is NULL, holding at most ulPoolPages
+  pages (at least PAGER_MIN_POOL) in memory. The page file is scratch
+  space: it starts empty and is removed from the directory at once,
+  so it goes away when the pager is closed.
+  Returns SUCCESS and sets *poPResult, or sets it to NULL and returns
+  IO_ERROR if the page file could not be created, or MEMORY_ERROR if
+  the buffer pool could not be allocated.
+*/
+int Pager_open(const char *pcPath, size_t ulPoolPages,
+               Pager_T *poPResult);
+
+/* Closes oPPager, discarding its page file and buffer pool. */
+void Pager_close(Pager_T oPPager);
+
+/*
+  Pins page ulPage of oPPager in the buffer pool, reading it from the
+  page file if it is not there, and sets *ppvPage to its bytes.
+  Returns SUCCESS, IO_ERROR if the page could not be read or a frame
+  could not be written back to make room, or MEMORY_ERROR if every
+  frame is pinned.
+*/
+int Pager_get(Pager_T oPPager, size_t ulPage, void **ppvPage);
+
+/*
+  Adds a page to oPPager, reusing a freed one if there is any, and
+  pins it as for Pager_get, with every byte zero. Sets *pulPage to its
+  number. Returns the same statuses as Pager_get.
+*/
+int Pager_allocate(Pager_T oPPager, size_t *pulPage, void **ppvPage);
+
+/*
+  Unpins the page whose bytes are at pvPage, noting that it must be
+  written back before its frame is reused if bDirty is TRUE.
+*/
+void Pager_release(Pager_T oPPager, void *pvPage, boolean bDirty);
+
+/*
+  Gives unpinned page ulPage of oPPager back for Pager_allocate to
+  reuse. Its bytes are discarded without being written back. If
+  memory runs out for remembering it, the page is just never reused.
+*/
+void Pager_free(Pager_T oPPager, size_t ulPage);
+
+/*
+  Sets *pulHits to how many Pager_get calls found their page in the
+  buffer pool, *pulMisses to how many read it from the page file, and
+  *pulWrites to how many pages have been written back.
+*/
+void Pager_getStats(Pager_T oPPager, size_t *pulHits,
+                    size_t *pulMisses, size_t *pulWrites);
+
+#endif
@@ -0,0 +1,96 @@
+/*--------------------------------------------------------------------*/
+/* ring.c                                                             */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include "ring.h"
+
+/* Bytes that keep the two indices off each other's cache line. */
+enum { LINE_SIZE = 64 };
+
+/*
+  A ring: ulHead and ulTail only ever grow, and are taken modulo the
+  capacity. The slots from ulHead up to ulTail hold the items.
+*/
+struct ring
+{
+   /* the slots, and one less than their number, a power of two */
+   void **ppvSlots;
+   size_t ulMask;
+   char acPadHead[LINE_SIZE];
+   /* the count of items ever removed; written by the consumer */
+   size_t ulHead;
+   char acPadTail[LINE_SIZE];
+   /* the count of items ever added; written by the producer */
+   size_t ulTail;
+   char acPadEnd[LINE_SIZE];
+};
+
+/*--------------------------------------------------------------------*/
+
+Ring_T Ring_new(size_t ulCapacity)
+{
+   Ring_T oRRing;
+   size_t ulSlots = 1;
+
+   while (ulSlots < ulCapacity)
+      ulSlots *= 2;
+
+   oRRing = calloc(1, sizeof(struct ring));
+   if (oRRing == NULL)
+      return NULL;
+   oRRing->ppvSlots = calloc(ulSlots, sizeof(void *));
+   if (oRRing->ppvSlots == NULL)
+   {
+      free(oRRing);
+      return NULL;
+   }
+   oRRing->ulMask = ulSlots - 1;
+   return oRRing;
+}
+
+void Ring_free(Ring_T oRRing)
+{
+   if (oRRing == NULL)
+      return;
+   free(oRRing->ppvSlots);
+   free(oRRing);
+}
+
+boolean Ring_push(Ring_T oRRing, void *pvItem)
+{
+   size_t ulTail;
+   size_t ulHead;
+
+   assert(oRRing != NULL);
+   assert(pvItem != NULL);
+
+   /* the item is in its slot before the consumer can see the index */
+   ulTail = oRRing->ulTail;
+   ulHead = __atomic_load_n(&oRRing->ulHead, __ATOMIC_ACQUIRE);
+   if (ulTail - ulHead > oRRing->ulMask)
+      return FALSE;
+   oRRing->ppvSlots[ulTail & oRRing->ulMask] = pvItem;
+   __atomic_store_n(&oRRing->ulTail, ulTail + 1, __ATOMIC_RELEASE);
+   return TRUE;
+}
+
+void *Ring_pop(Ring_T oRRing)
+{
+   size_t ulHead;
+   size_t ulTail;
+   void *pvItem;
+
+   assert(oRRing != NULL);
+
+   /* the slot is read before the producer can reuse it */
+   ulHead = oRRing->ulHead;
+   ulTail = __atomic_load_n(&oRRing->ulTail, __ATOMIC_ACQUIRE);
+   if (ulHead == ulTail)
+      return NULL;
+   pvItem = oRRing->ppvSlots[ulHead & oRRing->ulMask];
+   __atomic_store_n(&oRRing->ulHead, ulHead + 1, __ATOMIC_RELEASE);
+   return pvItem;
+}
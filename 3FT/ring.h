@@ -0,0 +1,40 @@
+/*--------------------------------------------------------------------*/
+/* ring.h                                                             */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef RING_INCLUDED
+#define RING_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Ring_T is a bounded first-in first-out queue of pointers for one
+  producing thread and one consuming thread, which need no lock: each
+  end only ever writes its own index, and reads the other's.
+*/
+typedef struct ring *Ring_T;
+
+/*
+  Returns a new, empty ring holding up to ulCapacity pointers (rounded
+  up to a power of two), or NULL if memory could not be allocated.
+*/
+Ring_T Ring_new(size_t ulCapacity);
+
+/* Frees oRRing, but not the items still in it. */
+void Ring_free(Ring_T oRRing);
+
+/*
+  Adds pvItem, which must not be NULL, at the back of oRRing. Returns
+  TRUE, or FALSE if oRRing is full. Only the producer may call this.
+*/
+boolean Ring_push(Ring_T oRRing, void *pvItem);
+
+/*
+  Removes and returns the item at the front of oRRing, or returns NULL
+  if it is empty. Only the consumer may call this.
+*/
+void *Ring_pop(Ring_T oRRing);
+
+#endif
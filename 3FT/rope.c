@@ -0,0 +1,263 @@
+/*--------------------------------------------------------------------*/
+/* rope.c                                                             */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rope.h"
+#include "dynarray.h"
+
+/* The number of bytes in a chunk. */
+enum { CHUNK_SIZE = 4096 };
+
+/* A rope: its chunks and its length */
+struct rope
+{
+   /* the chunks, in order; a NULL chunk reads as zeros. Bytes of the
+      last chunk past ulLength are always zero, so that extending the
+      rope never uncovers stale bytes */
+   DynArray_T oDChunks;
+   /* the number of bytes in the rope */
+   size_t ulLength;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the number of chunks needed to hold ulLength bytes. */
+static size_t Rope_chunksFor(size_t ulLength)
+{
+   return ulLength / CHUNK_SIZE + (ulLength % CHUNK_SIZE != 0);
+}
+
+/*
+  Makes sure that oRRope has chunk slots for its first ulLength bytes,
+  and, if bAllocate is TRUE, that the chunks holding bytes ulFirst up
+  to ulLength are allocated. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated; what was added by then is harmless, since
+  new chunks are zero.
+*/
+static int Rope_reserve(Rope_T oRRope, size_t ulFirst, size_t ulLength,
+                        boolean bAllocate)
+{
+   size_t ulChunks;
+   size_t ulIndex;
+   char *pcChunk;
+
+   assert(oRRope != NULL);
+
+   ulChunks = Rope_chunksFor(ulLength);
+   while (DynArray_getLength(oRRope->oDChunks) < ulChunks)
+   {
+      if (!DynArray_add(oRRope->oDChunks, NULL))
+         return MEMORY_ERROR;
+   }
+
+   if (!bAllocate || ulFirst >= ulLength)
+      return SUCCESS;
+
+   for (ulIndex = ulFirst / CHUNK_SIZE; ulIndex < ulChunks; ulIndex++)
+   {
+      if (DynArray_get(oRRope->oDChunks, ulIndex) == NULL)
+      {
+         pcChunk = calloc(CHUNK_SIZE, 1);
+         if (pcChunk == NULL)
+            return MEMORY_ERROR;
+         (void)DynArray_set(oRRope->oDChunks, ulIndex, pcChunk);
+      }
+   }
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+Rope_T Rope_new(const void *pvBytes, size_t ulLength)
+{
+   Rope_T oRRope;
+
+   assert(pvBytes != NULL || ulLength == 0);
+
+   oRRope = malloc(sizeof(struct rope));
+   if (oRRope == NULL)
+      return NULL;
+
+   oRRope->oDChunks = DynArray_new(0);
+   if (oRRope->oDChunks == NULL)
+   {
+      free(oRRope);
+      return NULL;
+   }
+   oRRope->ulLength = 0;
+
+   if (Rope_write(oRRope, 0, pvBytes, ulLength) != SUCCESS)
+   {
+      Rope_free(oRRope);
+      return NULL;
+   }
+   return oRRope;
+}
+
+void Rope_free(Rope_T oRRope)
+{
+   size_t ulIndex;
+
+   assert(oRRope != NULL);
+
+   for (ulIndex = 0; ulIndex < DynArray_getLength(oRRope->oDChunks);
+        ulIndex++)
+      free(DynArray_get(oRRope->oDChunks, ulIndex));
+   DynArray_free(oRRope->oDChunks);
+   free(oRRope);
+}
+
+size_t Rope_getLength(Rope_T oRRope)
+{
+   assert(oRRope != NULL);
+
+   return oRRope->ulLength;
+}
+
+size_t Rope_read(Rope_T oRRope, size_t ulOffset, void *pvBuf,
+                 size_t ulLength)
+{
+   char *pcBuf = pvBuf;
+   const char *pcChunk;
+   size_t ulDone = 0;
+   size_t ulInChunk;
+   size_t ulSpan;
+
+   assert(oRRope != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   if (ulOffset >= oRRope->ulLength)
+      return 0;
+   if (ulLength > oRRope->ulLength - ulOffset)
+      ulLength = oRRope->ulLength - ulOffset;
+
+   while (ulDone < ulLength)
+   {
+      ulInChunk = (ulOffset + ulDone) % CHUNK_SIZE;
+      ulSpan = CHUNK_SIZE - ulInChunk;
+      if (ulSpan > ulLength - ulDone)
+         ulSpan = ulLength - ulDone;
+
+      pcChunk = DynArray_get(oRRope->oDChunks,
+                             (ulOffset + ulDone) / CHUNK_SIZE);
+      if (pcChunk == NULL)
+         memset(pcBuf + ulDone, 0, ulSpan);
+      else
+         memcpy(pcBuf + ulDone, pcChunk + ulInChunk, ulSpan);
+      ulDone += ulSpan;
+   }
+   return ulLength;
+}
+
+size_t Rope_getSpan(Rope_T oRRope, size_t ulOffset,
+                    const void **ppvBytes)
+{
+   const char *pcChunk;
+   size_t ulInChunk;
+   size_t ulSpan;
+
+   assert(oRRope != NULL);
+   assert(ppvBytes != NULL);
+
+   *ppvBytes = NULL;
+   if (ulOffset >= oRRope->ulLength)
+      return 0;
+
+   ulInChunk = ulOffset % CHUNK_SIZE;
+   ulSpan = CHUNK_SIZE - ulInChunk;
+   if (ulSpan > oRRope->ulLength - ulOffset)
+      ulSpan = oRRope->ulLength - ulOffset;
+
+   pcChunk = DynArray_get(oRRope->oDChunks, ulOffset / CHUNK_SIZE);
+   if (pcChunk != NULL)
+      *ppvBytes = pcChunk + ulInChunk;
+   return ulSpan;
+}
+
+int Rope_write(Rope_T oRRope, size_t ulOffset, const void *pvBuf,
+               size_t ulLength)
+{
+   const char *pcBuf = pvBuf;
+   char *pcChunk;
+   size_t ulEnd;
+   size_t ulDone = 0;
+   size_t ulInChunk;
+   size_t ulSpan;
+   int iStatus;
+
+   assert(oRRope != NULL);
+   assert(pvBuf != NULL || ulLength == 0);
+
+   ulEnd = ulOffset + ulLength;
+   if (ulEnd < ulOffset)
+      return MEMORY_ERROR;
+
+   /* allocate everything first, so a failure changes no bytes */
+   iStatus = Rope_reserve(oRRope, ulOffset, ulEnd, TRUE);
+   if (iStatus != SUCCESS)
+      return iStatus;
+
+   while (ulDone < ulLength)
+   {
+      ulInChunk = (ulOffset + ulDone) % CHUNK_SIZE;
+      ulSpan = CHUNK_SIZE - ulInChunk;
+      if (ulSpan > ulLength - ulDone)
+         ulSpan = ulLength - ulDone;
+
+      pcChunk = DynArray_get(oRRope->oDChunks,
+                             (ulOffset + ulDone) / CHUNK_SIZE);
+      memcpy(pcChunk + ulInChunk, pcBuf + ulDone, ulSpan);
+      ulDone += ulSpan;
+   }
+
+   if (ulLength != 0 && ulEnd > oRRope->ulLength)
+      oRRope->ulLength = ulEnd;
+   return SUCCESS;
+}
+
+int Rope_truncate(Rope_T oRRope, size_t ulLength)
+{
+   char *pcChunk;
+   size_t ulChunks;
+
+   assert(oRRope != NULL);
+
+   if (ulLength >= oRRope->ulLength)
+   {
+      /* the old last chunk is already zero past the old end */
+      if (Rope_reserve(oRRope, 0, ulLength, FALSE) != SUCCESS)
+         return MEMORY_ERROR;
+      oRRope->ulLength = ulLength;
+      return SUCCESS;
+   }
+
+   /* drop whole chunks past the new end */
+   ulChunks = Rope_chunksFor(ulLength);
+   while (DynArray_getLength(oRRope->oDChunks) > ulChunks)
+      free(DynArray_removeAt(oRRope->oDChunks,
+                             DynArray_getLength(oRRope->oDChunks) - 1));
+
+   /* and zero the rest of the new last chunk */
+   if (ulLength % CHUNK_SIZE != 0)
+   {
+      pcChunk = DynArray_get(oRRope->oDChunks, ulChunks - 1);
+      if (pcChunk != NULL)
+         memset(pcChunk + ulLength % CHUNK_SIZE, 0,
+                CHUNK_SIZE - ulLength % CHUNK_SIZE);
+   }
+
+   oRRope->ulLength = ulLength;
+   return SUCCESS;
+}
+
+void Rope_flatten(Rope_T oRRope, void *pvDest)
+{
+   assert(oRRope != NULL);
+   assert(pvDest != NULL || oRRope->ulLength == 0);
+
+   (void)Rope_read(oRRope, 0, pvDest, oRRope->ulLength);
+}
@@ -0,0 +1,70 @@
+/*--------------------------------------------------------------------*/
+/* rope.h                                                             */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef ROPE_INCLUDED
+#define ROPE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Rope_T holds a sequence of bytes in fixed-size chunks, so that a
+  write to part of it touches only the chunks in that part. Chunks
+  that were never written read as zeros and take no memory.
+*/
+typedef struct rope *Rope_T;
+
+/*
+  Returns a new rope holding a copy of the ulLength bytes at pvBytes
+  (which may be NULL if ulLength is 0), or NULL if memory could not be
+  allocated.
+*/
+Rope_T Rope_new(const void *pvBytes, size_t ulLength);
+
+/* Frees oRRope and all of its chunks. */
+void Rope_free(Rope_T oRRope);
+
+/* Returns the number of bytes in oRRope. */
+size_t Rope_getLength(Rope_T oRRope);
+
+/*
+  Copies up to ulLength bytes of oRRope, starting at ulOffset, into
+  pvBuf. Returns the number of bytes copied, which is less than
+  ulLength only if the end of oRRope is reached.
+*/
+size_t Rope_read(Rope_T oRRope, size_t ulOffset, void *pvBuf,
+                 size_t ulLength);
+
+/*
+  Sets *ppvBytes to where the bytes of oRRope starting at ulOffset are
+  stored, or to NULL if they read as zeros, and returns how many bytes
+  from there on are stored together: at least one, unless ulOffset is
+  at or past the end of oRRope, in which case it returns 0.
+*/
+size_t Rope_getSpan(Rope_T oRRope, size_t ulOffset,
+                    const void **ppvBytes);
+
+/*
+  Overwrites ulLength bytes of oRRope starting at ulOffset with the
+  bytes at pvBuf, extending oRRope if they go past its end. Any gap
+  between the old end and ulOffset reads as zeros.
+  Returns SUCCESS, or MEMORY_ERROR (leaving the bytes of oRRope
+  unchanged) if memory could not be allocated.
+*/
+int Rope_write(Rope_T oRRope, size_t ulOffset, const void *pvBuf,
+               size_t ulLength);
+
+/*
+  Sets the length of oRRope to ulLength, dropping bytes past it or
+  extending oRRope with zeros. Returns SUCCESS, or MEMORY_ERROR
+  (leaving oRRope unchanged) if memory could not be allocated.
+*/
+int Rope_truncate(Rope_T oRRope, size_t ulLength);
+
+/* Copies all bytes of oRRope into pvDest, which must have room for
+   them. */
+void Rope_flatten(Rope_T oRRope, void *pvDest);
+
+#endif
@@ -0,0 +1,1159 @@
+/*--------------------------------------------------------------------*/
+/* tar.c                                                              */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "tar.h"
+#include "contents.h"
+#include "dynarray.h"
+#include "path.h"
+
+/* The size of an archive block; headers and data are padded to it. */
+enum { BLOCK_SIZE = 512 };
+
+/* The size of the output buffer, and of a streamed read. Spans at
+   least this long are written without being buffered. */
+enum { BUFFER_SIZE = 1 << 16 };
+
+/* The offsets and lengths of the USTAR header fields */
+enum { NAME_OFFSET = 0, NAME_LENGTH = 100 };
+enum { MODE_OFFSET = 100, UID_OFFSET = 108, GID_OFFSET = 116 };
+enum { SIZE_OFFSET = 124, SIZE_LENGTH = 12 };
+enum { MTIME_OFFSET = 136 };
+enum { CHKSUM_OFFSET = 148, CHKSUM_LENGTH = 8 };
+enum { TYPE_OFFSET = 156 };
+enum { MAGIC_OFFSET = 257, VERSION_OFFSET = 263 };
+enum { PREFIX_OFFSET = 345, PREFIX_LENGTH = 155 };
+
+/* The largest size an octal USTAR size field holds */
+#define MAX_OCTAL_SIZE 077777777777UL
+
+/* Where an archive being imported is read from */
+struct source
+{
+   /* the mapped archive, as contents that file contents are slices
+      of, or NULL if the archive is read as a stream */
+   Contents_T oCMapped;
+   /* the archive's descriptor */
+   int iFd;
+   /* the offset of the next unread byte in the archive */
+   size_t ulPos;
+   /* the number of bytes in the mapped archive */
+   size_t ulEnd;
+   /* TRUE if the archive ended right where a read began */
+   boolean bEnded;
+   /* the buffer streamed bytes are read into */
+   char *pcBuf;
+   /* the number of bytes pcBuf holds */
+   size_t ulBufSize;
+};
+
+/* The entry an import is working on, from its header and any
+   extended headers before it */
+struct entry
+{
+   /* the entry's path, malloc'd, or NULL if it is still unknown */
+   char *pcPath;
+   /* the entry's size, from an extended header if bHasSize */
+   size_t ulSize;
+   boolean bHasSize;
+};
+
+/* The state of one import */
+struct import
+{
+   /* the tree's root, as it becomes while importing */
+   Node_T oNRoot;
+   /* the directories from the root down to the one the last entry
+      went into, so the next entry only looks up what differs */
+   DynArray_T oDCursor;
+   /* every node created, in order, to undo a failed import */
+   DynArray_T oDCreated;
+};
+
+/* Where an archive being exported is written to */
+struct sink
+{
+   /* the archive's descriptor */
+   int iFd;
+   /* bytes not yet written */
+   char acBuf[BUFFER_SIZE];
+   /* the number of bytes in acBuf */
+   size_t ulUsed;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the number of padding bytes after ulLength bytes of data. */
+static size_t Tar_padding(size_t ulLength)
+{
+   return (BLOCK_SIZE - ulLength % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+/*
+  Sets *ppcBytes to the next ulLength bytes of psSource's archive and
+  moves past them. A streamed archive reads them into its buffer, so
+  they are only valid until the next call. Returns SUCCESS, IO_ERROR
+  if the archive could not be read or ends first, or MEMORY_ERROR if
+  memory could not be allocated.
+*/
+static int Tar_take(struct source *psSource, size_t ulLength,
+                    const char **ppcBytes)
+{
+   char *pcBuf;
+   size_t ulDone = 0;
+   ssize_t lRead;
+
+   assert(psSource != NULL);
+   assert(ppcBytes != NULL);
+
+   if (psSource->oCMapped != NULL)
+   {
+      if (ulLength > psSource->ulEnd - psSource->ulPos)
+      {
+         psSource->bEnded = (psSource->ulPos == psSource->ulEnd);
+         return IO_ERROR;
+      }
+      *ppcBytes = (const char *)Contents_getBytes(psSource->oCMapped)
+                  + psSource->ulPos;
+      psSource->ulPos += ulLength;
+      return SUCCESS;
+   }
+
+   if (ulLength > psSource->ulBufSize)
+   {
+      pcBuf = realloc(psSource->pcBuf, ulLength);
+      if (pcBuf == NULL)
+         return MEMORY_ERROR;
+      psSource->pcBuf = pcBuf;
+      psSource->ulBufSize = ulLength;
+   }
+
+   while (ulDone < ulLength)
+   {
+      lRead = read(psSource->iFd, psSource->pcBuf + ulDone,
+                   ulLength - ulDone);
+      if (lRead < 0 && errno == EINTR)
+         continue;
+      if (lRead <= 0)
+      {
+         psSource->bEnded = (lRead == 0 && ulDone == 0);
+         return IO_ERROR;
+      }
+      ulDone += (size_t)lRead;
+   }
+   *ppcBytes = psSource->pcBuf;
+   psSource->ulPos += ulLength;
+   return SUCCESS;
+}
+
+/*
+  Moves past the next ulLength bytes of psSource's archive. Returns
+  SUCCESS, IO_ERROR if the archive could not be read or ends first,
+  or MEMORY_ERROR if memory could not be allocated.
+*/
+static int Tar_skip(struct source *psSource, size_t ulLength)
+{
+   const char *pcBytes;
+   size_t ulStep;
+   int iStatus;
+
+   assert(psSource != NULL);
+
+   /* a stream is read through in pieces, not all at once */
+   while (ulLength > 0)
+   {
+      ulStep = ulLength;
+      if (psSource->oCMapped == NULL && ulStep > BUFFER_SIZE)
+         ulStep = BUFFER_SIZE;
+      iStatus = Tar_take(psSource, ulStep, &pcBytes);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      ulLength -= ulStep;
+   }
+   return SUCCESS;
+}
+
+/*
+  Maps the rest of the archive at iFd into psSource if iFd is a
+  regular file, or sets psSource up to read it as a stream if it is
+  not or cannot be mapped. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Tar_open(int iFd, struct source *psSource)
+{
+   struct stat sStat;
+   off_t lOffset;
+   void *pvMapping;
+
+   assert(psSource != NULL);
+
+   psSource->oCMapped = NULL;
+   psSource->iFd = iFd;
+   psSource->ulPos = 0;
+   psSource->ulEnd = 0;
+   psSource->bEnded = FALSE;
+   psSource->pcBuf = NULL;
+   psSource->ulBufSize = 0;
+
+   if (fstat(iFd, &sStat) != 0 || !S_ISREG(sStat.st_mode)
+       || sStat.st_size <= 0)
+      return SUCCESS;
+   lOffset = lseek(iFd, 0, SEEK_CUR);
+   if (lOffset < 0 || lOffset >= sStat.st_size)
+      return SUCCESS;
+
+   /* the whole file is mapped, since mappings start on page
+      boundaries, and reading starts at the descriptor's offset */
+   pvMapping = mmap(NULL, (size_t)sStat.st_size,
+                    PROT_READ | PROT_WRITE, MAP_PRIVATE, iFd, 0);
+   if (pvMapping == MAP_FAILED)
+      return SUCCESS;
+   psSource->oCMapped = Contents_newMapped(pvMapping,
+                                           (size_t)sStat.st_size);
+   if (psSource->oCMapped == NULL)
+   {
+      (void)munmap(pvMapping, (size_t)sStat.st_size);
+      return MEMORY_ERROR;
+   }
+   psSource->ulPos = (size_t)lOffset;
+   psSource->ulEnd = (size_t)sStat.st_size;
+   return SUCCESS;
+}
+
+/*
+  Lets go of psSource's buffer and its reference to the mapped
+  archive, which stays mapped while file contents are slices of it.
+  A mapped archive's descriptor is left just past what was read.
+*/
+static void Tar_close(struct source *psSource)
+{
+   assert(psSource != NULL);
+
+   if (psSource->oCMapped != NULL)
+   {
+      (void)lseek(psSource->iFd, (off_t)psSource->ulPos, SEEK_SET);
+      Contents_release(psSource->oCMapped, FALSE);
+   }
+   free(psSource->pcBuf);
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Parses the ulLength-byte numeric header field at pcField, which is
+  octal or, if its first byte has its top bit set, GNU base-256, into
+  *pulValue. Returns SUCCESS, or IO_ERROR if the field is malformed.
+*/
+static int Tar_parseNumber(const char *pcField, size_t ulLength,
+                           size_t *pulValue)
+{
+   const unsigned char *pucField = (const unsigned char *)pcField;
+   size_t ulValue = 0;
+   size_t ulIndex = 0;
+
+   assert(pcField != NULL);
+   assert(pulValue != NULL);
+
+   if ((pucField[0] & 0x80) != 0)
+   {
+      /* negative base-256 numbers are never valid here */
+      if ((pucField[0] & 0x40) != 0)
+         return IO_ERROR;
+      ulValue = pucField[0] & 0x3f;
+      for (ulIndex = 1; ulIndex < ulLength; ulIndex++)
+      {
+         if (ulValue > ((size_t)-1 >> 8))
+            return IO_ERROR;
+         ulValue = (ulValue << 8) | pucField[ulIndex];
+      }
+      *pulValue = ulValue;
+      return SUCCESS;
+   }
+
+   while (ulIndex < ulLength && pcField[ulIndex] == ' ')
+      ulIndex++;
+   for (; ulIndex < ulLength; ulIndex++)
+   {
+      if (pcField[ulIndex] == '\0' || pcField[ulIndex] == ' ')
+         break;
+      if (pcField[ulIndex] < '0' || pcField[ulIndex] > '7')
+         return IO_ERROR;
+      if (ulValue > ((size_t)-1 >> 3))
+         return IO_ERROR;
+      ulValue = (ulValue << 3) | (size_t)(pcField[ulIndex] - '0');
+   }
+   *pulValue = ulValue;
+   return SUCCESS;
+}
+
+/* Returns TRUE if the header block pcHeader is all zeros. */
+static boolean Tar_isZeroBlock(const char *pcHeader)
+{
+   size_t ulIndex;
+
+   assert(pcHeader != NULL);
+
+   for (ulIndex = 0; ulIndex < BLOCK_SIZE; ulIndex++)
+   {
+      if (pcHeader[ulIndex] != '\0')
+         return FALSE;
+   }
+   return TRUE;
+}
+
+/* Returns the checksum of header block pcHeader, whose checksum field
+   counts as spaces. */
+static size_t Tar_checksum(const char *pcHeader)
+{
+   const unsigned char *pucHeader = (const unsigned char *)pcHeader;
+   size_t ulSum = 0;
+   size_t ulIndex;
+
+   assert(pcHeader != NULL);
+
+   for (ulIndex = 0; ulIndex < BLOCK_SIZE; ulIndex++)
+   {
+      if (ulIndex >= CHKSUM_OFFSET
+          && ulIndex < CHKSUM_OFFSET + CHKSUM_LENGTH)
+         ulSum += ' ';
+      else
+         ulSum += pucHeader[ulIndex];
+   }
+   return ulSum;
+}
+
+/*
+  Replaces psEntry's path with a malloc'd copy of the ulLength bytes
+  at pcPath, up to any NUL. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Tar_setPath(struct entry *psEntry, const char *pcPath,
+                       size_t ulLength)
+{
+   char *pcCopy;
+
+   assert(psEntry != NULL);
+   assert(pcPath != NULL);
+
+   ulLength = strnlen(pcPath, ulLength);
+   pcCopy = malloc(ulLength + 1);
+   if (pcCopy == NULL)
+      return MEMORY_ERROR;
+   memcpy(pcCopy, pcPath, ulLength);
+   pcCopy[ulLength] = '\0';
+
+   free(psEntry->pcPath);
+   psEntry->pcPath = pcCopy;
+   return SUCCESS;
+}
+
+/*
+  Sets psEntry's path to the one in header block pcHeader: its name
+  field, after its prefix field and a '/' if it is a USTAR header
+  with a prefix. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Tar_headerPath(const char *pcHeader, struct entry *psEntry)
+{
+   char *pcPath;
+   size_t ulPrefix = 0;
+   size_t ulName;
+
+   assert(pcHeader != NULL);
+   assert(psEntry != NULL);
+
+   /* only a USTAR header's prefix field is part of its name */
+   if (strncmp(pcHeader + MAGIC_OFFSET, "ustar", 5) == 0)
+      ulPrefix = strnlen(pcHeader + PREFIX_OFFSET, PREFIX_LENGTH);
+   if (ulPrefix == 0)
+      return Tar_setPath(psEntry, pcHeader + NAME_OFFSET, NAME_LENGTH);
+
+   ulName = strnlen(pcHeader + NAME_OFFSET, NAME_LENGTH);
+   pcPath = malloc(ulPrefix + 1 + ulName + 1);
+   if (pcPath == NULL)
+      return MEMORY_ERROR;
+   memcpy(pcPath, pcHeader + PREFIX_OFFSET, ulPrefix);
+   pcPath[ulPrefix] = '/';
+   memcpy(pcPath + ulPrefix + 1, pcHeader + NAME_OFFSET, ulName);
+   pcPath[ulPrefix + 1 + ulName] = '\0';
+
+   free(psEntry->pcPath);
+   psEntry->pcPath = pcPath;
+   return SUCCESS;
+}
+
+/*
+  Applies the "path" and "size" records of the ulLength-byte PAX
+  extended header at pcData to psEntry; other records are ignored.
+  Returns SUCCESS, IO_ERROR if a record is malformed, or MEMORY_ERROR
+  if memory could not be allocated.
+*/
+static int Tar_parsePax(const char *pcData, size_t ulLength,
+                        struct entry *psEntry)
+{
+   const char *pcRecord;
+   const char *pcKey;
+   const char *pcValue;
+   size_t ulRecord;
+   size_t ulValue;
+   size_t ulSize;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(pcData != NULL || ulLength == 0);
+   assert(psEntry != NULL);
+
+   /* each record is "<length> <key>=<value>\n", <length> counting
+      the whole record */
+   while (ulLength > 0)
+   {
+      pcRecord = pcData;
+      ulRecord = 0;
+      for (ulIndex = 0; ulIndex < ulLength && pcRecord[ulIndex] != ' ';
+           ulIndex++)
+      {
+         if (pcRecord[ulIndex] < '0' || pcRecord[ulIndex] > '9'
+             || ulRecord > ulLength)
+            return IO_ERROR;
+         ulRecord = ulRecord * 10 + (size_t)(pcRecord[ulIndex] - '0');
+      }
+      if (ulRecord <= ulIndex + 1 || ulRecord > ulLength
+          || pcRecord[ulRecord - 1] != '\n')
+         return IO_ERROR;
+
+      pcKey = pcRecord + ulIndex + 1;
+      pcValue = memchr(pcKey, '=', (size_t)(pcRecord + ulRecord - pcKey));
+      if (pcValue == NULL)
+         return IO_ERROR;
+      pcValue++;
+      ulValue = (size_t)(pcRecord + ulRecord - 1 - pcValue);
+
+      if (pcValue - pcKey == 5 && strncmp(pcKey, "path=", 5) == 0)
+      {
+         iStatus = Tar_setPath(psEntry, pcValue, ulValue);
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+      else if (pcValue - pcKey == 5 && strncmp(pcKey, "size=", 5) == 0)
+      {
+         ulSize = 0;
+         for (ulIndex = 0; ulIndex < ulValue; ulIndex++)
+         {
+            if (pcValue[ulIndex] < '0' || pcValue[ulIndex] > '9'
+                || ulSize > ((size_t)-1 - 9) / 10)
+               return IO_ERROR;
+            ulSize = ulSize * 10 + (size_t)(pcValue[ulIndex] - '0');
+         }
+         psEntry->ulSize = ulSize;
+         psEntry->bHasSize = TRUE;
+      }
+
+      pcData += ulRecord;
+      ulLength -= ulRecord;
+   }
+   return SUCCESS;
+}
+
+/*
+  Turns the path of an archive entry into a tree path in place, by
+  dropping any leading "./" and '/' and any trailing '/'. Returns
+  where the tree path starts, which is an empty string for the
+  archive's top directory.
+*/
+static char *Tar_treePath(char *pcPath)
+{
+   size_t ulLength;
+
+   assert(pcPath != NULL);
+
+   for (;;)
+   {
+      if (pcPath[0] == '/')
+         pcPath++;
+      else if (pcPath[0] == '.' && pcPath[1] == '/')
+         pcPath += 2;
+      else
+         break;
+   }
+   if (strcmp(pcPath, ".") == 0)
+      pcPath++;
+
+   ulLength = strlen(pcPath);
+   while (ulLength > 0 && pcPath[ulLength - 1] == '/')
+      pcPath[--ulLength] = '\0';
+   return pcPath;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Makes the cursor of psImport end at the directory whose path is the
+  first ulDepth components of oPPath, creating it and any missing
+  ancestors. Only the components that differ from where the cursor
+  was are looked up. Returns SUCCESS, CONFLICTING_PATH if the path is
+  not under the root, NOT_A_DIRECTORY if it goes through a file, or
+  MEMORY_ERROR if memory could not be allocated.
+*/
+static int Tar_moveCursor(struct import *psImport, Path_T oPPath,
+                          size_t ulDepth)
+{
+   DynArray_T oDCursor;
+   const char *pcName;
+   Node_T oNDir;
+   Node_T oNChild = NULL;
+   size_t ulShared = 0;
+   size_t ulChildID;
+   int iStatus;
+
+   assert(psImport != NULL);
+   assert(oPPath != NULL);
+
+   oDCursor = psImport->oDCursor;
+
+   /* keep the directories the new path shares with the old one */
+   while (ulShared < ulDepth
+          && ulShared < DynArray_getLength(oDCursor)
+          && strcmp(Node_getName(DynArray_get(oDCursor, ulShared)),
+                    Path_getComponent(oPPath, ulShared)) == 0)
+      ulShared++;
+   DynArray_removeRange(oDCursor, ulShared,
+                        DynArray_getLength(oDCursor) - ulShared, NULL);
+
+   for (; ulShared < ulDepth; ulShared++)
+   {
+      pcName = Path_getComponent(oPPath, ulShared);
+
+      if (ulShared == 0 && psImport->oNRoot != NULL)
+      {
+         /* the root is the only directory of depth 1 */
+         if (strcmp(Node_getName(psImport->oNRoot), pcName) != 0)
+            return CONFLICTING_PATH;
+         if (!DynArray_add(oDCursor, psImport->oNRoot))
+            return MEMORY_ERROR;
+         continue;
+      }
+
+      if (ulShared == 0)
+      {
+         iStatus = Node_new(pcName, NULL, NULL, 0, FALSE, &oNChild);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         psImport->oNRoot = oNChild;
+      }
+      else
+      {
+         oNDir = DynArray_get(oDCursor, ulShared - 1);
+         if (Node_hasChild(oNDir, pcName, &ulChildID))
+         {
+            (void)Node_getChild(oNDir, ulChildID, &oNChild);
+            if (Node_isFile(oNChild))
+               return NOT_A_DIRECTORY;
+            if (!DynArray_add(oDCursor, oNChild))
+               return MEMORY_ERROR;
+            continue;
+         }
+         iStatus = Node_newChild(oNDir, pcName, FALSE, &oNChild);
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+
+      if (!DynArray_add(psImport->oDCreated, oNChild))
+      {
+         (void)Node_free(oNChild);
+         if (oNChild == psImport->oNRoot)
+            psImport->oNRoot = NULL;
+         return MEMORY_ERROR;
+      }
+      if (!DynArray_add(oDCursor, oNChild))
+         return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/*
+  Adds the entry psEntry of type cType, whose data comes next in
+  psSource, to psImport's tree, and moves past its data. Returns
+  SUCCESS or the status of the failure, as for Tar_import.
+*/
+static int Tar_addEntry(struct import *psImport, struct source *psSource,
+                        struct entry *psEntry, char cType)
+{
+   const char *pcPath;
+   const char *pcBytes;
+   Path_T oPPath = NULL;
+   Node_T oNDir;
+   Node_T oNFile = NULL;
+   Contents_T oCContents = NULL;
+   size_t ulDepth;
+   int iStatus;
+
+   assert(psImport != NULL);
+   assert(psSource != NULL);
+   assert(psEntry != NULL);
+
+   pcPath = Tar_treePath(psEntry->pcPath);
+   if (*pcPath == '\0')
+      return Tar_skip(psSource, psEntry->ulSize
+                      + Tar_padding(psEntry->ulSize));
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   ulDepth = Path_getDepth(oPPath);
+
+   if (cType == '5')
+   {
+      /* directories may be listed after what is in them */
+      iStatus = Tar_moveCursor(psImport, oPPath, ulDepth);
+      Path_free(oPPath);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      return Tar_skip(psSource, psEntry->ulSize
+                      + Tar_padding(psEntry->ulSize));
+   }
+
+   if (ulDepth == 1)
+   {
+      Path_free(oPPath);
+      if (psImport->oNRoot != NULL
+          && strcmp(Node_getName(psImport->oNRoot), pcPath) == 0)
+         return ALREADY_IN_TREE;
+      return CONFLICTING_PATH;
+   }
+
+   iStatus = Tar_moveCursor(psImport, oPPath, ulDepth - 1);
+   if (iStatus == SUCCESS)
+   {
+      oNDir = DynArray_get(psImport->oDCursor, ulDepth - 2);
+      iStatus = Node_newChild(oNDir,
+                              Path_getComponent(oPPath, ulDepth - 1),
+                              TRUE, &oNFile);
+   }
+   Path_free(oPPath);
+   if (iStatus != SUCCESS)
+      return iStatus;
+   if (!DynArray_add(psImport->oDCreated, oNFile))
+   {
+      (void)Node_free(oNFile);
+      return MEMORY_ERROR;
+   }
+
+   if (psEntry->ulSize != 0)
+   {
+      /* a mapped archive's bytes are shared, not copied */
+      if (psSource->oCMapped != NULL)
+      {
+         if (psEntry->ulSize > psSource->ulEnd - psSource->ulPos)
+            return IO_ERROR;
+         oCContents = Contents_newSlice(psSource->oCMapped,
+                                        psSource->ulPos,
+                                        psEntry->ulSize);
+         if (oCContents == NULL)
+            return MEMORY_ERROR;
+         psSource->ulPos += psEntry->ulSize;
+      }
+      else
+      {
+         iStatus = Tar_take(psSource, psEntry->ulSize, &pcBytes);
+         if (iStatus != SUCCESS)
+            return iStatus;
+         oCContents = Contents_new(pcBytes, psEntry->ulSize);
+         if (oCContents == NULL)
+            return MEMORY_ERROR;
+      }
+      Node_adoptContents(oNFile, oCContents);
+   }
+   return Tar_skip(psSource, Tar_padding(psEntry->ulSize));
+}
+
+/*
+  Reads entries from psSource into psImport's tree until the end of
+  the archive. Returns SUCCESS or the status of the failure, as for
+  Tar_import.
+*/
+static int Tar_readEntries(struct import *psImport,
+                           struct source *psSource)
+{
+   struct entry sEntry;
+   const char *pcHeader;
+   const char *pcData;
+   char acHeader[BLOCK_SIZE];
+   size_t ulStored;
+   size_t ulSize;
+   char cType;
+   int iStatus;
+
+   assert(psImport != NULL);
+   assert(psSource != NULL);
+
+   sEntry.pcPath = NULL;
+   sEntry.bHasSize = FALSE;
+
+   for (;;)
+   {
+      /* archives should end with zero blocks, but some just end */
+      iStatus = Tar_take(psSource, BLOCK_SIZE, &pcHeader);
+      if (iStatus != SUCCESS && psSource->bEnded)
+         iStatus = SUCCESS;
+      if (iStatus != SUCCESS)
+         break;
+      if (Tar_isZeroBlock(pcHeader))
+         break;
+
+      /* a streamed header is overwritten by the next read */
+      memcpy(acHeader, pcHeader, BLOCK_SIZE);
+      iStatus = Tar_parseNumber(acHeader + CHKSUM_OFFSET,
+                                CHKSUM_LENGTH, &ulStored);
+      if (iStatus == SUCCESS && ulStored != Tar_checksum(acHeader))
+         iStatus = IO_ERROR;
+      if (iStatus == SUCCESS)
+         iStatus = Tar_parseNumber(acHeader + SIZE_OFFSET, SIZE_LENGTH,
+                                   &ulSize);
+      if (iStatus != SUCCESS)
+         break;
+      if (sEntry.bHasSize)
+         ulSize = sEntry.ulSize;
+      cType = acHeader[TYPE_OFFSET];
+
+      if (cType == 'x' || cType == 'L')
+      {
+         /* extended headers describe the entry after them */
+         iStatus = Tar_take(psSource, ulSize, &pcData);
+         if (iStatus == SUCCESS && cType == 'x')
+            iStatus = Tar_parsePax(pcData, ulSize, &sEntry);
+         else if (iStatus == SUCCESS)
+            iStatus = Tar_setPath(&sEntry, pcData, ulSize);
+         if (iStatus == SUCCESS)
+            iStatus = Tar_skip(psSource, Tar_padding(ulSize));
+         if (iStatus != SUCCESS)
+            break;
+         continue;
+      }
+
+      if (sEntry.pcPath == NULL)
+      {
+         iStatus = Tar_headerPath(acHeader, &sEntry);
+         if (iStatus != SUCCESS)
+            break;
+      }
+      sEntry.ulSize = ulSize;
+
+      if (cType == '0' || cType == '\0' || cType == '5')
+         iStatus = Tar_addEntry(psImport, psSource, &sEntry, cType);
+      else
+         iStatus = Tar_skip(psSource, ulSize + Tar_padding(ulSize));
+      if (iStatus != SUCCESS)
+         break;
+
+      free(sEntry.pcPath);
+      sEntry.pcPath = NULL;
+      sEntry.bHasSize = FALSE;
+   }
+
+   free(sEntry.pcPath);
+   return iStatus;
+}
+
+int Tar_import(int iFd, Node_T *poNRoot, size_t *pulCount)
+{
+   struct import sImport;
+   struct source sSource;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(poNRoot != NULL);
+   assert(pulCount != NULL);
+
+   *pulCount = 0;
+   sImport.oNRoot = *poNRoot;
+   sImport.oDCursor = DynArray_new(0);
+   sImport.oDCreated = DynArray_new(0);
+   if (sImport.oDCursor == NULL || sImport.oDCreated == NULL)
+   {
+      if (sImport.oDCursor != NULL)
+         DynArray_free(sImport.oDCursor);
+      if (sImport.oDCreated != NULL)
+         DynArray_free(sImport.oDCreated);
+      return MEMORY_ERROR;
+   }
+
+   iStatus = Tar_open(iFd, &sSource);
+   if (iStatus == SUCCESS)
+   {
+      iStatus = Tar_readEntries(&sImport, &sSource);
+      if (iStatus != SUCCESS)
+      {
+         /* children were created after their parents */
+         for (ulIndex = DynArray_getLength(sImport.oDCreated);
+              ulIndex > 0; ulIndex--)
+            (void)Node_free(DynArray_get(sImport.oDCreated,
+                                         ulIndex - 1));
+      }
+      else
+      {
+         *poNRoot = sImport.oNRoot;
+         *pulCount = DynArray_getLength(sImport.oDCreated);
+      }
+      Tar_close(&sSource);
+   }
+
+   DynArray_free(sImport.oDCursor);
+   DynArray_free(sImport.oDCreated);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Writes ulLength bytes at pvBytes to iFd. Returns SUCCESS, or
+  IO_ERROR if they could not all be written.
+*/
+static int Tar_writeAll(int iFd, const void *pvBytes, size_t ulLength)
+{
+   const char *pcBytes = pvBytes;
+   ssize_t lWritten;
+
+   while (ulLength > 0)
+   {
+      lWritten = write(iFd, pcBytes, ulLength);
+      if (lWritten < 0 && errno == EINTR)
+         continue;
+      if (lWritten <= 0)
+         return IO_ERROR;
+      pcBytes += lWritten;
+      ulLength -= (size_t)lWritten;
+   }
+   return SUCCESS;
+}
+
+/* Writes out what psSink has buffered. Returns SUCCESS or IO_ERROR. */
+static int Tar_flush(struct sink *psSink)
+{
+   int iStatus;
+
+   assert(psSink != NULL);
+
+   iStatus = Tar_writeAll(psSink->iFd, psSink->acBuf, psSink->ulUsed);
+   psSink->ulUsed = 0;
+   return iStatus;
+}
+
+/*
+  Appends ulLength bytes at pvBytes, or zeros if pvBytes is NULL, to
+  psSink's archive. Long runs of bytes are written straight from
+  pvBytes. Returns SUCCESS or IO_ERROR.
+*/
+static int Tar_put(struct sink *psSink, const void *pvBytes,
+                   size_t ulLength)
+{
+   size_t ulSpace;
+   int iStatus;
+
+   assert(psSink != NULL);
+
+   if (pvBytes != NULL && ulLength >= BUFFER_SIZE)
+   {
+      iStatus = Tar_flush(psSink);
+      if (iStatus != SUCCESS)
+         return iStatus;
+      return Tar_writeAll(psSink->iFd, pvBytes, ulLength);
+   }
+
+   while (ulLength > 0)
+   {
+      if (psSink->ulUsed == BUFFER_SIZE)
+      {
+         iStatus = Tar_flush(psSink);
+         if (iStatus != SUCCESS)
+            return iStatus;
+      }
+      ulSpace = BUFFER_SIZE - psSink->ulUsed;
+      if (ulSpace > ulLength)
+         ulSpace = ulLength;
+      if (pvBytes == NULL)
+         memset(psSink->acBuf + psSink->ulUsed, 0, ulSpace);
+      else
+      {
+         memcpy(psSink->acBuf + psSink->ulUsed, pvBytes, ulSpace);
+         pvBytes = (const char *)pvBytes + ulSpace;
+      }
+      psSink->ulUsed += ulSpace;
+      ulLength -= ulSpace;
+   }
+   return SUCCESS;
+}
+
+/* Returns the number of decimal digits in ulValue. */
+static size_t Tar_digits(size_t ulValue)
+{
+   size_t ulDigits = 1;
+
+   while (ulValue >= 10)
+   {
+      ulValue /= 10;
+      ulDigits++;
+   }
+   return ulDigits;
+}
+
+/*
+  Appends the PAX record "<length> pcKey=pcValue\n" to the buffer at
+  pcRecords, which has room for it, and returns its length.
+*/
+static size_t Tar_paxRecord(char *pcRecords, const char *pcKey,
+                            const char *pcValue)
+{
+   size_t ulBody;
+   size_t ulLength;
+
+   assert(pcRecords != NULL);
+   assert(pcKey != NULL);
+   assert(pcValue != NULL);
+
+   /* the length counts its own digits */
+   ulBody = 1 + strlen(pcKey) + 1 + strlen(pcValue) + 1;
+   ulLength = ulBody + Tar_digits(ulBody);
+   if (Tar_digits(ulLength) != Tar_digits(ulBody))
+      ulLength++;
+
+   sprintf(pcRecords, "%lu %s=%s\n", (unsigned long)ulLength, pcKey,
+           pcValue);
+   return ulLength;
+}
+
+/*
+  Fills the header block pcHeader for an entry of ulSize bytes, type
+  cType and permissions uMode, whose name field is the ulNameLength
+  bytes at pcName and whose prefix field is the ulPrefixLength bytes
+  at pcPrefix, or empty if pcPrefix is NULL.
+*/
+static void Tar_fillHeader(char *pcHeader, const char *pcName,
+                           size_t ulNameLength, const char *pcPrefix,
+                           size_t ulPrefixLength, size_t ulSize,
+                           char cType, unsigned int uMode)
+{
+   assert(pcHeader != NULL);
+   assert(pcName != NULL);
+   assert(ulNameLength <= NAME_LENGTH);
+   assert(ulPrefixLength <= PREFIX_LENGTH);
+   assert(ulSize <= MAX_OCTAL_SIZE);
+
+   memset(pcHeader, 0, BLOCK_SIZE);
+   memcpy(pcHeader + NAME_OFFSET, pcName, ulNameLength);
+   if (pcPrefix != NULL)
+      memcpy(pcHeader + PREFIX_OFFSET, pcPrefix, ulPrefixLength);
+   sprintf(pcHeader + MODE_OFFSET, "%07o", uMode);
+   sprintf(pcHeader + UID_OFFSET, "%07o", 0U);
+   sprintf(pcHeader + GID_OFFSET, "%07o", 0U);
+   sprintf(pcHeader + SIZE_OFFSET, "%011lo", (unsigned long)ulSize);
+   sprintf(pcHeader + MTIME_OFFSET, "%011lo", 0UL);
+   pcHeader[TYPE_OFFSET] = cType;
+   memcpy(pcHeader + MAGIC_OFFSET, "ustar", 6);
+   memcpy(pcHeader + VERSION_OFFSET, "00", 2);
+
+   sprintf(pcHeader + CHKSUM_OFFSET, "%06lo",
+           (unsigned long)Tar_checksum(pcHeader));
+   pcHeader[CHKSUM_OFFSET + CHKSUM_LENGTH - 1] = ' ';
+}
+
+/*
+  Appends the header of an entry with path pcPath (ending in '/' for
+  a directory), ulSize bytes and type cType to psSink's archive. A
+  path that does not fit the USTAR name and prefix fields, or a size
+  too large for USTAR, is given in a PAX extended header first.
+  Returns SUCCESS, IO_ERROR or MEMORY_ERROR.
+*/
+static int Tar_putHeader(struct sink *psSink, const char *pcPath,
+                         size_t ulSize, char cType)
+{
+   char acHeader[BLOCK_SIZE];
+   char acSize[32];
+   char *pcRecords;
+   size_t ulPath;
+   size_t ulSplit;
+   size_t ulRecords = 0;
+   boolean bFits = FALSE;
+   unsigned int uMode;
+   int iStatus;
+
+   assert(psSink != NULL);
+   assert(pcPath != NULL);
+
+   /* split at the first '/' that leaves the rest short enough */
+   ulPath = strlen(pcPath);
+   if (ulPath <= NAME_LENGTH)
+   {
+      bFits = TRUE;
+      ulSplit = 0;
+   }
+   else
+   {
+      for (ulSplit = ulPath - NAME_LENGTH - 1;
+           ulSplit <= PREFIX_LENGTH && ulSplit < ulPath - 1; ulSplit++)
+      {
+         if (pcPath[ulSplit] == '/' && ulSplit != 0)
+         {
+            bFits = TRUE;
+            break;
+         }
+      }
+   }
+
+   if (!bFits || ulSize > MAX_OCTAL_SIZE)
+   {
+      pcRecords = malloc(2 * ulPath + 128);
+      if (pcRecords == NULL)
+         return MEMORY_ERROR;
+      if (!bFits)
+         ulRecords += Tar_paxRecord(pcRecords, "path", pcPath);
+      if (ulSize > MAX_OCTAL_SIZE)
+      {
+         sprintf(acSize, "%lu", (unsigned long)ulSize);
+         ulRecords += Tar_paxRecord(pcRecords + ulRecords, "size",
+                                    acSize);
+      }
+
+      Tar_fillHeader(acHeader, "././@PaxHeader", 14, NULL, 0,
+                     ulRecords, 'x', 0644);
+      iStatus = Tar_put(psSink, acHeader, BLOCK_SIZE);
+      if (iStatus == SUCCESS)
+         iStatus = Tar_put(psSink, pcRecords, ulRecords);
+      if (iStatus == SUCCESS)
+         iStatus = Tar_put(psSink, NULL, Tar_padding(ulRecords));
+      free(pcRecords);
+      if (iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   /* the USTAR header still carries what of the entry it can */
+   if (ulSize > MAX_OCTAL_SIZE)
+      ulSize = 0;
+   uMode = (cType == '5') ? 0755U : 0644U;
+   if (!bFits)
+      Tar_fillHeader(acHeader, pcPath + ulPath - NAME_LENGTH,
+                     NAME_LENGTH, NULL, 0, ulSize, cType, uMode);
+   else if (ulSplit == 0)
+      Tar_fillHeader(acHeader, pcPath, ulPath, NULL, 0, ulSize, cType,
+                     uMode);
+   else
+      Tar_fillHeader(acHeader, pcPath + ulSplit + 1,
+                     ulPath - ulSplit - 1, pcPath, ulSplit, ulSize,
+                     cType, uMode);
+   return Tar_put(psSink, acHeader, BLOCK_SIZE);
+}
+
+/*
+  Appends the entry for oNNode to psSink's archive: its header and,
+  for a file, its contents, written from where they are stored.
+  Returns SUCCESS, IO_ERROR or MEMORY_ERROR.
+*/
+static int Tar_putNode(struct sink *psSink, Node_T oNNode)
+{
+   Path_T oPPath;
+   const char *pcPathname;
+   char *pcPath;
+   const void *pvSpan;
+   size_t ulPath;
+   size_t ulSize;
+   size_t ulDone = 0;
+   size_t ulSpan;
+   int iStatus;
+
+   assert(psSink != NULL);
+   assert(oNNode != NULL);
+
+   oPPath = Node_getPath(oNNode);
+   if (oPPath == NULL)
+      return MEMORY_ERROR;
+   pcPathname = Path_getPathname(oPPath);
+   ulPath = strlen(pcPathname);
+
+   /* directories are told apart by a trailing '/' too */
+   pcPath = malloc(ulPath + 2);
+   if (pcPath == NULL)
+      return MEMORY_ERROR;
+   memcpy(pcPath, pcPathname, ulPath + 1);
+   if (!Node_isFile(oNNode))
+      strcpy(pcPath + ulPath, "/");
+
+   ulSize = Node_isFile(oNNode) ? Node_getFileSize(oNNode) : 0;
+   iStatus = Tar_putHeader(psSink, pcPath, ulSize,
+                           Node_isFile(oNNode) ? '0' : '5');
+   free(pcPath);
+
+   while (iStatus == SUCCESS && ulDone < ulSize)
+   {
+      ulSpan = Node_getFileSpan(oNNode, ulDone, &pvSpan);
+      if (ulSpan == 0)
+         return IO_ERROR;
+      iStatus = Tar_put(psSink, pvSpan, ulSpan);
+      ulDone += ulSpan;
+   }
+   if (iStatus != SUCCESS)
+      return iStatus;
+   return Tar_put(psSink, NULL, Tar_padding(ulSize));
+}
+
+/*
+  Appends the entries for the subtree rooted at directory oNDir to
+  psSink's archive: oNDir, its files, then its subdirectories' trees.
+  Returns SUCCESS, IO_ERROR or MEMORY_ERROR.
+*/
+static int Tar_putTree(struct sink *psSink, Node_T oNDir)
+{
+   Node_T oNChild = NULL;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(psSink != NULL);
+   assert(oNDir != NULL);
+
+   iStatus = Tar_putNode(psSink, oNDir);
+   for (ulIndex = 0; iStatus == SUCCESS
+        && ulIndex < Node_getNumChildren(oNDir); ulIndex++)
+   {
+      (void)Node_getChild(oNDir, ulIndex, &oNChild);
+      if (Node_isFile(oNChild))
+         iStatus = Tar_putNode(psSink, oNChild);
+   }
+   for (ulIndex = 0; iStatus == SUCCESS
+        && ulIndex < Node_getNumChildren(oNDir); ulIndex++)
+   {
+      (void)Node_getChild(oNDir, ulIndex, &oNChild);
+      if (!Node_isFile(oNChild))
+         iStatus = Tar_putTree(psSink, oNChild);
+   }
+   return iStatus;
+}
+
+int Tar_export(Node_T oNRoot, int iFd)
+{
+   struct sink *psSink;
+   int iStatus = SUCCESS;
+
+   psSink = malloc(sizeof(struct sink));
+   if (psSink == NULL)
+      return MEMORY_ERROR;
+   psSink->iFd = iFd;
+   psSink->ulUsed = 0;
+
+   if (oNRoot != NULL)
+      iStatus = Tar_putTree(psSink, oNRoot);
+   /* the archive ends with two zero blocks */
+   if (iStatus == SUCCESS)
+      iStatus = Tar_put(psSink, NULL, 2 * BLOCK_SIZE);
+   if (iStatus == SUCCESS)
+      iStatus = Tar_flush(psSink);
+
+   free(psSink);
+   return iStatus;
+}
@@ -0,0 +1,47 @@
+/*--------------------------------------------------------------------*/
+/* tar.h                                                              */
+/* Author: Ariella and Yoni                                           */
+/*--------------------------------------------------------------------*/
+
+#ifndef TAR_INCLUDED
+#define TAR_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  Reads a USTAR archive, with PAX or GNU long-name extensions, from
+  iFd, starting at its current offset, and adds its directories and
+  regular files to the tree rooted at *poNRoot, creating the root
+  (and setting *poNRoot) if it is NULL. Other entry types are skipped.
+  If iFd is a regular file, the archive is mapped and each file's
+  contents are a slice of the mapping rather than a copy; otherwise
+  the archive is read as a stream. Consecutive entries in the same
+  directory are linked under it directly, without looking it up
+  again. Missing ancestor directories are created, and directories
+  already in the tree are reused.
+  Sets *pulCount to the number of nodes created.
+  Returns SUCCESS, or, leaving the tree and *poNRoot unchanged:
+  * CONFLICTING_PATH if an entry is not under the root
+  * BAD_PATH if an entry's path is not a valid path
+  * NOT_A_DIRECTORY if an entry is under a file
+  * ALREADY_IN_TREE if a file entry is already in the tree
+  * IO_ERROR if iFd could not be read, or the archive is malformed
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Tar_import(int iFd, Node_T *poNRoot, size_t *pulCount);
+
+/*
+  Writes the tree rooted at oNRoot (which may be NULL for an empty
+  tree) to iFd as a USTAR archive, using PAX headers for paths or
+  sizes that USTAR cannot hold. Entries are written in the same order
+  as FT_toString lists them, and file contents are written straight
+  from where they are stored. The tree is only read.
+  Returns SUCCESS, or, possibly leaving a partial archive:
+  * IO_ERROR if iFd could not be written
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Tar_export(Node_T oNRoot, int iFd);
+
+#endif